@@ -0,0 +1,536 @@
+/* Copyright 2017-2018 NXP
+ *
+ * SPDX-License-Identifier: GPL-2.0
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sched.h>
+#include <pthread.h>
+#include <net/if.h>
+
+#include "ceetm_burst.h"
+#include "ceetm_hier.h"
+#include "ceetmctl.h"
+
+/* Microburst sampler. A sampler thread, pinned to one CPU, dumps the class
+ * xstats of an interface at a fixed rate and pushes the counters of the
+ * selected classes to a single producer / single consumer ring. A writer
+ * thread drains the ring into an optional binary trace and per-class
+ * histograms of the throughput over each interval, and of the intervals
+ * where rejects start after a clean one.
+ *
+ * The trace format is in ceetm_burst.h.
+ */
+
+#define CEETM_BURST_DEF_HZ	1000
+#define CEETM_BURST_MAX_HZ	10000
+/* Power of two: 6.5 s of samples of one class at 10 kHz, 0.1 s of all
+ * CEETM_BURST_MAX_CLASSES, the writer only has to keep up with that
+ */
+#define CEETM_BURST_RING_SIZE	(1 << 16)
+/* Throughput buckets: [2^k, 2^(k+1)) bytes per second */
+#define CEETM_BURST_BUCKETS	48
+#define CEETM_BURST_TRACE_BUFSIZE	(1 << 20)
+
+struct ceetm_burst_class {
+	__u32 handle;
+	bool seen;
+	struct ceetm_burst_rec last;
+	bool rejecting;
+	__u64 intervals;
+	__u64 onsets;
+	__u64 rej_frames;
+	double peak;
+	double bytes;
+	double secs;
+	__u64 hist[CEETM_BURST_BUCKETS];
+	__u64 onset_hist[CEETM_BURST_BUCKETS];
+};
+
+/* Single producer (the sampler), single consumer (the writer). Each index
+ * is only written by its owner and published with release semantics.
+ */
+struct ceetm_burst_ring {
+	struct ceetm_burst_rec *recs;
+	__u32 head;
+	char pad[60];
+	__u32 tail;
+};
+
+struct ceetm_burst {
+	enum dpaa_version ver;
+	int ifindex;
+	struct ceetm_nl nl;
+	struct ceetm_burst_class classes[CEETM_BURST_MAX_CLASSES];
+	int nclasses;
+	__u64 interval_ns;
+	struct ceetm_burst_ring ring;
+	FILE *trace;
+	char *trace_buf;
+	/* Sampler statistics */
+	__u64 polls;
+	__u64 overruns;
+	__u64 dropped;
+	__u64 now_ns;
+	int err;
+	/* Set once the sampler is done, the writer then drains and stops */
+	int done;
+};
+
+static volatile sig_atomic_t ceetm_burst_stop;
+
+static void explain(void)
+{
+	fprintf(stderr, "Usage: ceetmctl burst dev DEV class CLASSID "
+		"[class CLASSID]... [rate HZ]\n"
+		"	[cpu N] [duration S] [trace FILE] [soc SOC]\n"
+		"\n"
+		"Sample the xstats of the given classes HZ times per second\n"
+		"(default %d, at most %d) from a thread pinned to CPU N, for S\n"
+		"seconds or until interrupted. A histogram of the throughput\n"
+		"per interval and of the intervals where rejects start is\n"
+		"printed for every class, the raw samples go to FILE.\n",
+		CEETM_BURST_DEF_HZ, CEETM_BURST_MAX_HZ);
+}
+
+static void ceetm_burst_signal(int sig)
+{
+	ceetm_burst_stop = 1;
+}
+
+static __u64 ceetm_burst_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (__u64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static bool ceetm_burst_push(struct ceetm_burst_ring *r,
+			     const struct ceetm_burst_rec *rec)
+{
+	__u32 head = r->head;
+
+	if (head - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE) ==
+	    CEETM_BURST_RING_SIZE)
+		return false;
+
+	r->recs[head & (CEETM_BURST_RING_SIZE - 1)] = *rec;
+	__atomic_store_n(&r->head, head + 1, __ATOMIC_RELEASE);
+
+	return true;
+}
+
+static bool ceetm_burst_pop(struct ceetm_burst_ring *r,
+			    struct ceetm_burst_rec *rec)
+{
+	__u32 tail = r->tail;
+
+	if (tail == __atomic_load_n(&r->head, __ATOMIC_ACQUIRE))
+		return false;
+
+	*rec = r->recs[tail & (CEETM_BURST_RING_SIZE - 1)];
+	__atomic_store_n(&r->tail, tail + 1, __ATOMIC_RELEASE);
+
+	return true;
+}
+
+static int ceetm_burst_cb(const struct ceetm_xstats *st, void *arg)
+{
+	struct ceetm_burst *b = arg;
+	struct ceetm_burst_rec rec;
+	int i;
+
+	for (i = 0; i < b->nclasses; i++)
+		if (b->classes[i].handle == st->handle)
+			break;
+
+	if (i == b->nclasses)
+		return 0;
+
+	memset(&rec, 0, sizeof(rec));
+	rec.ts_ns = b->now_ns;
+	rec.handle = st->handle;
+	rec.idx = i;
+
+	if (st->ver == DPAA_1) {
+		rec.deq_bytes = st->d1.byte_count;
+		rec.deq_frames = st->d1.frame_count;
+		rec.rej_frames = st->d1.ern_drop_count;
+	} else {
+		rec.deq_bytes = st->d2.ceetm_dequeue_bytes;
+		rec.deq_frames = st->d2.ceetm_dequeue_frames;
+		rec.rej_bytes = st->d2.ceetm_reject_bytes;
+		rec.rej_frames = st->d2.ceetm_reject_frames;
+	}
+
+	/* Never block the sampler, a full ring loses the sample */
+	if (!ceetm_burst_push(&b->ring, &rec))
+		b->dropped++;
+
+	return 0;
+}
+
+static void *ceetm_burst_sampler(void *arg)
+{
+	struct ceetm_burst *b = arg;
+	struct timespec next;
+	__u64 deadline, now;
+
+	deadline = ceetm_burst_ns();
+
+	while (!ceetm_burst_stop) {
+		/* All the samples of a poll share the time the dump started */
+		b->now_ns = ceetm_burst_ns();
+		b->err = ceetm_class_xstats_dump(&b->nl, b->ver, b->ifindex,
+						 ceetm_burst_cb, b);
+		if (b->err)
+			break;
+		b->polls++;
+
+		deadline += b->interval_ns;
+		now = ceetm_burst_ns();
+		if (now >= deadline) {
+			/* Late: skip the missed slots instead of catching up */
+			b->overruns++;
+			deadline = now;
+			continue;
+		}
+
+		next.tv_sec = deadline / 1000000000ULL;
+		next.tv_nsec = deadline % 1000000000ULL;
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next,
+				       NULL) == EINTR && !ceetm_burst_stop)
+			;
+	}
+
+	__atomic_store_n(&b->done, 1, __ATOMIC_RELEASE);
+	return NULL;
+}
+
+static int ceetm_burst_bucket(double rate)
+{
+	int k = 0;
+
+	while (rate >= 2 && k < CEETM_BURST_BUCKETS - 1) {
+		rate /= 2;
+		k++;
+	}
+
+	return k;
+}
+
+static void ceetm_burst_account(struct ceetm_burst *b,
+				const struct ceetm_burst_rec *rec)
+{
+	struct ceetm_burst_class *c = &b->classes[rec->idx];
+	double secs, rate;
+	__u64 rej;
+	int k;
+
+	if (c->seen && rec->ts_ns > c->last.ts_ns) {
+		secs = (rec->ts_ns - c->last.ts_ns) / 1e9;
+		rate = (rec->deq_bytes - c->last.deq_bytes) / secs;
+		rej = rec->rej_frames - c->last.rej_frames;
+		k = ceetm_burst_bucket(rate);
+
+		c->intervals++;
+		c->hist[k]++;
+		c->bytes += rec->deq_bytes - c->last.deq_bytes;
+		c->secs += secs;
+		c->rej_frames += rej;
+		if (rate > c->peak)
+			c->peak = rate;
+
+		if (rej && !c->rejecting) {
+			c->onsets++;
+			c->onset_hist[k]++;
+		}
+		c->rejecting = rej != 0;
+	}
+
+	c->last = *rec;
+	c->seen = true;
+}
+
+static void *ceetm_burst_writer(void *arg)
+{
+	struct ceetm_burst *b = arg;
+	struct ceetm_burst_rec rec;
+	struct timespec idle = { 0, 200000 };
+
+	for (;;) {
+		if (!ceetm_burst_pop(&b->ring, &rec)) {
+			/* The sampler may have pushed its last samples just
+			 * before finishing, look once more.
+			 */
+			if (!__atomic_load_n(&b->done, __ATOMIC_ACQUIRE)) {
+				nanosleep(&idle, NULL);
+				continue;
+			}
+			if (!ceetm_burst_pop(&b->ring, &rec))
+				break;
+		}
+
+		ceetm_burst_account(b, &rec);
+		if (b->trace)
+			fwrite(&rec, sizeof(rec), 1, b->trace);
+	}
+
+	return NULL;
+}
+
+static void ceetm_burst_print(const struct ceetm_burst *b)
+{
+	const struct ceetm_burst_class *c;
+	char buf[64], id[16];
+	struct ceetm_node node;
+	__u64 max;
+	int i, k, bar;
+
+	memset(&node, 0, sizeof(node));
+	node.kind = CEETM_NODE_CLASS;
+
+	fprintf(stdout, "%llu polls, %llu overruns, %llu samples dropped\n",
+		b->polls, b->overruns, b->dropped);
+
+	for (i = 0; i < b->nclasses; i++) {
+		c = &b->classes[i];
+		node.handle = c->handle;
+
+		fprintf(stdout, "\nclass %s: %llu intervals, %llu rejected "
+			"frames, %llu reject onsets\n",
+			ceetm_node_id(&node, id, sizeof(id)), c->intervals,
+			c->rej_frames, c->onsets);
+		if (!c->intervals)
+			continue;
+
+		print_rate(buf, sizeof(buf), c->bytes / c->secs);
+		fprintf(stdout, "  mean %s", buf);
+		print_rate(buf, sizeof(buf), c->peak);
+		fprintf(stdout, " peak %s\n", buf);
+
+		for (max = 0, k = 0; k < CEETM_BURST_BUCKETS; k++)
+			if (c->hist[k] > max)
+				max = c->hist[k];
+
+		for (k = 0; k < CEETM_BURST_BUCKETS; k++) {
+			if (!c->hist[k])
+				continue;
+
+			print_rate(buf, sizeof(buf), k ? 1ULL << k : 0);
+			bar = c->hist[k] * 40 / max;
+			fprintf(stdout, "  >= %-10s %10llu %8llu onsets |%.*s\n",
+				buf, c->hist[k], c->onset_hist[k], bar ? bar : 1,
+				"########################################");
+		}
+	}
+}
+
+static int ceetm_burst_open_trace(struct ceetm_burst *b, const char *path)
+{
+	struct ceetm_burst_hdr hdr;
+	int i;
+
+	b->trace = fopen(path, "w");
+	if (!b->trace) {
+		perror(path);
+		return -1;
+	}
+
+	/* One large buffer, the writer only does whole-buffer writes */
+	b->trace_buf = malloc(CEETM_BURST_TRACE_BUFSIZE);
+	if (b->trace_buf)
+		setvbuf(b->trace, b->trace_buf, _IOFBF,
+			CEETM_BURST_TRACE_BUFSIZE);
+
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, CEETM_BURST_MAGIC, sizeof(hdr.magic));
+	hdr.version = CEETM_BURST_VERSION;
+	hdr.dpaa_version = b->ver == DPAA_1 ? 1 : 2;
+	hdr.ifindex = b->ifindex;
+	hdr.nclasses = b->nclasses;
+	hdr.interval_ns = b->interval_ns;
+	for (i = 0; i < b->nclasses; i++)
+		hdr.handles[i] = b->classes[i].handle;
+
+	if (fwrite(&hdr, sizeof(hdr), 1, b->trace) != 1) {
+		perror(path);
+		return -1;
+	}
+
+	return 0;
+}
+
+int do_burst(int argc, char **argv)
+{
+	pthread_t sampler, writer;
+	pthread_attr_t attr;
+	cpu_set_t cpus;
+	const char *dev = NULL, *trace = NULL;
+	unsigned int hz = CEETM_BURST_DEF_HZ, duration = 0;
+	struct ceetm_burst *b;
+	int cpu = -1, err, ret = -1;
+	__u32 handle;
+
+	b = calloc(1, sizeof(*b));
+	if (!b)
+		return -1;
+	b->nl.fd = -1;
+	b->ver = detect_dpaa_version();
+
+	while (argc > 0) {
+		if (strcmp(*argv, "dev") == 0) {
+			NEXT_ARG();
+			dev = *argv;
+
+		} else if (strcmp(*argv, "class") == 0) {
+			NEXT_ARG();
+			if (get_tc_classid(&handle, *argv)) {
+				fprintf(stderr, "Invalid class ID.\n");
+				goto out;
+			}
+			if (b->nclasses == CEETM_BURST_MAX_CLASSES) {
+				fprintf(stderr, "At most %d classes can be "
+						"sampled.\n",
+					CEETM_BURST_MAX_CLASSES);
+				goto out;
+			}
+			b->classes[b->nclasses++].handle = handle;
+
+		} else if (strcmp(*argv, "rate") == 0) {
+			NEXT_ARG();
+			if (get_unsigned(&hz, *argv, 10) || !hz ||
+			    hz > CEETM_BURST_MAX_HZ) {
+				fprintf(stderr, "Illegal rate argument: must be "
+						"between 1 and %d.\n",
+					CEETM_BURST_MAX_HZ);
+				goto out;
+			}
+
+		} else if (strcmp(*argv, "cpu") == 0) {
+			NEXT_ARG();
+			if (get_integer(&cpu, *argv, 10) || cpu < 0 ||
+			    cpu >= CPU_SETSIZE) {
+				fprintf(stderr, "Illegal cpu argument.\n");
+				goto out;
+			}
+
+		} else if (strcmp(*argv, "duration") == 0) {
+			NEXT_ARG();
+			if (get_unsigned(&duration, *argv, 10)) {
+				fprintf(stderr, "Illegal duration argument.\n");
+				goto out;
+			}
+
+		} else if (strcmp(*argv, "trace") == 0) {
+			NEXT_ARG();
+			trace = *argv;
+
+		} else if (strcmp(*argv, "soc") == 0) {
+			NEXT_ARG();
+			if (ceetmctl_parse_soc(*argv, &b->ver))
+				goto out;
+
+		} else if (strcmp(*argv, "help") == 0) {
+			explain();
+			goto out;
+
+		} else {
+			fprintf(stderr, "Illegal argument - %s.\n", *argv);
+			explain();
+			goto out;
+		}
+
+		argc--; argv++;
+	}
+
+	if (!dev || !b->nclasses) {
+		fprintf(stderr, "Please specify the device and at least one "
+				"class.\n");
+		goto out;
+	}
+
+	b->ifindex = if_nametoindex(dev);
+	if (!b->ifindex) {
+		fprintf(stderr, "Cannot find device \"%s\".\n", dev);
+		goto out;
+	}
+
+	b->interval_ns = 1000000000ULL / hz;
+	b->ring.recs = calloc(CEETM_BURST_RING_SIZE, sizeof(*b->ring.recs));
+	if (!b->ring.recs) {
+		fprintf(stderr, "Out of memory.\n");
+		goto out;
+	}
+
+	if (trace && ceetm_burst_open_trace(b, trace))
+		goto out;
+
+	if (ceetm_nl_open(&b->nl))
+		goto out;
+
+	signal(SIGINT, ceetm_burst_signal);
+	signal(SIGTERM, ceetm_burst_signal);
+	signal(SIGALRM, ceetm_burst_signal);
+	if (duration)
+		alarm(duration);
+
+	pthread_attr_init(&attr);
+	if (cpu >= 0) {
+		CPU_ZERO(&cpus);
+		CPU_SET(cpu, &cpus);
+		err = pthread_attr_setaffinity_np(&attr, sizeof(cpus), &cpus);
+		if (err) {
+			fprintf(stderr, "Cannot pin the sampler to CPU %d: %s\n",
+				cpu, strerror(err));
+			pthread_attr_destroy(&attr);
+			goto out;
+		}
+	}
+
+	err = pthread_create(&writer, NULL, ceetm_burst_writer, b);
+	if (err) {
+		fprintf(stderr, "Cannot start the writer thread: %s\n",
+			strerror(err));
+		pthread_attr_destroy(&attr);
+		goto out;
+	}
+
+	/* An offline or missing cpu only shows up here */
+	err = pthread_create(&sampler, &attr, ceetm_burst_sampler, b);
+	if (err) {
+		fprintf(stderr, "Cannot start the sampler thread: %s\n",
+			strerror(err));
+		__atomic_store_n(&b->done, 1, __ATOMIC_RELEASE);
+	} else {
+		pthread_join(sampler, NULL);
+	}
+	pthread_join(writer, NULL);
+	pthread_attr_destroy(&attr);
+	if (err)
+		goto out;
+
+	if (b->err)
+		fprintf(stderr, "Sampling stopped: cannot dump the classes.\n");
+
+	ceetm_burst_print(b);
+	ret = b->err ? -1 : 0;
+
+out:
+	if (b->trace && fclose(b->trace)) {
+		perror(trace);
+		ret = -1;
+	}
+	free(b->trace_buf);
+	ceetm_nl_close(&b->nl);
+	free(b->ring.recs);
+	free(b);
+	return ret;
+}
@@ -0,0 +1,41 @@
+/* Copyright 2017-2018 NXP
+ *
+ * SPDX-License-Identifier: GPL-2.0
+ */
+
+#ifndef __CEETM_BURST_H
+#define __CEETM_BURST_H
+
+#include <linux/types.h>
+
+/* Trace of the microburst sampler. It starts with a struct ceetm_burst_hdr
+ * and continues with one struct ceetm_burst_rec per class and poll, in
+ * host byte order, with the raw counters so any interval can be
+ * recomputed offline.
+ */
+
+#define CEETM_BURST_MAGIC	"CEETMBT1"
+#define CEETM_BURST_VERSION	1
+#define CEETM_BURST_MAX_CLASSES	64
+
+struct ceetm_burst_hdr {
+	char magic[8];
+	__u32 version;
+	__u32 dpaa_version;
+	__u32 ifindex;
+	__u32 nclasses;
+	__u64 interval_ns;
+	__u32 handles[CEETM_BURST_MAX_CLASSES];
+};
+
+struct ceetm_burst_rec {
+	__u64 ts_ns;
+	__u32 handle;
+	__u32 idx; /* position of the handle in the header */
+	__u64 deq_bytes;
+	__u64 deq_frames;
+	__u64 rej_bytes; /* 0 on DPAA1, only frames are counted */
+	__u64 rej_frames;
+};
+
+#endif
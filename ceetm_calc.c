@@ -0,0 +1,741 @@
+/* Copyright 2017-2018 NXP
+ *
+ * SPDX-License-Identifier: GPL-2.0
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "ceetm_calc.h"
+#include "ceetmctl.h"
+
+/* The model works on the configuration only, at the rate level:
+ *
+ * - The LNI hands out its capacity (the link rate, capped by the rate +
+ *   ceil of a shaped DPAA1 LNI) in three strict tiers: the CR of the
+ *   shaped channels, then their ER, then the unshaped channels weighted by
+ *   their tbl. Inside a tier the bandwidth is shared max-min fairly,
+ *   weighted by the configured CR, ER or tbl.
+ * - A channel serves its class queues in strict priority order. The CR
+ *   pool only serves CR eligible queues and the ER pool only ER eligible
+ *   ones; an unshaped channel has a single pool serving everybody.
+ * - A weighted group (DPAA1 wbfs, DPAA2 WEIGHTED_A / WEIGHTED_B) takes one
+ *   position in the priority order and shares what it gets max-min fairly.
+ *   A DPAA1 group with a position is served right after that independent
+ *   class queue, otherwise in place of the prio class it is grafted on.
+ *   DPAA2 weights are proportional to the bandwidth share, the DPAA1 WBFS
+ *   qweight is a crediting weight, the share goes with its inverse. The
+ *   weights can be raised to a calibrated power, see ceetmctl calibrate.
+ *   The class queues of a flow-hashed group have equal weights.
+ */
+
+/* Priority slots of a channel: up to eight queues or groups */
+#define CEETM_CALC_MAX_SLOTS	(CEETM_MAX_PRIO_QCOUNT + 2)
+
+struct ceetm_calc_slot {
+	int prio;
+	bool cr;
+	bool er;
+	int count;
+	int member[CEETM_MAX_WBFS_QCOUNT];
+	double weight[CEETM_MAX_WBFS_QCOUNT];
+};
+
+bool ceetm_calc_is_leaf(const struct ceetm_hier *h, int idx)
+{
+	return h->nodes[idx].kind == CEETM_NODE_CLASS && h->nodes[idx].child < 0;
+}
+
+int ceetm_calc_init(struct ceetm_calc *c, const struct ceetm_hier *h,
+		    double linkrate)
+{
+	int n = h->count ? h->count : 1;
+	int i;
+
+	memset(c, 0, sizeof(*c));
+	c->h = h;
+	c->linkrate = linkrate;
+	c->weight_exp = 1;
+
+	c->offered = calloc(n, sizeof(*c->offered));
+	c->frame_size = calloc(n, sizeof(*c->frame_size));
+	c->alloc = calloc(n, sizeof(*c->alloc));
+	c->scratch = calloc(7 * n, sizeof(*c->scratch));
+	c->order = calloc(n, sizeof(*c->order));
+
+	if (!c->offered || !c->frame_size || !c->alloc || !c->scratch || !c->order) {
+		fprintf(stderr, "Out of memory.\n");
+		ceetm_calc_free(c);
+		return -1;
+	}
+
+	for (i = 0; i < h->count; i++)
+		c->offered[i] = INFINITY;
+
+	return 0;
+}
+
+void ceetm_calc_free(struct ceetm_calc *c)
+{
+	free(c->offered);
+	free(c->frame_size);
+	free(c->alloc);
+	free(c->scratch);
+	free(c->order);
+	c->offered = NULL;
+	c->frame_size = NULL;
+	c->alloc = NULL;
+	c->scratch = NULL;
+	c->order = NULL;
+}
+
+/* Bytes accounted by the hardware per byte counted on a leaf */
+static double ceetm_calc_wire(const struct ceetm_calc *c, int leaf)
+{
+	double size = c->frame_size[leaf];
+
+	return size > 0 ? (size + c->overhead) / size : 1;
+}
+
+/* Weighted max-min fair share of a pool between n demands: demands are
+ * visited by increasing demand / weight, the ones below the current fair
+ * level are served in full and the rest split what is left. Returns the
+ * bandwidth handed out.
+ */
+static double ceetm_calc_fill(double pool, int n, const double *demand,
+			      const double *weight, double *out, int *order)
+{
+	double left = pool, sumw = 0, level;
+	int i, j, k;
+
+	for (i = 0; i < n; i++) {
+		sumw += weight[i];
+
+		/* Insertion sort, n is a handful of queues or channels */
+		for (j = i; j > 0; j--) {
+			k = order[j - 1];
+			if (demand[k] * weight[i] <= demand[i] * weight[k])
+				break;
+			order[j] = k;
+		}
+		order[j] = i;
+	}
+
+	for (i = 0; i < n; i++) {
+		k = order[i];
+		out[k] = 0;
+
+		if (left <= 0 || sumw <= 0 || demand[k] <= 0) {
+			sumw -= weight[k];
+			continue;
+		}
+
+		level = left / sumw;
+		out[k] = demand[k] <= level * weight[k] ? demand[k] :
+							  level * weight[k];
+		left -= out[k];
+		sumw -= weight[k];
+	}
+
+	return pool - (left > 0 ? left : 0);
+}
+
+static void ceetm_calc_sort_slots(struct ceetm_calc_slot *slots, int n)
+{
+	struct ceetm_calc_slot tmp;
+	int i, j;
+
+	for (i = 1; i < n; i++) {
+		tmp = slots[i];
+		for (j = i; j > 0 && slots[j - 1].prio > tmp.prio; j--)
+			slots[j] = slots[j - 1];
+		slots[j] = tmp;
+	}
+}
+
+/* Slot priorities of DPAA1 channels: twice the independent class queue,
+ * plus one for a group served right after it
+ */
+static int dpaa1_ceetm_calc_slots(const struct ceetm_calc *c, int sched,
+				  struct ceetm_calc_slot *slots)
+{
+	const struct ceetm_hier *h = c->h;
+	const struct ceetm_node *pc, *wq, *wc;
+	struct ceetm_calc_slot *s;
+	int n = 0, i, w;
+
+	for (i = h->nodes[sched].child; i >= 0 && n < CEETM_CALC_MAX_SLOTS;
+	     i = h->nodes[i].next) {
+		pc = &h->nodes[i];
+		s = &slots[n++];
+		memset(s, 0, sizeof(*s));
+		s->prio = 2 * (TC_H_MIN(pc->handle) - 1);
+
+		if (pc->child < 0) {
+			s->cr = pc->has_opt ? pc->opt.c1.cr : 1;
+			s->er = pc->has_opt ? pc->opt.c1.er : 1;
+			s->member[0] = i;
+			s->weight[0] = 1;
+			s->count = 1;
+			continue;
+		}
+
+		wq = &h->nodes[pc->child];
+		s->cr = wq->opt.q1.cr;
+		s->er = wq->opt.q1.er;
+		if (wq->has_group)
+			s->prio = 2 * wq->group_prio + 1;
+
+		for (w = wq->child; w >= 0 && s->count < CEETM_MAX_WBFS_QCOUNT;
+		     w = h->nodes[w].next) {
+			wc = &h->nodes[w];
+			s->member[s->count] = w;
+			s->weight[s->count] = wq->flow_hash ? 1 :
+					      pow(wc->opt.c1.weight ?
+						  wc->opt.c1.weight : 1,
+						  -c->weight_exp);
+			s->count++;
+		}
+	}
+
+	ceetm_calc_sort_slots(slots, n);
+
+	return n;
+}
+
+static int dpaa2_ceetm_calc_slots(const struct ceetm_calc *c, int sched,
+				  struct ceetm_calc_slot *slots)
+{
+	const struct ceetm_hier *h = c->h;
+	const struct dpaa2_ceetm_tc_qopt *q = &h->nodes[sched].opt.q2;
+	struct ceetm_calc_slot *s, *group[2] = { NULL, NULL };
+	const struct ceetm_node *cls;
+	int n = 0, i, g;
+	bool hashed;
+
+	for (i = h->nodes[sched].child; i >= 0; i = h->nodes[i].next) {
+		cls = &h->nodes[i];
+
+		if (cls->opt.c2.mode == STRICT_PRIORITY) {
+			if (n == CEETM_CALC_MAX_SLOTS)
+				break;
+			s = &slots[n++];
+			memset(s, 0, sizeof(*s));
+			s->prio = TC_H_MIN(cls->handle);
+		} else {
+			/* Without separate groups A and B form one group */
+			g = cls->opt.c2.mode == WEIGHTED_B &&
+			    q->separate_groups ? 1 : 0;
+
+			if (!group[g]) {
+				if (n == CEETM_CALC_MAX_SLOTS)
+					break;
+				group[g] = &slots[n++];
+				memset(group[g], 0, sizeof(*group[g]));
+				group[g]->prio = g ? q->prio_group_B :
+						     q->prio_group_A;
+			}
+			s = group[g];
+		}
+
+		if (s->count == CEETM_MAX_WBFS_QCOUNT)
+			continue;
+
+		s->cr = true;
+		s->er = true;
+		s->member[s->count] = i;
+		hashed = cls->opt.c2.mode != STRICT_PRIORITY &&
+			 (h->nodes[sched].flow_hash &
+			  (DPAA2_CEETM_FLOW_HASH_A <<
+			   (cls->opt.c2.mode - WEIGHTED_A)));
+		if (hashed)
+			s->weight[s->count] = 1;
+		else
+			s->weight[s->count] = pow(cls->opt.c2.weight ?
+						  cls->opt.c2.weight : 1,
+						  c->weight_exp);
+		s->count++;
+	}
+
+	ceetm_calc_sort_slots(slots, n);
+
+	return n;
+}
+
+/* The priority slots under a channel. A channel without a scheduler is a
+ * leaf on its own.
+ */
+static int ceetm_calc_slots(const struct ceetm_calc *c, int chan,
+			    struct ceetm_calc_slot *slots)
+{
+	const struct ceetm_hier *h = c->h;
+	int sched = h->nodes[chan].child;
+
+	if (sched < 0) {
+		memset(slots, 0, sizeof(*slots));
+		slots->cr = true;
+		slots->er = true;
+		slots->member[0] = chan;
+		slots->weight[0] = 1;
+		slots->count = 1;
+		return 1;
+	}
+
+	if (h->ver == DPAA_1)
+		return dpaa1_ceetm_calc_slots(c, sched, slots);
+
+	return dpaa2_ceetm_calc_slots(c, sched, slots);
+}
+
+static bool ceetm_calc_chan_shaper(const struct ceetm_hier *h, int chan,
+				   double *cr, double *er, double *tbl)
+{
+	const struct ceetm_node *ch = &h->nodes[chan];
+
+	*cr = 0;
+	*er = 0;
+	*tbl = 1;
+
+	/* A packet rate bounds no byte rate, the channel is not modelled as
+	 * shaped
+	 */
+	if (ch->pkt_mode)
+		return false;
+
+	if (h->ver == DPAA_1) {
+		if (ch->opt.c1.shaped) {
+			*cr = ch->opt.c1.rate;
+			*er = ch->opt.c1.ceil;
+			return true;
+		}
+
+		if (ch->opt.c1.tbl)
+			*tbl = ch->opt.c1.tbl;
+		return false;
+	}
+
+	if (ch->opt.c2.shaped) {
+		*cr = ch->opt.c2.shaping_cfg.cir;
+		*er = ch->opt.c2.shaping_cfg.eir;
+		return true;
+	}
+
+	return false;
+}
+
+/* Serve the slots of a channel in priority order from its CR and ER pools,
+ * an unshaped channel passes its whole allocation as the CR pool. When
+ * alloc is set, the grant of every queue is stored there.
+ */
+static void ceetm_calc_serve(const struct ceetm_calc *c,
+			     const struct ceetm_calc_slot *slots, int n,
+			     bool shaped, double *cr, double *er, double *alloc)
+{
+	double demand[CEETM_MAX_WBFS_QCOUNT], got[CEETM_MAX_WBFS_QCOUNT];
+	double out[CEETM_MAX_WBFS_QCOUNT];
+	int order[CEETM_MAX_WBFS_QCOUNT];
+	const struct ceetm_calc_slot *s;
+	int i, m;
+
+	for (i = 0; i < n; i++) {
+		s = &slots[i];
+
+		for (m = 0; m < s->count; m++) {
+			demand[m] = c->offered[s->member[m]] *
+				    ceetm_calc_wire(c, s->member[m]);
+			got[m] = 0;
+		}
+
+		if (!shaped || s->cr) {
+			*cr -= ceetm_calc_fill(*cr, s->count, demand, s->weight,
+					       out, order);
+			for (m = 0; m < s->count; m++) {
+				got[m] += out[m];
+				demand[m] -= out[m];
+			}
+		}
+
+		if (shaped && s->er) {
+			*er -= ceetm_calc_fill(*er, s->count, demand, s->weight,
+					       out, order);
+			for (m = 0; m < s->count; m++)
+				got[m] += out[m];
+		}
+
+		if (alloc) {
+			for (m = 0; m < s->count; m++)
+				alloc[s->member[m]] = got[m] /
+					ceetm_calc_wire(c, s->member[m]);
+		}
+	}
+}
+
+static double ceetm_calc_capacity(const struct ceetm_calc *c)
+{
+	const struct ceetm_node *root = &c->h->nodes[c->h->root];
+	double cap = c->linkrate;
+
+	if (root->limit && root->limit < cap)
+		cap = root->limit;
+
+	return cap;
+}
+
+static double ceetm_calc_sum(struct ceetm_calc *c, int idx)
+{
+	const struct ceetm_node *node = &c->h->nodes[idx];
+	double sum = 0;
+	int i;
+
+	if (node->child < 0)
+		return c->alloc[idx];
+
+	for (i = node->child; i >= 0; i = c->h->nodes[i].next)
+		sum += ceetm_calc_sum(c, i);
+
+	c->alloc[idx] = sum;
+	return sum;
+}
+
+void ceetm_calc_run(struct ceetm_calc *c)
+{
+	const struct ceetm_hier *h = c->h;
+	struct ceetm_calc_slot slots[CEETM_CALC_MAX_SLOTS];
+	double *req_cr, *req_er, *req_u, *w_cr, *w_er, *w_u, *grant;
+	double cap, cr, er, tbl, pool_cr, pool_er;
+	int chan, n, i, m, ns;
+	bool shaped;
+
+	memset(c->alloc, 0, h->count * sizeof(*c->alloc));
+	if (h->root < 0)
+		return;
+
+	req_cr = c->scratch;
+	req_er = req_cr + h->count;
+	req_u = req_er + h->count;
+	w_cr = req_u + h->count;
+	w_er = w_cr + h->count;
+	w_u = w_er + h->count;
+	grant = w_u + h->count;
+
+	/* What every channel would take from each tier on its own */
+	for (n = 0, chan = h->nodes[h->root].child; chan >= 0;
+	     chan = h->nodes[chan].next, n++) {
+		ns = ceetm_calc_slots(c, chan, slots);
+		shaped = ceetm_calc_chan_shaper(h, chan, &cr, &er, &tbl);
+
+		req_cr[n] = req_er[n] = req_u[n] = 0;
+		w_cr[n] = cr > 0 ? cr : 1;
+		w_er[n] = er > 0 ? er : 1;
+		w_u[n] = tbl;
+
+		if (shaped) {
+			pool_cr = cr;
+			pool_er = er;
+			ceetm_calc_serve(c, slots, ns, true, &pool_cr, &pool_er,
+					 NULL);
+			req_cr[n] = cr - pool_cr;
+			req_er[n] = er - pool_er;
+		} else {
+			for (i = 0; i < ns; i++)
+				for (m = 0; m < slots[i].count; m++)
+					req_u[n] += c->offered[slots[i].member[m]] *
+						    ceetm_calc_wire(c,
+							slots[i].member[m]);
+		}
+	}
+
+	cap = ceetm_calc_capacity(c);
+	cap -= ceetm_calc_fill(cap, n, req_cr, w_cr, grant, c->order);
+	memcpy(req_cr, grant, n * sizeof(*grant));
+	cap -= ceetm_calc_fill(cap, n, req_er, w_er, grant, c->order);
+	memcpy(req_er, grant, n * sizeof(*grant));
+	ceetm_calc_fill(cap, n, req_u, w_u, grant, c->order);
+	memcpy(req_u, grant, n * sizeof(*grant));
+
+	/* Hand the grants down to the class queues */
+	for (n = 0, chan = h->nodes[h->root].child; chan >= 0;
+	     chan = h->nodes[chan].next, n++) {
+		ns = ceetm_calc_slots(c, chan, slots);
+		shaped = ceetm_calc_chan_shaper(h, chan, &cr, &er, &tbl);
+
+		if (shaped) {
+			pool_cr = req_cr[n];
+			pool_er = req_er[n];
+		} else {
+			pool_cr = req_u[n];
+			pool_er = 0;
+		}
+
+		ceetm_calc_serve(c, slots, ns, shaped, &pool_cr, &pool_er,
+				 c->alloc);
+	}
+
+	ceetm_calc_sum(c, h->root);
+}
+
+/* Bandwidth a leaf gets when it is the only backlogged queue: the
+ * capacity of the LNI, limited by the channel pools it is eligible for.
+ */
+double ceetm_calc_max(const struct ceetm_calc *c, int leaf)
+{
+	const struct ceetm_hier *h = c->h;
+	const struct ceetm_node *node = &h->nodes[leaf], *sched;
+	double cap = ceetm_calc_capacity(c), cr, er, tbl, max;
+	bool cr_ok = true, er_ok = true;
+	int chan = leaf;
+
+	while (chan >= 0 && h->nodes[chan].up != h->root)
+		chan = h->nodes[chan].up;
+
+	if (chan < 0)
+		return 0;
+
+	if (h->ver == DPAA_1 && node->type == DPAA1_CEETM_WBFS &&
+	    node->up >= 0) {
+		sched = &h->nodes[node->up];
+		cr_ok = sched->opt.q1.cr;
+		er_ok = sched->opt.q1.er;
+	} else if (h->ver == DPAA_1 && node->type == DPAA1_CEETM_PRIO) {
+		cr_ok = node->opt.c1.cr;
+		er_ok = node->opt.c1.er;
+	}
+
+	if (!ceetm_calc_chan_shaper(h, chan, &cr, &er, &tbl))
+		return cap / ceetm_calc_wire(c, leaf);
+
+	max = (cr_ok ? cr : 0) + (er_ok ? er : 0);
+
+	return (max < cap ? max : cap) / ceetm_calc_wire(c, leaf);
+}
+
+static void explain(void)
+{
+	fprintf(stderr, "Usage: ceetmctl calc (dev DEV | file PLAN [soc SOC]) "
+		"[linkrate RATE] [load CLASSID (RATE | backlog)]...\n"
+		"	[overhead O framesize S] [weightexp A]\n"
+		"\n"
+		"Compute the steady-state bandwidth of every class queue of a\n"
+		"live hierarchy or of an offline PLAN (tc commands, one per line).\n"
+		"\n"
+		"SOC - dpaa1 or dpaa2, defaults to the running SoC\n"
+		"RATE - link rate used for unshaped LNIs (default 10gbit)\n"
+		"load - load offered to a class queue, queues without a load are\n"
+		"	backlogged\n"
+		"O - bytes per frame the hardware accounts on top of the\n"
+		"	counted ones, for frames of S bytes\n"
+		"A - exponent applied to the weights of the weighted groups\n"
+		"	(default 1), O and A as fitted by ceetmctl calibrate\n"
+		"\n"
+		"For each queue, alloc is the share under the offered loads,\n"
+		"guaranteed the share when every queue is backlogged and max the\n"
+		"share when it is the only backlogged queue.\n");
+}
+
+static void ceetm_calc_print_rate(FILE *f, const char *name, double rate)
+{
+	char buf[64];
+
+	if (isinf(rate)) {
+		fprintf(f, "%s backlog ", name);
+		return;
+	}
+
+	print_rate(buf, sizeof(buf), (__u64)rate);
+	fprintf(f, "%s %s ", name, buf);
+}
+
+static void ceetm_calc_print(const struct ceetm_calc *c, const double *guar,
+			     FILE *f, int idx, int depth)
+{
+	const struct ceetm_hier *h = c->h;
+	const struct ceetm_node *node = &h->nodes[idx];
+	const char *level;
+	char id[16];
+	int i;
+
+	if (node->kind == CEETM_NODE_QDISC && node->parent != TC_H_ROOT) {
+		for (i = node->child; i >= 0; i = h->nodes[i].next)
+			ceetm_calc_print(c, guar, f, i, depth);
+		return;
+	}
+
+	if (node->kind == CEETM_NODE_QDISC)
+		level = "lni";
+	else if (node->up == h->root)
+		level = "channel";
+	else if (node->child >= 0)
+		level = "group";
+	else
+		level = "cq";
+
+	fprintf(f, "%*s%-8s %-8s ", 2 * depth, "", level,
+		ceetm_node_id(node, id, sizeof(id)));
+
+	if (ceetm_calc_is_leaf(h, idx))
+		ceetm_calc_print_rate(f, "offered", c->offered[idx]);
+
+	ceetm_calc_print_rate(f, "alloc", c->alloc[idx]);
+	ceetm_calc_print_rate(f, "guaranteed", guar[idx]);
+
+	if (ceetm_calc_is_leaf(h, idx))
+		ceetm_calc_print_rate(f, "max", ceetm_calc_max(c, idx));
+
+	fprintf(f, "\n");
+
+	for (i = node->child; i >= 0; i = h->nodes[i].next)
+		ceetm_calc_print(c, guar, f, i, depth + 1);
+}
+
+int do_calc(int argc, char **argv)
+{
+	const char *dev = NULL, *file = NULL;
+	enum dpaa_version ver = detect_dpaa_version();
+	double linkrate = CEETM_CALC_DEF_LINKRATE;
+	unsigned int overhead = 0, framesize = 0;
+	double wexp = 1;
+	char *end;
+	struct ceetm_hier h;
+	struct ceetm_calc c;
+	double *guar = NULL;
+	char **loads = NULL;
+	int nloads = 0, i, idx, ret = -1;
+	__u32 handle;
+	__u64 rate;
+
+	loads = calloc(argc + 1, sizeof(*loads));
+	if (!loads)
+		return -1;
+
+	while (argc > 0) {
+		if (strcmp(*argv, "dev") == 0) {
+			NEXT_ARG();
+			dev = *argv;
+
+		} else if (strcmp(*argv, "file") == 0) {
+			NEXT_ARG();
+			file = *argv;
+
+		} else if (strcmp(*argv, "soc") == 0) {
+			NEXT_ARG();
+			if (ceetmctl_parse_soc(*argv, &ver))
+				goto out_args;
+
+		} else if (strcmp(*argv, "linkrate") == 0) {
+			NEXT_ARG();
+			if (get_rate64(&rate, *argv) || !rate) {
+				fprintf(stderr, "Illegal linkrate argument.\n");
+				goto out_args;
+			}
+			linkrate = rate;
+
+		} else if (strcmp(*argv, "overhead") == 0) {
+			NEXT_ARG();
+			if (get_unsigned(&overhead, *argv, 10)) {
+				fprintf(stderr, "Illegal overhead argument.\n");
+				goto out_args;
+			}
+
+		} else if (strcmp(*argv, "framesize") == 0) {
+			NEXT_ARG();
+			if (get_unsigned(&framesize, *argv, 10) || !framesize) {
+				fprintf(stderr, "Illegal framesize argument.\n");
+				goto out_args;
+			}
+
+		} else if (strcmp(*argv, "weightexp") == 0) {
+			NEXT_ARG();
+			wexp = strtod(*argv, &end);
+			if (*end || !(wexp > 0)) {
+				fprintf(stderr, "Illegal weightexp argument.\n");
+				goto out_args;
+			}
+
+		} else if (strcmp(*argv, "load") == 0) {
+			NEXT_ARG();
+			loads[nloads++] = *argv;
+			NEXT_ARG();
+			loads[nloads++] = *argv;
+
+		} else if (strcmp(*argv, "help") == 0) {
+			explain();
+			goto out_args;
+
+		} else {
+			fprintf(stderr, "Illegal argument - %s.\n", *argv);
+			explain();
+			goto out_args;
+		}
+
+		argc--; argv++;
+	}
+
+	if (ceetmctl_load_hier(dev, file, ver, &h))
+		goto out_args;
+
+	if (h.root < 0) {
+		fprintf(stderr, "No CEETM root qdisc in the hierarchy.\n");
+		goto out_hier;
+	}
+
+	if (overhead && !framesize) {
+		fprintf(stderr, "The overhead needs the frame size.\n");
+		goto out_hier;
+	}
+
+	if (ceetm_calc_init(&c, &h, linkrate))
+		goto out_hier;
+
+	c.overhead = overhead;
+	c.weight_exp = wexp;
+	for (i = 0; i < h.count; i++)
+		c.frame_size[i] = framesize;
+
+	guar = calloc(h.count, sizeof(*guar));
+	if (!guar) {
+		fprintf(stderr, "Out of memory.\n");
+		goto out_calc;
+	}
+
+	ceetm_calc_run(&c);
+	memcpy(guar, c.alloc, h.count * sizeof(*guar));
+
+	/* The loads were recorded as CLASSID, RATE pairs */
+	for (i = 0; i < nloads; i += 2) {
+		if (get_tc_classid(&handle, loads[i])) {
+			fprintf(stderr, "Invalid class ID %s.\n", loads[i]);
+			goto out_guar;
+		}
+
+		idx = ceetm_hier_find(&h, CEETM_NODE_CLASS, handle);
+		if (idx < 0 || !ceetm_calc_is_leaf(&h, idx)) {
+			fprintf(stderr, "%s is not a class queue.\n", loads[i]);
+			goto out_guar;
+		}
+
+		if (strcmp(loads[i + 1], "backlog") == 0) {
+			c.offered[idx] = INFINITY;
+		} else if (get_rate64(&rate, loads[i + 1])) {
+			fprintf(stderr, "Illegal load argument.\n");
+			goto out_guar;
+		} else {
+			c.offered[idx] = rate;
+		}
+	}
+
+	ceetm_calc_run(&c);
+	ceetm_calc_print(&c, guar, stdout, h.root, 0);
+
+	ret = 0;
+
+out_guar:
+	free(guar);
+out_calc:
+	ceetm_calc_free(&c);
+out_hier:
+	ceetm_hier_free(&h);
+out_args:
+	free(loads);
+	return ret;
+}
@@ -0,0 +1,46 @@
+/* Copyright 2017-2018 NXP
+ *
+ * SPDX-License-Identifier: GPL-2.0
+ */
+
+#ifndef __CEETM_CALC_H
+#define __CEETM_CALC_H
+
+#include "ceetm_hier.h"
+
+/* Link rate assumed for unshaped LNIs, in bytes per second (10G) */
+#define CEETM_CALC_DEF_LINKRATE	1250000000.0
+
+/* Steady-state fluid model of a CEETM hierarchy. All rates are in bytes
+ * per second and indexed like the nodes of the hierarchy.
+ */
+struct ceetm_calc {
+	const struct ceetm_hier *h;
+	double linkrate;
+	/* Correction of the weight curve: shares go with weight^weight_exp
+	 * (inverse for DPAA1 qweights), 1 as configured
+	 */
+	double weight_exp;
+	/* Input: load offered to every leaf, INFINITY if backlogged */
+	double *offered;
+	/* Input: mean frame size of every leaf, 0 if unknown. The shapers
+	 * and schedulers account overhead more bytes per frame than the
+	 * counters, the rates of the leaves are corrected accordingly.
+	 */
+	double *frame_size;
+	double overhead;
+	/* Output: bandwidth given to every node */
+	double *alloc;
+	/* Scratch space of the water-filling */
+	double *scratch;
+	int *order;
+};
+
+int ceetm_calc_init(struct ceetm_calc *c, const struct ceetm_hier *h,
+		    double linkrate);
+void ceetm_calc_free(struct ceetm_calc *c);
+void ceetm_calc_run(struct ceetm_calc *c);
+double ceetm_calc_max(const struct ceetm_calc *c, int leaf);
+bool ceetm_calc_is_leaf(const struct ceetm_hier *h, int idx);
+
+#endif
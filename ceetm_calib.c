@@ -0,0 +1,512 @@
+/* Copyright 2017-2018 NXP
+ *
+ * SPDX-License-Identifier: GPL-2.0
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "ceetm_burst.h"
+#include "ceetm_calc.h"
+#include "ceetmctl.h"
+
+/* Calibration of the scheduler model (see ceetm_calc.c) against a trace
+ * recorded on a live port by ceetmctl burst. The trace is cut in windows;
+ * in each of them the load offered to a recorded class queue is what it
+ * dequeued plus what it rejected, and the model is run on these loads to
+ * predict what every queue dequeues. The queues of the hierarchy missing
+ * from the trace are taken as idle.
+ *
+ * Two correction factors are fitted, by coordinate descent over a grid,
+ * to minimise the squared prediction error: the bytes per frame the
+ * hardware accounts on top of the counted ones (IFG, preamble, FCS,
+ * internal headers) and an exponent applied to the configured weights of
+ * the weighted groups.
+ */
+
+#define CEETM_CALIB_DEF_WINDOW_MS	1000
+#define CEETM_CALIB_MAX_OVERHEAD	64
+#define CEETM_CALIB_MIN_WEXP		0.25
+#define CEETM_CALIB_MAX_WEXP		2.0
+#define CEETM_CALIB_WEXP_STEP		0.05
+#define CEETM_CALIB_ROUNDS		4
+#define CEETM_CALIB_READ_RECS		4096
+
+/* One class over one window, rates in bytes per second */
+struct ceetm_calib_obs {
+	double offered;
+	double served;
+	double size;
+};
+
+struct ceetm_calib {
+	struct ceetm_hier h;
+	struct ceetm_calc c;
+	int nclasses;
+	__u32 handles[CEETM_BURST_MAX_CLASSES];
+	/* Node of every recorded class, -1 if not a class queue */
+	int node[CEETM_BURST_MAX_CLASSES];
+	/* nwin windows of nclasses observations, served < 0 if missing */
+	struct ceetm_calib_obs *obs;
+	double *secs;
+	int nwin;
+	int size;
+	/* Counters at the start of the current window and now */
+	struct ceetm_burst_rec prev[CEETM_BURST_MAX_CLASSES];
+	struct ceetm_burst_rec cur[CEETM_BURST_MAX_CLASSES];
+	bool has_prev[CEETM_BURST_MAX_CLASSES];
+	bool has_cur[CEETM_BURST_MAX_CLASSES];
+	double last_size[CEETM_BURST_MAX_CLASSES];
+};
+
+/* Result of the model over the whole trace for a set of factors */
+struct ceetm_calib_err {
+	double sq;
+	double abs[CEETM_BURST_MAX_CLASSES];
+	double meas[CEETM_BURST_MAX_CLASSES];
+	double pred[CEETM_BURST_MAX_CLASSES];
+};
+
+static void explain(void)
+{
+	fprintf(stderr, "Usage: ceetmctl calibrate trace FILE (dev DEV | "
+		"file PLAN [soc SOC])\n"
+		"	[window MS] [linkrate RATE]\n"
+		"\n"
+		"Replay the loads recorded by ceetmctl burst in FILE through the\n"
+		"scheduler model of the hierarchy, cut in windows of MS ms\n"
+		"(default %d), and report the prediction error of every class\n"
+		"queue, as configured and once corrected with the fitted\n"
+		"per-frame overhead and weight exponent.\n",
+		CEETM_CALIB_DEF_WINDOW_MS);
+}
+
+static struct ceetm_calib_obs *ceetm_calib_add_window(struct ceetm_calib *k,
+						      double secs)
+{
+	struct ceetm_calib_obs *obs;
+	double *s;
+	int size, i;
+
+	if (k->nwin == k->size) {
+		size = k->size ? 2 * k->size : 64;
+		obs = realloc(k->obs, (size_t)size * k->nclasses *
+				      sizeof(*obs));
+		if (!obs) {
+			fprintf(stderr, "Out of memory.\n");
+			return NULL;
+		}
+		k->obs = obs;
+
+		s = realloc(k->secs, size * sizeof(*s));
+		if (!s) {
+			fprintf(stderr, "Out of memory.\n");
+			return NULL;
+		}
+		k->secs = s;
+		k->size = size;
+	}
+
+	k->secs[k->nwin] = secs;
+	obs = &k->obs[(size_t)k->nwin++ * k->nclasses];
+	for (i = 0; i < k->nclasses; i++)
+		obs[i].served = -1;
+
+	return obs;
+}
+
+/* Rates over the window from the counters at both ends. DPAA1 only counts
+ * the rejected frames, their bytes are estimated at the mean frame size.
+ */
+static int ceetm_calib_close(struct ceetm_calib *k, __u64 start_ns,
+			     __u64 end_ns)
+{
+	const struct ceetm_burst_rec *a, *b;
+	struct ceetm_calib_obs *obs;
+	double secs = (end_ns - start_ns) / 1e9;
+	double deq, frames, rej;
+	int i;
+
+	obs = ceetm_calib_add_window(k, secs);
+	if (!obs)
+		return -1;
+
+	for (i = 0; i < k->nclasses; i++) {
+		a = &k->prev[i];
+		b = &k->cur[i];
+
+		if (!k->has_prev[i] || !k->has_cur[i] || k->node[i] < 0 ||
+		    b->deq_bytes < a->deq_bytes ||
+		    b->deq_frames < a->deq_frames ||
+		    b->rej_bytes < a->rej_bytes ||
+		    b->rej_frames < a->rej_frames)
+			continue;
+
+		deq = b->deq_bytes - a->deq_bytes;
+		frames = b->deq_frames - a->deq_frames;
+		if (frames)
+			k->last_size[i] = deq / frames;
+
+		rej = b->rej_bytes - a->rej_bytes;
+		if (!rej)
+			rej = (b->rej_frames - a->rej_frames) *
+			      k->last_size[i];
+
+		obs[i].offered = (deq + rej) / secs;
+		obs[i].served = deq / secs;
+		obs[i].size = k->last_size[i];
+	}
+
+	memcpy(k->prev, k->cur, sizeof(k->prev));
+	memcpy(k->has_prev, k->has_cur, sizeof(k->has_prev));
+
+	return 0;
+}
+
+static int ceetm_calib_read(struct ceetm_calib *k, FILE *f, __u64 window_ns)
+{
+	struct ceetm_burst_rec recs[CEETM_CALIB_READ_RECS];
+	struct ceetm_burst_hdr hdr;
+	__u64 start_ns = 0, cur_ns = 0;
+	bool started = false, polled = false;
+	size_t n, r;
+	int i;
+
+	if (fread(&hdr, sizeof(hdr), 1, f) != 1 ||
+	    memcmp(hdr.magic, CEETM_BURST_MAGIC, sizeof(hdr.magic)) ||
+	    hdr.version != CEETM_BURST_VERSION ||
+	    hdr.nclasses > CEETM_BURST_MAX_CLASSES) {
+		fprintf(stderr, "Not a ceetmctl burst trace.\n");
+		return -1;
+	}
+
+	if (hdr.dpaa_version != (k->h.ver == DPAA_1 ? 1U : 2U)) {
+		fprintf(stderr, "The trace was recorded on DPAA%u.\n",
+			hdr.dpaa_version);
+		return -1;
+	}
+
+	k->nclasses = hdr.nclasses;
+	memcpy(k->handles, hdr.handles, sizeof(k->handles));
+
+	for (i = 0; i < k->nclasses; i++) {
+		k->node[i] = ceetm_hier_find(&k->h, CEETM_NODE_CLASS,
+					     k->handles[i]);
+		if (k->node[i] >= 0 && !ceetm_calc_is_leaf(&k->h, k->node[i]))
+			k->node[i] = -1;
+	}
+
+	/* All the records of a poll share its time stamp, a window is
+	 * closed on the first poll at least window_ns after its start.
+	 */
+	while ((n = fread(recs, sizeof(recs[0]), CEETM_CALIB_READ_RECS,
+			  f)) > 0) {
+		for (r = 0; r < n; r++) {
+			if (recs[r].idx >= (__u32)k->nclasses)
+				continue;
+
+			if (polled && recs[r].ts_ns != cur_ns) {
+				if (!started) {
+					memcpy(k->prev, k->cur, sizeof(k->prev));
+					memcpy(k->has_prev, k->has_cur,
+					       sizeof(k->has_prev));
+					start_ns = cur_ns;
+					started = true;
+				} else if (cur_ns - start_ns >= window_ns) {
+					if (ceetm_calib_close(k, start_ns,
+							      cur_ns))
+						return -1;
+					start_ns = cur_ns;
+				}
+			}
+
+			cur_ns = recs[r].ts_ns;
+			polled = true;
+			k->cur[recs[r].idx] = recs[r];
+			k->has_cur[recs[r].idx] = true;
+		}
+	}
+
+	/* The tail of the trace makes a last window if not too short */
+	if (started && cur_ns - start_ns >= window_ns / 2 &&
+	    ceetm_calib_close(k, start_ns, cur_ns))
+		return -1;
+
+	return 0;
+}
+
+static void ceetm_calib_eval(struct ceetm_calib *k, double overhead,
+			     double wexp, struct ceetm_calib_err *e)
+{
+	const struct ceetm_calib_obs *obs;
+	double d;
+	int w, i, idx;
+
+	memset(e, 0, sizeof(*e));
+	k->c.overhead = overhead;
+	k->c.weight_exp = wexp;
+
+	for (w = 0; w < k->nwin; w++) {
+		obs = &k->obs[(size_t)w * k->nclasses];
+
+		for (i = 0; i < k->h.count; i++) {
+			k->c.offered[i] = 0;
+			k->c.frame_size[i] = 0;
+		}
+
+		for (i = 0; i < k->nclasses; i++) {
+			if (obs[i].served < 0)
+				continue;
+			k->c.offered[k->node[i]] = obs[i].offered;
+			k->c.frame_size[k->node[i]] = obs[i].size;
+		}
+
+		ceetm_calc_run(&k->c);
+
+		for (i = 0; i < k->nclasses; i++) {
+			if (obs[i].served < 0)
+				continue;
+
+			idx = k->node[i];
+			d = k->c.alloc[idx] - obs[i].served;
+			e->sq += d * d * k->secs[w];
+			e->abs[i] += fabs(d) * k->secs[w];
+			e->meas[i] += obs[i].served * k->secs[w];
+			e->pred[i] += k->c.alloc[idx] * k->secs[w];
+		}
+	}
+}
+
+/* The weights only matter with weighted groups */
+static bool ceetm_calib_has_weights(const struct ceetm_hier *h)
+{
+	const struct ceetm_node *node;
+	int i;
+
+	for (i = 0; i < h->count; i++) {
+		node = &h->nodes[i];
+		if (node->kind != CEETM_NODE_CLASS || !node->has_opt)
+			continue;
+
+		if (h->ver == DPAA_1 && node->type == DPAA1_CEETM_WBFS)
+			return true;
+		if (h->ver == DPAA_2 && node->type == DPAA2_CEETM_PRIO &&
+		    node->opt.c2.mode != STRICT_PRIORITY)
+			return true;
+	}
+
+	return false;
+}
+
+/* Coordinate descent, a factor only moves on a strict improvement so a
+ * flat error keeps the configured values.
+ */
+static void ceetm_calib_fit(struct ceetm_calib *k, double *overhead,
+			    double *wexp)
+{
+	struct ceetm_calib_err e;
+	bool weights = ceetm_calib_has_weights(&k->h);
+	double best, start, o, x, bo = 0, bx = 1;
+	int round;
+
+	ceetm_calib_eval(k, bo, bx, &e);
+	best = e.sq;
+
+	for (round = 0; round < CEETM_CALIB_ROUNDS; round++) {
+		start = best;
+
+		for (o = 0; o <= CEETM_CALIB_MAX_OVERHEAD; o++) {
+			ceetm_calib_eval(k, o, bx, &e);
+			if (e.sq < best) {
+				best = e.sq;
+				bo = o;
+			}
+		}
+
+		for (x = CEETM_CALIB_MIN_WEXP;
+		     weights && x <= CEETM_CALIB_MAX_WEXP + 1e-9;
+		     x += CEETM_CALIB_WEXP_STEP) {
+			ceetm_calib_eval(k, bo, x, &e);
+			if (e.sq < best) {
+				best = e.sq;
+				bx = x;
+			}
+		}
+
+		if (best >= start)
+			break;
+	}
+
+	*overhead = bo;
+	*wexp = bx;
+}
+
+static double ceetm_calib_pct(double err, double meas)
+{
+	return meas > 0 ? 100 * err / meas : 0;
+}
+
+static void ceetm_calib_print(const struct ceetm_calib *k,
+			      const struct ceetm_calib_err *raw,
+			      const struct ceetm_calib_err *fit,
+			      double overhead, double wexp)
+{
+	struct ceetm_node node;
+	double secs = 0, meas = 0, eraw = 0, efit = 0;
+	char m[64], p[64], q[64], id[16];
+	int w, i;
+
+	for (w = 0; w < k->nwin; w++)
+		secs += k->secs[w];
+
+	memset(&node, 0, sizeof(node));
+	node.kind = CEETM_NODE_CLASS;
+
+	fprintf(stdout, "%d windows, %.1f s of trace\n", k->nwin, secs);
+	fprintf(stdout, "overhead %.0f bytes per frame, weight exponent %.2f\n",
+		overhead, wexp);
+	fprintf(stdout, "\n%-8s %12s %12s %7s %12s %7s\n", "class", "measured",
+		"model", "error", "calibrated", "error");
+
+	for (i = 0; i < k->nclasses; i++) {
+		node.handle = k->handles[i];
+		ceetm_node_id(&node, id, sizeof(id));
+
+		if (k->node[i] < 0 || raw->meas[i] <= 0) {
+			fprintf(stdout, "%-8s %12s\n", id,
+				k->node[i] < 0 ? "not a cq" : "idle");
+			continue;
+		}
+
+		print_rate(m, sizeof(m), raw->meas[i] / secs);
+		print_rate(p, sizeof(p), raw->pred[i] / secs);
+		print_rate(q, sizeof(q), fit->pred[i] / secs);
+		fprintf(stdout, "%-8s %12s %12s %6.1f%% %12s %6.1f%%\n", id, m,
+			p, ceetm_calib_pct(raw->abs[i], raw->meas[i]), q,
+			ceetm_calib_pct(fit->abs[i], fit->meas[i]));
+
+		meas += raw->meas[i];
+		eraw += raw->abs[i];
+		efit += fit->abs[i];
+	}
+
+	fprintf(stdout, "\ntotal error %.1f%% -> %.1f%%\n",
+		ceetm_calib_pct(eraw, meas), ceetm_calib_pct(efit, meas));
+}
+
+int do_calibrate(int argc, char **argv)
+{
+	const char *dev = NULL, *file = NULL, *trace = NULL;
+	enum dpaa_version ver = detect_dpaa_version();
+	double linkrate = CEETM_CALC_DEF_LINKRATE;
+	unsigned int window = CEETM_CALIB_DEF_WINDOW_MS;
+	struct ceetm_calib_err raw, fit;
+	struct ceetm_calib *k;
+	double overhead, wexp;
+	int ret = -1;
+	__u64 rate;
+	FILE *f;
+
+	while (argc > 0) {
+		if (strcmp(*argv, "trace") == 0) {
+			NEXT_ARG();
+			trace = *argv;
+
+		} else if (strcmp(*argv, "dev") == 0) {
+			NEXT_ARG();
+			dev = *argv;
+
+		} else if (strcmp(*argv, "file") == 0) {
+			NEXT_ARG();
+			file = *argv;
+
+		} else if (strcmp(*argv, "soc") == 0) {
+			NEXT_ARG();
+			if (ceetmctl_parse_soc(*argv, &ver))
+				return -1;
+
+		} else if (strcmp(*argv, "window") == 0) {
+			NEXT_ARG();
+			if (get_unsigned(&window, *argv, 10) || !window) {
+				fprintf(stderr, "Illegal window argument.\n");
+				return -1;
+			}
+
+		} else if (strcmp(*argv, "linkrate") == 0) {
+			NEXT_ARG();
+			if (get_rate64(&rate, *argv) || !rate) {
+				fprintf(stderr, "Illegal linkrate argument.\n");
+				return -1;
+			}
+			linkrate = rate;
+
+		} else if (strcmp(*argv, "help") == 0) {
+			explain();
+			return -1;
+
+		} else {
+			fprintf(stderr, "Illegal argument - %s.\n", *argv);
+			explain();
+			return -1;
+		}
+
+		argc--; argv++;
+	}
+
+	if (!trace) {
+		fprintf(stderr, "Please specify the trace.\n");
+		return -1;
+	}
+
+	k = calloc(1, sizeof(*k));
+	if (!k) {
+		fprintf(stderr, "Out of memory.\n");
+		return -1;
+	}
+
+	if (ceetmctl_load_hier(dev, file, ver, &k->h))
+		goto out;
+
+	if (k->h.root < 0) {
+		fprintf(stderr, "No CEETM root qdisc in the hierarchy.\n");
+		goto out_hier;
+	}
+
+	if (ceetm_calc_init(&k->c, &k->h, linkrate))
+		goto out_hier;
+
+	f = fopen(trace, "r");
+	if (!f) {
+		perror(trace);
+		goto out_calc;
+	}
+
+	ret = ceetm_calib_read(k, f, (__u64)window * 1000000);
+	fclose(f);
+	if (ret)
+		goto out_calc;
+
+	ret = -1;
+	if (!k->nwin) {
+		fprintf(stderr, "The trace is shorter than a window.\n");
+		goto out_calc;
+	}
+
+	ceetm_calib_eval(k, 0, 1, &raw);
+	ceetm_calib_fit(k, &overhead, &wexp);
+	ceetm_calib_eval(k, overhead, wexp, &fit);
+	ceetm_calib_print(k, &raw, &fit, overhead, wexp);
+
+	ret = 0;
+
+out_calc:
+	ceetm_calc_free(&k->c);
+out_hier:
+	ceetm_hier_free(&k->h);
+out:
+	free(k->obs);
+	free(k->secs);
+	free(k);
+	return ret;
+}
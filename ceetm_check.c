@@ -0,0 +1,529 @@
+/* Copyright 2017-2018 NXP
+ *
+ * SPDX-License-Identifier: GPL-2.0
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+
+#include "ceetm_check.h"
+#include "ceetm_plan.h"
+#include "ceetmctl.h"
+
+/* Pre-flight validation of a complete hierarchy against the limits of a
+ * SoC. Errors are configurations the driver or the hardware rejects,
+ * warnings are accepted but probably not what was meant.
+ */
+
+struct ceetm_check {
+	const struct ceetm_hier *h;
+	const struct ceetm_soc_caps *caps;
+	FILE *f;
+	int errors;
+	int warnings;
+};
+
+static void ceetm_check_report(struct ceetm_check *chk, bool error,
+			       const struct ceetm_node *node,
+			       const char *fmt, ...)
+{
+	char id[16];
+	va_list args;
+
+	if (error)
+		chk->errors++;
+	else
+		chk->warnings++;
+
+	fprintf(chk->f, "%s: ", error ? "error" : "warning");
+	if (node)
+		fprintf(chk->f, "%s %s: ",
+			node->kind == CEETM_NODE_QDISC ? "qdisc" : "class",
+			ceetm_node_id(node, id, sizeof(id)));
+
+	va_start(args, fmt);
+	vfprintf(chk->f, fmt, args);
+	va_end(args);
+
+	fputc('\n', chk->f);
+}
+
+static void ceetm_check_rate(struct ceetm_check *chk,
+			     const struct ceetm_node *node, const char *name,
+			     __u64 rate)
+{
+	const struct ceetm_soc_caps *caps = chk->caps;
+
+	if (node->pkt_mode) {
+		if (caps->max_pps && rate > caps->max_pps)
+			ceetm_check_report(chk, true, node, "%s %llu pps is "
+					   "above the %s limit of %llu pps",
+					   name, rate, caps->name,
+					   caps->max_pps);
+		return;
+	}
+
+	if (rate > caps->max_rate)
+		ceetm_check_report(chk, true, node, "%s %llu B/s is above the "
+				   "%s limit of %llu B/s", name, rate,
+				   caps->name, caps->max_rate);
+
+	if (caps->rate_granularity && rate % caps->rate_granularity)
+		ceetm_check_report(chk, false, node, "%s %llu B/s is not a "
+				   "multiple of %llu B/s and will be rounded",
+				   name, rate, caps->rate_granularity);
+}
+
+static int ceetm_check_count_cqs(const struct ceetm_hier *h, int idx)
+{
+	int i, count = 0;
+
+	if (h->nodes[idx].kind == CEETM_NODE_CLASS && h->nodes[idx].child < 0)
+		return 1;
+
+	for (i = h->nodes[idx].child; i >= 0; i = h->nodes[i].next)
+		count += ceetm_check_count_cqs(h, i);
+
+	return count;
+}
+
+/* Sum of the minimum rates guaranteed to the class queues of a channel */
+static __u64 ceetm_check_min_service(const struct ceetm_hier *h, int idx)
+{
+	__u64 sum = 0;
+	int i;
+
+	if (h->nodes[idx].kind == CEETM_NODE_CLASS &&
+	    h->nodes[idx].has_min_service)
+		sum += h->nodes[idx].min_rate;
+
+	for (i = h->nodes[idx].child; i >= 0; i = h->nodes[i].next)
+		sum += ceetm_check_min_service(h, i);
+
+	return sum;
+}
+
+/* The wbfs qdiscs of a channel share its eight grouped class queues: one
+ * group of eight, or groups A and B of four
+ */
+static void dpaa1_ceetm_check_groups(struct ceetm_check *chk, int idx)
+{
+	const struct ceetm_hier *h = chk->h;
+	const struct ceetm_node *pc, *wq, *owner[2] = { NULL, NULL };
+	int i, g;
+
+	for (i = h->nodes[idx].child; i >= 0; i = pc->next) {
+		pc = &h->nodes[i];
+		if (pc->child < 0)
+			continue;
+
+		wq = &h->nodes[pc->child];
+		if (wq->kind != CEETM_NODE_QDISC || wq->type != DPAA1_CEETM_WBFS)
+			continue;
+
+		g = wq->has_group ? wq->group : DPAA1_CEETM_GROUP_A;
+		if (g > DPAA1_CEETM_GROUP_B) {
+			ceetm_check_report(chk, true, wq, "group %d is neither "
+					   "A nor B", g);
+			continue;
+		}
+
+		if (wq->has_group && wq->group_prio >= CEETM_MAX_PRIO_QCOUNT)
+			ceetm_check_report(chk, true, wq, "position %u, the "
+					   "groups go from 0 to %d",
+					   wq->group_prio,
+					   CEETM_MAX_PRIO_QCOUNT - 1);
+
+		if (wq->opt.q1.qcount == CEETM_MAX_WBFS_QCOUNT &&
+		    g != DPAA1_CEETM_GROUP_A)
+			ceetm_check_report(chk, true, wq, "a group of eight "
+					   "class queues is group A");
+
+		if (owner[g])
+			ceetm_check_report(chk, true, wq, "group %c is already "
+					   "taken by qdisc %x:",
+					   g == DPAA1_CEETM_GROUP_A ? 'A' : 'B',
+					   TC_H_MAJ(owner[g]->handle) >> 16);
+		owner[g] = wq;
+	}
+
+	for (g = 0; g < 2; g++) {
+		if (owner[g] && owner[!g] &&
+		    owner[g]->opt.q1.qcount == CEETM_MAX_WBFS_QCOUNT)
+			ceetm_check_report(chk, true, owner[g], "a group of "
+					   "eight class queues leaves no room "
+					   "for group %c", g ? 'A' : 'B');
+	}
+}
+
+/* The class queues of a flow-hashed group are served at equal weight, the
+ * weights given to them are not applied
+ */
+static bool ceetm_check_equal_weights(const struct ceetm_hier *h, int idx,
+				      int mode)
+{
+	const struct ceetm_node *c;
+	int i, weight = -1, w;
+
+	for (i = h->nodes[idx].child; i >= 0; i = c->next) {
+		c = &h->nodes[i];
+		if (!c->has_opt)
+			continue;
+		if (h->ver == DPAA_2 && c->opt.c2.mode != mode)
+			continue;
+
+		w = h->ver == DPAA_1 ? c->opt.c1.weight : c->opt.c2.weight;
+		if (weight >= 0 && w != weight)
+			return false;
+		weight = w;
+	}
+
+	return true;
+}
+
+static void dpaa1_ceetm_check_node(struct ceetm_check *chk, int idx)
+{
+	const struct ceetm_hier *h = chk->h;
+	const struct ceetm_node *node = &h->nodes[idx];
+	const struct ceetm_node *up = node->up >= 0 ? &h->nodes[node->up] : NULL;
+	const struct ceetm_node *root = &h->nodes[h->root];
+	const struct ceetm_node *chan;
+	int i;
+
+	if (node->kind == CEETM_NODE_QDISC) {
+		const struct tc_ceetm_qopt *q = &node->opt.q1;
+
+		switch (node->type) {
+		case DPAA1_CEETM_ROOT:
+			if (q->shaped) {
+				ceetm_check_rate(chk, node, "rate", q->rate);
+				ceetm_check_rate(chk, node, "ceil", q->ceil);
+				if (node->pkt_mode && q->overhead)
+					ceetm_check_report(chk, true, node,
+							   "overhead in packet "
+							   "mode");
+				else if (!node->pkt_mode && !q->overhead)
+					ceetm_check_report(chk, false, node,
+							   "shaped without "
+							   "overhead");
+			}
+			break;
+
+		case DPAA1_CEETM_PRIO:
+			if (!up || up->type != DPAA1_CEETM_ROOT)
+				ceetm_check_report(chk, true, node, "prio "
+						   "qdiscs belong under root "
+						   "classes");
+			dpaa1_ceetm_check_groups(chk, idx);
+			break;
+
+		case DPAA1_CEETM_WBFS:
+			if (!up || up->type != DPAA1_CEETM_PRIO)
+				ceetm_check_report(chk, true, node, "wbfs "
+						   "qdiscs belong under prio "
+						   "classes");
+			for (i = 0; i < q->qcount; i++) {
+				if (q->qweight[i] < chk->caps->min_weight ||
+				    q->qweight[i] > chk->caps->max_weight)
+					ceetm_check_report(chk, true, node,
+							   "qweight %u out of "
+							   "range", q->qweight[i]);
+			}
+
+			chan = up && up->up >= 0 && h->nodes[up->up].up >= 0 ?
+			       &h->nodes[h->nodes[up->up].up] : NULL;
+			if (chan && chan->opt.c1.shaped && !q->cr && !q->er)
+				ceetm_check_report(chk, true, node, "neither cr "
+						   "nor er is enabled in a shaped "
+						   "channel, the group is never "
+						   "served");
+
+			if (node->flow_hash &&
+			    !ceetm_check_equal_weights(h, idx, 0))
+				ceetm_check_report(chk, false, node, "the "
+						   "qweights of a flow-hashed "
+						   "group are not applied, its "
+						   "class queues are served "
+						   "equally");
+			break;
+		}
+
+		return;
+	}
+
+	if (node->type != DPAA1_CEETM_ROOT)
+		return;
+
+	if (node->opt.c1.shaped) {
+		ceetm_check_rate(chk, node, "rate", node->opt.c1.rate);
+		ceetm_check_rate(chk, node, "ceil", node->opt.c1.ceil);
+
+		if (!root->opt.q1.shaped)
+			ceetm_check_report(chk, true, node, "shaped channel "
+					   "under an unshaped LNI");
+	} else if (!node->opt.c1.tbl) {
+		ceetm_check_report(chk, false, node, "unshaped channel with "
+				   "a zero tbl");
+	}
+}
+
+static void dpaa2_ceetm_check_node(struct ceetm_check *chk, int idx)
+{
+	const struct ceetm_hier *h = chk->h;
+	const struct ceetm_node *node = &h->nodes[idx];
+	const struct ceetm_node *up = node->up >= 0 ? &h->nodes[node->up] : NULL;
+	const struct dpaa2_ceetm_shaping_cfg *cfg;
+	int i, weighted[2] = { 0, 0 };
+
+	if (node->kind == CEETM_NODE_QDISC) {
+		const struct dpaa2_ceetm_tc_qopt *q = &node->opt.q2;
+
+		if (node->type != DPAA2_CEETM_PRIO)
+			return;
+
+		if (!up || up->type != DPAA2_CEETM_ROOT)
+			ceetm_check_report(chk, true, node, "prio qdiscs belong "
+					   "under root classes");
+
+		if (q->prio_group_A >= CEETM_MAX_PRIO_QCOUNT ||
+		    q->prio_group_B >= CEETM_MAX_PRIO_QCOUNT)
+			ceetm_check_report(chk, true, node, "group priorities "
+					   "go from 0 to %d",
+					   CEETM_MAX_PRIO_QCOUNT - 1);
+
+		if (q->separate_groups > 1)
+			ceetm_check_report(chk, true, node, "separate is "
+					   "either 0 or 1");
+
+		for (i = node->child; i >= 0; i = h->nodes[i].next) {
+			if (h->nodes[i].opt.c2.mode != STRICT_PRIORITY)
+				weighted[h->nodes[i].opt.c2.mode - WEIGHTED_A]++;
+		}
+
+		if (weighted[1] && !q->separate_groups)
+			ceetm_check_report(chk, false, node, "WEIGHTED_B "
+					   "classes share group A unless the "
+					   "groups are separate");
+
+		for (i = 0; i < 2; i++) {
+			if (!(node->flow_hash & (DPAA2_CEETM_FLOW_HASH_A << i)))
+				continue;
+
+			if (!weighted[i])
+				ceetm_check_report(chk, false, node, "flow "
+						   "hashing on group %c, which "
+						   "has no class", 'A' + i);
+			else if (!ceetm_check_equal_weights(h, idx,
+							    WEIGHTED_A + i))
+				ceetm_check_report(chk, false, node, "the "
+						   "weights of flow-hashed "
+						   "group %c are not applied, "
+						   "its class queues are served "
+						   "equally", 'A' + i);
+		}
+		return;
+	}
+
+	if (node->type == DPAA2_CEETM_PRIO) {
+		if (node->opt.c2.mode != STRICT_PRIORITY &&
+		    (node->opt.c2.weight < chk->caps->min_weight ||
+		     node->opt.c2.weight > chk->caps->max_weight))
+			ceetm_check_report(chk, true, node, "weight %u is not "
+					   "between %u and %u",
+					   node->opt.c2.weight,
+					   chk->caps->min_weight,
+					   chk->caps->max_weight);
+		return;
+	}
+
+	cfg = &node->opt.c2.shaping_cfg;
+	if (!node->opt.c2.shaped)
+		return;
+
+	ceetm_check_rate(chk, node, "cir", cfg->cir);
+	ceetm_check_rate(chk, node, "eir", cfg->eir);
+
+	if (cfg->cir && !cfg->cbs)
+		ceetm_check_report(chk, true, node, "cir without a cbs");
+	if (cfg->eir && !cfg->ebs)
+		ceetm_check_report(chk, true, node, "eir without an ebs");
+}
+
+int ceetm_check_hier(const struct ceetm_hier *h,
+		     const struct ceetm_soc_caps *caps, FILE *f,
+		     int *warnings)
+{
+	struct ceetm_check chk = {
+		.h = h,
+		.caps = caps,
+		.f = f,
+	};
+	const struct ceetm_node *node, *root;
+	__u64 committed = 0, reserved = 0, cr, guaranteed;
+	int i, channels = 0, roots = 0, cqs;
+
+	if (caps->ver != h->ver)
+		ceetm_check_report(&chk, true, NULL, "%s is not a %s SoC",
+				   caps->name, h->ver == DPAA_1 ? "DPAA1" : "DPAA2");
+
+	for (i = 0; i < h->count; i++) {
+		node = &h->nodes[i];
+
+		if (!node->has_opt)
+			ceetm_check_report(&chk, true, node, "no options");
+
+		if (node->pkt_mode && !caps->max_pps)
+			ceetm_check_report(&chk, true, node, "%s shapers do not "
+					   "count packets", caps->name);
+
+		if (node->kind == CEETM_NODE_QDISC && node->parent == TC_H_ROOT)
+			roots++;
+		else if (node->up < 0)
+			ceetm_check_report(&chk, true, node, "parent %x:%x does "
+					   "not exist", TC_H_MAJ(node->parent) >> 16,
+					   TC_H_MIN(node->parent));
+	}
+
+	if (roots != 1 || h->root < 0) {
+		ceetm_check_report(&chk, true, NULL, "expected one root qdisc, "
+				   "found %d", roots);
+		goto out;
+	}
+
+	root = &h->nodes[h->root];
+
+	for (i = root->child; i >= 0; i = h->nodes[i].next) {
+		node = &h->nodes[i];
+		channels++;
+
+		cqs = ceetm_check_count_cqs(h, i);
+		if (cqs > (int)caps->cqs_per_channel)
+			ceetm_check_report(&chk, true, node, "%d class queues, "
+					   "%s channels have %u", cqs, caps->name,
+					   caps->cqs_per_channel);
+
+		if (node->child >= 0 && h->nodes[node->child].next >= 0)
+			ceetm_check_report(&chk, true, node, "more than one "
+					   "scheduler");
+
+		/* Packet rates do not add up with the byte rates */
+		cr = 0;
+		if (h->ver == DPAA_1 && node->opt.c1.shaped)
+			cr = node->opt.c1.rate;
+		else if (h->ver == DPAA_2 && node->opt.c2.shaped)
+			cr = node->opt.c2.shaping_cfg.cir;
+		if (node->pkt_mode)
+			cr = 0;
+		committed += cr;
+
+		if (node->has_buf_part)
+			reserved += node->buf_reserve;
+
+		guaranteed = ceetm_check_min_service(h, i);
+		if (cr && guaranteed > cr)
+			ceetm_check_report(&chk, true, node, "the minimum rates "
+					   "of the class queues (%llu B/s) "
+					   "exceed the committed rate "
+					   "(%llu B/s)", guaranteed, cr);
+	}
+
+	if (channels > (int)caps->channels_per_lni)
+		ceetm_check_report(&chk, true, root, "%d channels, %s LNIs have "
+				   "%u", channels, caps->name,
+				   caps->channels_per_lni);
+
+	if (root->limit && committed > root->limit)
+		ceetm_check_report(&chk, false, root, "the committed rates of "
+				   "the channels (%llu B/s) exceed the LNI "
+				   "(%llu B/s)", committed, root->limit);
+
+	/* The channels draw their reserves from the share of their LNI */
+	if (root->has_buf_part && root->buf_cap && reserved > root->buf_cap)
+		ceetm_check_report(&chk, true, root, "the buffer reserves of "
+				   "the channels (%llu B) exceed the LNI cap "
+				   "(%u B)", reserved, root->buf_cap);
+
+	for (i = 0; i < h->count; i++) {
+		if (h->ver == DPAA_1)
+			dpaa1_ceetm_check_node(&chk, i);
+		else
+			dpaa2_ceetm_check_node(&chk, i);
+	}
+
+out:
+	if (warnings)
+		*warnings = chk.warnings;
+
+	return chk.errors;
+}
+
+static void explain(void)
+{
+	fprintf(stderr, "Usage: ceetmctl check (file PLAN | dev DEV) "
+		"[soc SOC | svr SVR]\n"
+		"\n"
+		"Validate a complete hierarchy against the CEETM limits of a\n"
+		"SoC, without sending anything to the kernel.\n"
+		"SOC - SoC name (e.g. ls1046a, ls2088a, lx2160a) or dpaa1/dpaa2\n"
+		"SVR - hexadecimal system version register value\n"
+		"Both default to the running SoC.\n");
+}
+
+int do_check(int argc, char **argv)
+{
+	const struct ceetm_soc_caps *caps = ceetm_soc_caps();
+	const char *dev = NULL, *file = NULL;
+	struct ceetm_hier h;
+	int errors, warnings;
+	__u32 svr;
+
+	while (argc > 0) {
+		if (strcmp(*argv, "dev") == 0) {
+			NEXT_ARG();
+			dev = *argv;
+
+		} else if (strcmp(*argv, "file") == 0) {
+			NEXT_ARG();
+			file = *argv;
+
+		} else if (strcmp(*argv, "soc") == 0) {
+			NEXT_ARG();
+			caps = ceetm_soc_lookup_name(*argv);
+			if (!caps) {
+				fprintf(stderr, "Unknown SoC %s.\n", *argv);
+				return -1;
+			}
+
+		} else if (strcmp(*argv, "svr") == 0) {
+			NEXT_ARG();
+			if (get_u32(&svr, *argv, 16)) {
+				fprintf(stderr, "Illegal svr argument.\n");
+				return -1;
+			}
+			caps = ceetm_soc_lookup_svr(svr);
+
+		} else if (strcmp(*argv, "help") == 0) {
+			explain();
+			return -1;
+
+		} else {
+			fprintf(stderr, "Illegal argument - %s.\n", *argv);
+			explain();
+			return -1;
+		}
+
+		argc--; argv++;
+	}
+
+	if (ceetmctl_load_hier(dev, file, caps->ver, &h))
+		return -1;
+
+	errors = ceetm_check_hier(&h, caps, stdout, &warnings);
+	fprintf(stdout, "%s: %d errors, %d warnings\n", caps->name, errors,
+		warnings);
+
+	ceetm_hier_free(&h);
+
+	return errors ? -1 : 0;
+}
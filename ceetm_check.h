@@ -0,0 +1,17 @@
+/* Copyright 2017-2018 NXP
+ *
+ * SPDX-License-Identifier: GPL-2.0
+ */
+
+#ifndef __CEETM_CHECK_H
+#define __CEETM_CHECK_H
+
+#include <stdio.h>
+
+#include "ceetm_hier.h"
+
+int ceetm_check_hier(const struct ceetm_hier *h,
+		     const struct ceetm_soc_caps *caps, FILE *f,
+		     int *warnings);
+
+#endif
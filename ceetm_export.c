@@ -0,0 +1,651 @@
+/* Copyright 2017-2018 NXP
+ *
+ * SPDX-License-Identifier: GPL-2.0
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <net/if.h>
+#include <linux/gen_stats.h>
+
+#include "ceetm_hier.h"
+#include "ceetmctl.h"
+#include "libceetm.h"
+
+/* Bulk export of the classes of an interface, one fixed-schema row per
+ * class with its configuration and all its xstats, for collectors that
+ * poll ports with thousands of classes. The rows are decoded straight
+ * from a single class dump and the whole output is formatted into one
+ * buffer, written at once.
+ *
+ * The binary format is columnar: a struct ceetm_export_hdr, ncols struct
+ * ceetm_export_col, then every column in turn as nrows 64-bit values, in
+ * host byte order. Signed columns hold two's complement values.
+ */
+
+#define CEETM_EXPORT_MAGIC	"CEETMCX1"
+#define CEETM_EXPORT_VERSION	1
+#define CEETM_EXPORT_COL_NAME	24
+/* Column flags */
+#define CEETM_EXPORT_COL_SIGNED	1
+#define CEETM_EXPORT_COL_HANDLE	2 /* tc handle, "1:2" in CSV */
+/* Room for the text of any row, formatted in place */
+#define CEETM_EXPORT_ROW_MAX	2048
+
+struct ceetm_export_hdr {
+	char magic[8];
+	__u32 version;
+	__u32 dpaa_version;
+	__u32 ifindex;
+	__u32 ncols;
+	__u64 nrows;
+	__u64 ts_ns; /* CLOCK_REALTIME at the start of the dump */
+};
+
+struct ceetm_export_col {
+	char name[CEETM_EXPORT_COL_NAME];
+	__u32 flags;
+	__u32 pad;
+};
+
+/* The rows of both backends start alike, the table of each one maps the
+ * columns to the fields; an array field gives one column per element.
+ */
+struct ceetm_export_row1 {
+	__u64 handle;
+	__u64 parent;
+	__u64 type;
+	__u64 shaped;
+	__u64 pkt_mode;
+	__u64 rate;
+	__u64 ceil;
+	__u64 tbl;
+	__u64 cr;
+	__u64 er;
+	__u64 weight;
+	__u64 min_rate;
+	__u64 max_run;
+	__u64 buf_reserve;
+	__u64 buf_cap;
+	__u64 lat_sample;
+	__u64 ern_drop_count;
+	__u64 cgr_congested_count;
+	__u64 frame_count;
+	__u64 byte_count;
+	__s64 cr_tokens;
+	__s64 er_tokens;
+	__u64 shaper_blocked_ns;
+	__u64 buf_bytes;
+	__u64 buf_peak_bytes;
+	__u64 buf_cap_drops;
+	__u64 txq_count;
+	__u64 lat_samples;
+	__u64 lat_max_ns;
+	__u64 lat_hist[CEETM_LAT_BUCKETS];
+};
+
+struct ceetm_export_row2 {
+	__u64 handle;
+	__u64 parent;
+	__u64 type;
+	__u64 shaped;
+	__u64 pkt_mode;
+	__u64 mode;
+	__u64 weight;
+	__u64 cir;
+	__u64 eir;
+	__u64 cbs;
+	__u64 ebs;
+	__u64 coupled;
+	__u64 min_rate;
+	__u64 max_run;
+	__u64 buf_reserve;
+	__u64 buf_cap;
+	__u64 lat_sample;
+	__u64 deq_bytes;
+	__u64 deq_frames;
+	__u64 rej_bytes;
+	__u64 rej_frames;
+	__u64 rej_shaper_bytes;
+	__u64 rej_shaper_frames;
+	__u64 rej_cg_bytes;
+	__u64 rej_cg_frames;
+	__u64 rej_bp_bytes;
+	__u64 rej_bp_frames;
+	__u64 rej_wred_bytes;
+	__u64 rej_wred_frames;
+	__s64 cr_tokens;
+	__s64 er_tokens;
+	__u64 shaper_blocked_ns;
+	__u64 coupled_bytes;
+	__u64 buf_bytes;
+	__u64 buf_peak_bytes;
+	__u64 buf_cap_frames;
+	__u64 txq_count;
+	__u64 lat_samples;
+	__u64 lat_max_ns;
+	__u64 lat_hist[CEETM_LAT_BUCKETS];
+};
+
+struct ceetm_export_field {
+	const char *name;
+	int off;
+	int count;
+	__u32 flags;
+};
+
+#define CEETM_EXPORT_ID(row, f) \
+	{ #f, offsetof(struct row, f), 1, CEETM_EXPORT_COL_HANDLE }
+#define CEETM_EXPORT_U64(row, f) \
+	{ #f, offsetof(struct row, f), 1, 0 }
+#define CEETM_EXPORT_S64(row, f) \
+	{ #f, offsetof(struct row, f), 1, CEETM_EXPORT_COL_SIGNED }
+#define CEETM_EXPORT_ARRAY(row, f) \
+	{ #f, offsetof(struct row, f), CEETM_LAT_BUCKETS, 0 }
+
+#define I1(f)	CEETM_EXPORT_ID(ceetm_export_row1, f)
+#define U1(f)	CEETM_EXPORT_U64(ceetm_export_row1, f)
+#define S1(f)	CEETM_EXPORT_S64(ceetm_export_row1, f)
+#define I2(f)	CEETM_EXPORT_ID(ceetm_export_row2, f)
+#define U2(f)	CEETM_EXPORT_U64(ceetm_export_row2, f)
+#define S2(f)	CEETM_EXPORT_S64(ceetm_export_row2, f)
+
+static const struct ceetm_export_field ceetm_export_fields1[] = {
+	I1(handle), I1(parent), U1(type), U1(shaped), U1(pkt_mode), U1(rate),
+	U1(ceil), U1(tbl), U1(cr), U1(er), U1(weight), U1(min_rate),
+	U1(max_run), U1(buf_reserve), U1(buf_cap), U1(lat_sample),
+	U1(ern_drop_count), U1(cgr_congested_count), U1(frame_count),
+	U1(byte_count),
+	S1(cr_tokens), S1(er_tokens), U1(shaper_blocked_ns), U1(buf_bytes),
+	U1(buf_peak_bytes), U1(buf_cap_drops), U1(txq_count),
+	U1(lat_samples), U1(lat_max_ns),
+	CEETM_EXPORT_ARRAY(ceetm_export_row1, lat_hist),
+	{ NULL }
+};
+
+static const struct ceetm_export_field ceetm_export_fields2[] = {
+	I2(handle), I2(parent), U2(type), U2(shaped), U2(pkt_mode), U2(mode),
+	U2(weight), U2(cir), U2(eir), U2(cbs), U2(ebs), U2(coupled),
+	U2(min_rate), U2(max_run), U2(buf_reserve), U2(buf_cap),
+	U2(lat_sample), U2(deq_bytes), U2(deq_frames), U2(rej_bytes), U2(rej_frames),
+	U2(rej_shaper_bytes), U2(rej_shaper_frames), U2(rej_cg_bytes),
+	U2(rej_cg_frames), U2(rej_bp_bytes), U2(rej_bp_frames),
+	U2(rej_wred_bytes), U2(rej_wred_frames), S2(cr_tokens),
+	S2(er_tokens), U2(shaper_blocked_ns), U2(coupled_bytes),
+	U2(buf_bytes), U2(buf_peak_bytes), U2(buf_cap_frames),
+	U2(txq_count), U2(lat_samples), U2(lat_max_ns),
+	CEETM_EXPORT_ARRAY(ceetm_export_row2, lat_hist),
+	{ NULL }
+};
+
+#undef I1
+#undef U1
+#undef S1
+#undef I2
+#undef U2
+#undef S2
+
+struct ceetm_export {
+	struct ceetm_hier h;
+	const struct ceetm_export_field *fields;
+	int row_size;
+	char *rows;
+	int nrows;
+	int size;
+};
+
+static void explain(void)
+{
+	fprintf(stderr, "Usage: ceetmctl export dev DEV [format (csv | bin)] "
+		"[file FILE] [soc SOC]\n"
+		"\n"
+		"Write one row per CEETM class of DEV with its handle, parent,\n"
+		"type, shaping configuration and all its xstats counters, as\n"
+		"CSV (default) or in a binary columnar format, to FILE or the\n"
+		"standard output.\n");
+}
+
+static void *ceetm_export_add(struct ceetm_export *e)
+{
+	char *rows;
+	int size;
+
+	if (e->nrows == e->size) {
+		size = e->size ? 2 * e->size : 256;
+		rows = realloc(e->rows, (size_t)size * e->row_size);
+		if (!rows) {
+			fprintf(stderr, "Out of memory.\n");
+			return NULL;
+		}
+
+		e->rows = rows;
+		e->size = size;
+	}
+
+	return memset(e->rows + (size_t)e->nrows++ * e->row_size, 0,
+		      e->row_size);
+}
+
+static void dpaa1_ceetm_export_row(struct ceetm_export_row1 *r,
+				   const struct ceetm_node *node,
+				   const struct tc_ceetm_xstats *st)
+{
+	const struct tc_ceetm_copt *c = &node->opt.c1;
+
+	r->handle = node->handle;
+	r->parent = node->parent;
+	r->type = node->type;
+	r->shaped = c->shaped;
+	r->pkt_mode = node->pkt_mode;
+	r->rate = c->rate;
+	r->ceil = c->ceil;
+	r->tbl = c->tbl;
+	r->cr = c->cr;
+	r->er = c->er;
+	r->weight = c->weight;
+	r->min_rate = node->min_rate;
+	r->max_run = node->max_run;
+	r->buf_reserve = node->buf_reserve;
+	r->buf_cap = node->buf_cap;
+	r->lat_sample = node->lat_sample;
+
+	if (!st)
+		return;
+
+	r->ern_drop_count = st->ern_drop_count;
+	r->cgr_congested_count = st->cgr_congested_count;
+	r->frame_count = st->frame_count;
+	r->byte_count = st->byte_count;
+	r->cr_tokens = st->cr_tokens;
+	r->er_tokens = st->er_tokens;
+	r->shaper_blocked_ns = st->shaper_blocked_ns;
+	r->buf_bytes = st->buf_bytes;
+	r->buf_peak_bytes = st->buf_peak_bytes;
+	r->buf_cap_drops = st->buf_cap_drops;
+	r->txq_count = st->txq_count;
+	r->lat_samples = st->lat_samples;
+	r->lat_max_ns = st->lat_max_ns;
+	memcpy(r->lat_hist, st->lat_hist, sizeof(r->lat_hist));
+}
+
+static void dpaa2_ceetm_export_row(struct ceetm_export_row2 *r,
+				   const struct ceetm_node *node,
+				   const struct dpaa2_ceetm_tc_xstats *st)
+{
+	const struct dpaa2_ceetm_tc_copt *c = &node->opt.c2;
+
+	r->handle = node->handle;
+	r->parent = node->parent;
+	r->type = node->type;
+	r->shaped = c->shaped;
+	r->pkt_mode = node->pkt_mode;
+	r->mode = c->mode;
+	r->weight = c->weight;
+	r->cir = c->shaping_cfg.cir;
+	r->eir = c->shaping_cfg.eir;
+	r->cbs = c->shaping_cfg.cbs;
+	r->ebs = c->shaping_cfg.ebs;
+	r->coupled = c->shaping_cfg.coupled;
+	r->min_rate = node->min_rate;
+	r->max_run = node->max_run;
+	r->buf_reserve = node->buf_reserve;
+	r->buf_cap = node->buf_cap;
+	r->lat_sample = node->lat_sample;
+
+	if (!st)
+		return;
+
+	r->deq_bytes = st->ceetm_dequeue_bytes;
+	r->deq_frames = st->ceetm_dequeue_frames;
+	r->rej_bytes = st->ceetm_reject_bytes;
+	r->rej_frames = st->ceetm_reject_frames;
+	r->rej_shaper_bytes = st->ceetm_reject_shaper_bytes;
+	r->rej_shaper_frames = st->ceetm_reject_shaper_frames;
+	r->rej_cg_bytes = st->ceetm_reject_cg_bytes;
+	r->rej_cg_frames = st->ceetm_reject_cg_frames;
+	r->rej_bp_bytes = st->ceetm_reject_bp_bytes;
+	r->rej_bp_frames = st->ceetm_reject_bp_frames;
+	r->rej_wred_bytes = st->ceetm_reject_wred_bytes;
+	r->rej_wred_frames = st->ceetm_reject_wred_frames;
+	r->cr_tokens = st->ceetm_cr_tokens;
+	r->er_tokens = st->ceetm_er_tokens;
+	r->shaper_blocked_ns = st->ceetm_shaper_blocked_ns;
+	r->coupled_bytes = st->ceetm_coupled_bytes;
+	r->buf_bytes = st->ceetm_buf_bytes;
+	r->buf_peak_bytes = st->ceetm_buf_peak_bytes;
+	r->buf_cap_frames = st->ceetm_buf_cap_frames;
+	r->txq_count = st->ceetm_txq_count;
+	r->lat_samples = st->ceetm_lat_samples;
+	r->lat_max_ns = st->ceetm_lat_max_ns;
+	memcpy(r->lat_hist, st->ceetm_lat_hist, sizeof(r->lat_hist));
+}
+
+/* The options are decoded by the hierarchy code into a node that is only
+ * kept until the row is filled in.
+ */
+static int ceetm_export_filter(struct nlmsghdr *n, void *arg)
+{
+	struct ceetm_export *e = arg;
+	struct tcmsg *t = NLMSG_DATA(n);
+	struct rtattr *tb[TCA_MAX + 1];
+	struct rtattr *stb[TCA_STATS_MAX + 1];
+	struct rtattr *xstats = NULL;
+	struct tc_ceetm_xstats st1;
+	struct dpaa2_ceetm_tc_xstats st2;
+	void *row;
+
+	e->h.count = 0;
+	if (ceetm_hier_parse_msg(&e->h, n))
+		return -1;
+	if (!e->h.count || e->h.nodes[0].kind != CEETM_NODE_CLASS)
+		return 0;
+
+	parse_rtattr(tb, TCA_MAX, TCA_RTA(t),
+		     n->nlmsg_len - NLMSG_LENGTH(sizeof(*t)));
+	if (tb[TCA_STATS2]) {
+		parse_rtattr_nested(stb, TCA_STATS_MAX, tb[TCA_STATS2]);
+		xstats = stb[TCA_STATS_APP];
+	}
+	if (!xstats)
+		xstats = tb[TCA_XSTATS];
+
+	row = ceetm_export_add(e);
+	if (!row)
+		return -1;
+
+	if (e->h.ver == DPAA_1)
+		dpaa1_ceetm_export_row(row, &e->h.nodes[0],
+				       dpaa1_ceetm_get_xstats(xstats, &st1) ?
+				       NULL : &st1);
+	else
+		dpaa2_ceetm_export_row(row, &e->h.nodes[0],
+				       dpaa2_ceetm_get_xstats(xstats, &st2) ?
+				       NULL : &st2);
+
+	return 0;
+}
+
+static int ceetm_export_ncols(const struct ceetm_export_field *f)
+{
+	int ncols = 0;
+
+	for (; f->name; f++)
+		ncols += f->count;
+
+	return ncols;
+}
+
+static __u64 ceetm_export_value(const struct ceetm_export *e, int row,
+				const struct ceetm_export_field *f, int i)
+{
+	__u64 v;
+
+	memcpy(&v, e->rows + (size_t)row * e->row_size + f->off +
+	       i * sizeof(v), sizeof(v));
+	return v;
+}
+
+/* Digits written backwards into a scratch area, then moved in place */
+static char *ceetm_export_u64(char *p, __u64 v)
+{
+	char tmp[20];
+	int n = 0;
+
+	do {
+		tmp[n++] = '0' + v % 10;
+		v /= 10;
+	} while (v);
+
+	while (n)
+		*p++ = tmp[--n];
+
+	return p;
+}
+
+static char *ceetm_export_hex(char *p, __u32 v)
+{
+	static const char digits[] = "0123456789abcdef";
+	char tmp[8];
+	int n = 0;
+
+	do {
+		tmp[n++] = digits[v & 0xf];
+		v >>= 4;
+	} while (v);
+
+	while (n)
+		*p++ = tmp[--n];
+
+	return p;
+}
+
+/* tc style handles, as printed by tc */
+static char *ceetm_export_id(char *p, __u32 handle)
+{
+	if (handle == TC_H_ROOT) {
+		memcpy(p, "root", 4);
+		return p + 4;
+	}
+
+	p = ceetm_export_hex(p, TC_H_MAJ(handle) >> 16);
+	*p++ = ':';
+	return ceetm_export_hex(p, TC_H_MIN(handle));
+}
+
+static char *ceetm_export_csv(const struct ceetm_export *e, size_t *len)
+{
+	const struct ceetm_export_field *f;
+	char *buf, *p;
+	__u64 v;
+	int r, i;
+
+	buf = malloc(((size_t)e->nrows + 1) * CEETM_EXPORT_ROW_MAX);
+	if (!buf) {
+		fprintf(stderr, "Out of memory.\n");
+		return NULL;
+	}
+
+	p = buf;
+	for (f = e->fields; f->name; f++) {
+		for (i = 0; i < f->count; i++) {
+			if (f->count > 1)
+				p += sprintf(p, "%s%d,", f->name, i);
+			else
+				p += sprintf(p, "%s,", f->name);
+		}
+	}
+	p[-1] = '\n';
+
+	for (r = 0; r < e->nrows; r++) {
+		for (f = e->fields; f->name; f++) {
+			for (i = 0; i < f->count; i++) {
+				v = ceetm_export_value(e, r, f, i);
+				if (f->flags & CEETM_EXPORT_COL_HANDLE)
+					p = ceetm_export_id(p, v);
+				else if ((f->flags & CEETM_EXPORT_COL_SIGNED) &&
+					 (__s64)v < 0)
+					*p++ = '-', p = ceetm_export_u64(p, -v);
+				else
+					p = ceetm_export_u64(p, v);
+				*p++ = ',';
+			}
+		}
+		p[-1] = '\n';
+	}
+
+	*len = p - buf;
+	return buf;
+}
+
+static char *ceetm_export_bin(const struct ceetm_export *e, size_t *len)
+{
+	const struct ceetm_export_field *f;
+	struct ceetm_export_hdr *hdr;
+	struct ceetm_export_col *col;
+	struct timespec ts;
+	int ncols = ceetm_export_ncols(e->fields);
+	__u64 *p;
+	char *buf;
+	int r, i;
+
+	*len = sizeof(*hdr) + ncols * sizeof(*col) +
+	       (size_t)ncols * e->nrows * sizeof(__u64);
+	buf = calloc(1, *len);
+	if (!buf) {
+		fprintf(stderr, "Out of memory.\n");
+		return NULL;
+	}
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	hdr = (struct ceetm_export_hdr *)buf;
+	memcpy(hdr->magic, CEETM_EXPORT_MAGIC, sizeof(hdr->magic));
+	hdr->version = CEETM_EXPORT_VERSION;
+	hdr->dpaa_version = e->h.ver == DPAA_1 ? 1 : 2;
+	hdr->ifindex = e->h.ifindex;
+	hdr->ncols = ncols;
+	hdr->nrows = e->nrows;
+	hdr->ts_ns = (__u64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+
+	col = (struct ceetm_export_col *)(hdr + 1);
+	p = (__u64 *)(col + ncols);
+	for (f = e->fields; f->name; f++) {
+		for (i = 0; i < f->count; i++, col++) {
+			if (f->count > 1)
+				snprintf(col->name, sizeof(col->name), "%s%d",
+					 f->name, i);
+			else
+				snprintf(col->name, sizeof(col->name), "%s",
+					 f->name);
+			col->flags = f->flags;
+
+			for (r = 0; r < e->nrows; r++)
+				*p++ = ceetm_export_value(e, r, f, i);
+		}
+	}
+
+	return buf;
+}
+
+static int ceetm_export_write(const char *file, const char *buf, size_t len)
+{
+	FILE *f = stdout;
+	int ret = 0;
+
+	if (file) {
+		f = fopen(file, "w");
+		if (!f) {
+			perror(file);
+			return -1;
+		}
+	}
+
+	/* The whole export goes in a single write */
+	setvbuf(f, NULL, _IONBF, 0);
+	if (len && fwrite(buf, len, 1, f) != 1) {
+		perror(file ? file : "stdout");
+		ret = -1;
+	}
+
+	if (file && fclose(f)) {
+		perror(file);
+		ret = -1;
+	}
+
+	return ret;
+}
+
+int do_export(int argc, char **argv)
+{
+	const char *dev = NULL, *file = NULL;
+	enum dpaa_version ver = detect_dpaa_version();
+	struct ceetm_export e;
+	struct ceetm_nl nl;
+	bool bin = false;
+	char *buf = NULL;
+	size_t len;
+	int ifindex, ret = -1;
+
+	while (argc > 0) {
+		if (strcmp(*argv, "dev") == 0) {
+			NEXT_ARG();
+			dev = *argv;
+
+		} else if (strcmp(*argv, "format") == 0) {
+			NEXT_ARG();
+			if (strcmp(*argv, "csv") == 0) {
+				bin = false;
+			} else if (strcmp(*argv, "bin") == 0) {
+				bin = true;
+			} else {
+				fprintf(stderr, "Illegal format argument: "
+						"must be csv or bin.\n");
+				return -1;
+			}
+
+		} else if (strcmp(*argv, "file") == 0) {
+			NEXT_ARG();
+			file = *argv;
+
+		} else if (strcmp(*argv, "soc") == 0) {
+			NEXT_ARG();
+			if (ceetmctl_parse_soc(*argv, &ver))
+				return -1;
+
+		} else if (strcmp(*argv, "help") == 0) {
+			explain();
+			return -1;
+
+		} else {
+			fprintf(stderr, "Illegal argument - %s.\n", *argv);
+			explain();
+			return -1;
+		}
+
+		argc--; argv++;
+	}
+
+	if (!dev) {
+		fprintf(stderr, "Please specify the device.\n");
+		return -1;
+	}
+
+	ifindex = if_nametoindex(dev);
+	if (!ifindex) {
+		fprintf(stderr, "Cannot find device \"%s\".\n", dev);
+		return -1;
+	}
+
+	memset(&e, 0, sizeof(e));
+	ceetm_hier_init(&e.h, ver, ifindex);
+	if (ver == DPAA_1) {
+		e.fields = ceetm_export_fields1;
+		e.row_size = sizeof(struct ceetm_export_row1);
+	} else {
+		e.fields = ceetm_export_fields2;
+		e.row_size = sizeof(struct ceetm_export_row2);
+	}
+
+	if (ceetm_nl_open(&nl))
+		goto out;
+
+	ret = ceetm_nl_dump(&nl, RTM_GETTCLASS, ifindex, ceetm_export_filter,
+			    &e);
+	ceetm_nl_close(&nl);
+	if (ret) {
+		fprintf(stderr, "Cannot dump the classes of %s.\n", dev);
+		ret = -1;
+		goto out;
+	}
+
+	ret = -1;
+	buf = bin ? ceetm_export_bin(&e, &len) : ceetm_export_csv(&e, &len);
+	if (buf)
+		ret = ceetm_export_write(file, buf, len);
+
+out:
+	free(buf);
+	free(e.rows);
+	ceetm_hier_free(&e.h);
+	return ret;
+}
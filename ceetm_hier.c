@@ -0,0 +1,437 @@
+/* Copyright 2017-2018 NXP
+ *
+ * SPDX-License-Identifier: GPL-2.0
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <linux/gen_stats.h>
+
+#include "ceetm_hier.h"
+
+struct ceetm_node *ceetm_hier_add(struct ceetm_hier *h)
+{
+	struct ceetm_node *nodes;
+	int size;
+
+	if (h->count == h->size) {
+		size = h->size ? 2 * h->size : 64;
+		nodes = realloc(h->nodes, size * sizeof(*nodes));
+		if (!nodes) {
+			fprintf(stderr, "Out of memory.\n");
+			return NULL;
+		}
+
+		h->nodes = nodes;
+		h->size = size;
+	}
+
+	memset(&h->nodes[h->count], 0, sizeof(h->nodes[0]));
+	return &h->nodes[h->count++];
+}
+
+static void dpaa1_ceetm_decode(struct ceetm_node *node, struct rtattr *opt,
+			       struct rtattr *xstats)
+{
+	struct rtattr *tb[TCA_CEETM_MAX + 1];
+	struct tc_ceetm_xstats st;
+
+	if (opt) {
+		parse_rtattr_nested(tb, TCA_CEETM_MAX, opt);
+
+		if (node->kind == CEETM_NODE_QDISC && tb[TCA_CEETM_QOPS] &&
+		    RTA_PAYLOAD(tb[TCA_CEETM_QOPS]) >= sizeof(node->opt.q1)) {
+			memcpy(&node->opt.q1, RTA_DATA(tb[TCA_CEETM_QOPS]),
+			       sizeof(node->opt.q1));
+			node->type = node->opt.q1.type;
+			node->has_opt = true;
+
+		} else if (node->kind == CEETM_NODE_CLASS && tb[TCA_CEETM_COPT] &&
+			   RTA_PAYLOAD(tb[TCA_CEETM_COPT]) >= sizeof(node->opt.c1)) {
+			memcpy(&node->opt.c1, RTA_DATA(tb[TCA_CEETM_COPT]),
+			       sizeof(node->opt.c1));
+			node->type = node->opt.c1.type;
+			node->has_opt = true;
+		}
+
+		if (node->kind == CEETM_NODE_CLASS &&
+		    tb[TCA_CEETM_MIN_SERVICE] &&
+		    RTA_PAYLOAD(tb[TCA_CEETM_MIN_SERVICE]) >=
+		    sizeof(struct tc_ceetm_min_service)) {
+			struct tc_ceetm_min_service *ms =
+				RTA_DATA(tb[TCA_CEETM_MIN_SERVICE]);
+
+			node->has_min_service = true;
+			node->min_rate = ms->rate;
+			node->max_run = ms->maxrun;
+		}
+
+		if (tb[TCA_CEETM_BUF_PART] &&
+		    RTA_PAYLOAD(tb[TCA_CEETM_BUF_PART]) >=
+		    sizeof(struct tc_ceetm_buf_part)) {
+			struct tc_ceetm_buf_part *bp =
+				RTA_DATA(tb[TCA_CEETM_BUF_PART]);
+
+			node->has_buf_part = true;
+			node->buf_reserve = bp->reserve;
+			node->buf_cap = bp->cap;
+		}
+
+		if (node->kind == CEETM_NODE_CLASS &&
+		    tb[TCA_CEETM_LAT_SAMPLE] &&
+		    RTA_PAYLOAD(tb[TCA_CEETM_LAT_SAMPLE]) >= sizeof(__u32)) {
+			node->has_lat_sample = true;
+			node->lat_sample =
+				rta_getattr_u32(tb[TCA_CEETM_LAT_SAMPLE]);
+		}
+
+		if (tb[TCA_CEETM_PKT_MODE] &&
+		    RTA_PAYLOAD(tb[TCA_CEETM_PKT_MODE]) >= sizeof(__u32))
+			node->pkt_mode =
+				!!rta_getattr_u32(tb[TCA_CEETM_PKT_MODE]);
+
+		if (node->kind == CEETM_NODE_QDISC &&
+		    tb[TCA_CEETM_WBFS_GROUP] &&
+		    RTA_PAYLOAD(tb[TCA_CEETM_WBFS_GROUP]) >=
+		    sizeof(struct tc_ceetm_wbfs_group)) {
+			struct tc_ceetm_wbfs_group *grp =
+				RTA_DATA(tb[TCA_CEETM_WBFS_GROUP]);
+
+			node->has_group = true;
+			node->group = grp->group;
+			node->group_prio = grp->prio;
+		}
+
+		if (node->kind == CEETM_NODE_QDISC &&
+		    tb[TCA_CEETM_FLOW_HASH] &&
+		    RTA_PAYLOAD(tb[TCA_CEETM_FLOW_HASH]) >= sizeof(__u32)) {
+			node->has_flow_hash = true;
+			node->flow_hash =
+				rta_getattr_u32(tb[TCA_CEETM_FLOW_HASH]);
+		}
+	}
+
+	if (!dpaa1_ceetm_get_xstats(xstats, &st)) {
+		node->stats.deq_bytes = st.byte_count;
+		node->stats.deq_frames = st.frame_count;
+		node->stats.rej_frames = st.ern_drop_count;
+		node->stats.congested = st.cgr_congested_count;
+	}
+}
+
+static void dpaa2_ceetm_decode(struct ceetm_node *node, struct rtattr *opt,
+			       struct rtattr *xstats)
+{
+	struct rtattr *tb[DPAA2_CEETM_TCA_MAX];
+	struct dpaa2_ceetm_tc_xstats st;
+
+	if (opt) {
+		parse_rtattr_nested(tb, DPAA2_CEETM_TCA_MAX - 1, opt);
+
+		if (node->kind == CEETM_NODE_QDISC && tb[DPAA2_CEETM_TCA_QOPS] &&
+		    RTA_PAYLOAD(tb[DPAA2_CEETM_TCA_QOPS]) >= sizeof(node->opt.q2)) {
+			memcpy(&node->opt.q2, RTA_DATA(tb[DPAA2_CEETM_TCA_QOPS]),
+			       sizeof(node->opt.q2));
+			node->type = node->opt.q2.type;
+			node->has_opt = true;
+
+		} else if (node->kind == CEETM_NODE_CLASS &&
+			   tb[DPAA2_CEETM_TCA_COPT] &&
+			   RTA_PAYLOAD(tb[DPAA2_CEETM_TCA_COPT]) >= sizeof(node->opt.c2)) {
+			memcpy(&node->opt.c2, RTA_DATA(tb[DPAA2_CEETM_TCA_COPT]),
+			       sizeof(node->opt.c2));
+			node->type = node->opt.c2.type;
+			node->has_opt = true;
+		}
+
+		if (node->kind == CEETM_NODE_CLASS &&
+		    tb[DPAA2_CEETM_TCA_MIN_SERVICE] &&
+		    RTA_PAYLOAD(tb[DPAA2_CEETM_TCA_MIN_SERVICE]) >=
+		    sizeof(struct dpaa2_ceetm_tc_min_service)) {
+			struct dpaa2_ceetm_tc_min_service *ms =
+				RTA_DATA(tb[DPAA2_CEETM_TCA_MIN_SERVICE]);
+
+			node->has_min_service = true;
+			node->min_rate = ms->rate;
+			node->max_run = ms->maxrun;
+		}
+
+		if (tb[DPAA2_CEETM_TCA_BUF_PART] &&
+		    RTA_PAYLOAD(tb[DPAA2_CEETM_TCA_BUF_PART]) >=
+		    sizeof(struct dpaa2_ceetm_tc_buf_part)) {
+			struct dpaa2_ceetm_tc_buf_part *bp =
+				RTA_DATA(tb[DPAA2_CEETM_TCA_BUF_PART]);
+
+			node->has_buf_part = true;
+			node->buf_reserve = bp->reserve;
+			node->buf_cap = bp->cap;
+		}
+
+		if (node->kind == CEETM_NODE_CLASS &&
+		    tb[DPAA2_CEETM_TCA_LAT_SAMPLE] &&
+		    RTA_PAYLOAD(tb[DPAA2_CEETM_TCA_LAT_SAMPLE]) >=
+		    sizeof(__u32)) {
+			node->has_lat_sample = true;
+			node->lat_sample =
+				rta_getattr_u32(tb[DPAA2_CEETM_TCA_LAT_SAMPLE]);
+		}
+
+		if (tb[DPAA2_CEETM_TCA_PKT_MODE] &&
+		    RTA_PAYLOAD(tb[DPAA2_CEETM_TCA_PKT_MODE]) >= sizeof(__u32))
+			node->pkt_mode =
+				!!rta_getattr_u32(tb[DPAA2_CEETM_TCA_PKT_MODE]);
+
+		if (node->kind == CEETM_NODE_QDISC &&
+		    tb[DPAA2_CEETM_TCA_FLOW_HASH] &&
+		    RTA_PAYLOAD(tb[DPAA2_CEETM_TCA_FLOW_HASH]) >=
+		    sizeof(__u32)) {
+			node->has_flow_hash = true;
+			node->flow_hash =
+				rta_getattr_u32(tb[DPAA2_CEETM_TCA_FLOW_HASH]);
+		}
+	}
+
+	if (!dpaa2_ceetm_get_xstats(xstats, &st)) {
+		node->stats.deq_bytes = st.ceetm_dequeue_bytes;
+		node->stats.deq_frames = st.ceetm_dequeue_frames;
+		node->stats.rej_bytes = st.ceetm_reject_bytes;
+		node->stats.rej_frames = st.ceetm_reject_frames;
+	}
+}
+
+/* Total bandwidth a shaped LNI or channel can send, CR + ER */
+void ceetm_node_update_limit(const struct ceetm_hier *h,
+			     struct ceetm_node *node)
+{
+	node->limit = 0;
+
+	if (!node->has_opt || node->pkt_mode)
+		return;
+
+	if (h->ver == DPAA_1) {
+		if (node->kind == CEETM_NODE_QDISC &&
+		    node->type == DPAA1_CEETM_ROOT && node->opt.q1.shaped)
+			node->limit = (__u64)node->opt.q1.rate +
+				      node->opt.q1.ceil;
+		else if (node->kind == CEETM_NODE_CLASS &&
+			 node->type == DPAA1_CEETM_ROOT && node->opt.c1.shaped)
+			node->limit = (__u64)node->opt.c1.rate +
+				      node->opt.c1.ceil;
+	} else {
+		if (node->kind == CEETM_NODE_CLASS &&
+		    node->type == DPAA2_CEETM_ROOT && node->opt.c2.shaped)
+			node->limit = node->opt.c2.shaping_cfg.cir +
+				      node->opt.c2.shaping_cfg.eir;
+	}
+}
+
+/* Decode a RTM_NEWQDISC / RTM_NEWTCLASS message into a new node. Messages
+ * of other interfaces or qdisc kinds are skipped.
+ */
+int ceetm_hier_parse_msg(struct ceetm_hier *h, struct nlmsghdr *n)
+{
+	struct tcmsg *t = NLMSG_DATA(n);
+	struct rtattr *tb[TCA_MAX + 1];
+	struct rtattr *st[TCA_STATS_MAX + 1];
+	struct rtattr *xstats = NULL;
+	struct ceetm_node *node;
+	int len;
+
+	if (n->nlmsg_type != RTM_NEWQDISC && n->nlmsg_type != RTM_NEWTCLASS)
+		return 0;
+
+	len = n->nlmsg_len - NLMSG_LENGTH(sizeof(*t));
+	if (len < 0 || t->tcm_ifindex != h->ifindex)
+		return 0;
+
+	parse_rtattr(tb, TCA_MAX, TCA_RTA(t), len);
+
+	if (!tb[TCA_KIND] || strcmp(RTA_DATA(tb[TCA_KIND]), "ceetm") != 0)
+		return 0;
+
+	node = ceetm_hier_add(h);
+	if (!node)
+		return -1;
+
+	node->kind = n->nlmsg_type == RTM_NEWQDISC ? CEETM_NODE_QDISC :
+						     CEETM_NODE_CLASS;
+	node->handle = t->tcm_handle;
+	node->parent = t->tcm_parent;
+
+	if (tb[TCA_STATS2]) {
+		parse_rtattr_nested(st, TCA_STATS_MAX, tb[TCA_STATS2]);
+		xstats = st[TCA_STATS_APP];
+	}
+
+	if (!xstats)
+		xstats = tb[TCA_XSTATS];
+
+	if (h->ver == DPAA_1)
+		dpaa1_ceetm_decode(node, tb[TCA_OPTIONS], xstats);
+	else
+		dpaa2_ceetm_decode(node, tb[TCA_OPTIONS], xstats);
+
+	ceetm_node_update_limit(h, node);
+
+	return 0;
+}
+
+static int ceetm_hier_filter(struct nlmsghdr *n, void *arg)
+{
+	return ceetm_hier_parse_msg(arg, n);
+}
+
+static int ceetm_node_cmp(const void *a, const void *b)
+{
+	const struct ceetm_node *na = a, *nb = b;
+
+	if (na->kind != nb->kind)
+		return na->kind < nb->kind ? -1 : 1;
+	if (na->handle != nb->handle)
+		return na->handle < nb->handle ? -1 : 1;
+	return 0;
+}
+
+int ceetm_hier_find(const struct ceetm_hier *h, enum ceetm_node_kind kind,
+		    __u32 handle)
+{
+	struct ceetm_node key, *node;
+
+	key.kind = kind;
+	key.handle = handle;
+
+	node = bsearch(&key, h->nodes, h->count, sizeof(key), ceetm_node_cmp);
+	return node ? node - h->nodes : -1;
+}
+
+/* tc style identifier of a node, "1:" for qdiscs and "1:2" for classes */
+const char *ceetm_node_id(const struct ceetm_node *node, char *buf, int len)
+{
+	if (node->kind == CEETM_NODE_QDISC)
+		snprintf(buf, len, "%x:", TC_H_MAJ(node->handle) >> 16);
+	else
+		snprintf(buf, len, "%x:%x", TC_H_MAJ(node->handle) >> 16,
+			 TC_H_MIN(node->handle));
+
+	return buf;
+}
+
+int ceetm_hier_depth(const struct ceetm_hier *h, int idx)
+{
+	int depth = 0;
+
+	while (h->nodes[idx].up >= 0) {
+		idx = h->nodes[idx].up;
+		depth++;
+	}
+
+	return depth;
+}
+
+static void ceetm_counters_add(struct ceetm_counters *dst,
+			       const struct ceetm_counters *src)
+{
+	dst->deq_bytes += src->deq_bytes;
+	dst->deq_frames += src->deq_frames;
+	dst->rej_bytes += src->rej_bytes;
+	dst->rej_frames += src->rej_frames;
+	dst->congested += src->congested;
+}
+
+/* Leaves (class queues) keep their own counters, every other node gets the
+ * sum of its children. Channels and schedulers do not own frames, so this
+ * avoids counting a frame twice if the driver already aggregates.
+ */
+static void ceetm_hier_aggregate(struct ceetm_hier *h, int idx)
+{
+	struct ceetm_node *node = &h->nodes[idx];
+	int c;
+
+	if (node->child < 0) {
+		node->total = node->stats;
+		return;
+	}
+
+	memset(&node->total, 0, sizeof(node->total));
+	for (c = node->child; c >= 0; c = h->nodes[c].next) {
+		ceetm_hier_aggregate(h, c);
+		ceetm_counters_add(&node->total, &h->nodes[c].total);
+	}
+}
+
+/* Classes hang off the qdisc sharing their major number, qdiscs hang off
+ * the class they are grafted on. Nodes are sorted by handle so both
+ * lookups are binary searches and children end up listed in handle order.
+ */
+void ceetm_hier_index(struct ceetm_hier *h)
+{
+	struct ceetm_node *node;
+	int i, up;
+
+	qsort(h->nodes, h->count, sizeof(h->nodes[0]), ceetm_node_cmp);
+
+	h->root = -1;
+	for (i = 0; i < h->count; i++) {
+		h->nodes[i].up = -1;
+		h->nodes[i].child = -1;
+		h->nodes[i].next = -1;
+	}
+
+	for (i = h->count - 1; i >= 0; i--) {
+		node = &h->nodes[i];
+
+		if (node->kind == CEETM_NODE_CLASS)
+			up = ceetm_hier_find(h, CEETM_NODE_QDISC,
+					     TC_H_MAJ(node->handle));
+		else if (node->parent == TC_H_ROOT)
+			up = -1;
+		else
+			up = ceetm_hier_find(h, CEETM_NODE_CLASS, node->parent);
+
+		if (node->kind == CEETM_NODE_QDISC && node->parent == TC_H_ROOT)
+			h->root = i;
+
+		if (up < 0)
+			continue;
+
+		node->up = up;
+		node->next = h->nodes[up].child;
+		h->nodes[up].child = i;
+	}
+
+	if (h->root >= 0)
+		ceetm_hier_aggregate(h, h->root);
+}
+
+void ceetm_hier_init(struct ceetm_hier *h, enum dpaa_version ver, int ifindex)
+{
+	memset(h, 0, sizeof(*h));
+	h->ver = ver;
+	h->ifindex = ifindex;
+	h->root = -1;
+}
+
+int ceetm_hier_load(struct ceetm_nl *nl, enum dpaa_version ver, int ifindex,
+		    struct ceetm_hier *h)
+{
+	ceetm_hier_init(h, ver, ifindex);
+
+	if (ceetm_nl_dump(nl, RTM_GETQDISC, ifindex, ceetm_hier_filter, h) ||
+	    ceetm_nl_dump(nl, RTM_GETTCLASS, ifindex, ceetm_hier_filter, h)) {
+		ceetm_hier_free(h);
+		return -1;
+	}
+
+	ceetm_hier_index(h);
+
+	return 0;
+}
+
+void ceetm_hier_free(struct ceetm_hier *h)
+{
+	free(h->nodes);
+	h->nodes = NULL;
+	h->count = 0;
+	h->size = 0;
+	h->root = -1;
+}
@@ -0,0 +1,106 @@
+/* Copyright 2017-2018 NXP
+ *
+ * SPDX-License-Identifier: GPL-2.0
+ */
+
+#ifndef __CEETM_HIER_H
+#define __CEETM_HIER_H
+
+#include "dpaa1_ceetm.h"
+#include "dpaa2_ceetm.h"
+#include "ceetm_soc.h"
+#include "ceetm_nl.h"
+
+enum ceetm_node_kind {
+	CEETM_NODE_QDISC,
+	CEETM_NODE_CLASS,
+};
+
+/* Backend independent view of the CEETM xstats */
+struct ceetm_counters {
+	__u64 deq_bytes;
+	__u64 deq_frames;
+	__u64 rej_bytes;
+	__u64 rej_frames;
+	__u64 congested;
+};
+
+/* One CEETM qdisc or class of an interface */
+struct ceetm_node {
+	enum ceetm_node_kind kind;
+	__u32 handle;
+	__u32 parent;
+	__u32 type;
+	bool has_opt;
+	union {
+		struct tc_ceetm_qopt q1;
+		struct tc_ceetm_copt c1;
+		struct dpaa2_ceetm_tc_qopt q2;
+		struct dpaa2_ceetm_tc_copt c2;
+	} opt;
+	/* Minimum service of a prio class, in bytes per second and frames */
+	bool has_min_service;
+	__u64 min_rate;
+	__u32 max_run;
+	/* Buffer pool partition of a LNI or channel, in bytes */
+	bool has_buf_part;
+	__u32 buf_reserve;
+	__u32 buf_cap;
+	/* Latency sampling of a class queue, one frame in lat_sample */
+	bool has_lat_sample;
+	__u32 lat_sample;
+	/* Shaper of a LNI or channel counting frames, its rates in packets
+	 * per second
+	 */
+	bool pkt_mode;
+	/* Class group of a DPAA1 wbfs qdisc, served right after the
+	 * independent class queue group_prio
+	 */
+	bool has_group;
+	__u8 group;
+	__u8 group_prio;
+	/* Flow hashing of a DPAA1 wbfs qdisc (1) or of the weighted groups
+	 * of a DPAA2 prio qdisc (DPAA2_CEETM_FLOW_HASH_* flags)
+	 */
+	bool has_flow_hash;
+	__u32 flow_hash;
+	/* Configured bandwidth in bytes per second, 0 if not shaped or
+	 * shaped in packets
+	 */
+	__u64 limit;
+	/* Counters reported for the node itself */
+	struct ceetm_counters stats;
+	/* Counters aggregated from the leaves of the subtree */
+	struct ceetm_counters total;
+	/* Tree links, as indexes in the node array, -1 if none */
+	int up;
+	int child;
+	int next;
+};
+
+/* Snapshot of the CEETM hierarchy of an interface */
+struct ceetm_hier {
+	enum dpaa_version ver;
+	int ifindex;
+	struct ceetm_node *nodes;
+	int count;
+	int size;
+	/* Index of the root qdisc (the LNI), -1 if none */
+	int root;
+};
+
+void ceetm_hier_init(struct ceetm_hier *h, enum dpaa_version ver, int ifindex);
+int ceetm_hier_load(struct ceetm_nl *nl, enum dpaa_version ver, int ifindex,
+		    struct ceetm_hier *h);
+struct ceetm_node *ceetm_hier_add(struct ceetm_hier *h);
+int ceetm_hier_parse_msg(struct ceetm_hier *h, struct nlmsghdr *n);
+void ceetm_hier_index(struct ceetm_hier *h);
+void ceetm_node_update_limit(const struct ceetm_hier *h,
+			     struct ceetm_node *node);
+void ceetm_hier_free(struct ceetm_hier *h);
+int ceetm_hier_find(const struct ceetm_hier *h, enum ceetm_node_kind kind,
+		    __u32 handle);
+const char *ceetm_node_id(const struct ceetm_node *node, char *buf, int len);
+int ceetm_hier_depth(const struct ceetm_hier *h, int idx);
+
+#endif
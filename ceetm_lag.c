@@ -0,0 +1,597 @@
+/* Copyright 2017-2018 NXP
+ *
+ * SPDX-License-Identifier: GPL-2.0
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <signal.h>
+#include <syslog.h>
+#include <time.h>
+#include <unistd.h>
+#include <net/if.h>
+
+#include "ceetm_plan.h"
+#include "ceetmctl.h"
+
+/* Shared rate budget of a LAG. A customer rate applies to a bond, but
+ * every member port shapes its traffic on its own LNI (or channel): a
+ * static split of the budget wastes the share of the members the hash
+ * leaves idle.
+ *
+ * The controller samples the dequeue counters of the member shapers every
+ * interval and splits the budget again, max-min fair on the demand of each
+ * member: the measured rate plus some headroom, or more than its share for
+ * a member that runs at its limit or drops frames. The shares always add
+ * up to the budget, members never go below a floor, and the shapers losing
+ * bandwidth are changed before the ones gaining it, in the same batch, so
+ * the aggregate does not go above the budget while it is applied.
+ */
+
+#define CEETM_LAG_MAX_MEMBERS		8
+#define CEETM_LAG_DEF_INTERVAL		200
+/* Percentage of the even share a member keeps whatever its load */
+#define CEETM_LAG_DEF_FLOOR		20
+/* Shares moving less than this percentage of the budget are left alone */
+#define CEETM_LAG_MIN_STEP		1
+
+struct ceetm_lag_member {
+	char dev[IFNAMSIZ];
+	int ifindex;
+	/* The shaper: the LNI qdisc or a channel class */
+	enum ceetm_node_kind kind;
+	__u32 handle;
+	/* Options of a DPAA1 LNI, a change carries all of them */
+	struct tc_ceetm_qopt q1;
+	/* Bytes per second: current share, last measured rate, demand */
+	__u64 share;
+	__u64 rate;
+	__u64 demand;
+	__u64 alloc;
+	struct ceetm_counters last;
+	bool sampled;
+};
+
+struct ceetm_lag {
+	const char *bond;
+	enum dpaa_version ver;
+	const struct ceetm_soc_caps *caps;
+	__u64 budget;
+	/* Largest share a member shaper takes, bytes per second */
+	__u64 max_share;
+	/* Channel shaped on every member, 0 for the default one */
+	__u32 classid;
+	unsigned int interval;
+	unsigned int floor;
+	struct ceetm_lag_member members[CEETM_LAG_MAX_MEMBERS];
+	int count;
+	bool daemon;
+};
+
+static volatile sig_atomic_t ceetm_lag_stop;
+
+static void explain(void)
+{
+	fprintf(stderr, "Usage: ceetmctl lag rate RATE (bond BOND | dev DEV "
+		"[dev DEV]...) [class CLASSID] [interval MS] [floor PCT] "
+		"[soc SOC] [daemon]\n"
+		"\n"
+		"RATE - rate of the whole LAG, shared by the members\n"
+		"BOND - bonding interface, its slaves are the members\n"
+		"CLASSID - channel shaped on every member (root class), by\n"
+		"	default the LNI on DPAA1 and the first channel on DPAA2\n"
+		"MS - sampling interval (default %d)\n"
+		"PCT - share of an idle member, in percent of RATE / members\n"
+		"	(default %d)\n",
+		CEETM_LAG_DEF_INTERVAL, CEETM_LAG_DEF_FLOOR);
+}
+
+static void ceetm_lag_log(const struct ceetm_lag *lag, const char *fmt, ...)
+{
+	va_list args;
+
+	va_start(args, fmt);
+	if (lag->daemon) {
+		vsyslog(LOG_INFO, fmt, args);
+	} else {
+		vfprintf(stdout, fmt, args);
+		fputc('\n', stdout);
+		fflush(stdout);
+	}
+	va_end(args);
+}
+
+static void ceetm_lag_signal(int sig)
+{
+	ceetm_lag_stop = 1;
+}
+
+static int ceetm_lag_add_member(struct ceetm_lag *lag, const char *dev)
+{
+	struct ceetm_lag_member *m;
+
+	if (lag->count == CEETM_LAG_MAX_MEMBERS) {
+		fprintf(stderr, "At most %d members are supported.\n",
+			CEETM_LAG_MAX_MEMBERS);
+		return -1;
+	}
+
+	if (strlen(dev) >= IFNAMSIZ) {
+		fprintf(stderr, "Invalid device name \"%s\".\n", dev);
+		return -1;
+	}
+
+	m = &lag->members[lag->count];
+	strcpy(m->dev, dev);
+	m->ifindex = if_nametoindex(dev);
+	if (!m->ifindex) {
+		fprintf(stderr, "Cannot find device \"%s\".\n", dev);
+		return -1;
+	}
+
+	lag->count++;
+	return 0;
+}
+
+/* The slaves of a bond, as listed by the bonding driver */
+static int ceetm_lag_read_bond(struct ceetm_lag *lag)
+{
+	char path[64], *line = NULL, *word, *save = NULL;
+	size_t len = 0;
+	int ret = 0;
+	FILE *f;
+
+	snprintf(path, sizeof(path), "/sys/class/net/%s/bonding/slaves",
+		 lag->bond);
+	f = fopen(path, "r");
+	if (!f) {
+		perror(path);
+		return -1;
+	}
+
+	if (getline(&line, &len, f) > 0) {
+		for (word = strtok_r(line, " \t\n", &save); word && !ret;
+		     word = strtok_r(NULL, " \t\n", &save))
+			ret = ceetm_lag_add_member(lag, word);
+	}
+
+	free(line);
+	fclose(f);
+	return ret;
+}
+
+/* Find the shaper of a member in its hierarchy */
+static int ceetm_lag_find(const struct ceetm_hier *h, __u32 classid)
+{
+	const struct ceetm_node *node;
+	int idx;
+
+	if (h->root < 0)
+		return -1;
+
+	if (classid)
+		return ceetm_hier_find(h, CEETM_NODE_CLASS, classid);
+
+	if (h->ver == DPAA_1)
+		return h->root;
+
+	/* The DPAA2 LNI has no shaper of its own */
+	for (idx = h->nodes[h->root].child; idx >= 0; idx = node->next) {
+		node = &h->nodes[idx];
+		if (node->has_opt && node->opt.c2.shaped)
+			return idx;
+	}
+
+	return -1;
+}
+
+static int ceetm_lag_collect(struct ceetm_lag *lag,
+			     struct ceetm_lag_member *m,
+			     const struct ceetm_hier *h)
+{
+	const struct ceetm_node *node;
+	int idx;
+
+	idx = ceetm_lag_find(h, lag->classid);
+	if (idx < 0) {
+		fprintf(stderr, "%s: no LNI or channel to shape.\n", m->dev);
+		return -1;
+	}
+
+	node = &h->nodes[idx];
+	if (!node->has_opt || node->type != (lag->ver == DPAA_1 ?
+	    DPAA1_CEETM_ROOT : DPAA2_CEETM_ROOT)) {
+		fprintf(stderr, "%s: %x:%x is not a LNI or channel.\n", m->dev,
+			TC_H_MAJ(node->handle) >> 16, TC_H_MIN(node->handle));
+		return -1;
+	}
+
+	if (lag->ver == DPAA_1 && node->kind == CEETM_NODE_QDISC &&
+	    !node->opt.q1.shaped) {
+		fprintf(stderr, "%s: the LNI is not shaped.\n", m->dev);
+		return -1;
+	}
+
+	if (node->pkt_mode) {
+		fprintf(stderr, "%s: %x:%x is shaped in packets per second.\n",
+			m->dev, TC_H_MAJ(node->handle) >> 16,
+			TC_H_MIN(node->handle));
+		return -1;
+	}
+
+	m->kind = node->kind;
+	m->handle = node->handle;
+	if (node->kind == CEETM_NODE_QDISC)
+		m->q1 = node->opt.q1;
+
+	return 0;
+}
+
+/* Dequeue rate of a member since the last sample. A member that drops
+ * frames or sits at its share wants more than it gets: it asks for a
+ * quarter more, the others for their rate and a tenth of headroom.
+ */
+static void ceetm_lag_sample(struct ceetm_lag_member *m,
+			     const struct ceetm_hier *h, double secs)
+{
+	const struct ceetm_counters *c;
+	bool busy;
+	int idx;
+
+	idx = ceetm_hier_find(h, m->kind, m->handle);
+	if (idx < 0) {
+		m->demand = m->share;
+		return;
+	}
+
+	c = &h->nodes[idx].total;
+	if (!m->sampled || c->deq_bytes < m->last.deq_bytes) {
+		m->sampled = true;
+		m->last = *c;
+		m->demand = m->share;
+		return;
+	}
+
+	m->rate = (c->deq_bytes - m->last.deq_bytes) / secs;
+	busy = c->rej_frames != m->last.rej_frames ||
+	       m->rate >= m->share / 10 * 9;
+	m->last = *c;
+
+	m->demand = busy ? m->share + m->share / 4 : m->rate + m->rate / 10;
+}
+
+/* Max-min fair split of the budget on the demands, above the floor. What
+ * is left once every demand is met goes evenly to all, for the bursts.
+ */
+static void ceetm_lag_allocate(struct ceetm_lag *lag)
+{
+	__u64 floor, left = lag->budget, fair;
+	struct ceetm_lag_member *m;
+	int i, pending = lag->count;
+	bool done[CEETM_LAG_MAX_MEMBERS] = { false };
+	bool again = true;
+
+	floor = lag->budget / lag->count * lag->floor / 100;
+
+	for (i = 0; i < lag->count; i++) {
+		m = &lag->members[i];
+		if (m->demand < floor)
+			m->demand = floor;
+		m->alloc = 0;
+	}
+
+	while (again && pending) {
+		again = false;
+		fair = left / pending;
+
+		for (i = 0; i < lag->count; i++) {
+			m = &lag->members[i];
+			if (done[i] || m->demand > fair)
+				continue;
+
+			m->alloc = m->demand;
+			left -= m->demand;
+			done[i] = true;
+			pending--;
+			again = true;
+		}
+	}
+
+	if (pending) {
+		fair = left / pending;
+		for (i = 0; i < lag->count; i++) {
+			if (!done[i]) {
+				lag->members[i].alloc = fair;
+				left -= fair;
+			}
+		}
+	} else {
+		fair = left / lag->count;
+		for (i = 0; i < lag->count; i++) {
+			lag->members[i].alloc += fair;
+			left -= fair;
+		}
+	}
+
+	/* The rounding, the shares add up to the budget exactly */
+	lag->members[0].alloc += left;
+}
+
+static int ceetm_lag_build(const struct ceetm_lag *lag,
+			   const struct ceetm_lag_member *m,
+			   struct ceetm_req *req, __u64 rate)
+{
+	struct tc_ceetm_qopt q1;
+
+	/* A member can not carry more than its shaper takes anyway */
+	if (rate > lag->max_share)
+		rate = lag->max_share;
+
+	/* No excess rate (DPAA1 ceil, DPAA2 eir): it would let the
+	 * aggregate above the budget
+	 */
+	if (m->kind == CEETM_NODE_CLASS)
+		return ceetm_channel_shaper_req(req, lag->ver, m->ifindex,
+						m->handle, rate, 0);
+
+	ceetm_req_init(req, RTM_NEWQDISC, true, m->ifindex, TC_H_ROOT,
+		       m->handle);
+	q1 = m->q1;
+	q1.rate = rate;
+	q1.ceil = 0;
+	return dpaa1_ceetm_qdisc_req(req, &q1, NULL, NULL, NULL, NULL);
+}
+
+static int ceetm_lag_add_change(const struct ceetm_lag *lag,
+				struct ceetm_batch *b,
+				const struct ceetm_lag_member *m)
+{
+	struct ceetm_req req;
+	int err;
+
+	err = ceetm_lag_build(lag, m, &req, m->alloc);
+	if (!err)
+		err = ceetm_batch_add(b, &req);
+	if (err)
+		ceetm_lag_log(lag, "%s: cannot build the change of %x:%x: %s",
+			      m->dev, TC_H_MAJ(m->handle) >> 16,
+			      TC_H_MIN(m->handle), strerror(-err));
+
+	return err;
+}
+
+/* Apply the new shares, if one moved enough. 'force' for the first run. */
+static int ceetm_lag_apply(struct ceetm_lag *lag, struct ceetm_nl *nl,
+			   bool force)
+{
+	char buf[CEETM_LAG_MAX_MEMBERS * sizeof(struct ceetm_req)];
+	__u64 step = lag->budget * CEETM_LAG_MIN_STEP / 100;
+	struct ceetm_lag_member *m;
+	struct ceetm_batch b;
+	int i, err, failed;
+
+	for (i = 0; i < lag->count && !force; i++) {
+		m = &lag->members[i];
+		if (m->alloc > m->share + step || m->alloc + step < m->share)
+			force = true;
+	}
+
+	if (!force)
+		return 0;
+
+	ceetm_batch_init(&b, buf, sizeof(buf));
+
+	/* Shrink first, then grow */
+	for (i = 0; i < lag->count; i++) {
+		m = &lag->members[i];
+		if (m->alloc <= m->share && ceetm_lag_add_change(lag, &b, m))
+			return -1;
+	}
+	for (i = 0; i < lag->count; i++) {
+		m = &lag->members[i];
+		if (m->alloc > m->share && ceetm_lag_add_change(lag, &b, m))
+			return -1;
+	}
+
+	err = ceetm_batch_send(nl, &b, &failed);
+	if (err) {
+		ceetm_lag_log(lag, "%s: change of the shares failed: %s",
+			      lag->bond ? lag->bond : "lag", strerror(-err));
+		return -1;
+	}
+
+	for (i = 0; i < lag->count; i++) {
+		m = &lag->members[i];
+		ceetm_lag_log(lag, "%s: share %llu B/s, was %llu B/s, "
+			      "rate %llu B/s", m->dev, m->alloc, m->share,
+			      m->rate);
+		m->share = m->alloc;
+	}
+
+	return 0;
+}
+
+/* Sample every member and split the budget again */
+static int ceetm_lag_step(struct ceetm_lag *lag, struct ceetm_nl *nl,
+			  double secs)
+{
+	struct ceetm_lag_member *m;
+	struct ceetm_hier h;
+	int i;
+
+	for (i = 0; i < lag->count; i++) {
+		m = &lag->members[i];
+		if (ceetm_hier_load(nl, lag->ver, m->ifindex, &h))
+			return -1;
+
+		ceetm_lag_sample(m, &h, secs);
+		ceetm_hier_free(&h);
+	}
+
+	ceetm_lag_allocate(lag);
+	return ceetm_lag_apply(lag, nl, false);
+}
+
+int do_lag(int argc, char **argv)
+{
+	struct timespec last, now;
+	struct ceetm_lag *lag;
+	struct ceetm_hier h;
+	struct ceetm_nl nl;
+	double secs;
+	int i, ret = -1;
+
+	lag = calloc(1, sizeof(*lag));
+	if (!lag)
+		return -1;
+
+	lag->caps = ceetm_soc_caps();
+	lag->interval = CEETM_LAG_DEF_INTERVAL;
+	lag->floor = CEETM_LAG_DEF_FLOOR;
+
+	while (argc > 0) {
+		if (strcmp(*argv, "rate") == 0) {
+			NEXT_ARG();
+			if (get_rate64(&lag->budget, *argv) || !lag->budget) {
+				fprintf(stderr, "Illegal rate argument.\n");
+				goto out_free;
+			}
+
+		} else if (strcmp(*argv, "bond") == 0) {
+			NEXT_ARG();
+			lag->bond = *argv;
+
+		} else if (strcmp(*argv, "dev") == 0) {
+			NEXT_ARG();
+			if (ceetm_lag_add_member(lag, *argv))
+				goto out_free;
+
+		} else if (strcmp(*argv, "class") == 0) {
+			NEXT_ARG();
+			if (get_tc_classid(&lag->classid, *argv) ||
+			    !TC_H_MIN(lag->classid)) {
+				fprintf(stderr, "Illegal class argument.\n");
+				goto out_free;
+			}
+
+		} else if (strcmp(*argv, "interval") == 0) {
+			NEXT_ARG();
+			if (get_unsigned(&lag->interval, *argv, 10) ||
+			    !lag->interval) {
+				fprintf(stderr, "Illegal interval argument.\n");
+				goto out_free;
+			}
+
+		} else if (strcmp(*argv, "floor") == 0) {
+			NEXT_ARG();
+			if (get_unsigned(&lag->floor, *argv, 10) ||
+			    lag->floor > 100) {
+				fprintf(stderr, "Illegal floor argument.\n");
+				goto out_free;
+			}
+
+		} else if (strcmp(*argv, "soc") == 0) {
+			NEXT_ARG();
+			lag->caps = ceetm_soc_lookup_name(*argv);
+			if (!lag->caps) {
+				fprintf(stderr, "Unknown SoC %s.\n", *argv);
+				goto out_free;
+			}
+
+		} else if (strcmp(*argv, "daemon") == 0) {
+			lag->daemon = true;
+
+		} else if (strcmp(*argv, "help") == 0) {
+			explain();
+			goto out_free;
+
+		} else {
+			fprintf(stderr, "Illegal argument - %s.\n", *argv);
+			explain();
+			goto out_free;
+		}
+
+		argc--; argv++;
+	}
+
+	if (!lag->budget) {
+		fprintf(stderr, "Please specify the rate.\n");
+		goto out_free;
+	}
+
+	if (lag->bond && (lag->count || ceetm_lag_read_bond(lag)))
+		goto out_free;
+
+	if (lag->count < 2) {
+		fprintf(stderr, "Please specify the bond or at least two "
+				"devices.\n");
+		goto out_free;
+	}
+
+	/* The DPAA1 shapers take 32-bit rates */
+	lag->ver = lag->caps->ver;
+	lag->max_share = lag->caps->max_rate;
+	if (lag->ver == DPAA_1 && lag->max_share > (__u32)~0U)
+		lag->max_share = (__u32)~0U;
+
+	if (lag->budget / lag->count > lag->max_share) {
+		fprintf(stderr, "The rate is more than the %d members can "
+				"carry, %llu B/s each on %s.\n", lag->count,
+			(unsigned long long)lag->max_share, lag->caps->name);
+		goto out_free;
+	}
+
+	if (ceetm_nl_open(&nl))
+		goto out_free;
+
+	for (i = 0; i < lag->count; i++) {
+		if (ceetm_hier_load(&nl, lag->ver, lag->members[i].ifindex, &h))
+			goto out_nl;
+
+		ret = ceetm_lag_collect(lag, &lag->members[i], &h);
+		ceetm_hier_free(&h);
+		if (ret)
+			goto out_nl;
+		ret = -1;
+	}
+
+	/* Start from an even split */
+	for (i = 0; i < lag->count; i++)
+		lag->members[i].demand = lag->budget / lag->count;
+	ceetm_lag_allocate(lag);
+	if (ceetm_lag_apply(lag, &nl, true))
+		goto out_nl;
+
+	if (lag->daemon) {
+		if (daemon(0, 0)) {
+			perror("daemon");
+			goto out_nl;
+		}
+		openlog("ceetmctl", LOG_PID, LOG_DAEMON);
+	}
+
+	signal(SIGINT, ceetm_lag_signal);
+	signal(SIGTERM, ceetm_lag_signal);
+
+	clock_gettime(CLOCK_MONOTONIC, &last);
+	while (!ceetm_lag_stop) {
+		ceetmctl_sleep_ms(lag->interval);
+
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		secs = ceetmctl_secs(&last, &now);
+		last = now;
+
+		if (ceetm_lag_step(lag, &nl, secs))
+			break;
+	}
+
+	ret = ceetm_lag_stop ? 0 : -1;
+
+out_nl:
+	ceetm_nl_close(&nl);
+out_free:
+	free(lag);
+	return ret;
+}
@@ -0,0 +1,546 @@
+/* Copyright 2017-2018 NXP
+ *
+ * SPDX-License-Identifier: GPL-2.0
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <syslog.h>
+#include <unistd.h>
+#include <net/if.h>
+
+#include "ceetm_plan.h"
+#include "ceetmctl.h"
+
+/* Link speed aware shaping. The shaper settings of a hierarchy are written
+ * for one link speed, the base. When the port comes up at another speed,
+ * a LNI shaped above the line rate no longer holds the backlog: the frames
+ * queue in the MAC FIFOs instead, out of reach of the CEETM scheduler.
+ *
+ * The watcher takes the shaped LNIs and channels and their base rates from
+ * a plan or snapshot of the hierarchy, never from the live shapers: those
+ * may already be scaled by an earlier run, a restart would scale them
+ * again. It then follows the RTNLGRP_LINK notifications of the interface. On every new speed the
+ * shapers are set to their per-speed profile when there is one, scaled by
+ * speed / base otherwise, in a single batch of qdisc / class changes.
+ */
+
+/* Mbit/s, the speed the hierarchies are usually written for */
+#define CEETM_LINK_DEF_BASE		10000
+#define CEETM_LINK_MAX_SHAPERS		64
+#define CEETM_LINK_MAX_PROFILES		256
+
+struct ceetm_link_shaper {
+	enum ceetm_node_kind kind;
+	__u32 handle;
+	/* Rates at the base speed, bytes per second */
+	__u64 cir;
+	__u64 eir;
+	/* Options of a DPAA1 LNI, a change carries all of them */
+	struct tc_ceetm_qopt q1;
+};
+
+/* Rates of one shaper at one speed, from the profile file */
+struct ceetm_link_profile {
+	unsigned int speed;
+	enum ceetm_node_kind kind;
+	__u32 handle;
+	__u64 cir;
+	__u64 eir;
+};
+
+struct ceetm_link {
+	const char *dev;
+	int ifindex;
+	enum dpaa_version ver;
+	unsigned int base;
+	/* Speed the shapers are set for, 0 before the first change */
+	unsigned int speed;
+	struct ceetm_link_shaper shapers[CEETM_LINK_MAX_SHAPERS];
+	int count;
+	struct ceetm_link_profile profiles[CEETM_LINK_MAX_PROFILES];
+	int nprofiles;
+	bool daemon;
+};
+
+static volatile sig_atomic_t ceetm_link_stop;
+
+static void explain(void)
+{
+	fprintf(stderr, "Usage: ceetmctl autoscale dev DEV plan PLAN "
+		"[base SPEED] [profile FILE]\n"
+		"	[soc SOC] [daemon]\n"
+		"\n"
+		"PLAN - plan or snapshot of the hierarchy of DEV, its shaper\n"
+		"	rates are the ones at the base speed\n"
+		"Each line of FILE is:\n"
+		"SPEED ID CIR [EIR]\n"
+		"\n"
+		"SPEED - link speed in Mbit/s, as reported by ethtool\n"
+		"base - speed the current shaper settings are meant for "
+		"(default %d)\n"
+		"ID - handle of a root qdisc (LNI, e.g. 1:) or classid of a root\n"
+		"	class (channel, e.g. 1:1)\n"
+		"CIR/EIR - committed and excess rates of the shaper at SPEED,\n"
+		"	the rate and ceil of DPAA1 LNIs and channels\n"
+		"The shapers without a profile for a speed are scaled by\n"
+		"SPEED / base.\n",
+		CEETM_LINK_DEF_BASE);
+}
+
+static void ceetm_link_log(const struct ceetm_link *link, const char *fmt, ...)
+{
+	va_list args;
+
+	va_start(args, fmt);
+	if (link->daemon) {
+		vsyslog(LOG_INFO, fmt, args);
+	} else {
+		vfprintf(stdout, fmt, args);
+		fputc('\n', stdout);
+		fflush(stdout);
+	}
+	va_end(args);
+}
+
+static void ceetm_link_signal(int sig)
+{
+	ceetm_link_stop = 1;
+}
+
+/* "1:" names the LNI qdisc, "1:1" the channel class */
+static int ceetm_link_parse_id(const char *arg, enum ceetm_node_kind *kind,
+			       __u32 *handle)
+{
+	if (get_tc_classid(handle, arg))
+		return -1;
+
+	*kind = TC_H_MIN(*handle) ? CEETM_NODE_CLASS : CEETM_NODE_QDISC;
+	return 0;
+}
+
+static int ceetm_link_parse_line(struct ceetm_link *link, int argc,
+				 char **argv)
+{
+	struct ceetm_link_profile *p;
+
+	if (argc != 3 && argc != 4)
+		return -1;
+
+	if (link->nprofiles == CEETM_LINK_MAX_PROFILES) {
+		fprintf(stderr, "At most %d profile lines are supported.\n",
+			CEETM_LINK_MAX_PROFILES);
+		return -1;
+	}
+
+	p = &link->profiles[link->nprofiles];
+	memset(p, 0, sizeof(*p));
+
+	if (get_unsigned(&p->speed, argv[0], 10) || !p->speed ||
+	    ceetm_link_parse_id(argv[1], &p->kind, &p->handle) ||
+	    get_rate64(&p->cir, argv[2]) ||
+	    (argc == 4 && get_rate64(&p->eir, argv[3])))
+		return -1;
+
+	link->nprofiles++;
+	return 0;
+}
+
+static int ceetm_link_load_profiles(struct ceetm_link *link, const char *path)
+{
+	char *argv[CEETM_PLAN_MAX_ARGS], *line = NULL, *word, *save;
+	unsigned int lineno = 0;
+	size_t len = 0;
+	int argc, ret = 0;
+	FILE *f;
+
+	f = fopen(path, "r");
+	if (!f) {
+		perror(path);
+		return -1;
+	}
+
+	while (getline(&line, &len, f) > 0) {
+		lineno++;
+		line[strcspn(line, "#\n")] = '\0';
+
+		argc = 0;
+		save = NULL;
+		for (word = strtok_r(line, " \t", &save);
+		     word && argc < CEETM_PLAN_MAX_ARGS;
+		     word = strtok_r(NULL, " \t", &save))
+			argv[argc++] = word;
+
+		if (argc == 0)
+			continue;
+
+		if (ceetm_link_parse_line(link, argc, argv)) {
+			fprintf(stderr, "%s:%u: invalid profile.\n", path,
+				lineno);
+			ret = -1;
+			break;
+		}
+	}
+
+	free(line);
+	fclose(f);
+	return ret;
+}
+
+/* Remember the shaped LNIs and channels of the plan with their base rates */
+static int ceetm_link_collect(struct ceetm_link *link,
+			      const struct ceetm_hier *h)
+{
+	const struct ceetm_node *node;
+	struct ceetm_link_shaper *sh;
+	int i;
+
+	for (i = 0; i < h->count; i++) {
+		node = &h->nodes[i];
+
+		if (!node->has_opt)
+			continue;
+
+		if (h->ver == DPAA_1 && (node->type != DPAA1_CEETM_ROOT ||
+		    (node->kind == CEETM_NODE_QDISC && !node->opt.q1.shaped) ||
+		    (node->kind == CEETM_NODE_CLASS && !node->opt.c1.shaped)))
+			continue;
+
+		/* The DPAA2 LNI has no shaper of its own */
+		if (h->ver == DPAA_2 && (node->type != DPAA2_CEETM_ROOT ||
+					 node->kind == CEETM_NODE_QDISC ||
+					 !node->opt.c2.shaped))
+			continue;
+
+		/* A packet rate does not scale with the line rate */
+		if (node->pkt_mode)
+			continue;
+
+		if (link->count == CEETM_LINK_MAX_SHAPERS) {
+			fprintf(stderr, "At most %d shapers can be followed.\n",
+				CEETM_LINK_MAX_SHAPERS);
+			return -1;
+		}
+
+		sh = &link->shapers[link->count++];
+		memset(sh, 0, sizeof(*sh));
+		sh->kind = node->kind;
+		sh->handle = node->handle;
+
+		if (h->ver == DPAA_2) {
+			sh->cir = node->opt.c2.shaping_cfg.cir;
+			sh->eir = node->opt.c2.shaping_cfg.eir;
+		} else if (node->kind == CEETM_NODE_QDISC) {
+			sh->q1 = node->opt.q1;
+			sh->cir = node->opt.q1.rate;
+			sh->eir = node->opt.q1.ceil;
+		} else {
+			sh->cir = node->opt.c1.rate;
+			sh->eir = node->opt.c1.ceil;
+		}
+	}
+
+	return 0;
+}
+
+/* Mbit/s, 0 while the link is down or the driver does not know */
+static unsigned int ceetm_link_read_speed(const char *dev)
+{
+	char path[64];
+	int speed = 0;
+	FILE *f;
+
+	snprintf(path, sizeof(path), "/sys/class/net/%s/speed", dev);
+	f = fopen(path, "r");
+	if (!f)
+		return 0;
+
+	if (fscanf(f, "%d", &speed) != 1 || speed < 0)
+		speed = 0;
+
+	fclose(f);
+	return speed;
+}
+
+static void ceetm_link_target(const struct ceetm_link *link,
+			      const struct ceetm_link_shaper *sh,
+			      unsigned int speed, __u64 *cir, __u64 *eir)
+{
+	const struct ceetm_link_profile *p;
+	int i;
+
+	for (i = 0; i < link->nprofiles; i++) {
+		p = &link->profiles[i];
+		if (p->speed == speed && p->kind == sh->kind &&
+		    p->handle == sh->handle) {
+			*cir = p->cir;
+			*eir = p->eir;
+			return;
+		}
+	}
+
+	*cir = sh->cir * speed / link->base;
+	*eir = sh->eir * speed / link->base;
+}
+
+static int ceetm_link_build(const struct ceetm_link *link,
+			    const struct ceetm_link_shaper *sh,
+			    struct ceetm_req *req, __u64 cir, __u64 eir)
+{
+	struct tc_ceetm_qopt q1;
+
+	/* The DPAA1 rates are 32 bits wide */
+	if (link->ver == DPAA_1) {
+		if (cir > (__u32)~0U)
+			cir = (__u32)~0U;
+		if (eir > (__u32)~0U)
+			eir = (__u32)~0U;
+	}
+
+	if (sh->kind == CEETM_NODE_CLASS)
+		return ceetm_channel_shaper_req(req, link->ver, link->ifindex,
+						sh->handle, cir, eir);
+
+	ceetm_req_init(req, RTM_NEWQDISC, true, link->ifindex, TC_H_ROOT,
+		       sh->handle);
+	q1 = sh->q1;
+	q1.rate = cir;
+	q1.ceil = eir;
+	return dpaa1_ceetm_qdisc_req(req, &q1, NULL, NULL, NULL, NULL);
+}
+
+static int ceetm_link_rescale(struct ceetm_link *link, struct ceetm_nl *nl,
+			      unsigned int speed)
+{
+	const struct ceetm_link_shaper *sh;
+	struct ceetm_batch b;
+	struct ceetm_req req;
+	__u64 cir, eir;
+	char id[16];
+	void *buf;
+	int i, err, failed;
+
+	buf = malloc(link->count * sizeof(struct ceetm_req));
+	if (!buf)
+		return -ENOMEM;
+
+	ceetm_batch_init(&b, buf, link->count * sizeof(struct ceetm_req));
+
+	for (i = 0; i < link->count; i++) {
+		sh = &link->shapers[i];
+		ceetm_link_target(link, sh, speed, &cir, &eir);
+
+		err = ceetm_link_build(link, sh, &req, cir, eir);
+		if (!err)
+			err = ceetm_batch_add(&b, &req);
+		if (err) {
+			ceetm_link_log(link, "%s: cannot build the change of "
+				       "%x:%x: %s", link->dev,
+				       TC_H_MAJ(sh->handle) >> 16,
+				       TC_H_MIN(sh->handle), strerror(-err));
+			goto out;
+		}
+	}
+
+	err = ceetm_batch_send(nl, &b, &failed);
+	if (err) {
+		sh = &link->shapers[failed >= 0 ? failed : 0];
+		ceetm_link_log(link, "%s: speed %u Mbit/s, change of %x:%x "
+			       "failed: %s", link->dev, speed,
+			       TC_H_MAJ(sh->handle) >> 16,
+			       TC_H_MIN(sh->handle), strerror(-err));
+		goto out;
+	}
+
+	link->speed = speed;
+
+	for (i = 0; i < link->count; i++) {
+		sh = &link->shapers[i];
+		ceetm_link_target(link, sh, speed, &cir, &eir);
+		snprintf(id, sizeof(id), "%x:%x", TC_H_MAJ(sh->handle) >> 16,
+			 TC_H_MIN(sh->handle));
+		ceetm_link_log(link, "%s: speed %u Mbit/s, %s %s cir %llu "
+			       "eir %llu B/s", link->dev, speed,
+			       sh->kind == CEETM_NODE_QDISC ? "qdisc" : "class",
+			       id, cir, eir);
+	}
+
+out:
+	free(buf);
+	return err;
+}
+
+/* Wait for a notification about the interface, true if one came in.
+ * A lost notification (the socket overran) counts as one.
+ */
+static bool ceetm_link_wait(struct ceetm_nl *events, int ifindex)
+{
+	struct pollfd pfd = { .fd = events->fd, .events = POLLIN };
+	struct ifinfomsg *ifi;
+	struct nlmsghdr *h;
+	ssize_t len;
+
+	/* Wake up now and then to notice the signals */
+	if (poll(&pfd, 1, 1000) <= 0)
+		return false;
+
+	len = recv(events->fd, events->buf, sizeof(events->buf), 0);
+	if (len < 0)
+		return errno == ENOBUFS;
+
+	for (h = (struct nlmsghdr *)events->buf; NLMSG_OK(h, len);
+	     h = NLMSG_NEXT(h, len)) {
+		if (h->nlmsg_type != RTM_NEWLINK ||
+		    h->nlmsg_len < NLMSG_LENGTH(sizeof(*ifi)))
+			continue;
+
+		ifi = NLMSG_DATA(h);
+		if (ifi->ifi_index == ifindex)
+			return true;
+	}
+
+	return false;
+}
+
+int do_autoscale(int argc, char **argv)
+{
+	enum dpaa_version ver = detect_dpaa_version();
+	const char *profile = NULL, *plan = NULL;
+	struct ceetm_nl nl, events;
+	struct ceetm_link *link;
+	struct ceetm_hier h;
+	unsigned int speed;
+	bool pending;
+	int ret = -1;
+
+	link = calloc(1, sizeof(*link));
+	if (!link)
+		return -1;
+
+	link->base = CEETM_LINK_DEF_BASE;
+
+	while (argc > 0) {
+		if (strcmp(*argv, "dev") == 0) {
+			NEXT_ARG();
+			link->dev = *argv;
+
+		} else if (strcmp(*argv, "base") == 0) {
+			NEXT_ARG();
+			if (get_unsigned(&link->base, *argv, 10) ||
+			    !link->base) {
+				fprintf(stderr, "Illegal base argument.\n");
+				goto out_free;
+			}
+
+		} else if (strcmp(*argv, "plan") == 0) {
+			NEXT_ARG();
+			plan = *argv;
+
+		} else if (strcmp(*argv, "profile") == 0) {
+			NEXT_ARG();
+			profile = *argv;
+
+		} else if (strcmp(*argv, "soc") == 0) {
+			NEXT_ARG();
+			if (ceetmctl_parse_soc(*argv, &ver))
+				goto out_free;
+
+		} else if (strcmp(*argv, "daemon") == 0) {
+			link->daemon = true;
+
+		} else if (strcmp(*argv, "help") == 0) {
+			explain();
+			goto out_free;
+
+		} else {
+			fprintf(stderr, "Illegal argument - %s.\n", *argv);
+			explain();
+			goto out_free;
+		}
+
+		argc--; argv++;
+	}
+
+	if (!link->dev) {
+		fprintf(stderr, "Please specify the device.\n");
+		goto out_free;
+	}
+
+	if (!plan) {
+		fprintf(stderr, "Please specify the plan holding the base "
+				"rates.\n");
+		goto out_free;
+	}
+
+	if (profile && ceetm_link_load_profiles(link, profile))
+		goto out_free;
+
+	link->ver = ver;
+	link->ifindex = if_nametoindex(link->dev);
+	if (!link->ifindex) {
+		fprintf(stderr, "Cannot find device \"%s\".\n", link->dev);
+		goto out_free;
+	}
+
+	if (ceetmctl_load_hier(NULL, plan, ver, &h))
+		goto out_free;
+
+	ret = ceetm_link_collect(link, &h);
+	ceetm_hier_free(&h);
+	if (ret)
+		goto out_free;
+
+	ret = -1;
+	if (!link->count) {
+		fprintf(stderr, "No shaped LNI or channel in %s.\n", plan);
+		goto out_free;
+	}
+
+	if (ceetm_nl_open(&nl))
+		goto out_free;
+
+	/* Subscribe before the first read, not to miss a change in between */
+	if (ceetm_nl_open(&events))
+		goto out_nl;
+	if (ceetm_nl_subscribe(&events, RTNLGRP_LINK))
+		goto out_events;
+
+	if (link->daemon) {
+		if (daemon(0, 0)) {
+			perror("daemon");
+			goto out_events;
+		}
+		openlog("ceetmctl", LOG_PID, LOG_DAEMON);
+	}
+
+	signal(SIGINT, ceetm_link_signal);
+	signal(SIGTERM, ceetm_link_signal);
+
+	speed = ceetm_link_read_speed(link->dev);
+	pending = true;
+	while (!ceetm_link_stop) {
+		/* Keep the last settings while the link is down. A failed
+		 * change is retried on the next notification, not in a loop.
+		 */
+		if (pending && speed && speed != link->speed)
+			ceetm_link_rescale(link, &nl, speed);
+
+		pending = ceetm_link_wait(&events, link->ifindex);
+		if (pending)
+			speed = ceetm_link_read_speed(link->dev);
+	}
+
+	ret = 0;
+
+out_events:
+	ceetm_nl_close(&events);
+out_nl:
+	ceetm_nl_close(&nl);
+out_free:
+	free(link);
+	return ret;
+}
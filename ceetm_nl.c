@@ -0,0 +1,285 @@
+/* Copyright 2017-2018 NXP
+ *
+ * SPDX-License-Identifier: GPL-2.0
+ */
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/socket.h>
+
+#include "ceetm_nl.h"
+
+int ceetm_nl_open(struct ceetm_nl *nl)
+{
+	struct sockaddr_nl local;
+	socklen_t addr_len = sizeof(local);
+	int bufsize = CEETM_NL_SOCK_BUFSIZE;
+
+	memset(&local, 0, sizeof(local));
+	local.nl_family = AF_NETLINK;
+
+	nl->fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+	if (nl->fd < 0) {
+		perror("Cannot open netlink socket");
+		return -1;
+	}
+
+	/* Best effort, the defaults only limit the size of a batch */
+	setsockopt(nl->fd, SOL_SOCKET, SO_SNDBUF, &bufsize, sizeof(bufsize));
+	setsockopt(nl->fd, SOL_SOCKET, SO_RCVBUF, &bufsize, sizeof(bufsize));
+
+	if (bind(nl->fd, (struct sockaddr *)&local, sizeof(local)) < 0 ||
+	    getsockname(nl->fd, (struct sockaddr *)&local, &addr_len) < 0) {
+		perror("Cannot bind netlink socket");
+		close(nl->fd);
+		nl->fd = -1;
+		return -1;
+	}
+
+	nl->pid = local.nl_pid;
+	nl->seq = 0;
+
+	return 0;
+}
+
+/* Join a rtnetlink multicast group (RTNLGRP_*), to be notified of changes.
+ * The notifications are best kept on a socket of their own: the request
+ * helpers drop whatever they do not wait for.
+ */
+int ceetm_nl_subscribe(struct ceetm_nl *nl, unsigned int group)
+{
+	if (setsockopt(nl->fd, SOL_NETLINK, NETLINK_ADD_MEMBERSHIP, &group,
+		       sizeof(group)) < 0) {
+		perror("Cannot join netlink group");
+		return -errno;
+	}
+
+	return 0;
+}
+
+void ceetm_nl_close(struct ceetm_nl *nl)
+{
+	if (nl->fd >= 0)
+		close(nl->fd);
+	nl->fd = -1;
+}
+
+/* Send a request and wait for its acknowledgement. Returns 0 or the
+ * negative errno reported by the kernel.
+ */
+int ceetm_nl_talk(struct ceetm_nl *nl, struct nlmsghdr *n)
+{
+	struct nlmsghdr *h;
+	struct nlmsgerr *e;
+	ssize_t len;
+
+	n->nlmsg_seq = ++nl->seq;
+	n->nlmsg_flags |= NLM_F_ACK;
+
+	if (send(nl->fd, n, n->nlmsg_len, 0) < 0) {
+		perror("Cannot talk to rtnetlink");
+		return -errno;
+	}
+
+	while (1) {
+		len = recv(nl->fd, nl->buf, sizeof(nl->buf), 0);
+		if (len < 0) {
+			if (errno == EINTR || errno == EAGAIN)
+				continue;
+			perror("netlink receive error");
+			return -errno;
+		}
+
+		if (len == 0) {
+			fprintf(stderr, "EOF on netlink\n");
+			return -EIO;
+		}
+
+		for (h = (struct nlmsghdr *)nl->buf; NLMSG_OK(h, len);
+		     h = NLMSG_NEXT(h, len)) {
+			if (h->nlmsg_pid != nl->pid ||
+			    h->nlmsg_seq != n->nlmsg_seq ||
+			    h->nlmsg_type != NLMSG_ERROR)
+				continue;
+
+			e = NLMSG_DATA(h);
+			return e->error;
+		}
+	}
+}
+
+/* Send back to back requests in a single write and wait for all the
+ * acknowledgements. Returns 0 or the first error, with the index of the
+ * failed request.
+ */
+static int ceetm_nl_batch_chunk(struct ceetm_nl *nl, void *buf, int len,
+				int *failed)
+{
+	struct nlmsghdr *n, *h;
+	struct nlmsgerr *e;
+	__u32 first = nl->seq + 1;
+	int count = 0, acked = 0, err = 0, left = len;
+	ssize_t rlen;
+
+	for (n = buf; NLMSG_OK(n, left); n = NLMSG_NEXT(n, left)) {
+		n->nlmsg_seq = ++nl->seq;
+		n->nlmsg_flags |= NLM_F_ACK;
+		count++;
+	}
+
+	if (failed)
+		*failed = -1;
+
+	if (!count)
+		return 0;
+
+	if (send(nl->fd, buf, len, 0) < 0) {
+		perror("Cannot talk to rtnetlink");
+		return -errno;
+	}
+
+	while (acked < count) {
+		rlen = recv(nl->fd, nl->buf, sizeof(nl->buf), 0);
+		if (rlen < 0) {
+			if (errno == EINTR || errno == EAGAIN)
+				continue;
+			perror("netlink receive error");
+			return -errno;
+		}
+
+		if (rlen == 0) {
+			fprintf(stderr, "EOF on netlink\n");
+			return -EIO;
+		}
+
+		for (h = (struct nlmsghdr *)nl->buf; NLMSG_OK(h, rlen);
+		     h = NLMSG_NEXT(h, rlen)) {
+			if (h->nlmsg_pid != nl->pid ||
+			    h->nlmsg_type != NLMSG_ERROR ||
+			    h->nlmsg_seq - first >= (__u32)count)
+				continue;
+
+			acked++;
+			e = NLMSG_DATA(h);
+			if (e->error && !err) {
+				err = e->error;
+				if (failed)
+					*failed = h->nlmsg_seq - first;
+			}
+		}
+	}
+
+	return err;
+}
+
+/* Send a buffer of back to back requests and wait for all the
+ * acknowledgements. The kernel handles the requests in order, so a qdisc
+ * added early in the batch is there for the classes that follow. The
+ * buffer goes in writes of up to CEETM_NL_CHUNK, which the socket takes
+ * whatever its send buffer; the chunks after a failed one are not sent.
+ * Returns 0 or the first error, with the index of the failed request.
+ */
+int ceetm_nl_batch(struct ceetm_nl *nl, void *buf, int len, int *failed)
+{
+	struct nlmsghdr *n;
+	int off = 0, chunk, count, sent = 0, err;
+
+	if (failed)
+		*failed = -1;
+
+	while (off < len) {
+		chunk = 0;
+		count = 0;
+		while (off + chunk < len) {
+			n = (struct nlmsghdr *)((char *)buf + off + chunk);
+			if (!NLMSG_OK(n, len - off - chunk) ||
+			    (chunk && chunk + NLMSG_ALIGN(n->nlmsg_len) >
+			     CEETM_NL_CHUNK))
+				break;
+			chunk += NLMSG_ALIGN(n->nlmsg_len);
+			count++;
+		}
+
+		if (!chunk)
+			break;
+
+		err = ceetm_nl_batch_chunk(nl, (char *)buf + off, chunk,
+					   failed);
+		if (err) {
+			if (failed && *failed >= 0)
+				*failed += sent;
+			return err;
+		}
+
+		off += chunk;
+		sent += count;
+	}
+
+	return 0;
+}
+
+/* Dump the qdiscs (RTM_GETQDISC) or classes (RTM_GETTCLASS) of an interface
+ * and feed every answer to the filter.
+ */
+int ceetm_nl_dump(struct ceetm_nl *nl, int type, int ifindex,
+		  ceetm_nl_filter_t filter, void *arg)
+{
+	struct {
+		struct nlmsghdr n;
+		struct tcmsg t;
+	} req;
+	struct nlmsghdr *h;
+	ssize_t len;
+	__u32 seq;
+	int err;
+
+	memset(&req, 0, sizeof(req));
+	req.n.nlmsg_len = NLMSG_LENGTH(sizeof(struct tcmsg));
+	req.n.nlmsg_type = type;
+	req.n.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+	req.n.nlmsg_seq = seq = ++nl->seq;
+	req.t.tcm_family = AF_UNSPEC;
+	req.t.tcm_ifindex = ifindex;
+
+	if (send(nl->fd, &req, req.n.nlmsg_len, 0) < 0) {
+		perror("Cannot send dump request");
+		return -1;
+	}
+
+	while (1) {
+		len = recv(nl->fd, nl->buf, sizeof(nl->buf), 0);
+		if (len < 0) {
+			if (errno == EINTR || errno == EAGAIN)
+				continue;
+			perror("netlink receive error");
+			return -1;
+		}
+
+		if (len == 0) {
+			fprintf(stderr, "EOF on netlink\n");
+			return -1;
+		}
+
+		for (h = (struct nlmsghdr *)nl->buf; NLMSG_OK(h, len);
+		     h = NLMSG_NEXT(h, len)) {
+			if (h->nlmsg_pid != nl->pid || h->nlmsg_seq != seq)
+				continue;
+
+			if (h->nlmsg_type == NLMSG_DONE)
+				return 0;
+
+			if (h->nlmsg_type == NLMSG_ERROR) {
+				struct nlmsgerr *e = NLMSG_DATA(h);
+
+				fprintf(stderr, "Dump terminated: %s\n",
+					strerror(-e->error));
+				return -1;
+			}
+
+			err = filter(h, arg);
+			if (err < 0)
+				return err;
+		}
+	}
+}
@@ -0,0 +1,38 @@
+/* Copyright 2017-2018 NXP
+ *
+ * SPDX-License-Identifier: GPL-2.0
+ */
+
+#ifndef __CEETM_NL_H
+#define __CEETM_NL_H
+
+#include <linux/types.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+
+/* Size of the receive buffer of a rtnetlink socket */
+#define CEETM_NL_BUFSIZE	32768
+/* Kernel socket buffers, large enough for a batch of a whole hierarchy */
+#define CEETM_NL_SOCK_BUFSIZE	(1024 * 1024)
+/* Most bytes of requests sent in one write, below the default wmem_max */
+#define CEETM_NL_CHUNK		(64 * 1024)
+
+struct ceetm_nl {
+	int fd;
+	__u32 seq;
+	__u32 pid;
+	char buf[CEETM_NL_BUFSIZE];
+};
+
+/* Called for every message of a dump, a negative return stops the dump */
+typedef int (*ceetm_nl_filter_t)(struct nlmsghdr *n, void *arg);
+
+int ceetm_nl_open(struct ceetm_nl *nl);
+int ceetm_nl_subscribe(struct ceetm_nl *nl, unsigned int group);
+void ceetm_nl_close(struct ceetm_nl *nl);
+int ceetm_nl_talk(struct ceetm_nl *nl, struct nlmsghdr *n);
+int ceetm_nl_batch(struct ceetm_nl *nl, void *buf, int len, int *failed);
+int ceetm_nl_dump(struct ceetm_nl *nl, int type, int ifindex,
+		  ceetm_nl_filter_t filter, void *arg);
+
+#endif
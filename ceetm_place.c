@@ -0,0 +1,694 @@
+/* Copyright 2017-2018 NXP
+ *
+ * SPDX-License-Identifier: GPL-2.0
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ceetm_check.h"
+#include "ceetm_plan.h"
+#include "ceetmctl.h"
+
+/* Capacity planning of tenants over the ports of a box. Every tenant asks
+ * for a committed and an excess rate and either a strict priority CQ (prio
+ * 0 to 7, 0 first) or a slot in a weighted group:
+ *
+ *	port fm1-mac1 rate 10gbit
+ *	port fm1-mac2 rate 10gbit
+ *	tenant acme cir 400mbit eir 100mbit prio 1
+ *	tenant globex cir 50mbit weighted
+ *
+ * The tenants are placed largest first, each on the port it oversubscribes
+ * the least, in the first channel of that port with a free CQ or slot. A
+ * channel is shaped at the sum of the rates of its tenants. Within a
+ * channel the strict CQs come first, by priority, then one weighted group
+ * (a DPAA1 wbfs qdisc of 4 or 8 classes on the last prio CQ, DPAA2 classes
+ * in group A), the weights following the committed rates.
+ *
+ * The hierarchy is written in the plugin syntax, and loaded back through
+ * the plugin parsers to be checked against the limits of the SoC.
+ */
+
+#define CEETM_PLACE_MAX_PORTS		64
+#define CEETM_PLACE_MAX_CHANNELS	32
+#define CEETM_PLACE_NAME_LEN		32
+/* Burst sizes of the DPAA2 channel shapers, bytes */
+#define CEETM_PLACE_BURST		16000
+/* Room for the hierarchy of one channel in the plugin syntax */
+#define CEETM_PLACE_CHANNEL_TEXT	4096
+
+struct ceetm_place_tenant {
+	char name[CEETM_PLACE_NAME_LEN];
+	__u64 cir;
+	__u64 eir;
+	/* Strict priority, -1 for a weighted slot */
+	int prio;
+	unsigned int line;
+	/* Assignment */
+	int port;
+	int channel;
+	/* Class queue within the channel, the wbfs class on DPAA1 */
+	__u32 classid;
+};
+
+struct ceetm_place_channel {
+	/* Tenants, strict then weighted once sorted */
+	int tenants[2 * CEETM_MAX_PRIO_QCOUNT];
+	int nstrict;
+	int nweighted;
+	__u64 cir;
+	__u64 eir;
+};
+
+struct ceetm_place_port {
+	char dev[CEETM_PLACE_NAME_LEN];
+	__u64 rate;
+	__u64 cir;
+	__u64 eir;
+	struct ceetm_place_channel channels[CEETM_PLACE_MAX_CHANNELS];
+	int nchannels;
+};
+
+struct ceetm_place {
+	const struct ceetm_soc_caps *caps;
+	struct ceetm_place_port ports[CEETM_PLACE_MAX_PORTS];
+	int nports;
+	struct ceetm_place_tenant *tenants;
+	int ntenants;
+	int size;
+};
+
+static void explain(void)
+{
+	fprintf(stderr, "Usage: ceetmctl place sla FILE [soc SOC] [out PLAN]\n"
+		"\n"
+		"Each line of FILE is either:\n"
+		"port DEV rate RATE\n"
+		"tenant NAME [cir CIR] [eir EIR] [prio PRIO | weighted]\n"
+		"\n"
+		"PRIO - strict priority of the tenant CQ, 0 (first) to %d;\n"
+		"	tenants are weighted by default\n"
+		"PLAN - file the hierarchy is written to, stdout by default\n",
+		CEETM_MAX_PRIO_QCOUNT - 1);
+}
+
+static int ceetm_place_parse_port(struct ceetm_place *pl, int argc,
+				  char **argv)
+{
+	struct ceetm_place_port *port;
+
+	if (argc != 4 || strcmp(argv[2], "rate") ||
+	    strlen(argv[1]) >= CEETM_PLACE_NAME_LEN)
+		return -1;
+
+	if (pl->nports == CEETM_PLACE_MAX_PORTS) {
+		fprintf(stderr, "At most %d ports are supported.\n",
+			CEETM_PLACE_MAX_PORTS);
+		return -1;
+	}
+
+	port = &pl->ports[pl->nports];
+	memset(port, 0, sizeof(*port));
+	strcpy(port->dev, argv[1]);
+	if (get_rate64(&port->rate, argv[3]) || !port->rate)
+		return -1;
+
+	pl->nports++;
+	return 0;
+}
+
+static int ceetm_place_parse_tenant(struct ceetm_place *pl, int argc,
+				    char **argv, unsigned int line)
+{
+	struct ceetm_place_tenant *t, *tenants;
+	unsigned int prio;
+
+	if (argc < 2 || strlen(argv[1]) >= CEETM_PLACE_NAME_LEN)
+		return -1;
+
+	if (pl->ntenants == pl->size) {
+		pl->size = pl->size ? 2 * pl->size : 256;
+		tenants = realloc(pl->tenants, pl->size * sizeof(*tenants));
+		if (!tenants) {
+			fprintf(stderr, "Out of memory.\n");
+			return -1;
+		}
+		pl->tenants = tenants;
+	}
+
+	t = &pl->tenants[pl->ntenants];
+	memset(t, 0, sizeof(*t));
+	strcpy(t->name, argv[1]);
+	t->prio = -1;
+	t->line = line;
+	argc -= 2; argv += 2;
+
+	while (argc > 0) {
+		if (strcmp(*argv, "cir") == 0 && argc > 1) {
+			argc--; argv++;
+			if (get_rate64(&t->cir, *argv))
+				return -1;
+
+		} else if (strcmp(*argv, "eir") == 0 && argc > 1) {
+			argc--; argv++;
+			if (get_rate64(&t->eir, *argv))
+				return -1;
+
+		} else if (strcmp(*argv, "prio") == 0 && argc > 1) {
+			argc--; argv++;
+			if (get_unsigned(&prio, *argv, 10) ||
+			    prio >= CEETM_MAX_PRIO_QCOUNT)
+				return -1;
+			t->prio = prio;
+
+		} else if (strcmp(*argv, "weighted") == 0) {
+			t->prio = -1;
+
+		} else {
+			return -1;
+		}
+
+		argc--; argv++;
+	}
+
+	if (!t->cir && !t->eir)
+		return -1;
+
+	pl->ntenants++;
+	return 0;
+}
+
+static int ceetm_place_load(struct ceetm_place *pl, const char *path)
+{
+	char *argv[CEETM_PLAN_MAX_ARGS], *line = NULL;
+	unsigned int lineno = 0;
+	size_t len = 0;
+	int argc, ret = -1;
+	FILE *f;
+
+	f = fopen(path, "r");
+	if (!f) {
+		perror(path);
+		return -1;
+	}
+
+	while (getline(&line, &len, f) > 0) {
+		lineno++;
+
+		argc = ceetm_plan_split(line, argv);
+		if (argc == 0)
+			continue;
+
+		if (argc > 0 && strcmp(argv[0], "port") == 0) {
+			if (ceetm_place_parse_port(pl, argc, argv)) {
+				fprintf(stderr, "%s:%u: invalid port.\n", path,
+					lineno);
+				goto out;
+			}
+		} else if (argc > 0 && strcmp(argv[0], "tenant") == 0) {
+			if (ceetm_place_parse_tenant(pl, argc, argv, lineno)) {
+				fprintf(stderr, "%s:%u: invalid tenant.\n",
+					path, lineno);
+				goto out;
+			}
+		} else {
+			fprintf(stderr, "%s:%u: invalid line.\n", path, lineno);
+			goto out;
+		}
+	}
+
+	if (!pl->nports || !pl->ntenants) {
+		fprintf(stderr, "%s: no port or no tenant.\n", path);
+		goto out;
+	}
+
+	ret = 0;
+
+out:
+	free(line);
+	fclose(f);
+	return ret;
+}
+
+/* A channel has CEETM_MAX_PRIO_QCOUNT CQs: one per strict tenant, one for
+ * the weighted group on DPAA1, one per weighted tenant on DPAA2. A DPAA1
+ * wbfs group has at most CEETM_MAX_WBFS_QCOUNT classes.
+ */
+static bool ceetm_place_fits(const struct ceetm_place *pl,
+			     const struct ceetm_place_channel *ch, bool strict)
+{
+	unsigned int cqs = pl->caps->cqs_per_channel;
+	int ns = ch->nstrict + strict, nw = ch->nweighted + !strict;
+
+	if (cqs > CEETM_MAX_PRIO_QCOUNT)
+		cqs = CEETM_MAX_PRIO_QCOUNT;
+
+	if (pl->caps->ver == DPAA_2)
+		return ns + nw <= (int)cqs;
+
+	return nw <= CEETM_MAX_WBFS_QCOUNT && ns + (nw > 0) <= (int)cqs;
+}
+
+/* First channel of the port with room for the tenant, a new one if the
+ * LNI has one left, -1 otherwise.
+ */
+static int ceetm_place_channel(const struct ceetm_place *pl,
+			       const struct ceetm_place_port *port,
+			       bool strict)
+{
+	unsigned int max = pl->caps->channels_per_lni;
+	int i;
+
+	for (i = 0; i < port->nchannels; i++)
+		if (ceetm_place_fits(pl, &port->channels[i], strict))
+			return i;
+
+	if (max > CEETM_PLACE_MAX_CHANNELS)
+		max = CEETM_PLACE_MAX_CHANNELS;
+
+	return port->nchannels < (int)max ? port->nchannels : -1;
+}
+
+static int ceetm_place_cmp_cir(const void *a, const void *b)
+{
+	const struct ceetm_place_tenant *x = a, *y = b;
+
+	if (x->cir != y->cir)
+		return x->cir < y->cir ? 1 : -1;
+	if (x->eir != y->eir)
+		return x->eir < y->eir ? 1 : -1;
+	return x->line < y->line ? -1 : 1;
+}
+
+/* Largest tenants first, each on the port left with the lowest committed
+ * load relative to its rate: the worst oversubscription stays as low as
+ * the tenants allow.
+ */
+static int ceetm_place_assign(struct ceetm_place *pl)
+{
+	struct ceetm_place_tenant *t;
+	struct ceetm_place_port *port;
+	struct ceetm_place_channel *ch;
+	double load, best_load = 0;
+	int i, p, c, best, best_ch = -1;
+	bool strict;
+
+	qsort(pl->tenants, pl->ntenants, sizeof(*pl->tenants),
+	      ceetm_place_cmp_cir);
+
+	for (i = 0; i < pl->ntenants; i++) {
+		t = &pl->tenants[i];
+		strict = t->prio >= 0;
+		best = -1;
+
+		for (p = 0; p < pl->nports; p++) {
+			port = &pl->ports[p];
+			c = ceetm_place_channel(pl, port, strict);
+			if (c < 0)
+				continue;
+
+			load = (double)(port->cir + t->cir) / port->rate;
+			if (best < 0 || load < best_load) {
+				best = p;
+				best_ch = c;
+				best_load = load;
+			}
+		}
+
+		if (best < 0) {
+			fprintf(stderr, "line %u: no CQ left for tenant %s.\n",
+				t->line, t->name);
+			return -1;
+		}
+
+		port = &pl->ports[best];
+		if (best_ch == port->nchannels) {
+			memset(&port->channels[best_ch], 0, sizeof(*ch));
+			port->nchannels++;
+		}
+
+		ch = &port->channels[best_ch];
+		ch->tenants[ch->nstrict + ch->nweighted] = i;
+		if (strict)
+			ch->nstrict++;
+		else
+			ch->nweighted++;
+		ch->cir += t->cir;
+		ch->eir += t->eir;
+		port->cir += t->cir;
+		port->eir += t->eir;
+		t->port = best;
+		t->channel = best_ch;
+	}
+
+	return 0;
+}
+
+/* Strict CQs by priority, the weighted slots after them */
+static bool ceetm_place_before(const struct ceetm_place_tenant *x,
+			       const struct ceetm_place_tenant *y)
+{
+	if ((x->prio < 0) != (y->prio < 0))
+		return y->prio < 0;
+	if (x->prio != y->prio)
+		return x->prio < y->prio;
+	return x->line < y->line;
+}
+
+static void ceetm_place_sort_slots(const struct ceetm_place *pl,
+				   struct ceetm_place_channel *ch)
+{
+	int i, j, t;
+
+	for (i = 1; i < ch->nstrict + ch->nweighted; i++) {
+		t = ch->tenants[i];
+		for (j = i; j > 0 && ceetm_place_before(&pl->tenants[t],
+				&pl->tenants[ch->tenants[j - 1]]); j--)
+			ch->tenants[j] = ch->tenants[j - 1];
+		ch->tenants[j] = t;
+	}
+}
+
+/* Weights of the weighted group of a channel, following the committed
+ * rates. The DPAA2 weight goes with the share, the DPAA1 qweight with its
+ * inverse.
+ */
+static unsigned int ceetm_place_weight(const struct ceetm_place *pl,
+				       const struct ceetm_place_channel *ch,
+				       const struct ceetm_place_tenant *t)
+{
+	const struct ceetm_soc_caps *caps = pl->caps;
+	__u64 share = t->cir ? t->cir : 1, max = 1;
+	unsigned int min = caps->min_weight ? caps->min_weight : 1;
+	double w;
+	int i;
+
+	for (i = ch->nstrict; i < ch->nstrict + ch->nweighted; i++)
+		if (pl->tenants[ch->tenants[i]].cir > max)
+			max = pl->tenants[ch->tenants[i]].cir;
+
+	if (caps->ver == DPAA_2)
+		w = (double)caps->max_weight * share / max;
+	else
+		w = (double)min * max / share;
+
+	if (w < min)
+		return min;
+	if (w > caps->max_weight)
+		return caps->max_weight;
+	return w + 0.5;
+}
+
+static __u64 ceetm_place_round(const struct ceetm_place *pl, __u64 rate)
+{
+	__u64 step = pl->caps->rate_granularity;
+
+	return step ? (rate + step - 1) / step * step : rate;
+}
+
+/* The plugin commands of one channel (1-based index k) and its tenants */
+static int ceetm_place_channel_text(struct ceetm_place *pl,
+				    const struct ceetm_place_port *port,
+				    struct ceetm_place_channel *ch, int k,
+				    char *buf, int len)
+{
+	struct ceetm_place_tenant *t;
+	int i, n = 0, prio = k + 1, wbfs = 0x100 + k;
+
+	ceetm_place_sort_slots(pl, ch);
+
+	/* Rounded up, the shaper would round the sum of the tenants anyway */
+	ch->cir = ceetm_place_round(pl, ch->cir);
+	ch->eir = ceetm_place_round(pl, ch->eir);
+
+	if (pl->caps->ver == DPAA_1) {
+		n += snprintf(buf + n, len - n, "class add dev %s parent 1: "
+			      "classid 1:%x ceetm type root rate %llubps "
+			      "ceil %llubps\n", port->dev, k,
+			      (unsigned long long)ch->cir,
+			      (unsigned long long)ch->eir);
+		n += snprintf(buf + n, len - n, "qdisc add dev %s parent 1:%x "
+			      "handle %x: ceetm type prio qcount %d\n",
+			      port->dev, k, prio,
+			      ch->nstrict + (ch->nweighted > 0));
+
+		if (ch->nweighted) {
+			n += snprintf(buf + n, len - n, "qdisc add dev %s "
+				      "parent %x:%x handle %x: ceetm type wbfs "
+				      "qcount %d qweight", port->dev, prio,
+				      ch->nstrict + 1, wbfs,
+				      ch->nweighted > 4 ? 8 : 4);
+			for (i = 0; i < (ch->nweighted > 4 ? 8 : 4); i++) {
+				t = i < ch->nweighted ?
+				    &pl->tenants[ch->tenants[ch->nstrict + i]] :
+				    NULL;
+				n += snprintf(buf + n, len - n, " %u",
+					      t ? ceetm_place_weight(pl, ch, t) :
+					      pl->caps->max_weight);
+			}
+			n += snprintf(buf + n, len - n, " cr 1 er 1\n");
+		}
+	} else {
+		n += snprintf(buf + n, len - n, "class add dev %s parent 1: "
+			      "classid 1:%x ceetm type root cir %llubps "
+			      "cbs %d", port->dev, k,
+			      (unsigned long long)ch->cir, CEETM_PLACE_BURST);
+		if (ch->eir)
+			n += snprintf(buf + n, len - n, " eir %llubps ebs %d",
+				      (unsigned long long)ch->eir,
+				      CEETM_PLACE_BURST);
+		n += snprintf(buf + n, len - n, "\nqdisc add dev %s parent "
+			      "1:%x handle %x: ceetm type prio prioA %d "
+			      "separate 0\n", port->dev, k, prio,
+			      ch->nweighted ? ch->nstrict : 0);
+
+		for (i = 0; i < ch->nstrict + ch->nweighted; i++) {
+			t = &pl->tenants[ch->tenants[i]];
+			n += snprintf(buf + n, len - n, "class add dev %s "
+				      "parent %x: classid %x:%x ceetm type prio ",
+				      port->dev, prio, prio, i + 1);
+			if (i < ch->nstrict)
+				n += snprintf(buf + n, len - n,
+					      "mode STRICT_PRIORITY\n");
+			else
+				n += snprintf(buf + n, len - n, "mode "
+					      "WEIGHTED_A weight %u\n",
+					      ceetm_place_weight(pl, ch, t));
+		}
+	}
+
+	for (i = 0; i < ch->nstrict + ch->nweighted; i++) {
+		t = &pl->tenants[ch->tenants[i]];
+		if (pl->caps->ver == DPAA_1 && i >= ch->nstrict)
+			t->classid = (wbfs << 16) | (i - ch->nstrict + 1);
+		else
+			t->classid = (prio << 16) | (i + 1);
+		n += snprintf(buf + n, len - n, "# %s: %s class %x:%x\n",
+			      t->name, port->dev, t->classid >> 16,
+			      t->classid & 0xffff);
+	}
+
+	return n < len ? n : -1;
+}
+
+/* Load the text of a port through the plugin parsers and check it */
+static int ceetm_place_check(const struct ceetm_place *pl,
+			     const struct ceetm_place_port *port, char *text)
+{
+	char *argv[CEETM_PLAN_MAX_ARGS], *line, *save = NULL;
+	struct ceetm_plan_req req;
+	struct ceetm_plan plan;
+	struct ceetm_hier h;
+	bool change;
+	int argc, ret = -1;
+
+	ceetm_hier_init(&h, pl->caps->ver, 0);
+	ceetm_plan_init(&plan, &h);
+
+	for (line = strtok_r(text, "\n", &save); line;
+	     line = strtok_r(NULL, "\n", &save)) {
+		argc = ceetm_plan_split(line, argv);
+		if (argc <= 0)
+			continue;
+
+		if (ceetm_plan_build(&h, argc, argv, &req, &change) ||
+		    ceetm_plan_add(&plan, &req, change, 0))
+			goto out;
+	}
+
+	if (ceetm_plan_finish(&plan) ||
+	    ceetm_check_hier(&h, pl->caps, stderr, NULL))
+		goto out;
+
+	ret = 0;
+
+out:
+	if (ret)
+		fprintf(stderr, "%s: the planned hierarchy is not valid.\n",
+			port->dev);
+	ceetm_plan_release(&plan);
+	ceetm_hier_free(&h);
+	return ret;
+}
+
+static int ceetm_place_write(struct ceetm_place *pl, FILE *out)
+{
+	const struct ceetm_place_port *port;
+	char *text, *copy;
+	int p, c, n, size, len;
+
+	size = CEETM_PLACE_CHANNEL_TEXT * (CEETM_PLACE_MAX_CHANNELS + 1);
+	text = malloc(size);
+	copy = malloc(size);
+	if (!text || !copy) {
+		fprintf(stderr, "Out of memory.\n");
+		free(text);
+		free(copy);
+		return -1;
+	}
+
+	for (p = 0; p < pl->nports; p++) {
+		port = &pl->ports[p];
+		if (!port->nchannels)
+			continue;
+
+		if (pl->caps->ver == DPAA_1)
+			len = snprintf(text, size, "qdisc add dev %s root "
+				       "handle 1: ceetm type root rate %llubps "
+				       "ceil 0 overhead 24\n", port->dev,
+				       (unsigned long long)port->rate);
+		else
+			len = snprintf(text, size, "qdisc add dev %s root "
+				       "handle 1: ceetm type root\n",
+				       port->dev);
+
+		for (c = 0; c < port->nchannels; c++) {
+			n = ceetm_place_channel_text(pl, port,
+						     &pl->ports[p].channels[c],
+						     c + 1, text + len,
+						     size - len);
+			if (n < 0)
+				goto err;
+			len += n;
+		}
+
+		memcpy(copy, text, len + 1);
+		if (ceetm_place_check(pl, port, copy))
+			goto err;
+
+		fputs(text, out);
+	}
+
+	free(copy);
+	free(text);
+	return 0;
+
+err:
+	free(copy);
+	free(text);
+	return -1;
+}
+
+/* Committed load and headroom of every LNI */
+static void ceetm_place_report(const struct ceetm_place *pl, FILE *f)
+{
+	const struct ceetm_place_port *port;
+	long long headroom;
+	int p, c, cqs;
+
+	fprintf(f, "%d tenants on %d ports (%s)\n", pl->ntenants, pl->nports,
+		pl->caps->name);
+
+	for (p = 0; p < pl->nports; p++) {
+		port = &pl->ports[p];
+		for (c = 0, cqs = 0; c < port->nchannels; c++)
+			cqs += port->channels[c].nstrict +
+			       port->channels[c].nweighted;
+
+		headroom = (long long)port->rate - (long long)port->cir;
+		fprintf(f, "%s: rate %llu B/s, cir %llu B/s (%.1f%%), "
+			"eir %llu B/s, %s %lld B/s, %d channels, %d tenants\n",
+			port->dev, (unsigned long long)port->rate,
+			(unsigned long long)port->cir,
+			100.0 * port->cir / port->rate,
+			(unsigned long long)port->eir,
+			headroom >= 0 ? "headroom" : "oversubscribed by",
+			headroom >= 0 ? headroom : -headroom,
+			port->nchannels, cqs);
+	}
+}
+
+int do_place(int argc, char **argv)
+{
+	const char *sla = NULL, *path = NULL;
+	struct ceetm_place *pl;
+	FILE *out = stdout;
+	int ret = -1;
+
+	pl = calloc(1, sizeof(*pl));
+	if (!pl)
+		return -1;
+
+	pl->caps = ceetm_soc_caps();
+
+	while (argc > 0) {
+		if (strcmp(*argv, "sla") == 0) {
+			NEXT_ARG();
+			sla = *argv;
+
+		} else if (strcmp(*argv, "soc") == 0) {
+			NEXT_ARG();
+			pl->caps = ceetm_soc_lookup_name(*argv);
+			if (!pl->caps) {
+				fprintf(stderr, "Unknown SoC %s.\n", *argv);
+				goto out;
+			}
+
+		} else if (strcmp(*argv, "out") == 0) {
+			NEXT_ARG();
+			path = *argv;
+
+		} else if (strcmp(*argv, "help") == 0) {
+			explain();
+			goto out;
+
+		} else {
+			fprintf(stderr, "Illegal argument - %s.\n", *argv);
+			explain();
+			goto out;
+		}
+
+		argc--; argv++;
+	}
+
+	if (!sla) {
+		fprintf(stderr, "Please specify the SLA file.\n");
+		goto out;
+	}
+
+	if (ceetm_place_load(pl, sla) || ceetm_place_assign(pl))
+		goto out;
+
+	if (path) {
+		out = fopen(path, "w");
+		if (!out) {
+			perror(path);
+			goto out;
+		}
+	}
+
+	ret = ceetm_place_write(pl, out);
+
+	/* Kept apart from the plan when it goes to stdout */
+	if (!ret)
+		ceetm_place_report(pl, path ? stdout : stderr);
+
+	if (path)
+		fclose(out);
+
+out:
+	free(pl->tenants);
+	free(pl);
+	return ret;
+}
@@ -0,0 +1,531 @@
+/* Copyright 2017-2018 NXP
+ *
+ * SPDX-License-Identifier: GPL-2.0
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+
+#include "ceetm_plan.h"
+
+/* An offline plan is a list of tc commands, one per line, e.g.
+ *
+ *	qdisc add dev fm1-mac1 root handle 1: ceetm type root rate 1gbit
+ *	class add dev fm1-mac1 parent 1: classid 1:1 ceetm type root tbl 1
+ *
+ * The leading "tc" is optional, everything after a '#' is a comment.
+ * The ceetm options go through the same parsers as the tc plugin, then the
+ * resulting messages are decoded as if they were dumped by the kernel.
+ */
+
+struct ceetm_plan_change {
+	struct ceetm_plan_change *next;
+	unsigned int line;
+	struct ceetm_plan_req req;
+};
+
+/* The DPAA1 prio and wbfs qdiscs create their class queues themselves,
+ * mirror that so later 'class change' lines find them.
+ */
+static int dpaa1_ceetm_plan_children(struct ceetm_hier *h, __u32 handle)
+{
+	struct tc_ceetm_qopt q = h->nodes[h->count - 1].opt.q1;
+	struct ceetm_node *node;
+	int i;
+
+	if (q.type != DPAA1_CEETM_PRIO && q.type != DPAA1_CEETM_WBFS)
+		return 0;
+
+	for (i = 0; i < q.qcount; i++) {
+		node = ceetm_hier_add(h);
+		if (!node)
+			return -1;
+
+		node->kind = CEETM_NODE_CLASS;
+		node->handle = TC_H_MAJ(handle) | (i + 1);
+		node->parent = handle;
+		node->type = q.type;
+		node->has_opt = true;
+		node->opt.c1.type = q.type;
+
+		if (q.type == DPAA1_CEETM_PRIO) {
+			node->opt.c1.cr = 1;
+			node->opt.c1.er = 1;
+		} else {
+			node->opt.c1.weight = q.qweight[i];
+		}
+	}
+
+	return 0;
+}
+
+static void dpaa1_ceetm_plan_merge(struct ceetm_node *dst,
+				   const struct ceetm_node *src)
+{
+	if (src->has_buf_part) {
+		dst->has_buf_part = true;
+		dst->buf_reserve = src->buf_reserve;
+		dst->buf_cap = src->buf_cap;
+	}
+
+	if (dst->kind == CEETM_NODE_QDISC) {
+		if (src->type == DPAA1_CEETM_ROOT) {
+			dst->opt.q1.shaped = src->opt.q1.shaped;
+			dst->opt.q1.rate = src->opt.q1.rate;
+			dst->opt.q1.ceil = src->opt.q1.ceil;
+			dst->opt.q1.overhead = src->opt.q1.overhead;
+			dst->pkt_mode = src->pkt_mode;
+		} else if (src->type == DPAA1_CEETM_WBFS) {
+			dst->opt.q1.cr = src->opt.q1.cr;
+			dst->opt.q1.er = src->opt.q1.er;
+			/* A change moves the group, it stays A or B */
+			if (src->has_group) {
+				if (!dst->has_group) {
+					dst->has_group = true;
+					dst->group = DPAA1_CEETM_GROUP_A;
+				}
+				dst->group_prio = src->group_prio;
+			}
+			if (src->has_flow_hash) {
+				dst->has_flow_hash = true;
+				dst->flow_hash = src->flow_hash;
+			}
+		}
+		return;
+	}
+
+	if (src->has_lat_sample) {
+		dst->has_lat_sample = true;
+		dst->lat_sample = src->lat_sample;
+	}
+
+	if (src->type == DPAA1_CEETM_ROOT) {
+		dst->opt.c1 = src->opt.c1;
+		dst->pkt_mode = src->pkt_mode;
+	} else if (src->type == DPAA1_CEETM_PRIO) {
+		dst->opt.c1.cr = src->opt.c1.cr;
+		dst->opt.c1.er = src->opt.c1.er;
+		dst->opt.c1.shaped = 1;
+		if (src->has_min_service) {
+			dst->has_min_service = true;
+			dst->min_rate = src->min_rate;
+			dst->max_run = src->max_run;
+		}
+	} else if (src->type == DPAA1_CEETM_WBFS) {
+		dst->opt.c1.weight = src->opt.c1.weight;
+	}
+}
+
+static void dpaa2_ceetm_plan_merge(struct ceetm_node *dst,
+				   const struct ceetm_node *src, __u32 mask)
+{
+	struct dpaa2_ceetm_shaping_cfg *d = &dst->opt.c2.shaping_cfg;
+	const struct dpaa2_ceetm_shaping_cfg *s = &src->opt.c2.shaping_cfg;
+
+	if (src->has_buf_part) {
+		dst->has_buf_part = true;
+		if (mask & DPAA2_CEETM_CHG_BUF_RESERVE)
+			dst->buf_reserve = src->buf_reserve;
+		if (mask & DPAA2_CEETM_CHG_BUF_CAP)
+			dst->buf_cap = src->buf_cap;
+	}
+
+	if (dst->kind == CEETM_NODE_QDISC) {
+		if (mask & DPAA2_CEETM_CHG_PRIO_A)
+			dst->opt.q2.prio_group_A = src->opt.q2.prio_group_A;
+		if (mask & DPAA2_CEETM_CHG_PRIO_B)
+			dst->opt.q2.prio_group_B = src->opt.q2.prio_group_B;
+		if (mask & DPAA2_CEETM_CHG_SEPARATE)
+			dst->opt.q2.separate_groups = src->opt.q2.separate_groups;
+		if (mask & DPAA2_CEETM_CHG_FLOW_HASH_A)
+			dst->flow_hash = (dst->flow_hash &
+					  ~DPAA2_CEETM_FLOW_HASH_A) |
+					 (src->flow_hash &
+					  DPAA2_CEETM_FLOW_HASH_A);
+		if (mask & DPAA2_CEETM_CHG_FLOW_HASH_B)
+			dst->flow_hash = (dst->flow_hash &
+					  ~DPAA2_CEETM_FLOW_HASH_B) |
+					 (src->flow_hash &
+					  DPAA2_CEETM_FLOW_HASH_B);
+		if (src->has_flow_hash)
+			dst->has_flow_hash = true;
+		return;
+	}
+
+	if (mask & DPAA2_CEETM_CHG_CIR)
+		d->cir = s->cir;
+	if (mask & DPAA2_CEETM_CHG_EIR)
+		d->eir = s->eir;
+	if (mask & DPAA2_CEETM_CHG_PKT_MODE)
+		dst->pkt_mode = src->pkt_mode;
+	if (mask & DPAA2_CEETM_CHG_CBS)
+		d->cbs = s->cbs;
+	if (mask & DPAA2_CEETM_CHG_EBS)
+		d->ebs = s->ebs;
+	if (mask & DPAA2_CEETM_CHG_COUPLED)
+		d->coupled = s->coupled;
+	if (mask & DPAA2_CEETM_CHG_MODE)
+		dst->opt.c2.mode = src->opt.c2.mode;
+	if (mask & DPAA2_CEETM_CHG_WEIGHT)
+		dst->opt.c2.weight = src->opt.c2.weight;
+	if (src->has_min_service) {
+		dst->has_min_service = true;
+		if (mask & DPAA2_CEETM_CHG_MIN_RATE)
+			dst->min_rate = src->min_rate;
+		if (mask & DPAA2_CEETM_CHG_MAX_RUN)
+			dst->max_run = src->max_run;
+	}
+	if (src->has_lat_sample && (mask & DPAA2_CEETM_CHG_LAT_SAMPLE)) {
+		dst->has_lat_sample = true;
+		dst->lat_sample = src->lat_sample;
+	}
+
+	if (mask & DPAA2_CEETM_CHG_SHAPED)
+		dst->opt.c2.shaped = src->opt.c2.shaped;
+	else if (src->opt.c2.shaped)
+		dst->opt.c2.shaped = 1;
+}
+
+static __u32 dpaa2_ceetm_plan_mask(struct ceetm_plan_req *req)
+{
+	struct tcmsg *t = NLMSG_DATA(&req->n);
+	struct rtattr *tb[TCA_MAX + 1];
+	struct rtattr *opts[DPAA2_CEETM_TCA_MAX];
+
+	parse_rtattr(tb, TCA_MAX, TCA_RTA(t),
+		     req->n.nlmsg_len - NLMSG_LENGTH(sizeof(*t)));
+	if (!tb[TCA_OPTIONS])
+		return 0;
+
+	parse_rtattr_nested(opts, DPAA2_CEETM_TCA_MAX - 1, tb[TCA_OPTIONS]);
+	if (!opts[DPAA2_CEETM_TCA_CHANGE_MASK])
+		return ~0U;
+
+	return rta_getattr_u32(opts[DPAA2_CEETM_TCA_CHANGE_MASK]);
+}
+
+static int ceetm_plan_apply_change(struct ceetm_hier *h,
+				   struct ceetm_plan_change *chg)
+{
+	struct ceetm_hier tmp;
+	struct ceetm_node *dst, *src;
+	int idx, ret = -1;
+	__u32 mask;
+
+	ceetm_hier_init(&tmp, h->ver, h->ifindex);
+	if (ceetm_hier_parse_msg(&tmp, &chg->req.n) || !tmp.count)
+		goto out;
+
+	src = &tmp.nodes[0];
+	idx = ceetm_hier_find(h, src->kind, src->handle);
+	if (idx < 0) {
+		fprintf(stderr, "line %u: %x:%x does not exist.\n", chg->line,
+			TC_H_MAJ(src->handle) >> 16, TC_H_MIN(src->handle));
+		goto out;
+	}
+
+	dst = &h->nodes[idx];
+	if (dst->type != src->type) {
+		fprintf(stderr, "line %u: type does not match the existing "
+				"configuration.\n", chg->line);
+		goto out;
+	}
+
+	if (h->ver == DPAA_1) {
+		dpaa1_ceetm_plan_merge(dst, src);
+	} else {
+		mask = dpaa2_ceetm_plan_mask(&chg->req);
+
+		/* A rate changed alone is in the unit the shaper counts */
+		if ((mask & (DPAA2_CEETM_CHG_CIR | DPAA2_CEETM_CHG_EIR)) &&
+		    !(mask & DPAA2_CEETM_CHG_PKT_MODE) &&
+		    src->pkt_mode != dst->pkt_mode) {
+			fprintf(stderr, "line %u: the rate is not in the unit "
+					"of the shaper, give both CIR and EIR "
+					"to switch it.\n", chg->line);
+			goto out;
+		}
+
+		dpaa2_ceetm_plan_merge(dst, src, mask);
+	}
+
+	ceetm_node_update_limit(h, dst);
+	ret = 0;
+
+out:
+	ceetm_hier_free(&tmp);
+	return ret;
+}
+
+/* Turn one tc command into a qdisc / class message for the interface and
+ * backend of the hierarchy.
+ */
+int ceetm_plan_build(const struct ceetm_hier *h, int argc, char **argv,
+		     struct ceetm_plan_req *req, bool *change)
+{
+	bool is_class;
+	__u32 handle;
+
+	memset(req, 0, sizeof(*req));
+	req->n.nlmsg_len = NLMSG_LENGTH(sizeof(struct tcmsg));
+	req->n.nlmsg_flags = NLM_F_REQUEST;
+	req->t.tcm_family = AF_UNSPEC;
+	req->t.tcm_ifindex = h->ifindex;
+
+	if (argc > 0 && strcmp(*argv, "tc") == 0) {
+		argc--; argv++;
+	}
+
+	if (argc < 2) {
+		fprintf(stderr, "Incomplete command.\n");
+		return -1;
+	}
+
+	if (strcmp(*argv, "qdisc") == 0) {
+		is_class = false;
+	} else if (strcmp(*argv, "class") == 0) {
+		is_class = true;
+	} else {
+		fprintf(stderr, "Unknown object \"%s\".\n", *argv);
+		return -1;
+	}
+	req->n.nlmsg_type = is_class ? RTM_NEWTCLASS : RTM_NEWQDISC;
+	argc--; argv++;
+
+	if (strcmp(*argv, "add") == 0) {
+		*change = false;
+		req->n.nlmsg_flags |= NLM_F_CREATE | NLM_F_EXCL;
+	} else if (strcmp(*argv, "replace") == 0) {
+		*change = false;
+		req->n.nlmsg_flags |= NLM_F_CREATE | NLM_F_REPLACE;
+	} else if (strcmp(*argv, "change") == 0) {
+		*change = true;
+	} else {
+		fprintf(stderr, "Unsupported command \"%s\".\n", *argv);
+		return -1;
+	}
+	argc--; argv++;
+
+	while (argc > 0) {
+		if (strcmp(*argv, "dev") == 0) {
+			NEXT_ARG();
+
+		} else if (strcmp(*argv, "root") == 0) {
+			req->t.tcm_parent = TC_H_ROOT;
+
+		} else if (strcmp(*argv, "parent") == 0) {
+			NEXT_ARG();
+			if (get_tc_classid(&handle, *argv)) {
+				fprintf(stderr, "Invalid parent ID.\n");
+				return -1;
+			}
+			req->t.tcm_parent = handle;
+
+		} else if (strcmp(*argv, "handle") == 0 && !is_class) {
+			NEXT_ARG();
+			if (get_qdisc_handle(&handle, *argv)) {
+				fprintf(stderr, "Invalid qdisc ID.\n");
+				return -1;
+			}
+			req->t.tcm_handle = handle;
+
+		} else if (strcmp(*argv, "classid") == 0 && is_class) {
+			NEXT_ARG();
+			if (get_tc_classid(&handle, *argv)) {
+				fprintf(stderr, "Invalid class ID.\n");
+				return -1;
+			}
+			req->t.tcm_handle = handle;
+
+		} else if (strcmp(*argv, "ceetm") == 0) {
+			argc--; argv++;
+			break;
+
+		} else {
+			fprintf(stderr, "Illegal argument - %s.\n", *argv);
+			return -1;
+		}
+
+		argc--; argv++;
+	}
+
+	if (!req->t.tcm_handle) {
+		fprintf(stderr, "Please specify the %s.\n",
+			is_class ? "classid" : "qdisc handle");
+		return -1;
+	}
+
+	/* Classes always sit under the qdisc with the same major number */
+	if (is_class && !req->t.tcm_parent)
+		req->t.tcm_parent = TC_H_MAJ(req->t.tcm_handle);
+
+	addattr_l(&req->n, sizeof(*req), TCA_KIND, "ceetm", strlen("ceetm") + 1);
+
+	if (h->ver == DPAA_1) {
+		if (is_class)
+			return dpaa1_ceetm_parse_copt(NULL, argc, argv, &req->n);
+		return dpaa1_ceetm_parse_qopt(NULL, argc, argv, &req->n);
+	}
+
+	if (is_class)
+		return dpaa2_ceetm_parse_copt(NULL, argc, argv, &req->n);
+	return dpaa2_ceetm_parse_qopt(NULL, argc, argv, &req->n);
+}
+
+/* Split a plan line in words, in place. Returns the number of words or
+ * -1 if there are more than CEETM_PLAN_MAX_ARGS.
+ */
+int ceetm_plan_split(char *line, char **argv)
+{
+	char *word, *save = NULL;
+	int argc = 0;
+
+	line[strcspn(line, "#\n")] = '\0';
+
+	for (word = strtok_r(line, " \t", &save); word;
+	     word = strtok_r(NULL, " \t", &save)) {
+		if (argc == CEETM_PLAN_MAX_ARGS)
+			return -1;
+		argv[argc++] = word;
+	}
+
+	return argc;
+}
+
+void ceetm_plan_init(struct ceetm_plan *p, struct ceetm_hier *h)
+{
+	p->h = h;
+	p->changes = NULL;
+	p->last = &p->changes;
+}
+
+/* Whether a node is already in the hierarchy, indexed or not */
+static bool ceetm_plan_has_node(const struct ceetm_hier *h,
+				const struct ceetm_plan_req *req)
+{
+	enum ceetm_node_kind kind = req->n.nlmsg_type == RTM_NEWQDISC ?
+				    CEETM_NODE_QDISC : CEETM_NODE_CLASS;
+	int i;
+
+	for (i = 0; i < h->count; i++)
+		if (h->nodes[i].kind == kind &&
+		    h->nodes[i].handle == req->t.tcm_handle)
+			return true;
+
+	return false;
+}
+
+/* Add the message of one plan line. 'change' messages are kept aside and
+ * applied by ceetm_plan_finish() once all the 'add' ones are in, so the
+ * hierarchy only has to be indexed twice. A 'replace' of an existing node
+ * is merged like a change, of a new one added like an 'add'.
+ */
+int ceetm_plan_add(struct ceetm_plan *p, const struct ceetm_plan_req *req,
+		   bool change, unsigned int line)
+{
+	struct ceetm_plan_change *chg;
+	struct ceetm_hier *h = p->h;
+
+	if (!change && (req->n.nlmsg_flags & NLM_F_REPLACE))
+		change = ceetm_plan_has_node(h, req);
+
+	if (change) {
+		chg = malloc(sizeof(*chg));
+		if (!chg) {
+			fprintf(stderr, "Out of memory.\n");
+			return -1;
+		}
+
+		chg->next = NULL;
+		chg->line = line;
+		memcpy(&chg->req, req, req->n.nlmsg_len);
+		*p->last = chg;
+		p->last = &chg->next;
+		return 0;
+	}
+
+	if (ceetm_hier_parse_msg(h, (struct nlmsghdr *)&req->n))
+		return -1;
+
+	if (h->ver == DPAA_1 && req->n.nlmsg_type == RTM_NEWQDISC &&
+	    dpaa1_ceetm_plan_children(h, req->t.tcm_handle))
+		return -1;
+
+	return 0;
+}
+
+void ceetm_plan_release(struct ceetm_plan *p)
+{
+	struct ceetm_plan_change *chg;
+
+	while (p->changes) {
+		chg = p->changes;
+		p->changes = chg->next;
+		free(chg);
+	}
+	p->last = &p->changes;
+}
+
+int ceetm_plan_finish(struct ceetm_plan *p)
+{
+	struct ceetm_plan_change *chg;
+	int ret = -1;
+
+	ceetm_hier_index(p->h);
+
+	for (chg = p->changes; chg; chg = chg->next) {
+		if (ceetm_plan_apply_change(p->h, chg))
+			goto out;
+	}
+
+	ceetm_hier_index(p->h);
+	ret = 0;
+
+out:
+	ceetm_plan_release(p);
+	return ret;
+}
+
+/* Load a plan into an empty hierarchy */
+int ceetm_plan_load(FILE *f, struct ceetm_hier *h)
+{
+	struct ceetm_plan_req req;
+	struct ceetm_plan plan;
+	char *argv[CEETM_PLAN_MAX_ARGS];
+	unsigned int lineno = 0;
+	char *line = NULL;
+	size_t len = 0;
+	bool change;
+	int argc, ret = -1;
+
+	ceetm_plan_init(&plan, h);
+
+	while (getline(&line, &len, f) > 0) {
+		lineno++;
+
+		argc = ceetm_plan_split(line, argv);
+		if (argc < 0) {
+			fprintf(stderr, "line %u: too many arguments.\n", lineno);
+			goto out;
+		}
+
+		if (argc == 0)
+			continue;
+
+		if (ceetm_plan_build(h, argc, argv, &req, &change)) {
+			fprintf(stderr, "line %u: invalid command.\n", lineno);
+			goto out;
+		}
+
+		if (ceetm_plan_add(&plan, &req, change, lineno))
+			goto out;
+	}
+
+	ret = ceetm_plan_finish(&plan);
+
+out:
+	ceetm_plan_release(&plan);
+	free(line);
+	return ret;
+}
@@ -0,0 +1,41 @@
+/* Copyright 2017-2018 NXP
+ *
+ * SPDX-License-Identifier: GPL-2.0
+ */
+
+#ifndef __CEETM_PLAN_H
+#define __CEETM_PLAN_H
+
+#include <stdio.h>
+
+#include "ceetm_hier.h"
+
+/* Maximum number of words on a plan line */
+#define CEETM_PLAN_MAX_ARGS	64
+
+struct ceetm_plan_req {
+	struct nlmsghdr n;
+	struct tcmsg t;
+	char buf[2048];
+};
+
+struct ceetm_plan_change;
+
+/* A plan being loaded into a hierarchy, one message at a time */
+struct ceetm_plan {
+	struct ceetm_hier *h;
+	struct ceetm_plan_change *changes;
+	struct ceetm_plan_change **last;
+};
+
+int ceetm_plan_split(char *line, char **argv);
+int ceetm_plan_build(const struct ceetm_hier *h, int argc, char **argv,
+		     struct ceetm_plan_req *req, bool *change);
+int ceetm_plan_load(FILE *f, struct ceetm_hier *h);
+void ceetm_plan_init(struct ceetm_plan *p, struct ceetm_hier *h);
+int ceetm_plan_add(struct ceetm_plan *p, const struct ceetm_plan_req *req,
+		   bool change, unsigned int line);
+int ceetm_plan_finish(struct ceetm_plan *p);
+void ceetm_plan_release(struct ceetm_plan *p);
+
+#endif
@@ -0,0 +1,362 @@
+/* Copyright 2017-2018 NXP
+ *
+ * SPDX-License-Identifier: GPL-2.0
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <net/if.h>
+
+#include "ceetm_check.h"
+#include "ceetm_plan.h"
+#include "ceetmctl.h"
+
+/* Apply one hierarchy template to many interfaces in parallel. Every worker
+ * owns a rtnetlink socket and a message buffer sized for the whole
+ * template, builds the messages of a port with the plugin parsers and
+ * sends them as a single batch.
+ */
+
+#define CEETM_PROV_MAX_PORTS	256
+
+struct ceetm_prov_line {
+	int argc;
+	char *argv[CEETM_PLAN_MAX_ARGS];
+	unsigned int lineno;
+};
+
+struct ceetm_prov_port {
+	const char *dev;
+	int ifindex;
+	int err;
+	int failed_line;
+	double usecs;
+};
+
+struct ceetm_prov {
+	enum dpaa_version ver;
+	const struct ceetm_soc_caps *caps;
+	struct ceetm_prov_line *lines;
+	int nlines;
+	char *text;
+	struct ceetm_prov_port ports[CEETM_PROV_MAX_PORTS];
+	int nports;
+	/* Next port to provision, shared by the workers */
+	int next;
+};
+
+struct ceetm_prov_worker {
+	pthread_t thread;
+	struct ceetm_prov *prov;
+	struct ceetm_nl nl;
+	char *buf;
+	size_t size;
+};
+
+static void explain(void)
+{
+	fprintf(stderr, "Usage: ceetmctl provision template PLAN dev DEV "
+		"[dev DEV]... [soc SOC] [threads N]\n"
+		"\n"
+		"Apply the tc commands of PLAN to every DEV, the dev given in\n"
+		"PLAN is ignored. N workers (default: one per CPU) provision the\n"
+		"ports in parallel and the time spent on each port is reported.\n"
+		"The template is validated against the limits of SOC (a SoC\n"
+		"name, dpaa1 or dpaa2, defaults to the running SoC) first.\n");
+}
+
+static double ceetm_prov_usecs(const struct timespec *a,
+			       const struct timespec *b)
+{
+	return (b->tv_sec - a->tv_sec) * 1e6 + (b->tv_nsec - a->tv_nsec) / 1e3;
+}
+
+/* Read the template once, the workers share the split lines read-only */
+static int ceetm_prov_load(struct ceetm_prov *prov, const char *path)
+{
+	struct ceetm_prov_line *line;
+	char *p, *end;
+	size_t len;
+	long size;
+	FILE *f;
+	int n;
+
+	f = fopen(path, "r");
+	if (!f) {
+		perror(path);
+		return -1;
+	}
+
+	if (fseek(f, 0, SEEK_END) || (size = ftell(f)) < 0 ||
+	    fseek(f, 0, SEEK_SET)) {
+		perror(path);
+		fclose(f);
+		return -1;
+	}
+
+	prov->text = malloc(size + 1);
+	prov->lines = calloc(size / 2 + 1, sizeof(*prov->lines));
+	if (!prov->text || !prov->lines) {
+		fprintf(stderr, "Out of memory.\n");
+		fclose(f);
+		return -1;
+	}
+
+	len = fread(prov->text, 1, size, f);
+	prov->text[len] = '\0';
+	fclose(f);
+
+	for (p = prov->text, n = 1; *p; p = end, n++) {
+		end = strchr(p, '\n');
+		if (end)
+			*end++ = '\0';
+		else
+			end = p + strlen(p);
+
+		line = &prov->lines[prov->nlines];
+		line->lineno = n;
+		line->argc = ceetm_plan_split(p, line->argv);
+		if (line->argc < 0) {
+			fprintf(stderr, "%s:%d: too many arguments.\n", path, n);
+			return -1;
+		}
+
+		if (line->argc)
+			prov->nlines++;
+	}
+
+	return 0;
+}
+
+static void ceetm_prov_port(struct ceetm_prov_worker *w,
+			    struct ceetm_prov_port *port)
+{
+	struct ceetm_prov *prov = w->prov;
+	struct ceetm_plan_req *req;
+	struct timespec start, end;
+	struct ceetm_hier h;
+	size_t len = 0;
+	bool change;
+	int i, failed;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	ceetm_hier_init(&h, prov->ver, port->ifindex);
+
+	for (i = 0; i < prov->nlines; i++) {
+		req = (struct ceetm_plan_req *)(w->buf + len);
+
+		if (ceetm_plan_build(&h, prov->lines[i].argc,
+				     prov->lines[i].argv, req, &change)) {
+			port->err = -EINVAL;
+			port->failed_line = prov->lines[i].lineno;
+			return;
+		}
+
+		len += NLMSG_ALIGN(req->n.nlmsg_len);
+	}
+
+	port->err = ceetm_nl_batch(&w->nl, w->buf, len, &failed);
+	if (port->err && failed >= 0)
+		port->failed_line = prov->lines[failed].lineno;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	port->usecs = ceetm_prov_usecs(&start, &end);
+}
+
+/* Build the whole template and validate the resulting hierarchy against
+ * the SoC limits before touching any port, so a typo or a resource
+ * shortage fails the run instead of leaving half provisioned ports behind.
+ */
+static int ceetm_prov_check(const struct ceetm_prov *prov, const char *path)
+{
+	struct ceetm_hier h;
+	int errors;
+	FILE *f;
+
+	f = fopen(path, "r");
+	if (!f) {
+		perror(path);
+		return -1;
+	}
+
+	ceetm_hier_init(&h, prov->ver, 0);
+	errors = ceetm_plan_load(f, &h);
+	fclose(f);
+
+	if (!errors)
+		errors = ceetm_check_hier(&h, prov->caps, stderr, NULL);
+
+	ceetm_hier_free(&h);
+
+	return errors ? -1 : 0;
+}
+
+static void *ceetm_prov_worker(void *arg)
+{
+	struct ceetm_prov_worker *w = arg;
+	struct ceetm_prov *prov = w->prov;
+	int i;
+
+	while ((i = __atomic_fetch_add(&prov->next, 1, __ATOMIC_RELAXED)) <
+	       prov->nports)
+		ceetm_prov_port(w, &prov->ports[i]);
+
+	return NULL;
+}
+
+int do_provision(int argc, char **argv)
+{
+	struct ceetm_prov_worker *workers = NULL;
+	struct ceetm_prov *prov;
+	struct timespec start, end;
+	const char *template = NULL;
+	unsigned int nthreads = 0;
+	int i, started = 0, ret = -1;
+	long cpus;
+
+	prov = calloc(1, sizeof(*prov));
+	if (!prov)
+		return -1;
+
+	prov->caps = ceetm_soc_caps();
+
+	while (argc > 0) {
+		if (strcmp(*argv, "template") == 0) {
+			NEXT_ARG();
+			template = *argv;
+
+		} else if (strcmp(*argv, "dev") == 0) {
+			NEXT_ARG();
+			if (prov->nports == CEETM_PROV_MAX_PORTS) {
+				fprintf(stderr, "At most %d ports can be "
+						"provisioned.\n",
+					CEETM_PROV_MAX_PORTS);
+				goto out_free;
+			}
+
+			prov->ports[prov->nports].dev = *argv;
+			prov->ports[prov->nports].ifindex = if_nametoindex(*argv);
+			if (!prov->ports[prov->nports].ifindex) {
+				fprintf(stderr, "Cannot find device \"%s\".\n",
+					*argv);
+				goto out_free;
+			}
+			prov->nports++;
+
+		} else if (strcmp(*argv, "soc") == 0) {
+			NEXT_ARG();
+			prov->caps = ceetm_soc_lookup_name(*argv);
+			if (!prov->caps) {
+				fprintf(stderr, "Unknown SoC %s.\n", *argv);
+				goto out_free;
+			}
+
+		} else if (strcmp(*argv, "threads") == 0) {
+			NEXT_ARG();
+			if (get_unsigned(&nthreads, *argv, 10) || !nthreads) {
+				fprintf(stderr, "Illegal threads argument.\n");
+				goto out_free;
+			}
+
+		} else if (strcmp(*argv, "help") == 0) {
+			explain();
+			goto out_free;
+
+		} else {
+			fprintf(stderr, "Illegal argument - %s.\n", *argv);
+			explain();
+			goto out_free;
+		}
+
+		argc--; argv++;
+	}
+
+	if (!template || !prov->nports) {
+		fprintf(stderr, "Please specify the template and at least one "
+				"device.\n");
+		goto out_free;
+	}
+
+	prov->ver = prov->caps->ver;
+
+	if (ceetm_prov_load(prov, template) ||
+	    ceetm_prov_check(prov, template))
+		goto out_free;
+
+	if (!nthreads) {
+		cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		nthreads = cpus > 0 ? cpus : 1;
+	}
+	if (nthreads > (unsigned int)prov->nports)
+		nthreads = prov->nports;
+
+	workers = calloc(nthreads, sizeof(*workers));
+	if (!workers) {
+		fprintf(stderr, "Out of memory.\n");
+		goto out_free;
+	}
+
+	/* Sockets and buffers are set up before the clock starts */
+	for (i = 0; i < (int)nthreads; i++) {
+		workers[i].prov = prov;
+		workers[i].nl.fd = -1;
+		workers[i].size = (prov->nlines + 1) *
+				  sizeof(struct ceetm_plan_req);
+		workers[i].buf = malloc(workers[i].size);
+		if (!workers[i].buf || ceetm_nl_open(&workers[i].nl))
+			goto out_workers;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for (started = 0; started < (int)nthreads; started++) {
+		if (pthread_create(&workers[started].thread, NULL,
+				   ceetm_prov_worker, &workers[started])) {
+			fprintf(stderr, "Cannot start worker thread.\n");
+			break;
+		}
+	}
+
+	/* Whatever was started still drains the port list */
+	for (i = 0; i < started; i++)
+		pthread_join(workers[i].thread, NULL);
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	ret = started ? 0 : -1;
+	for (i = 0; i < prov->nports; i++) {
+		struct ceetm_prov_port *port = &prov->ports[i];
+
+		if (port->err) {
+			fprintf(stdout, "%s: failed at template line %d: %s\n",
+				port->dev, port->failed_line,
+				strerror(-port->err));
+			ret = -1;
+		} else if (i < prov->next) {
+			fprintf(stdout, "%s: applied in %.0f us\n", port->dev,
+				port->usecs);
+		}
+	}
+
+	fprintf(stdout, "%d ports, %d commands each, %u threads: %.0f us\n",
+		prov->nports, prov->nlines, nthreads,
+		ceetm_prov_usecs(&start, &end));
+
+out_workers:
+	for (i = 0; i < (int)nthreads; i++) {
+		if (workers[i].nl.fd >= 0)
+			ceetm_nl_close(&workers[i].nl);
+		free(workers[i].buf);
+	}
+	free(workers);
+out_free:
+	free(prov->lines);
+	free(prov->text);
+	free(prov);
+	return ret;
+}
@@ -0,0 +1,649 @@
+/* Copyright 2017-2018 NXP
+ *
+ * SPDX-License-Identifier: GPL-2.0
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <signal.h>
+#include <syslog.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ceetm_check.h"
+#include "ceetm_plan.h"
+#include "ceetmctl.h"
+
+/* Time of day shaping profiles. A port runs different rates and weights
+ * in business hours, backup windows, ... Each profile is a list of tc
+ * commands, compiled once at start up into a netlink batch and validated
+ * against the hierarchy of the port. At the switch times the batch of the
+ * new profile is sent with a single write, so the port never runs a mix of
+ * two profiles for longer than the kernel takes to apply the messages.
+ *
+ *	profile business
+ *	class change classid 1:1 ceetm type root cir 800mbit eir 200mbit
+ *	class change classid 2:3 ceetm type prio weight 300
+ *
+ *	profile backup
+ *	...
+ *
+ *	at 08:00 mon-fri business
+ *	at 20:00 backup
+ */
+
+#define CEETM_SCHED_MAX_PROFILES	32
+#define CEETM_SCHED_MAX_SWITCHES	128
+#define CEETM_SCHED_NAME_LEN		32
+#define CEETM_SCHED_ALL_DAYS		0x7f
+
+/* The compiled messages of one profile */
+struct ceetm_sched_profile {
+	char name[CEETM_SCHED_NAME_LEN];
+	char *buf;
+	size_t len;
+	size_t size;
+	/* Config line of every message */
+	unsigned int *lines;
+	int count;
+};
+
+/* Switch to a profile at a local time, on some week days */
+struct ceetm_sched_switch {
+	int hour;
+	int min;
+	/* Bit 0 for Sunday, as tm_wday */
+	unsigned int days;
+	int profile;
+};
+
+struct ceetm_sched {
+	const char *dev;
+	enum dpaa_version ver;
+	const struct ceetm_soc_caps *caps;
+	struct ceetm_sched_profile profiles[CEETM_SCHED_MAX_PROFILES];
+	int nprofiles;
+	struct ceetm_sched_switch switches[CEETM_SCHED_MAX_SWITCHES];
+	int nswitches;
+	bool daemon;
+};
+
+static const char * const ceetm_sched_days[] = {
+	"sun", "mon", "tue", "wed", "thu", "fri", "sat",
+};
+
+static volatile sig_atomic_t ceetm_sched_stop;
+
+static void explain(void)
+{
+	fprintf(stderr, "Usage: ceetmctl schedule (dev DEV | plan PLAN) "
+		"config FILE [soc SOC] [apply NAME] [daemon]\n"
+		"\n"
+		"FILE holds profiles and switch times:\n"
+		"profile NAME - starts a profile, followed by tc class / qdisc\n"
+		"	commands\n"
+		"at HH:MM [DAYS] NAME - switch to the profile NAME at local time\n"
+		"	HH:MM, every day or on DAYS (e.g. mon-fri or sat,sun)\n"
+		"\n"
+		"plan - only compile and validate the profiles against PLAN\n"
+		"apply - send the profile NAME once and exit\n"
+		"Otherwise the profile due is applied, then every switch on "
+		"time.\n");
+}
+
+static void ceetm_sched_log(const struct ceetm_sched *s, const char *fmt, ...)
+{
+	va_list args;
+
+	va_start(args, fmt);
+	if (s->daemon) {
+		vsyslog(LOG_INFO, fmt, args);
+	} else {
+		vfprintf(stdout, fmt, args);
+		fputc('\n', stdout);
+		fflush(stdout);
+	}
+	va_end(args);
+}
+
+static void ceetm_sched_signal(int sig)
+{
+	ceetm_sched_stop = 1;
+}
+
+static int ceetm_sched_find(const struct ceetm_sched *s, const char *name)
+{
+	int i;
+
+	for (i = 0; i < s->nprofiles; i++)
+		if (strcmp(s->profiles[i].name, name) == 0)
+			return i;
+
+	return -1;
+}
+
+static int ceetm_sched_parse_day(const char *arg, int len)
+{
+	int i;
+
+	for (i = 0; i < 7; i++)
+		if (len == 3 && strncmp(arg, ceetm_sched_days[i], 3) == 0)
+			return i;
+
+	return -1;
+}
+
+/* "mon-fri", "sat,sun", "mon,wed-fri" */
+static int ceetm_sched_parse_days(const char *arg, unsigned int *days)
+{
+	const char *p = arg;
+	int first, last, len;
+
+	*days = 0;
+	while (*p) {
+		len = strcspn(p, ",-");
+		first = ceetm_sched_parse_day(p, len);
+		if (first < 0)
+			return -1;
+		p += len;
+
+		last = first;
+		if (*p == '-') {
+			p++;
+			len = strcspn(p, ",");
+			last = ceetm_sched_parse_day(p, len);
+			if (last < 0)
+				return -1;
+			p += len;
+		}
+
+		/* Ranges can wrap around the week, fri-mon */
+		for (; first != last; first = (first + 1) % 7)
+			*days |= 1 << first;
+		*days |= 1 << last;
+
+		if (*p == ',')
+			p++;
+	}
+
+	return *days ? 0 : -1;
+}
+
+static int ceetm_sched_parse_switch(struct ceetm_sched *s, int argc,
+				    char **argv)
+{
+	struct ceetm_sched_switch *sw;
+	char *end;
+
+	if (argc != 3 && argc != 4)
+		return -1;
+
+	if (s->nswitches == CEETM_SCHED_MAX_SWITCHES) {
+		fprintf(stderr, "At most %d switch times are supported.\n",
+			CEETM_SCHED_MAX_SWITCHES);
+		return -1;
+	}
+
+	sw = &s->switches[s->nswitches];
+	sw->hour = strtol(argv[1], &end, 10);
+	if (*end != ':' || sw->hour < 0 || sw->hour > 23)
+		return -1;
+	sw->min = strtol(end + 1, &end, 10);
+	if (*end || sw->min < 0 || sw->min > 59)
+		return -1;
+
+	sw->days = CEETM_SCHED_ALL_DAYS;
+	if (argc == 4 && ceetm_sched_parse_days(argv[2], &sw->days)) {
+		fprintf(stderr, "Invalid days \"%s\".\n", argv[2]);
+		return -1;
+	}
+
+	sw->profile = ceetm_sched_find(s, argv[argc - 1]);
+	if (sw->profile < 0) {
+		fprintf(stderr, "Unknown profile \"%s\".\n", argv[argc - 1]);
+		return -1;
+	}
+
+	s->nswitches++;
+	return 0;
+}
+
+static int ceetm_sched_new_profile(struct ceetm_sched *s, int argc,
+				   char **argv)
+{
+	struct ceetm_sched_profile *p;
+
+	if (argc != 2 || strlen(argv[1]) >= CEETM_SCHED_NAME_LEN)
+		return -1;
+
+	if (ceetm_sched_find(s, argv[1]) >= 0) {
+		fprintf(stderr, "Profile \"%s\" defined twice.\n", argv[1]);
+		return -1;
+	}
+
+	if (s->nprofiles == CEETM_SCHED_MAX_PROFILES) {
+		fprintf(stderr, "At most %d profiles are supported.\n",
+			CEETM_SCHED_MAX_PROFILES);
+		return -1;
+	}
+
+	p = &s->profiles[s->nprofiles++];
+	strcpy(p->name, argv[1]);
+	return 0;
+}
+
+/* Append the message of a profile line to the batch of the profile */
+static int ceetm_sched_add(struct ceetm_sched_profile *p,
+			   const struct ceetm_plan_req *req, unsigned int line)
+{
+	size_t len = NLMSG_ALIGN(req->n.nlmsg_len);
+	unsigned int *lines;
+	char *buf;
+
+	if (p->len + len > p->size) {
+		p->size = p->size ? 2 * p->size : 16 * 1024;
+		buf = realloc(p->buf, p->size);
+		if (buf)
+			p->buf = buf;
+		lines = realloc(p->lines, p->size / NLMSG_ALIGN(
+				NLMSG_LENGTH(sizeof(struct tcmsg))) *
+				sizeof(*lines));
+		if (lines)
+			p->lines = lines;
+		if (!buf || !lines) {
+			fprintf(stderr, "Out of memory.\n");
+			return -1;
+		}
+	}
+
+	memcpy(p->buf + p->len, req, req->n.nlmsg_len);
+	p->len += len;
+	p->lines[p->count++] = line;
+
+	return 0;
+}
+
+static int ceetm_sched_load(struct ceetm_sched *s, const struct ceetm_hier *h,
+			    const char *path)
+{
+	char *argv[CEETM_PLAN_MAX_ARGS], *line = NULL;
+	struct ceetm_sched_profile *p = NULL;
+	struct ceetm_plan_req req;
+	unsigned int lineno = 0;
+	size_t len = 0;
+	bool change;
+	int argc, ret = -1;
+	FILE *f;
+
+	f = fopen(path, "r");
+	if (!f) {
+		perror(path);
+		return -1;
+	}
+
+	while (getline(&line, &len, f) > 0) {
+		lineno++;
+
+		argc = ceetm_plan_split(line, argv);
+		if (argc < 0) {
+			fprintf(stderr, "%s:%u: too many arguments.\n", path,
+				lineno);
+			goto out;
+		}
+
+		if (!argc)
+			continue;
+
+		if (strcmp(argv[0], "profile") == 0) {
+			if (ceetm_sched_new_profile(s, argc, argv)) {
+				fprintf(stderr, "%s:%u: invalid profile.\n",
+					path, lineno);
+				goto out;
+			}
+			p = &s->profiles[s->nprofiles - 1];
+			continue;
+		}
+
+		if (strcmp(argv[0], "at") == 0) {
+			if (ceetm_sched_parse_switch(s, argc, argv)) {
+				fprintf(stderr, "%s:%u: invalid switch time.\n",
+					path, lineno);
+				goto out;
+			}
+			continue;
+		}
+
+		if (!p) {
+			fprintf(stderr, "%s:%u: command out of a profile.\n",
+				path, lineno);
+			goto out;
+		}
+
+		if (ceetm_plan_build(h, argc, argv, &req, &change) ||
+		    ceetm_sched_add(p, &req, lineno)) {
+			fprintf(stderr, "%s:%u: invalid command.\n", path,
+				lineno);
+			goto out;
+		}
+	}
+
+	if (!s->nprofiles) {
+		fprintf(stderr, "%s: no profile.\n", path);
+		goto out;
+	}
+
+	ret = 0;
+
+out:
+	free(line);
+	fclose(f);
+	return ret;
+}
+
+/* Load a profile on top of a copy of the hierarchy and check the result,
+ * a profile rejected there would be rejected half way at switch time.
+ */
+static int ceetm_sched_validate(const struct ceetm_sched *s,
+				const struct ceetm_hier *h,
+				const struct ceetm_sched_profile *p)
+{
+	struct ceetm_plan_req req;
+	struct ceetm_plan plan;
+	struct ceetm_hier tmp;
+	struct nlmsghdr *n;
+	struct ceetm_node *node;
+	size_t off;
+	int i, ret = -1;
+
+	ceetm_hier_init(&tmp, h->ver, h->ifindex);
+	ceetm_plan_init(&plan, &tmp);
+
+	for (i = 0; i < h->count; i++) {
+		node = ceetm_hier_add(&tmp);
+		if (!node)
+			goto out;
+		*node = h->nodes[i];
+	}
+
+	for (off = 0, i = 0; off < p->len; off += NLMSG_ALIGN(n->nlmsg_len)) {
+		n = (struct nlmsghdr *)(p->buf + off);
+		memcpy(&req, n, n->nlmsg_len);
+		if (ceetm_plan_add(&plan, &req,
+				   !(n->nlmsg_flags & NLM_F_CREATE),
+				   p->lines[i++]))
+			goto out;
+	}
+
+	if (ceetm_plan_finish(&plan))
+		goto out;
+
+	if (tmp.root < 0) {
+		ret = 0;
+		goto out;
+	}
+
+	if (!ceetm_check_hier(&tmp, s->caps, stderr, NULL))
+		ret = 0;
+
+out:
+	ceetm_plan_release(&plan);
+	ceetm_hier_free(&tmp);
+	return ret;
+}
+
+/* Time of a switch on the day 'offset' days away from 'now', or -1 if it
+ * does not run that day. mktime() sorts out the DST changes.
+ */
+static time_t ceetm_sched_at(const struct ceetm_sched_switch *sw,
+			     const struct tm *now, int offset)
+{
+	struct tm tm = *now;
+	time_t t;
+
+	tm.tm_mday += offset;
+	tm.tm_hour = sw->hour;
+	tm.tm_min = sw->min;
+	tm.tm_sec = 0;
+	tm.tm_isdst = -1;
+
+	t = mktime(&tm);
+	if (t == (time_t)-1 || !(sw->days & (1 << tm.tm_wday)))
+		return -1;
+
+	return t;
+}
+
+/* The switch that fired last before 'now' (when 'next' is false) or the
+ * one that fires first after it. -1 if there is none within a week.
+ */
+static int ceetm_sched_pick(const struct ceetm_sched *s, time_t now,
+			    bool next, time_t *when)
+{
+	struct tm tm;
+	time_t t, best = 0;
+	int i, d, ret = -1;
+
+	localtime_r(&now, &tm);
+
+	for (i = 0; i < s->nswitches; i++) {
+		for (d = 0; d <= 7; d++) {
+			t = ceetm_sched_at(&s->switches[i], &tm, next ? d : -d);
+			if (t == (time_t)-1 || (next ? t <= now : t > now))
+				continue;
+
+			if (ret < 0 || (next ? t < best : t > best)) {
+				best = t;
+				ret = i;
+			}
+			break;
+		}
+	}
+
+	*when = best;
+	return ret;
+}
+
+/* Send a compiled profile in one write */
+static int ceetm_sched_apply(const struct ceetm_sched *s, struct ceetm_nl *nl,
+			     const struct ceetm_sched_profile *p)
+{
+	struct timespec start, end;
+	int err, failed;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	err = ceetm_nl_batch(nl, p->buf, p->len, &failed);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	if (err) {
+		ceetm_sched_log(s, "%s: profile %s failed at line %u: %s",
+				s->dev, p->name,
+				p->lines[failed >= 0 ? failed : 0],
+				strerror(-err));
+		return -1;
+	}
+
+	ceetm_sched_log(s, "%s: profile %s applied, %d commands in %ld us",
+			s->dev, p->name, p->count,
+			(long)((end.tv_sec - start.tv_sec) * 1000000 +
+			       (end.tv_nsec - start.tv_nsec) / 1000));
+	return 0;
+}
+
+static void ceetm_sched_run(const struct ceetm_sched *s, struct ceetm_nl *nl)
+{
+	struct timespec ts;
+	time_t now, when;
+	int sw;
+
+	now = time(NULL);
+	sw = ceetm_sched_pick(s, now, false, &when);
+	if (sw >= 0)
+		ceetm_sched_apply(s, nl, &s->profiles[s->switches[sw].profile]);
+
+	while (!ceetm_sched_stop) {
+		sw = ceetm_sched_pick(s, now, true, &when);
+		if (sw < 0)
+			break;
+
+		/* Wake up now and then to notice the signals */
+		clock_gettime(CLOCK_REALTIME, &ts);
+		if (ts.tv_sec + 1 < when) {
+			ts.tv_sec++;
+			clock_nanosleep(CLOCK_REALTIME, TIMER_ABSTIME, &ts,
+					NULL);
+			continue;
+		}
+
+		ts.tv_sec = when;
+		ts.tv_nsec = 0;
+		if (clock_nanosleep(CLOCK_REALTIME, TIMER_ABSTIME, &ts, NULL))
+			continue;
+
+		ceetm_sched_apply(s, nl, &s->profiles[s->switches[sw].profile]);
+		now = when;
+	}
+}
+
+static void ceetm_sched_free(struct ceetm_sched *s)
+{
+	int i;
+
+	for (i = 0; i < s->nprofiles; i++) {
+		free(s->profiles[i].buf);
+		free(s->profiles[i].lines);
+	}
+	free(s);
+}
+
+int do_schedule(int argc, char **argv)
+{
+	const char *config = NULL, *plan = NULL, *apply = NULL;
+	struct ceetm_sched *s;
+	struct ceetm_hier h;
+	struct ceetm_nl nl;
+	time_t when;
+	int i, sw, ret = -1;
+
+	s = calloc(1, sizeof(*s));
+	if (!s)
+		return -1;
+
+	s->caps = ceetm_soc_caps();
+
+	while (argc > 0) {
+		if (strcmp(*argv, "dev") == 0) {
+			NEXT_ARG();
+			s->dev = *argv;
+
+		} else if (strcmp(*argv, "plan") == 0) {
+			NEXT_ARG();
+			plan = *argv;
+
+		} else if (strcmp(*argv, "config") == 0) {
+			NEXT_ARG();
+			config = *argv;
+
+		} else if (strcmp(*argv, "soc") == 0) {
+			NEXT_ARG();
+			s->caps = ceetm_soc_lookup_name(*argv);
+			if (!s->caps) {
+				fprintf(stderr, "Unknown SoC %s.\n", *argv);
+				goto out_free;
+			}
+
+		} else if (strcmp(*argv, "apply") == 0) {
+			NEXT_ARG();
+			apply = *argv;
+
+		} else if (strcmp(*argv, "daemon") == 0) {
+			s->daemon = true;
+
+		} else if (strcmp(*argv, "help") == 0) {
+			explain();
+			goto out_free;
+
+		} else {
+			fprintf(stderr, "Illegal argument - %s.\n", *argv);
+			explain();
+			goto out_free;
+		}
+
+		argc--; argv++;
+	}
+
+	if (!config) {
+		fprintf(stderr, "Please specify the config file.\n");
+		goto out_free;
+	}
+
+	s->ver = s->caps->ver;
+	if (ceetmctl_load_hier(s->dev, plan, s->ver, &h))
+		goto out_free;
+
+	if (ceetm_sched_load(s, &h, config))
+		goto out_hier;
+
+	for (i = 0; i < s->nprofiles; i++) {
+		if (ceetm_sched_validate(s, &h, &s->profiles[i])) {
+			fprintf(stderr, "Profile %s does not apply.\n",
+				s->profiles[i].name);
+			goto out_hier;
+		}
+	}
+
+	if (plan) {
+		for (i = 0; i < s->nprofiles; i++)
+			fprintf(stdout, "profile %s: %d commands, %zu bytes\n",
+				s->profiles[i].name, s->profiles[i].count,
+				s->profiles[i].len);
+
+		sw = ceetm_sched_pick(s, time(NULL), true, &when);
+		if (sw >= 0)
+			fprintf(stdout, "next switch: profile %s at %s",
+				s->profiles[s->switches[sw].profile].name,
+				ctime(&when));
+		ret = 0;
+		goto out_hier;
+	}
+
+	if (ceetm_nl_open(&nl))
+		goto out_hier;
+
+	if (apply) {
+		i = ceetm_sched_find(s, apply);
+		if (i < 0)
+			fprintf(stderr, "Unknown profile \"%s\".\n", apply);
+		else
+			ret = ceetm_sched_apply(s, &nl, &s->profiles[i]);
+		goto out_nl;
+	}
+
+	if (!s->nswitches) {
+		fprintf(stderr, "No switch time in %s.\n", config);
+		goto out_nl;
+	}
+
+	if (s->daemon) {
+		if (daemon(0, 0)) {
+			perror("daemon");
+			goto out_nl;
+		}
+		openlog("ceetmctl", LOG_PID, LOG_DAEMON);
+	}
+
+	signal(SIGINT, ceetm_sched_signal);
+	signal(SIGTERM, ceetm_sched_signal);
+
+	ceetm_sched_run(s, &nl);
+	ret = 0;
+
+out_nl:
+	ceetm_nl_close(&nl);
+out_hier:
+	ceetm_hier_free(&h);
+out_free:
+	ceetm_sched_free(s);
+	return ret;
+}
@@ -0,0 +1,509 @@
+/* Copyright 2017-2018 NXP
+ *
+ * SPDX-License-Identifier: GPL-2.0
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <net/if.h>
+
+#include "ceetm_plan.h"
+#include "ceetmctl.h"
+
+/* A snapshot is a plan: a header line naming the format version and the
+ * DPAA generation, then one tc command per qdisc / class in tree order,
+ * written by the plugin's own option printers with exact rates. Restoring
+ * it builds every command with the plugin parsers and sends them to the
+ * kernel as a single batch.
+ */
+
+#define CEETM_SNAP_MAGIC	"# ceetm-snapshot"
+#define CEETM_SNAP_VERSION	1
+
+struct ceetm_snap_line {
+	char *text;
+	unsigned int lineno;
+};
+
+static void save_explain(void)
+{
+	fprintf(stderr, "Usage: ceetmctl save (dev DEV | plan PLAN) [soc SOC] "
+		"[file FILE]\n"
+		"\n"
+		"Write the CEETM hierarchy of DEV, or the one built by an offline\n"
+		"PLAN, to FILE (default: stdout). SOC (a SoC name, dpaa1 or\n"
+		"dpaa2) defaults to the running SoC.\n");
+}
+
+static void restore_explain(void)
+{
+	fprintf(stderr, "Usage: ceetmctl restore dev DEV [file FILE] [soc SOC] "
+		"[flush]\n"
+		"\n"
+		"Apply a snapshot written by 'ceetmctl save' to DEV. With flush\n"
+		"the current root qdisc of DEV is deleted first.\n");
+}
+
+static const char *dpaa_name(enum dpaa_version ver)
+{
+	return ver == DPAA_1 ? "dpaa1" : "dpaa2";
+}
+
+/* The DPAA1 wbfs classes are created by their qdisc, carry their current
+ * weights in its qweight list instead.
+ */
+static void dpaa1_ceetm_snap_qweight(const struct ceetm_hier *h,
+				     struct tc_ceetm_qopt *qopt, int idx)
+{
+	const struct ceetm_node *node;
+	int i, c;
+
+	for (c = h->nodes[idx].child; c >= 0; c = node->next) {
+		node = &h->nodes[c];
+		i = TC_H_MIN(node->handle) - 1;
+		if (node->has_opt && i >= 0 && i < qopt->qcount &&
+		    i < CEETM_MAX_WBFS_QCOUNT)
+			qopt->qweight[i] = node->opt.c1.weight;
+	}
+}
+
+static int ceetm_snap_base_opts(const struct ceetm_hier *h, int idx,
+				char *buf, int len)
+{
+	const struct ceetm_node *node = &h->nodes[idx];
+	struct tc_ceetm_qopt q1;
+
+	if (h->ver == DPAA_2)
+		return node->kind == CEETM_NODE_QDISC ?
+			dpaa2_ceetm_sprint_qopt(buf, len, &node->opt.q2) :
+			dpaa2_ceetm_sprint_copt(buf, len, &node->opt.c2,
+						node->pkt_mode);
+
+	if (node->kind == CEETM_NODE_CLASS)
+		return dpaa1_ceetm_sprint_copt(buf, len, &node->opt.c1,
+					       node->pkt_mode);
+
+	q1 = node->opt.q1;
+	if (q1.type == DPAA1_CEETM_WBFS)
+		dpaa1_ceetm_snap_qweight(h, &q1, idx);
+
+	return dpaa1_ceetm_sprint_qopt(buf, len, &q1, node->pkt_mode);
+}
+
+/* The options carried in their own attributes follow the main ones */
+static int ceetm_snap_opts(const struct ceetm_hier *h, int idx,
+			   char *buf, int len)
+{
+	const struct ceetm_node *node = &h->nodes[idx];
+	int n;
+
+	n = ceetm_snap_base_opts(h, idx, buf, len);
+
+	if (n >= 0 && n < len && node->has_min_service)
+		n += snprintf(buf + n, len - n, " minrate %llubps maxrun %u",
+			      (unsigned long long)node->min_rate,
+			      node->max_run);
+
+	if (n >= 0 && n < len && node->has_buf_part)
+		n += snprintf(buf + n, len - n, " reserve %u cap %u",
+			      node->buf_reserve, node->buf_cap);
+
+	if (n >= 0 && n < len && node->has_group)
+		n += snprintf(buf + n, len - n, " group %c position %u",
+			      node->group == DPAA1_CEETM_GROUP_A ? 'A' : 'B',
+			      node->group_prio);
+
+	if (n >= 0 && n < len && node->has_flow_hash && h->ver == DPAA_1 &&
+	    node->flow_hash)
+		n += snprintf(buf + n, len - n, " flowhash 1");
+
+	if (n >= 0 && n < len && node->has_flow_hash && h->ver == DPAA_2 &&
+	    (node->flow_hash & DPAA2_CEETM_FLOW_HASH_A))
+		n += snprintf(buf + n, len - n, " flowhashA 1");
+
+	if (n >= 0 && n < len && node->has_flow_hash && h->ver == DPAA_2 &&
+	    (node->flow_hash & DPAA2_CEETM_FLOW_HASH_B))
+		n += snprintf(buf + n, len - n, " flowhashB 1");
+
+	if (n >= 0 && n < len && node->has_lat_sample)
+		n += snprintf(buf + n, len - n, " latsample %u",
+			      node->lat_sample);
+
+	return n;
+}
+
+/* Pre-order walk, so every parent is created before its children */
+static int ceetm_snap_write(const struct ceetm_hier *h, int idx, FILE *f)
+{
+	const struct ceetm_node *node = &h->nodes[idx];
+	const char *verb = "add";
+	char id[16], parent[16];
+	char opts[512];
+	int c;
+
+	if (!node->has_opt) {
+		fprintf(stderr, "%s %s has no options.\n",
+			node->kind == CEETM_NODE_QDISC ? "qdisc" : "class",
+			ceetm_node_id(node, id, sizeof(id)));
+		return -1;
+	}
+
+	/* The DPAA1 prio and wbfs classes already exist once their qdisc is
+	 * added, only the prio ones and the sampled wbfs ones have settings
+	 * that can differ from the defaults.
+	 */
+	if (h->ver == DPAA_1 && node->kind == CEETM_NODE_CLASS &&
+	    node->type != DPAA1_CEETM_ROOT) {
+		if (!node->has_lat_sample &&
+		    (node->type != DPAA1_CEETM_PRIO ||
+		     (node->opt.c1.cr == 1 && node->opt.c1.er == 1 &&
+		      !node->has_min_service)))
+			goto children;
+		verb = "change";
+	}
+
+	if (ceetm_snap_opts(h, idx, opts, sizeof(opts)) < 0) {
+		fprintf(stderr, "Cannot encode the options of %s.\n",
+			ceetm_node_id(node, id, sizeof(id)));
+		return -1;
+	}
+
+	ceetm_node_id(node, id, sizeof(id));
+	if (node->up >= 0)
+		ceetm_node_id(&h->nodes[node->up], parent, sizeof(parent));
+
+	if (node->kind == CEETM_NODE_QDISC && node->up < 0)
+		fprintf(f, "qdisc add root handle %s ceetm %s\n", id, opts);
+	else if (node->kind == CEETM_NODE_QDISC)
+		fprintf(f, "qdisc add parent %s handle %s ceetm %s\n", parent,
+			id, opts);
+	else
+		fprintf(f, "class %s parent %s classid %s ceetm %s\n", verb,
+			node->up >= 0 ? parent : id, id, opts);
+
+children:
+	for (c = node->child; c >= 0; c = h->nodes[c].next)
+		if (ceetm_snap_write(h, c, f))
+			return -1;
+
+	return 0;
+}
+
+int do_save(int argc, char **argv)
+{
+	const char *dev = NULL, *plan = NULL, *file = NULL;
+	enum dpaa_version ver = detect_dpaa_version();
+	struct ceetm_hier h;
+	FILE *f = stdout;
+	int ret;
+
+	while (argc > 0) {
+		if (strcmp(*argv, "dev") == 0) {
+			NEXT_ARG();
+			dev = *argv;
+
+		} else if (strcmp(*argv, "plan") == 0) {
+			NEXT_ARG();
+			plan = *argv;
+
+		} else if (strcmp(*argv, "soc") == 0) {
+			NEXT_ARG();
+			if (ceetmctl_parse_soc(*argv, &ver))
+				return -1;
+
+		} else if (strcmp(*argv, "file") == 0) {
+			NEXT_ARG();
+			file = *argv;
+
+		} else if (strcmp(*argv, "help") == 0) {
+			save_explain();
+			return 0;
+
+		} else {
+			fprintf(stderr, "Illegal argument - %s.\n", *argv);
+			save_explain();
+			return -1;
+		}
+
+		argc--; argv++;
+	}
+
+	if (ceetmctl_load_hier(dev, plan, ver, &h))
+		return -1;
+
+	if (h.root < 0) {
+		fprintf(stderr, "No CEETM root qdisc on %s.\n", dev ? dev : plan);
+		ceetm_hier_free(&h);
+		return -1;
+	}
+
+	if (file && strcmp(file, "-") != 0) {
+		f = fopen(file, "w");
+		if (!f) {
+			perror(file);
+			ceetm_hier_free(&h);
+			return -1;
+		}
+	}
+
+	fprintf(f, "%s %d %s\n", CEETM_SNAP_MAGIC, CEETM_SNAP_VERSION,
+		dpaa_name(h.ver));
+	ret = ceetm_snap_write(&h, h.root, f);
+
+	if (fflush(f) || ferror(f)) {
+		perror(file ? file : "stdout");
+		ret = -1;
+	}
+	if (f != stdout)
+		fclose(f);
+
+	ceetm_hier_free(&h);
+	return ret;
+}
+
+/* Check the header line, a snapshot of another DPAA generation cannot be
+ * parsed by the local backend.
+ */
+static int ceetm_snap_header(const char *line, enum dpaa_version ver)
+{
+	char name[16];
+	int version;
+
+	if (strncmp(line, CEETM_SNAP_MAGIC, strlen(CEETM_SNAP_MAGIC)) != 0 ||
+	    sscanf(line + strlen(CEETM_SNAP_MAGIC), "%d %15s", &version,
+		   name) != 2) {
+		fprintf(stderr, "Not a CEETM snapshot.\n");
+		return -1;
+	}
+
+	if (version != CEETM_SNAP_VERSION) {
+		fprintf(stderr, "Unsupported snapshot version %d.\n", version);
+		return -1;
+	}
+
+	if (strcmp(name, dpaa_name(ver)) != 0) {
+		fprintf(stderr, "Snapshot of a %s hierarchy, this is a %s "
+				"SoC.\n", name, dpaa_name(ver));
+		return -1;
+	}
+
+	return 0;
+}
+
+static int ceetm_snap_flush(int ifindex)
+{
+	struct ceetm_plan_req req;
+	struct ceetm_nl nl;
+	int err;
+
+	memset(&req, 0, sizeof(req));
+	req.n.nlmsg_len = NLMSG_LENGTH(sizeof(struct tcmsg));
+	req.n.nlmsg_type = RTM_DELQDISC;
+	req.n.nlmsg_flags = NLM_F_REQUEST;
+	req.t.tcm_family = AF_UNSPEC;
+	req.t.tcm_ifindex = ifindex;
+	req.t.tcm_parent = TC_H_ROOT;
+
+	if (ceetm_nl_open(&nl))
+		return -1;
+
+	/* Nothing to delete is not an error */
+	err = ceetm_nl_talk(&nl, &req.n);
+	ceetm_nl_close(&nl);
+
+	if (err && err != -ENOENT && err != -EINVAL) {
+		fprintf(stderr, "Cannot delete the root qdisc: %s\n",
+			strerror(-err));
+		return -1;
+	}
+
+	return 0;
+}
+
+static int ceetm_snap_apply(struct ceetm_hier *h, FILE *f, const char *path,
+			    bool flush)
+{
+	struct ceetm_snap_line *lines = NULL, *tmp;
+	char *argv[CEETM_PLAN_MAX_ARGS];
+	struct ceetm_plan_req *req;
+	int nlines = 0, alloc = 0;
+	int i, argc, failed, err;
+	unsigned int lineno = 1;
+	char *buf = NULL, *header = NULL;
+	struct ceetm_nl nl;
+	size_t len = 0;
+	ssize_t n;
+	bool change;
+	int ret = -1;
+
+	if (getline(&header, &len, f) < 0) {
+		fprintf(stderr, "%s: empty snapshot.\n", path);
+		goto out;
+	}
+	if (ceetm_snap_header(header, h->ver))
+		goto out;
+
+	/* Keep the text of every line, the parsed argv points into it */
+	for (;;) {
+		char *line = NULL;
+
+		len = 0;
+		n = getline(&line, &len, f);
+		if (n < 0) {
+			free(line);
+			break;
+		}
+		lineno++;
+
+		if (nlines == alloc) {
+			alloc = alloc ? alloc * 2 : 64;
+			tmp = realloc(lines, alloc * sizeof(*lines));
+			if (!tmp) {
+				free(line);
+				fprintf(stderr, "Out of memory.\n");
+				goto out;
+			}
+			lines = tmp;
+		}
+
+		lines[nlines].text = line;
+		lines[nlines].lineno = lineno;
+		nlines++;
+	}
+
+	buf = malloc((nlines + 1) * sizeof(struct ceetm_plan_req));
+	if (!buf) {
+		fprintf(stderr, "Out of memory.\n");
+		goto out;
+	}
+
+	/* Every message is built before anything is sent, a bad line leaves
+	 * the interface untouched.
+	 */
+	len = 0;
+	for (i = 0; i < nlines; i++) {
+		argc = ceetm_plan_split(lines[i].text, argv);
+		if (argc < 0) {
+			fprintf(stderr, "%s:%u: too many arguments.\n", path,
+				lines[i].lineno);
+			goto out;
+		}
+		if (!argc) {
+			lines[i].lineno = 0;
+			continue;
+		}
+
+		req = (struct ceetm_plan_req *)(buf + len);
+		if (ceetm_plan_build(h, argc, argv, req, &change)) {
+			fprintf(stderr, "%s:%u: invalid command.\n", path,
+				lines[i].lineno);
+			goto out;
+		}
+
+		len += NLMSG_ALIGN(req->n.nlmsg_len);
+	}
+
+	if (!len) {
+		fprintf(stderr, "%s: empty snapshot.\n", path);
+		goto out;
+	}
+
+	if (flush && ceetm_snap_flush(h->ifindex))
+		goto out;
+
+	if (ceetm_nl_open(&nl))
+		goto out;
+	err = ceetm_nl_batch(&nl, buf, len, &failed);
+	ceetm_nl_close(&nl);
+
+	if (err) {
+		/* Map the index of the failed message back to its line */
+		for (i = 0; i < nlines && failed >= 0; i++)
+			if (lines[i].lineno && failed-- == 0)
+				break;
+		if (i < nlines)
+			fprintf(stderr, "%s:%u: %s\n", path, lines[i].lineno,
+				strerror(-err));
+		else
+			fprintf(stderr, "%s: %s\n", path, strerror(-err));
+		goto out;
+	}
+
+	ret = 0;
+out:
+	for (i = 0; i < nlines; i++)
+		free(lines[i].text);
+	free(lines);
+	free(header);
+	free(buf);
+	return ret;
+}
+
+int do_restore(int argc, char **argv)
+{
+	const char *dev = NULL, *file = NULL;
+	enum dpaa_version ver = detect_dpaa_version();
+	struct ceetm_hier h;
+	bool flush = false;
+	FILE *f = stdin;
+	int ifindex, ret;
+	while (argc > 0) {
+		if (strcmp(*argv, "dev") == 0) {
+			NEXT_ARG();
+			dev = *argv;
+
+		} else if (strcmp(*argv, "file") == 0) {
+			NEXT_ARG();
+			file = *argv;
+
+		} else if (strcmp(*argv, "soc") == 0) {
+			NEXT_ARG();
+			if (ceetmctl_parse_soc(*argv, &ver))
+				return -1;
+
+		} else if (strcmp(*argv, "flush") == 0) {
+			flush = true;
+
+		} else if (strcmp(*argv, "help") == 0) {
+			restore_explain();
+			return 0;
+
+		} else {
+			fprintf(stderr, "Illegal argument - %s.\n", *argv);
+			restore_explain();
+			return -1;
+		}
+
+		argc--; argv++;
+	}
+
+	if (!dev) {
+		fprintf(stderr, "Please specify the device.\n");
+		return -1;
+	}
+
+	ifindex = if_nametoindex(dev);
+	if (!ifindex) {
+		fprintf(stderr, "Cannot find device \"%s\".\n", dev);
+		return -1;
+	}
+
+	if (file && strcmp(file, "-") != 0) {
+		f = fopen(file, "r");
+		if (!f) {
+			perror(file);
+			return -1;
+		}
+	}
+
+	ceetm_hier_init(&h, ver, ifindex);
+
+	ret = ceetm_snap_apply(&h, f, file ? file : "stdin", flush);
+
+	if (f != stdin)
+		fclose(f);
+
+	ceetm_hier_free(&h);
+	return ret;
+}
@@ -0,0 +1,147 @@
+/* Copyright 2014-2016 Freescale Semiconductor Inc.
+ * Copyright 2017-2018 NXP
+ *
+ * SPDX-License-Identifier: GPL-2.0
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "dpaa1_ceetm_abi.h"
+#include "dpaa2_ceetm_abi.h"
+#include "ceetm_soc.h"
+
+/* The SVR does not change at runtime: read it once and keep it for every
+ * later call, from any thread. The value is stored with the valid bit set
+ * so a concurrent first call at worst reads the file twice.
+ */
+#define SVR_CACHE_VALID		(1ULL << 32)
+
+static unsigned long long svr_cache;
+
+static unsigned int read_svr(void)
+{
+	unsigned long long cached = __atomic_load_n(&svr_cache, __ATOMIC_ACQUIRE);
+	unsigned int svr_ver = 0;
+	FILE *svr_file;
+
+	if (cached & SVR_CACHE_VALID)
+		return (unsigned int)cached;
+
+	svr_file = fopen(DPAA_SOC_ID_FILE, "r");
+	if (svr_file) {
+		if (fscanf(svr_file, "svr:%x", &svr_ver) <= 0)
+			svr_ver = 0;
+		fclose(svr_file);
+	}
+
+	__atomic_store_n(&svr_cache, SVR_CACHE_VALID | svr_ver,
+			 __ATOMIC_RELEASE);
+
+	return svr_ver;
+}
+
+/* Rates are in bytes per second */
+#define GBIT(x)			((__u64)(x) * 125000000)
+#define MBIT(x)			((__u64)(x) * 125000)
+/* Minimum size frames at a byte rate: 64 bytes, preamble and IFG */
+#define LINE_PPS(rate)		((rate) / 84)
+
+#define DPAA1_CAPS(_name, _svr)						\
+	{								\
+		.name = _name,						\
+		.svr = _svr,						\
+		.ver = DPAA_1,						\
+		.channels_per_lni = 32,					\
+		.cqs_per_channel = 16,					\
+		.max_rate = GBIT(10),					\
+		.max_pps = LINE_PPS(GBIT(10)),				\
+		.rate_granularity = 0,					\
+		.cq_shaping = false,					\
+		.min_weight = 1,					\
+		.max_weight = CEETM_MAX_WBFS_VALUE,			\
+	}
+
+#define DPAA2_CAPS(_name, _svr, _channels, _rate, _cq_shaping, _pps)	\
+	{								\
+		.name = _name,						\
+		.svr = _svr,						\
+		.ver = DPAA_2,						\
+		.channels_per_lni = _channels,				\
+		.cqs_per_channel = CEETM_MAX_PRIO_QCOUNT,		\
+		.max_rate = _rate,					\
+		.max_pps = (_pps) ? LINE_PPS(_rate) : 0,		\
+		.rate_granularity = MBIT(1),				\
+		.cq_shaping = _cq_shaping,				\
+		.min_weight = DPAA2_CEETM_MIN_WEIGHT,			\
+		.max_weight = DPAA2_CEETM_MAX_WEIGHT,			\
+	}
+
+/* Known SoC personalities, keyed by SVR. The DPAA1 CEETM has 16 class
+ * queues per channel (8 independent, 8 grouped) and fine grained token
+ * rates; the DPAA2 shapers are programmed in Mbps and only LX2 can shape
+ * a single class queue or count frames instead of bytes.
+ */
+static const struct ceetm_soc_caps soc_caps[] = {
+	DPAA1_CAPS("ls1043a", 0x87920400),
+	DPAA1_CAPS("ls1023a", 0x87920c00),
+	DPAA1_CAPS("ls1046a", 0x87070400),
+	DPAA1_CAPS("ls1026a", 0x87070800),
+	DPAA2_CAPS("ls1088a", 0x87030000, 8, GBIT(10), false, false),
+	DPAA2_CAPS("ls1048a", 0x87030800, 8, GBIT(10), false, false),
+	DPAA2_CAPS("ls2080a", 0x87011000, 16, GBIT(10), false, false),
+	DPAA2_CAPS("ls2085a", 0x87010000, 16, GBIT(10), false, false),
+	DPAA2_CAPS("ls2088a", 0x87090000, 16, GBIT(10), false, false),
+	DPAA2_CAPS("ls2084a", 0x87091000, 16, GBIT(10), false, false),
+	DPAA2_CAPS("lx2160a", 0x87360000, 32, GBIT(100), true, true),
+	DPAA2_CAPS("lx2120a", 0x87362000, 32, GBIT(100), true, true),
+};
+
+/* Used for unknown personalities of a known family and unknown SoCs */
+static const struct ceetm_soc_caps dpaa1_generic = DPAA1_CAPS("dpaa1", 0);
+static const struct ceetm_soc_caps dpaa2_generic =
+	DPAA2_CAPS("dpaa2", 0, 8, GBIT(10), false, false);
+
+const struct ceetm_soc_caps *ceetm_soc_lookup_svr(unsigned int svr)
+{
+	unsigned int i;
+
+	for (i = 0; i < sizeof(soc_caps) / sizeof(soc_caps[0]); i++) {
+		if (soc_caps[i].svr == (svr & SVR_SOC_MASK))
+			return &soc_caps[i];
+	}
+
+	switch (svr & SVR_MASK) {
+	case SVR_LS1043A_FAMILY:
+	case SVR_LS1046A_FAMILY:
+		return &dpaa1_generic;
+	default:
+		return &dpaa2_generic;
+	}
+}
+
+const struct ceetm_soc_caps *ceetm_soc_lookup_name(const char *name)
+{
+	unsigned int i;
+
+	for (i = 0; i < sizeof(soc_caps) / sizeof(soc_caps[0]); i++) {
+		if (strcmp(soc_caps[i].name, name) == 0)
+			return &soc_caps[i];
+	}
+
+	if (strcmp(name, dpaa1_generic.name) == 0)
+		return &dpaa1_generic;
+	if (strcmp(name, dpaa2_generic.name) == 0)
+		return &dpaa2_generic;
+
+	return NULL;
+}
+
+const struct ceetm_soc_caps *ceetm_soc_caps(void)
+{
+	return ceetm_soc_lookup_svr(read_svr());
+}
+
+enum dpaa_version detect_dpaa_version(void)
+{
+	return ceetm_soc_caps()->ver;
+}
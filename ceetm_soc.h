@@ -0,0 +1,59 @@
+/* Copyright 2014-2016 Freescale Semiconductor Inc.
+ * Copyright 2017-2018 NXP
+ *
+ * SPDX-License-Identifier: GPL-2.0
+ */
+
+#ifndef __CEETM_SOC_H
+#define __CEETM_SOC_H
+
+#include <stdbool.h>
+#include <linux/types.h>
+
+/* DPAA SoC identifier.
+ * If this is not available, assume the board is DPAA2.
+ */
+#define DPAA_SOC_ID_FILE	"/sys/devices/soc0/soc_id"
+
+#define SVR_LS1043A_FAMILY	0x87920000
+#define SVR_LS1046A_FAMILY	0x87070000
+#define SVR_MASK		0xffff0000
+/* SoC personality: everything but the revision and the E (security) bit */
+#define SVR_SOC_MASK		0xfffffe00
+
+enum dpaa_version {
+	DPAA_1,
+	DPAA_2,
+};
+
+/* CEETM resources and limits of a SoC */
+struct ceetm_soc_caps {
+	const char *name;
+	/* SVR of the personality (SVR_SOC_MASK applied), 0 for fallbacks */
+	unsigned int svr;
+	enum dpaa_version ver;
+	/* Channels a single LNI can use */
+	unsigned int channels_per_lni;
+	/* Class queues a channel can schedule */
+	unsigned int cqs_per_channel;
+	/* Fastest rate an LNI or channel shaper accepts, bytes per second */
+	__u64 max_rate;
+	/* Fastest packet rate an LNI or channel shaper accepts in packet
+	 * mode, 0 if the shapers only count bytes
+	 */
+	__u64 max_pps;
+	/* Step of the shaper rates, bytes per second, 0 if not quantised */
+	__u64 rate_granularity;
+	/* The class queues can be shaped individually */
+	bool cq_shaping;
+	/* Range of the weights in a weighted group */
+	unsigned int min_weight;
+	unsigned int max_weight;
+};
+
+enum dpaa_version detect_dpaa_version(void);
+const struct ceetm_soc_caps *ceetm_soc_caps(void);
+const struct ceetm_soc_caps *ceetm_soc_lookup_svr(unsigned int svr);
+const struct ceetm_soc_caps *ceetm_soc_lookup_name(const char *name);
+
+#endif
@@ -0,0 +1,792 @@
+/* Copyright 2017-2018 NXP
+ *
+ * SPDX-License-Identifier: GPL-2.0
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <net/if.h>
+
+#include "ceetm_check.h"
+#include "ceetm_plan.h"
+#include "ceetmctl.h"
+
+/* Per tenant subtrees. A template holds the tc commands of one tenant,
+ * e.g. a channel and its WBFS group, with {column} placeholders for the
+ * values that differ between tenants:
+ *
+ *	class add parent 1: classid 1:{ch} ceetm type root rate {rate}
+ *	qdisc add parent 1:{ch} handle {q}: ceetm type wbfs qcount 4 ...
+ *
+ * Every row of a CSV file, whose first line names the columns, expands the
+ * template once. The words are substituted in memory and go straight to
+ * the plugin parsers; the messages are loaded in a hierarchy per interface
+ * for validation, then sent in batches. A "dev" column spreads the tenants
+ * over several interfaces.
+ */
+
+#define CEETM_TENANT_MAX_COLS	32
+#define CEETM_TENANT_MAX_DEVS	1024
+/* Room for the substituted words of one template line */
+#define CEETM_TENANT_LINE_SIZE	4096
+
+/* A template word, cut at its placeholders: text, value, text, ... */
+struct ceetm_tenant_seg {
+	const char *text;
+	int len;
+	/* Column substituted after the text, -1 for none */
+	int col;
+};
+
+struct ceetm_tenant_word {
+	/* The word itself when it has no placeholder */
+	char *text;
+	struct ceetm_tenant_seg *segs;
+	int nsegs;
+};
+
+struct ceetm_tenant_line {
+	struct ceetm_tenant_word words[CEETM_PLAN_MAX_ARGS];
+	int argc;
+	unsigned int lineno;
+};
+
+struct ceetm_tenant_row {
+	char *cols[CEETM_TENANT_MAX_COLS];
+	unsigned int lineno;
+};
+
+struct ceetm_tenant_dev {
+	const char *name;
+	int ifindex;
+	struct ceetm_hier h;
+	struct ceetm_plan plan;
+	/* Messages, back to back, and the CSV line each one comes from */
+	char *buf;
+	size_t len;
+	size_t size;
+	unsigned int *lines;
+	int count;
+	int err;
+	int failed;
+};
+
+struct ceetm_tenant {
+	enum dpaa_version ver;
+	const struct ceetm_soc_caps *caps;
+	char *tpl_text;
+	struct ceetm_tenant_line *tpl;
+	int ntpl;
+	char *csv_text;
+	char *names[CEETM_TENANT_MAX_COLS];
+	int ncols;
+	/* Column holding the interface of a tenant, -1 if none */
+	int dev_col;
+	struct ceetm_tenant_row *rows;
+	int nrows;
+	struct ceetm_tenant_dev devs[CEETM_TENANT_MAX_DEVS];
+	int ndevs;
+	bool dry;
+	struct ceetm_nl nl;
+};
+
+static void explain(void)
+{
+	fprintf(stderr, "Usage: ceetmctl tenants template TPL csv FILE "
+		"[base PLAN] [dev DEV] [soc SOC] [dry]\n"
+		"\n"
+		"TPL - tc commands of one tenant, with {NAME} placeholders\n"
+		"FILE - one tenant per line, NAME,NAME,... on the first line\n"
+		"PLAN - tc commands run once per interface before the tenants\n"
+		"DEV - interface of the tenants, unless FILE has a dev column\n"
+		"SOC - SoC name, dpaa1 or dpaa2 (defaults to the running SoC)\n"
+		"dry - expand and validate only, against the plan alone\n");
+}
+
+static double ceetm_tenant_msecs(const struct timespec *a,
+				 const struct timespec *b)
+{
+	return (b->tv_sec - a->tv_sec) * 1e3 + (b->tv_nsec - a->tv_nsec) / 1e6;
+}
+
+static char *ceetm_tenant_read(const char *path)
+{
+	char *text;
+	size_t len;
+	long size;
+	FILE *f;
+
+	f = fopen(path, "r");
+	if (!f) {
+		perror(path);
+		return NULL;
+	}
+
+	if (fseek(f, 0, SEEK_END) || (size = ftell(f)) < 0 ||
+	    fseek(f, 0, SEEK_SET)) {
+		perror(path);
+		fclose(f);
+		return NULL;
+	}
+
+	text = malloc(size + 1);
+	if (!text) {
+		fprintf(stderr, "Out of memory.\n");
+		fclose(f);
+		return NULL;
+	}
+
+	len = fread(text, 1, size, f);
+	text[len] = '\0';
+	fclose(f);
+
+	return text;
+}
+
+/* Cut the next line out of a text read in memory */
+static char *ceetm_tenant_next_line(char **p)
+{
+	char *line = *p, *end;
+
+	if (!*line)
+		return NULL;
+
+	end = strchr(line, '\n');
+	if (end) {
+		*end = '\0';
+		*p = end + 1;
+	} else {
+		*p = line + strlen(line);
+	}
+
+	return line;
+}
+
+static int ceetm_tenant_col(const struct ceetm_tenant *t, const char *name,
+			    int len)
+{
+	int i;
+
+	for (i = 0; i < t->ncols; i++) {
+		if ((int)strlen(t->names[i]) == len &&
+		    strncmp(t->names[i], name, len) == 0)
+			return i;
+	}
+
+	return -1;
+}
+
+/* Split a word at its placeholders, done once for the whole run */
+static int ceetm_tenant_compile_word(const struct ceetm_tenant *t, char *text,
+				     struct ceetm_tenant_word *w)
+{
+	struct ceetm_tenant_seg *seg;
+	char *p = text, *open, *close;
+
+	w->text = text;
+	if (!strchr(text, '{'))
+		return 0;
+
+	/* At most one segment per character */
+	w->segs = calloc(strlen(text) + 1, sizeof(*w->segs));
+	if (!w->segs) {
+		fprintf(stderr, "Out of memory.\n");
+		return -1;
+	}
+
+	while (*p) {
+		seg = &w->segs[w->nsegs++];
+		seg->text = p;
+		seg->col = -1;
+
+		open = strchr(p, '{');
+		if (!open) {
+			seg->len = strlen(p);
+			break;
+		}
+
+		close = strchr(open, '}');
+		if (!close) {
+			fprintf(stderr, "Unterminated placeholder in \"%s\".\n",
+				text);
+			return -1;
+		}
+
+		seg->len = open - p;
+		seg->col = ceetm_tenant_col(t, open + 1, close - open - 1);
+		if (seg->col < 0) {
+			fprintf(stderr, "Unknown column \"%.*s\".\n",
+				(int)(close - open - 1), open + 1);
+			return -1;
+		}
+
+		p = close + 1;
+	}
+
+	return 0;
+}
+
+static int ceetm_tenant_load_template(struct ceetm_tenant *t,
+				      const char *path)
+{
+	char *argv[CEETM_PLAN_MAX_ARGS], *p, *line;
+	struct ceetm_tenant_line *tl;
+	unsigned int lineno = 0;
+	int i, argc;
+
+	t->tpl_text = ceetm_tenant_read(path);
+	if (!t->tpl_text)
+		return -1;
+
+	for (p = t->tpl_text; *p; p++)
+		if (*p == '\n')
+			t->ntpl++;
+
+	t->tpl = calloc(t->ntpl + 1, sizeof(*t->tpl));
+	if (!t->tpl) {
+		fprintf(stderr, "Out of memory.\n");
+		return -1;
+	}
+
+	t->ntpl = 0;
+	p = t->tpl_text;
+	while ((line = ceetm_tenant_next_line(&p))) {
+		lineno++;
+
+		argc = ceetm_plan_split(line, argv);
+		if (argc < 0) {
+			fprintf(stderr, "%s:%u: too many arguments.\n", path,
+				lineno);
+			return -1;
+		}
+
+		if (!argc)
+			continue;
+
+		tl = &t->tpl[t->ntpl++];
+		tl->argc = argc;
+		tl->lineno = lineno;
+
+		for (i = 0; i < argc; i++) {
+			if (ceetm_tenant_compile_word(t, argv[i],
+						      &tl->words[i])) {
+				fprintf(stderr, "%s:%u: invalid placeholder.\n",
+					path, lineno);
+				return -1;
+			}
+		}
+	}
+
+	if (!t->ntpl) {
+		fprintf(stderr, "%s: empty template.\n", path);
+		return -1;
+	}
+
+	return 0;
+}
+
+/* Split a CSV line in place, the fields are trimmed */
+static int ceetm_tenant_split_csv(char *line, char **cols, int max)
+{
+	char *p = line, *end;
+	int n = 0;
+
+	line[strcspn(line, "#\r")] = '\0';
+	if (!line[strspn(line, " \t")])
+		return 0;
+
+	while (1) {
+		if (n == max)
+			return -1;
+
+		while (*p == ' ' || *p == '\t')
+			p++;
+		cols[n++] = p;
+
+		end = strchr(p, ',');
+		if (end)
+			*end = '\0';
+
+		p += strlen(p);
+		while (p > cols[n - 1] && (p[-1] == ' ' || p[-1] == '\t'))
+			*--p = '\0';
+
+		if (!end)
+			return n;
+		p = end + 1;
+	}
+}
+
+static int ceetm_tenant_load_csv(struct ceetm_tenant *t, const char *path)
+{
+	struct ceetm_tenant_row *row;
+	unsigned int lineno = 0;
+	char *p, *line;
+	int i, n, lines = 1;
+
+	t->csv_text = ceetm_tenant_read(path);
+	if (!t->csv_text)
+		return -1;
+
+	for (p = t->csv_text; *p; p++)
+		if (*p == '\n')
+			lines++;
+
+	t->rows = malloc(lines * sizeof(*t->rows));
+	if (!t->rows) {
+		fprintf(stderr, "Out of memory.\n");
+		return -1;
+	}
+
+	p = t->csv_text;
+	while ((line = ceetm_tenant_next_line(&p))) {
+		lineno++;
+
+		if (!t->ncols) {
+			n = ceetm_tenant_split_csv(line, t->names,
+						   CEETM_TENANT_MAX_COLS);
+			if (n < 0) {
+				fprintf(stderr, "%s: at most %d columns.\n",
+					path, CEETM_TENANT_MAX_COLS);
+				return -1;
+			}
+			t->ncols = n;
+			continue;
+		}
+
+		row = &t->rows[t->nrows];
+		n = ceetm_tenant_split_csv(line, row->cols, t->ncols);
+		if (!n)
+			continue;
+
+		if (n != t->ncols) {
+			fprintf(stderr, "%s:%u: %d columns expected.\n", path,
+				lineno, t->ncols);
+			return -1;
+		}
+
+		row->lineno = lineno;
+		t->nrows++;
+	}
+
+	if (!t->nrows) {
+		fprintf(stderr, "%s: no tenant.\n", path);
+		return -1;
+	}
+
+	t->dev_col = -1;
+	for (i = 0; i < t->ncols; i++)
+		if (strcmp(t->names[i], "dev") == 0)
+			t->dev_col = i;
+
+	return 0;
+}
+
+static struct ceetm_tenant_dev *ceetm_tenant_dev(struct ceetm_tenant *t,
+						 const char *name)
+{
+	struct ceetm_tenant_dev *dev;
+	int i;
+
+	for (i = t->ndevs - 1; i >= 0; i--)
+		if (strcmp(t->devs[i].name, name) == 0)
+			return &t->devs[i];
+
+	if (t->ndevs == CEETM_TENANT_MAX_DEVS) {
+		fprintf(stderr, "At most %d interfaces are supported.\n",
+			CEETM_TENANT_MAX_DEVS);
+		return NULL;
+	}
+
+	dev = &t->devs[t->ndevs];
+	memset(dev, 0, sizeof(*dev));
+	dev->name = name;
+
+	/* The ifindex only matters once the messages are sent */
+	dev->ifindex = if_nametoindex(name);
+	if (!dev->ifindex && !t->dry) {
+		fprintf(stderr, "Cannot find device \"%s\".\n", name);
+		return NULL;
+	}
+
+	/* The tenants go on top of what the interface already runs */
+	if (t->dry)
+		ceetm_hier_init(&dev->h, t->ver, dev->ifindex);
+	else if (ceetm_hier_load(&t->nl, t->ver, dev->ifindex, &dev->h))
+		return NULL;
+
+	ceetm_plan_init(&dev->plan, &dev->h);
+	t->ndevs++;
+
+	return dev;
+}
+
+/* Append a message to the batch of an interface and its hierarchy */
+static int ceetm_tenant_add(struct ceetm_tenant_dev *dev,
+			    const struct ceetm_plan_req *req, bool change,
+			    unsigned int lineno)
+{
+	size_t len = NLMSG_ALIGN(req->n.nlmsg_len);
+	unsigned int *lines;
+	char *buf;
+
+	if (dev->len + len > dev->size) {
+		dev->size = dev->size ? 2 * dev->size : 64 * 1024;
+		buf = realloc(dev->buf, dev->size);
+		lines = realloc(dev->lines, dev->size / NLMSG_ALIGN(
+				NLMSG_LENGTH(sizeof(struct tcmsg))) *
+				sizeof(*lines));
+		if (buf)
+			dev->buf = buf;
+		if (lines)
+			dev->lines = lines;
+		if (!buf || !lines) {
+			fprintf(stderr, "Out of memory.\n");
+			return -1;
+		}
+	}
+
+	memcpy(dev->buf + dev->len, req, req->n.nlmsg_len);
+	dev->len += len;
+	dev->lines[dev->count++] = lineno;
+
+	return ceetm_plan_add(&dev->plan, req, change, lineno);
+}
+
+/* The base plan is run once on every interface, before its tenants */
+static int ceetm_tenant_base(struct ceetm_tenant_dev *dev, const char *path)
+{
+	char *argv[CEETM_PLAN_MAX_ARGS], *line = NULL;
+	struct ceetm_plan_req req;
+	unsigned int lineno = 0;
+	size_t len = 0;
+	bool change;
+	int argc, ret = -1;
+	FILE *f;
+
+	f = fopen(path, "r");
+	if (!f) {
+		perror(path);
+		return -1;
+	}
+
+	while (getline(&line, &len, f) > 0) {
+		lineno++;
+
+		argc = ceetm_plan_split(line, argv);
+		if (argc < 0) {
+			fprintf(stderr, "%s:%u: too many arguments.\n", path,
+				lineno);
+			goto out;
+		}
+
+		if (!argc)
+			continue;
+
+		if (ceetm_plan_build(&dev->h, argc, argv, &req, &change)) {
+			fprintf(stderr, "%s:%u: invalid command.\n", path,
+				lineno);
+			goto out;
+		}
+
+		/* Base lines are reported as line 0 of the CSV */
+		if (ceetm_tenant_add(dev, &req, change, 0))
+			goto out;
+	}
+
+	ret = 0;
+
+out:
+	free(line);
+	fclose(f);
+	return ret;
+}
+
+/* Substitute the columns of a row in a template line */
+static int ceetm_tenant_subst(const struct ceetm_tenant_line *tl,
+			      const struct ceetm_tenant_row *row,
+			      char *buf, char **argv)
+{
+	const struct ceetm_tenant_word *w;
+	const struct ceetm_tenant_seg *seg;
+	char *p = buf, *end = buf + CEETM_TENANT_LINE_SIZE;
+	int i, j, len;
+
+	for (i = 0; i < tl->argc; i++) {
+		w = &tl->words[i];
+		if (!w->nsegs) {
+			argv[i] = w->text;
+			continue;
+		}
+
+		argv[i] = p;
+		for (j = 0; j < w->nsegs; j++) {
+			seg = &w->segs[j];
+			len = seg->len;
+			if (p + len >= end)
+				return -1;
+			memcpy(p, seg->text, len);
+			p += len;
+
+			if (seg->col < 0)
+				continue;
+
+			len = strlen(row->cols[seg->col]);
+			if (p + len >= end)
+				return -1;
+			memcpy(p, row->cols[seg->col], len);
+			p += len;
+		}
+		*p++ = '\0';
+	}
+
+	return 0;
+}
+
+static int ceetm_tenant_expand(struct ceetm_tenant *t, const char *devname,
+			       const char *base)
+{
+	char *argv[CEETM_PLAN_MAX_ARGS], buf[CEETM_TENANT_LINE_SIZE];
+	const struct ceetm_tenant_row *row;
+	struct ceetm_tenant_dev *dev;
+	struct ceetm_plan_req req;
+	const char *name;
+	bool change;
+	int i, j, first;
+
+	for (i = 0; i < t->nrows; i++) {
+		row = &t->rows[i];
+		name = t->dev_col >= 0 ? row->cols[t->dev_col] : devname;
+
+		first = t->ndevs;
+		dev = ceetm_tenant_dev(t, name);
+		if (!dev)
+			return -1;
+
+		if (t->ndevs > first && base && ceetm_tenant_base(dev, base))
+			return -1;
+
+		for (j = 0; j < t->ntpl; j++) {
+			if (ceetm_tenant_subst(&t->tpl[j], row, buf, argv)) {
+				fprintf(stderr, "line %u: tenant too long.\n",
+					row->lineno);
+				return -1;
+			}
+
+			if (ceetm_plan_build(&dev->h, t->tpl[j].argc, argv,
+					     &req, &change)) {
+				fprintf(stderr, "line %u: invalid tenant "
+						"(template line %u).\n",
+					row->lineno, t->tpl[j].lineno);
+				return -1;
+			}
+
+			if (ceetm_tenant_add(dev, &req, change, row->lineno))
+				return -1;
+		}
+	}
+
+	return 0;
+}
+
+/* Check the hierarchy of every interface: the live one with the tenants
+ * on top, or only the base and the tenants on a dry run.
+ */
+static int ceetm_tenant_validate(struct ceetm_tenant *t)
+{
+	struct ceetm_tenant_dev *dev;
+	int i, errors = 0;
+
+	for (i = 0; i < t->ndevs; i++) {
+		dev = &t->devs[i];
+
+		if (ceetm_plan_finish(&dev->plan)) {
+			fprintf(stderr, "%s: invalid tenants.\n", dev->name);
+			errors++;
+			continue;
+		}
+
+		if (dev->h.root < 0) {
+			fprintf(stderr, "%s: no root qdisc, the SoC limits "
+					"are not checked.\n", dev->name);
+			continue;
+		}
+
+		if (ceetm_check_hier(&dev->h, t->caps, stderr, NULL)) {
+			fprintf(stderr, "%s: the tenants do not fit.\n",
+				dev->name);
+			errors++;
+		}
+	}
+
+	return errors ? -1 : 0;
+}
+
+/* Send the messages of an interface in order, in chunks the socket takes */
+static void ceetm_tenant_send(struct ceetm_nl *nl,
+			      struct ceetm_tenant_dev *dev)
+{
+	int failed;
+
+	dev->err = ceetm_nl_batch(nl, dev->buf, dev->len, &failed);
+	if (dev->err)
+		dev->failed = failed >= 0 ? failed : 0;
+}
+
+static void ceetm_tenant_free(struct ceetm_tenant *t)
+{
+	int i, j;
+
+	for (i = 0; i < t->ndevs; i++) {
+		ceetm_plan_release(&t->devs[i].plan);
+		ceetm_hier_free(&t->devs[i].h);
+		free(t->devs[i].buf);
+		free(t->devs[i].lines);
+	}
+
+	for (i = 0; t->tpl && i < t->ntpl; i++)
+		for (j = 0; j < t->tpl[i].argc; j++)
+			free(t->tpl[i].words[j].segs);
+
+	free(t->tpl);
+	free(t->tpl_text);
+	free(t->rows);
+	free(t->csv_text);
+	free(t);
+}
+
+int do_tenants(int argc, char **argv)
+{
+	const char *template = NULL, *csv = NULL, *base = NULL, *devname = NULL;
+	struct timespec start, built, end;
+	struct ceetm_tenant_dev *dev;
+	struct ceetm_tenant *t;
+	int i, msgs = 0, ret = -1;
+
+	t = calloc(1, sizeof(*t));
+	if (!t)
+		return -1;
+
+	t->nl.fd = -1;
+
+	t->caps = ceetm_soc_caps();
+
+	while (argc > 0) {
+		if (strcmp(*argv, "template") == 0) {
+			NEXT_ARG();
+			template = *argv;
+
+		} else if (strcmp(*argv, "csv") == 0) {
+			NEXT_ARG();
+			csv = *argv;
+
+		} else if (strcmp(*argv, "base") == 0) {
+			NEXT_ARG();
+			base = *argv;
+
+		} else if (strcmp(*argv, "dev") == 0) {
+			NEXT_ARG();
+			devname = *argv;
+
+		} else if (strcmp(*argv, "soc") == 0) {
+			NEXT_ARG();
+			t->caps = ceetm_soc_lookup_name(*argv);
+			if (!t->caps) {
+				fprintf(stderr, "Unknown SoC %s.\n", *argv);
+				goto out;
+			}
+
+		} else if (strcmp(*argv, "dry") == 0) {
+			t->dry = true;
+
+		} else if (strcmp(*argv, "help") == 0) {
+			explain();
+			goto out;
+
+		} else {
+			fprintf(stderr, "Illegal argument - %s.\n", *argv);
+			explain();
+			goto out;
+		}
+
+		argc--; argv++;
+	}
+
+	if (!template || !csv) {
+		fprintf(stderr, "Please specify the template and the csv.\n");
+		goto out;
+	}
+
+	t->ver = t->caps->ver;
+
+	/* The columns are known before the template refers to them */
+	if (ceetm_tenant_load_csv(t, csv) ||
+	    ceetm_tenant_load_template(t, template))
+		goto out;
+
+	if (t->dev_col < 0 && !devname) {
+		fprintf(stderr, "Please specify the device or a dev column.\n");
+		goto out;
+	}
+
+	if (!t->dry && ceetm_nl_open(&t->nl))
+		goto out;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	if (ceetm_tenant_expand(t, devname, base))
+		goto out;
+
+	clock_gettime(CLOCK_MONOTONIC, &built);
+
+	if (ceetm_tenant_validate(t))
+		goto out;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	for (i = 0; i < t->ndevs; i++)
+		msgs += t->devs[i].count;
+
+	fprintf(stdout, "%d tenants, %d interfaces, %d commands: expanded in "
+		"%.1f ms, validated in %.1f ms\n", t->nrows, t->ndevs, msgs,
+		ceetm_tenant_msecs(&start, &built),
+		ceetm_tenant_msecs(&built, &end));
+
+	if (t->dry) {
+		ret = 0;
+		goto out;
+	}
+
+	ret = 0;
+	for (i = 0; i < t->ndevs; i++) {
+		dev = &t->devs[i];
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		ceetm_tenant_send(&t->nl, dev);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+
+		if (dev->err) {
+			if (dev->lines[dev->failed])
+				fprintf(stdout, "%s: failed at csv line %u: "
+					"%s\n", dev->name,
+					dev->lines[dev->failed],
+					strerror(-dev->err));
+			else
+				fprintf(stdout, "%s: failed in the base plan: "
+					"%s\n", dev->name, strerror(-dev->err));
+			ret = -1;
+			continue;
+		}
+
+		fprintf(stdout, "%s: %d commands applied in %.1f ms\n",
+			dev->name, dev->count, ceetm_tenant_msecs(&start, &end));
+	}
+
+out:
+	if (t->nl.fd >= 0)
+		ceetm_nl_close(&t->nl);
+	ceetm_tenant_free(t);
+	return ret;
+}
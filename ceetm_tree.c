@@ -0,0 +1,237 @@
+/* Copyright 2017-2018 NXP
+ *
+ * SPDX-License-Identifier: GPL-2.0
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <net/if.h>
+
+#include "ceetm_hier.h"
+#include "ceetmctl.h"
+
+/* Utilisation above which a shaper is reported as a bottleneck */
+#define CEETM_TREE_BUSY_PERCENT	90
+
+#define CEETM_TREE_DEF_INTERVAL	1000
+
+struct ceetm_tree {
+	struct ceetm_hier prev;
+	struct ceetm_hier cur;
+	unsigned int interval;
+	/* Measured time between the two dumps */
+	double secs;
+	int bottleneck;
+	double bottleneck_util;
+};
+
+static void explain(void)
+{
+	fprintf(stderr, "Usage: ceetmctl tree dev DEV [interval MS]\n"
+		"\n"
+		"Dump the CEETM hierarchy of DEV twice, MS milliseconds apart\n"
+		"(default %d), and show the dequeue rate and rejects of every CQ,\n"
+		"channel and LNI. Shaped levels also show their utilisation\n"
+		"against the configured rate + ceil (DPAA1) or CIR + EIR (DPAA2).\n"
+		"The most utilised shaper above %d%% is marked as the bottleneck.\n",
+		CEETM_TREE_DEF_INTERVAL, CEETM_TREE_BUSY_PERCENT);
+}
+
+static const char *ceetm_tree_level(const struct ceetm_hier *h,
+				    const struct ceetm_node *node)
+{
+	if (node->kind == CEETM_NODE_QDISC)
+		return node->parent == TC_H_ROOT ? "lni" : "sched";
+
+	if (node->type == (h->ver == DPAA_1 ? DPAA1_CEETM_ROOT :
+					      DPAA2_CEETM_ROOT))
+		return "channel";
+
+	return node->child < 0 ? "cq" : "group";
+}
+
+/* Bytes per second dequeued by a node between the two snapshots */
+static __u64 ceetm_tree_rate(const struct ceetm_tree *tree, int idx,
+			     __u64 *rej_frames)
+{
+	const struct ceetm_node *node = &tree->cur.nodes[idx];
+	const struct ceetm_node *old;
+	int p;
+
+	*rej_frames = 0;
+
+	p = ceetm_hier_find(&tree->prev, node->kind, node->handle);
+	if (p < 0)
+		return 0;
+
+	old = &tree->prev.nodes[p];
+	if (node->total.deq_bytes < old->total.deq_bytes)
+		return 0;
+
+	if (node->total.rej_frames >= old->total.rej_frames)
+		*rej_frames = node->total.rej_frames - old->total.rej_frames;
+
+	return (node->total.deq_bytes - old->total.deq_bytes) / tree->secs;
+}
+
+static void ceetm_tree_find_bottleneck(struct ceetm_tree *tree)
+{
+	const struct ceetm_node *node;
+	__u64 rate, rej;
+	double util;
+	int i;
+
+	tree->bottleneck = -1;
+	tree->bottleneck_util = 0;
+
+	for (i = 0; i < tree->cur.count; i++) {
+		node = &tree->cur.nodes[i];
+		if (!node->limit)
+			continue;
+
+		rate = ceetm_tree_rate(tree, i, &rej);
+		util = 100.0 * rate / node->limit;
+
+		if (util >= CEETM_TREE_BUSY_PERCENT &&
+		    util > tree->bottleneck_util) {
+			tree->bottleneck = i;
+			tree->bottleneck_util = util;
+		}
+	}
+}
+
+static void ceetm_tree_print_node(struct ceetm_tree *tree, FILE *f, int idx,
+				  int depth)
+{
+	const struct ceetm_node *node = &tree->cur.nodes[idx];
+	__u64 rate, rej;
+	char buf[64], id[16];
+	int c;
+
+	/* Inner schedulers only group class queues, fold them into the
+	 * class they are grafted on.
+	 */
+	if (node->kind == CEETM_NODE_QDISC && node->parent != TC_H_ROOT) {
+		for (c = node->child; c >= 0; c = tree->cur.nodes[c].next)
+			ceetm_tree_print_node(tree, f, c, depth);
+		return;
+	}
+
+	rate = ceetm_tree_rate(tree, idx, &rej);
+
+	fprintf(f, "%c %*s%-8s %-8s ", idx == tree->bottleneck ? '*' : ' ',
+		2 * depth, "", ceetm_tree_level(&tree->cur, node),
+		ceetm_node_id(node, id, sizeof(id)));
+
+	print_rate(buf, sizeof(buf), rate);
+	fprintf(f, "tx %s ", buf);
+
+	if (node->limit) {
+		print_rate(buf, sizeof(buf), node->limit);
+		fprintf(f, "of %s (%.1f%%) ", buf, 100.0 * rate / node->limit);
+	}
+
+	fprintf(f, "rej %llu frames/s\n", (__u64)(rej / tree->secs));
+
+	for (c = node->child; c >= 0; c = tree->cur.nodes[c].next)
+		ceetm_tree_print_node(tree, f, c, depth + 1);
+}
+
+int do_tree(int argc, char **argv)
+{
+	struct ceetm_tree tree;
+	struct timespec start, end;
+	struct ceetm_nl nl;
+	enum dpaa_version ver;
+	const char *dev = NULL;
+	int ifindex, ret = -1;
+	char buf[64], id[16];
+
+	memset(&tree, 0, sizeof(tree));
+	tree.interval = CEETM_TREE_DEF_INTERVAL;
+
+	while (argc > 0) {
+		if (strcmp(*argv, "dev") == 0) {
+			NEXT_ARG();
+			dev = *argv;
+
+		} else if (strcmp(*argv, "interval") == 0) {
+			NEXT_ARG();
+			if (get_unsigned(&tree.interval, *argv, 10) ||
+			    tree.interval == 0) {
+				fprintf(stderr, "Illegal interval argument.\n");
+				return -1;
+			}
+
+		} else if (strcmp(*argv, "help") == 0) {
+			explain();
+			return -1;
+
+		} else {
+			fprintf(stderr, "Illegal argument - %s.\n", *argv);
+			explain();
+			return -1;
+		}
+
+		argc--; argv++;
+	}
+
+	if (!dev) {
+		fprintf(stderr, "Please specify the device.\n");
+		return -1;
+	}
+
+	ifindex = if_nametoindex(dev);
+	if (!ifindex) {
+		fprintf(stderr, "Cannot find device \"%s\".\n", dev);
+		return -1;
+	}
+
+	ver = detect_dpaa_version();
+
+	if (ceetm_nl_open(&nl))
+		return -1;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	if (ceetm_hier_load(&nl, ver, ifindex, &tree.prev))
+		goto out_nl;
+
+	ceetmctl_sleep_ms(tree.interval);
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	if (ceetm_hier_load(&nl, ver, ifindex, &tree.cur))
+		goto out_prev;
+	tree.secs = ceetmctl_secs(&start, &end);
+
+	if (tree.cur.root < 0) {
+		fprintf(stderr, "No CEETM root qdisc on %s.\n", dev);
+		goto out_cur;
+	}
+
+	ceetm_tree_find_bottleneck(&tree);
+	ceetm_tree_print_node(&tree, stdout, tree.cur.root, 0);
+
+	if (tree.bottleneck >= 0) {
+		const struct ceetm_node *b = &tree.cur.nodes[tree.bottleneck];
+
+		print_rate(buf, sizeof(buf), b->limit);
+		fprintf(stdout, "bottleneck: %s %s at %.1f%% of %s\n",
+			ceetm_tree_level(&tree.cur, b),
+			ceetm_node_id(b, id, sizeof(id)),
+			tree.bottleneck_util, buf);
+	} else {
+		fprintf(stdout, "bottleneck: none above %d%%\n",
+			CEETM_TREE_BUSY_PERCENT);
+	}
+
+	ret = 0;
+
+out_cur:
+	ceetm_hier_free(&tree.cur);
+out_prev:
+	ceetm_hier_free(&tree.prev);
+out_nl:
+	ceetm_nl_close(&nl);
+	return ret;
+}
@@ -0,0 +1,622 @@
+/* Copyright 2017-2018 NXP
+ *
+ * SPDX-License-Identifier: GPL-2.0
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <signal.h>
+#include <syslog.h>
+#include <time.h>
+#include <unistd.h>
+#include <net/if.h>
+
+#include "ceetm_plan.h"
+#include "ceetmctl.h"
+
+/* Closed-loop tuning of the weights and excess rates of a live hierarchy.
+ *
+ * Every interval the counters of the tuned classes are sampled and
+ * smoothed. A class missing its SLO gets a larger share (weight or excess
+ * rate up by CEETM_TUNE_UP), a class meeting it with a good margin slowly
+ * gives bandwidth back (down by CEETM_TUNE_DOWN), always within the
+ * operator bounds. Changes go through the regular 'class change' paths and
+ * are rate-limited per class (holddown) and per interval (maxchanges).
+ */
+
+#define CEETM_TUNE_DEF_INTERVAL		1000
+#define CEETM_TUNE_DEF_HOLDDOWN		10
+#define CEETM_TUNE_DEF_MAXCHANGES	1
+
+#define CEETM_TUNE_UP		1.25
+#define CEETM_TUNE_DOWN		0.95
+/* Weight of a new sample in the smoothed measurements */
+#define CEETM_TUNE_EWMA		0.3
+/* A class gives bandwidth back only below this fraction of its drop SLO or
+ * above this multiple of its rate SLO.
+ */
+#define CEETM_TUNE_DROP_MARGIN	0.25
+#define CEETM_TUNE_RATE_MARGIN	1.2
+
+#define CEETM_TUNE_MAX_TARGETS	256
+
+enum ceetm_tune_knob {
+	CEETM_TUNE_WEIGHT,	/* DPAA2 prio class weight */
+	CEETM_TUNE_EIR,		/* DPAA2 channel excess rate */
+	CEETM_TUNE_QWEIGHT,	/* DPAA1 wbfs class weight */
+	CEETM_TUNE_CEIL,	/* DPAA1 channel excess rate */
+};
+
+enum ceetm_tune_slo {
+	CEETM_TUNE_SLO_DROP,
+	CEETM_TUNE_SLO_RATE,
+};
+
+struct ceetm_tune_target {
+	__u32 handle;
+	enum ceetm_tune_knob knob;
+	enum ceetm_tune_slo slo;
+	double min;
+	double max;
+	/* Reject ratio or dequeue rate (bytes per second) to meet */
+	double goal;
+	double value;
+	double rate;
+	double drop;
+	bool sampled;
+	time_t last_change;
+};
+
+struct ceetm_tune {
+	struct ceetm_tune_target targets[CEETM_TUNE_MAX_TARGETS];
+	int count;
+	unsigned int interval;
+	unsigned int holddown;
+	unsigned int maxchanges;
+	bool daemon;
+};
+
+static volatile sig_atomic_t ceetm_tune_stop;
+
+static void explain(void)
+{
+	fprintf(stderr, "Usage: ceetmctl tune dev DEV config FILE [interval MS] "
+		"[holddown S] [maxchanges N] [daemon]\n"
+		"\n"
+		"Each line of FILE is:\n"
+		"CLASSID KNOB MIN MAX (drop PERCENT | rate RATE)\n"
+		"\n"
+		"KNOB - weight (DPAA2 prio class), eir (DPAA2 root class),\n"
+		"	qweight (DPAA1 wbfs class) or ceil (DPAA1 root class)\n"
+		"MIN/MAX - bounds of the knob, rates for eir / ceil\n"
+		"drop - highest reject ratio of the class\n"
+		"rate - dequeue rate the class must reach while backlogged\n"
+		"MS - sampling interval (default %d)\n"
+		"S - minimum time between two changes of a class (default %d)\n"
+		"N - maximum number of changes per interval (default %d)\n",
+		CEETM_TUNE_DEF_INTERVAL, CEETM_TUNE_DEF_HOLDDOWN,
+		CEETM_TUNE_DEF_MAXCHANGES);
+}
+
+static void ceetm_tune_log(const struct ceetm_tune *tune, const char *fmt, ...)
+{
+	va_list args;
+
+	va_start(args, fmt);
+	if (tune->daemon) {
+		vsyslog(LOG_INFO, fmt, args);
+	} else {
+		vfprintf(stdout, fmt, args);
+		fputc('\n', stdout);
+		fflush(stdout);
+	}
+	va_end(args);
+}
+
+static time_t ceetm_tune_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec;
+}
+
+static void ceetm_tune_signal(int sig)
+{
+	ceetm_tune_stop = 1;
+}
+
+static int ceetm_tune_parse_knob(const char *arg, enum ceetm_tune_knob *knob)
+{
+	if (strcmp(arg, "weight") == 0)
+		*knob = CEETM_TUNE_WEIGHT;
+	else if (strcmp(arg, "eir") == 0)
+		*knob = CEETM_TUNE_EIR;
+	else if (strcmp(arg, "qweight") == 0)
+		*knob = CEETM_TUNE_QWEIGHT;
+	else if (strcmp(arg, "ceil") == 0)
+		*knob = CEETM_TUNE_CEIL;
+	else
+		return -1;
+
+	return 0;
+}
+
+static bool ceetm_tune_is_rate(enum ceetm_tune_knob knob)
+{
+	return knob == CEETM_TUNE_EIR || knob == CEETM_TUNE_CEIL;
+}
+
+static int ceetm_tune_parse_bound(enum ceetm_tune_knob knob, const char *arg,
+				  double *val)
+{
+	__u64 rate;
+	__u32 w;
+
+	if (ceetm_tune_is_rate(knob)) {
+		if (get_rate64(&rate, arg))
+			return -1;
+		*val = rate;
+		return 0;
+	}
+
+	if (get_u32(&w, arg, 10) || !w)
+		return -1;
+	*val = w;
+	return 0;
+}
+
+static int ceetm_tune_parse_line(struct ceetm_tune *tune, int argc,
+				 char **argv)
+{
+	struct ceetm_tune_target *t;
+	__u64 rate;
+
+	if (argc != 6)
+		return -1;
+
+	if (tune->count == CEETM_TUNE_MAX_TARGETS) {
+		fprintf(stderr, "At most %d classes can be tuned.\n",
+			CEETM_TUNE_MAX_TARGETS);
+		return -1;
+	}
+
+	t = &tune->targets[tune->count];
+	memset(t, 0, sizeof(*t));
+
+	if (get_tc_classid(&t->handle, argv[0]) ||
+	    ceetm_tune_parse_knob(argv[1], &t->knob) ||
+	    ceetm_tune_parse_bound(t->knob, argv[2], &t->min) ||
+	    ceetm_tune_parse_bound(t->knob, argv[3], &t->max) ||
+	    t->min > t->max)
+		return -1;
+
+	if (strcmp(argv[4], "drop") == 0) {
+		t->slo = CEETM_TUNE_SLO_DROP;
+		t->goal = strtod(argv[5], NULL) / 100;
+		if (t->goal <= 0 || t->goal >= 1)
+			return -1;
+	} else if (strcmp(argv[4], "rate") == 0) {
+		t->slo = CEETM_TUNE_SLO_RATE;
+		if (get_rate64(&rate, argv[5]) || !rate)
+			return -1;
+		t->goal = rate;
+	} else {
+		return -1;
+	}
+
+	tune->count++;
+	return 0;
+}
+
+static int ceetm_tune_load_config(struct ceetm_tune *tune, const char *path)
+{
+	char *argv[CEETM_PLAN_MAX_ARGS], *line = NULL, *word, *save;
+	unsigned int lineno = 0;
+	size_t len = 0;
+	int argc, ret = 0;
+	FILE *f;
+
+	f = fopen(path, "r");
+	if (!f) {
+		perror(path);
+		return -1;
+	}
+
+	while (getline(&line, &len, f) > 0) {
+		lineno++;
+		line[strcspn(line, "#\n")] = '\0';
+
+		argc = 0;
+		save = NULL;
+		for (word = strtok_r(line, " \t", &save);
+		     word && argc < CEETM_PLAN_MAX_ARGS;
+		     word = strtok_r(NULL, " \t", &save))
+			argv[argc++] = word;
+
+		if (argc == 0)
+			continue;
+
+		if (ceetm_tune_parse_line(tune, argc, argv)) {
+			fprintf(stderr, "%s:%u: invalid target.\n", path, lineno);
+			ret = -1;
+			break;
+		}
+	}
+
+	free(line);
+	fclose(f);
+	return ret;
+}
+
+/* Check that the knob exists on the class and read its current value */
+static int ceetm_tune_read(const struct ceetm_hier *h,
+			   struct ceetm_tune_target *t)
+{
+	const struct ceetm_node *node, *sched;
+	int idx;
+
+	idx = ceetm_hier_find(h, CEETM_NODE_CLASS, t->handle);
+	if (idx < 0)
+		return -1;
+
+	node = &h->nodes[idx];
+	/* The weights of a flow-hashed group are not applied */
+	sched = node->up >= 0 ? &h->nodes[node->up] : NULL;
+
+	switch (t->knob) {
+	case CEETM_TUNE_WEIGHT:
+		if (h->ver != DPAA_2 || node->type != DPAA2_CEETM_PRIO ||
+		    node->opt.c2.mode == STRICT_PRIORITY)
+			return -1;
+		if (sched && (sched->flow_hash & (DPAA2_CEETM_FLOW_HASH_A <<
+				(node->opt.c2.mode - WEIGHTED_A))))
+			return -1;
+		t->value = node->opt.c2.weight;
+		break;
+	case CEETM_TUNE_EIR:
+		if (h->ver != DPAA_2 || node->type != DPAA2_CEETM_ROOT ||
+		    !node->opt.c2.shaped || node->pkt_mode)
+			return -1;
+		t->value = node->opt.c2.shaping_cfg.eir;
+		break;
+	case CEETM_TUNE_QWEIGHT:
+		if (h->ver != DPAA_1 || node->type != DPAA1_CEETM_WBFS ||
+		    (sched && sched->flow_hash))
+			return -1;
+		t->value = node->opt.c1.weight;
+		break;
+	case CEETM_TUNE_CEIL:
+		if (h->ver != DPAA_1 || node->type != DPAA1_CEETM_ROOT ||
+		    !node->opt.c1.shaped || node->pkt_mode)
+			return -1;
+		t->value = node->opt.c1.ceil;
+		break;
+	}
+
+	return 0;
+}
+
+/* Smooth the dequeue rate and reject ratio of a class between two dumps */
+static void ceetm_tune_sample(const struct ceetm_hier *prev,
+			      const struct ceetm_hier *cur, double secs,
+			      struct ceetm_tune_target *t)
+{
+	const struct ceetm_counters *a, *b;
+	double rate, drop, deq, rej;
+	int i, j;
+
+	i = ceetm_hier_find(prev, CEETM_NODE_CLASS, t->handle);
+	j = ceetm_hier_find(cur, CEETM_NODE_CLASS, t->handle);
+	if (i < 0 || j < 0)
+		return;
+
+	a = &prev->nodes[i].total;
+	b = &cur->nodes[j].total;
+	if (b->deq_bytes < a->deq_bytes || b->rej_frames < a->rej_frames)
+		return;
+
+	deq = b->deq_frames - a->deq_frames;
+	rej = b->rej_frames - a->rej_frames;
+	rate = (b->deq_bytes - a->deq_bytes) / secs;
+	drop = deq + rej > 0 ? rej / (deq + rej) : 0;
+
+	/* DPAA1 only counts the congestion onsets, take them as drops above
+	 * the goal, so the smoothed ratio can cross it
+	 */
+	if (!rej && b->congested > a->congested)
+		drop = t->goal * 2 < 1 ? t->goal * 2 : 1;
+
+	if (!t->sampled) {
+		t->rate = rate;
+		t->drop = drop;
+		t->sampled = true;
+		return;
+	}
+
+	t->rate += CEETM_TUNE_EWMA * (rate - t->rate);
+	t->drop += CEETM_TUNE_EWMA * (drop - t->drop);
+}
+
+/* The factor to apply to the share of a class, 1 to leave it alone */
+static double ceetm_tune_decide(const struct ceetm_tune_target *t)
+{
+	if (t->slo == CEETM_TUNE_SLO_DROP) {
+		if (t->drop > t->goal)
+			return CEETM_TUNE_UP;
+		if (t->drop < t->goal * CEETM_TUNE_DROP_MARGIN)
+			return CEETM_TUNE_DOWN;
+		return 1;
+	}
+
+	/* Below the goal only matters if the class has more to send */
+	if (t->rate < t->goal && t->drop > 0)
+		return CEETM_TUNE_UP;
+	if (t->rate > t->goal * CEETM_TUNE_RATE_MARGIN)
+		return CEETM_TUNE_DOWN;
+	return 1;
+}
+
+static int ceetm_tune_apply(struct ceetm_nl *nl, const struct ceetm_hier *h,
+			    const struct ceetm_tune_target *t, double value)
+{
+	char id[16], val[32], rate[32];
+	struct ceetm_plan_req req;
+	const struct ceetm_node *node;
+	char *argv[12];
+	bool change;
+	int argc = 0, idx;
+
+	idx = ceetm_hier_find(h, CEETM_NODE_CLASS, t->handle);
+	if (idx < 0)
+		return -ENOENT;
+
+	node = &h->nodes[idx];
+	ceetm_node_id(node, id, sizeof(id));
+
+	argv[argc++] = "class";
+	argv[argc++] = "change";
+	argv[argc++] = "classid";
+	argv[argc++] = id;
+	argv[argc++] = "ceetm";
+	argv[argc++] = "type";
+
+	switch (t->knob) {
+	case CEETM_TUNE_WEIGHT:
+		snprintf(val, sizeof(val), "%.0f", value);
+		argv[argc++] = "prio";
+		argv[argc++] = "weight";
+		argv[argc++] = val;
+		break;
+	case CEETM_TUNE_EIR:
+		snprintf(val, sizeof(val), "%.0fbps", value);
+		argv[argc++] = "root";
+		argv[argc++] = "eir";
+		argv[argc++] = val;
+		break;
+	case CEETM_TUNE_QWEIGHT:
+		snprintf(val, sizeof(val), "%.0f", value);
+		argv[argc++] = "wbfs";
+		argv[argc++] = "qweight";
+		argv[argc++] = val;
+		break;
+	case CEETM_TUNE_CEIL:
+		/* A DPAA1 channel change needs the rate along with the ceil */
+		snprintf(rate, sizeof(rate), "%ubps", node->opt.c1.rate);
+		snprintf(val, sizeof(val), "%.0fbps", value);
+		argv[argc++] = "root";
+		argv[argc++] = "rate";
+		argv[argc++] = rate;
+		argv[argc++] = "ceil";
+		argv[argc++] = val;
+		break;
+	}
+
+	if (ceetm_plan_build(h, argc, argv, &req, &change))
+		return -EINVAL;
+
+	return ceetm_nl_talk(nl, &req.n);
+}
+
+static void ceetm_tune_step(struct ceetm_tune *tune, struct ceetm_nl *nl,
+			    const struct ceetm_hier *h)
+{
+	struct ceetm_tune_target *t;
+	unsigned int changes = 0;
+	double factor, value;
+	time_t now = ceetm_tune_now();
+	char id[16];
+	int i, err;
+
+	for (i = 0; i < tune->count && changes < tune->maxchanges; i++) {
+		t = &tune->targets[i];
+
+		if (!t->sampled ||
+		    (t->last_change && now - t->last_change < tune->holddown))
+			continue;
+
+		factor = ceetm_tune_decide(t);
+		if (factor == 1)
+			continue;
+
+		/* The DPAA1 WBFS weight is a cost, a larger share needs a
+		 * smaller qweight.
+		 */
+		if (t->knob == CEETM_TUNE_QWEIGHT)
+			factor = 1 / factor;
+
+		value = t->value * factor;
+		if (factor > 1 && value < t->value + 1)
+			value = t->value + 1;
+		else if (factor < 1 && value > t->value - 1)
+			value = t->value - 1;
+
+		if (value < t->min)
+			value = t->min;
+		if (value > t->max)
+			value = t->max;
+
+		value = (double)(__u64)(value + 0.5);
+		if (value == t->value)
+			continue;
+
+		snprintf(id, sizeof(id), "%x:%x", TC_H_MAJ(t->handle) >> 16,
+			 TC_H_MIN(t->handle));
+
+		err = ceetm_tune_apply(nl, h, t, value);
+		if (err) {
+			ceetm_tune_log(tune, "%s: change to %.0f failed: %s", id,
+				       value, strerror(-err));
+			t->last_change = now;
+			continue;
+		}
+
+		ceetm_tune_log(tune, "%s: %.0f -> %.0f (rate %.0f B/s, drop %.3f%%)",
+			       id, t->value, value, t->rate, 100 * t->drop);
+
+		t->value = value;
+		t->last_change = now;
+		changes++;
+	}
+}
+
+int do_tune(int argc, char **argv)
+{
+	struct ceetm_hier prev, cur;
+	enum dpaa_version ver = detect_dpaa_version();
+	const char *dev = NULL, *config = NULL;
+	struct ceetm_tune *tune;
+	struct timespec last, now;
+	struct ceetm_nl nl;
+	double secs;
+	int ifindex, i, ret = -1;
+
+	tune = calloc(1, sizeof(*tune));
+	if (!tune)
+		return -1;
+
+	tune->interval = CEETM_TUNE_DEF_INTERVAL;
+	tune->holddown = CEETM_TUNE_DEF_HOLDDOWN;
+	tune->maxchanges = CEETM_TUNE_DEF_MAXCHANGES;
+
+	while (argc > 0) {
+		if (strcmp(*argv, "dev") == 0) {
+			NEXT_ARG();
+			dev = *argv;
+
+		} else if (strcmp(*argv, "config") == 0) {
+			NEXT_ARG();
+			config = *argv;
+
+		} else if (strcmp(*argv, "interval") == 0) {
+			NEXT_ARG();
+			if (get_unsigned(&tune->interval, *argv, 10) ||
+			    !tune->interval) {
+				fprintf(stderr, "Illegal interval argument.\n");
+				goto out_free;
+			}
+
+		} else if (strcmp(*argv, "holddown") == 0) {
+			NEXT_ARG();
+			if (get_unsigned(&tune->holddown, *argv, 10)) {
+				fprintf(stderr, "Illegal holddown argument.\n");
+				goto out_free;
+			}
+
+		} else if (strcmp(*argv, "maxchanges") == 0) {
+			NEXT_ARG();
+			if (get_unsigned(&tune->maxchanges, *argv, 10) ||
+			    !tune->maxchanges) {
+				fprintf(stderr, "Illegal maxchanges argument.\n");
+				goto out_free;
+			}
+
+		} else if (strcmp(*argv, "daemon") == 0) {
+			tune->daemon = true;
+
+		} else if (strcmp(*argv, "help") == 0) {
+			explain();
+			goto out_free;
+
+		} else {
+			fprintf(stderr, "Illegal argument - %s.\n", *argv);
+			explain();
+			goto out_free;
+		}
+
+		argc--; argv++;
+	}
+
+	if (!dev || !config) {
+		fprintf(stderr, "Please specify the device and the config.\n");
+		goto out_free;
+	}
+
+	if (ceetm_tune_load_config(tune, config))
+		goto out_free;
+
+	ifindex = if_nametoindex(dev);
+	if (!ifindex) {
+		fprintf(stderr, "Cannot find device \"%s\".\n", dev);
+		goto out_free;
+	}
+
+	if (ceetm_nl_open(&nl))
+		goto out_free;
+
+	clock_gettime(CLOCK_MONOTONIC, &last);
+	if (ceetm_hier_load(&nl, ver, ifindex, &prev))
+		goto out_nl;
+
+	for (i = 0; i < tune->count; i++) {
+		if (ceetm_tune_read(&prev, &tune->targets[i])) {
+			fprintf(stderr, "Class %x:%x does not support the "
+					"requested knob.\n",
+				TC_H_MAJ(tune->targets[i].handle) >> 16,
+				TC_H_MIN(tune->targets[i].handle));
+			goto out_prev;
+		}
+	}
+
+	if (tune->daemon) {
+		if (daemon(0, 0)) {
+			perror("daemon");
+			goto out_prev;
+		}
+		openlog("ceetmctl", LOG_PID, LOG_DAEMON);
+	}
+
+	signal(SIGINT, ceetm_tune_signal);
+	signal(SIGTERM, ceetm_tune_signal);
+
+	while (!ceetm_tune_stop) {
+		ceetmctl_sleep_ms(tune->interval);
+
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		if (ceetm_hier_load(&nl, ver, ifindex, &cur))
+			break;
+		secs = ceetmctl_secs(&last, &now);
+		last = now;
+
+		for (i = 0; i < tune->count; i++)
+			ceetm_tune_sample(&prev, &cur, secs,
+					  &tune->targets[i]);
+
+		ceetm_tune_step(tune, &nl, &cur);
+
+		ceetm_hier_free(&prev);
+		prev = cur;
+	}
+
+	ret = ceetm_tune_stop ? 0 : -1;
+
+out_prev:
+	ceetm_hier_free(&prev);
+out_nl:
+	ceetm_nl_close(&nl);
+out_free:
+	free(tune);
+	return ret;
+}
@@ -0,0 +1,180 @@
+/* Copyright 2017-2018 NXP
+ *
+ * SPDX-License-Identifier: GPL-2.0
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <net/if.h>
+
+#include "ceetm_plan.h"
+#include "ceetmctl.h"
+
+/* Globals referenced by the iproute2 tc helpers linked into the tool */
+int use_iec;
+int show_details;
+int show_stats;
+int show_raw;
+int show_graph;
+int batch_mode;
+int use_names;
+
+static const struct cmd {
+	const char *name;
+	int (*func)(int argc, char **argv);
+} cmds[] = {
+	{ "tree",	do_tree },
+	{ "calc",	do_calc },
+	{ "tune",	do_tune },
+	{ "provision",	do_provision },
+	{ "check",	do_check },
+	{ "save",	do_save },
+	{ "restore",	do_restore },
+	{ "burst",	do_burst },
+	{ "autoscale",	do_autoscale },
+	{ "tenants",	do_tenants },
+	{ "schedule",	do_schedule },
+	{ "lag",	do_lag },
+	{ "place",	do_place },
+	{ "export",	do_export },
+	{ "calibrate",	do_calibrate },
+	{ NULL,		NULL },
+};
+
+static void usage(void)
+{
+	fprintf(stderr, "Usage: ceetmctl COMMAND [ARGS]\n"
+		"\n"
+		"Commands:\n"
+		"tree dev DEV [interval MS] - show the CEETM hierarchy of DEV with\n"
+		"	the counters aggregated per CQ, channel and LNI and the\n"
+		"	utilisation of each shaper\n"
+		"calc (dev DEV | file PLAN) ... - compute the steady-state\n"
+		"	bandwidth of every class queue\n"
+		"tune dev DEV config FILE ... - adjust weights and excess rates\n"
+		"	to meet per-class throughput or drop objectives\n"
+		"provision template PLAN dev DEV... - apply a hierarchy to many\n"
+		"	interfaces in parallel\n"
+		"check (file PLAN | dev DEV) [soc SOC] - validate a hierarchy\n"
+		"	against the CEETM limits of a SoC\n"
+		"save (dev DEV | plan PLAN) [file FILE] - write a hierarchy to a\n"
+		"	snapshot\n"
+		"restore dev DEV [file FILE] [flush] - apply a snapshot to DEV\n"
+		"	in a single batch\n"
+		"burst dev DEV class CLASSID... [rate HZ] - sample class\n"
+		"	counters at up to 10 kHz to catch microbursts\n"
+		"autoscale dev DEV plan PLAN [base SPEED] [profile FILE] -\n"
+		"	follow the link speed of DEV and rescale its LNI and\n"
+		"	channel shapers from their PLAN rates\n"
+		"tenants template TPL csv FILE [dev DEV] - expand the subtree of\n"
+		"	one tenant for every line of FILE and apply them in batches\n"
+		"schedule dev DEV config FILE - switch between precompiled\n"
+		"	shaping profiles at set times of the day\n"
+		"lag rate RATE bond BOND - share a rate between the LNIs of the\n"
+		"	members of a LAG, following their load\n"
+		"place sla FILE [soc SOC] - assign tenants to ports, channels\n"
+		"	and class queues and write the hierarchy\n"
+		"export dev DEV [format (csv | bin)] - write the configuration\n"
+		"	and counters of every class, one row per class\n"
+		"calibrate trace FILE (dev DEV | file PLAN) - fit the scheduler\n"
+		"	model to the counters recorded by burst\n"
+		);
+}
+
+/* A SoC name from the capability table, or dpaa1 / dpaa2 */
+int ceetmctl_parse_soc(const char *arg, enum dpaa_version *ver)
+{
+	const struct ceetm_soc_caps *caps = ceetm_soc_lookup_name(arg);
+
+	if (!caps) {
+		fprintf(stderr, "Illegal soc argument: must be a SoC name, "
+				"dpaa1 or dpaa2.\n");
+		return -1;
+	}
+
+	*ver = caps->ver;
+	return 0;
+}
+
+/* Sleep between two samples, cut short by a signal. Any interval fits,
+ * usleep(ms * 1000) overflows above 4294 s.
+ */
+void ceetmctl_sleep_ms(unsigned int ms)
+{
+	struct timespec ts = {
+		.tv_sec = ms / 1000,
+		.tv_nsec = (ms % 1000) * 1000000L,
+	};
+
+	nanosleep(&ts, NULL);
+}
+
+/* Seconds from a to b, CLOCK_MONOTONIC time stamps */
+double ceetmctl_secs(const struct timespec *a, const struct timespec *b)
+{
+	return (b->tv_sec - a->tv_sec) + (b->tv_nsec - a->tv_nsec) / 1e9;
+}
+
+/* Load the hierarchy of a live interface or of an offline plan */
+int ceetmctl_load_hier(const char *dev, const char *file,
+		       enum dpaa_version ver, struct ceetm_hier *h)
+{
+	struct ceetm_nl nl;
+	int ifindex, ret;
+	FILE *f;
+
+	if (!dev == !file) {
+		fprintf(stderr, "Please specify either the device or the "
+				"plan file.\n");
+		return -1;
+	}
+
+	if (file) {
+		f = strcmp(file, "-") == 0 ? stdin : fopen(file, "r");
+		if (!f) {
+			perror(file);
+			return -1;
+		}
+
+		ceetm_hier_init(h, ver, 0);
+		ret = ceetm_plan_load(f, h);
+		if (f != stdin)
+			fclose(f);
+		if (ret)
+			ceetm_hier_free(h);
+		return ret;
+	}
+
+	ifindex = if_nametoindex(dev);
+	if (!ifindex) {
+		fprintf(stderr, "Cannot find device \"%s\".\n", dev);
+		return -1;
+	}
+
+	if (ceetm_nl_open(&nl))
+		return -1;
+
+	ret = ceetm_hier_load(&nl, ver, ifindex, h);
+	ceetm_nl_close(&nl);
+
+	return ret;
+}
+
+int main(int argc, char **argv)
+{
+	const struct cmd *c;
+
+	if (argc < 2 || strcmp(argv[1], "help") == 0) {
+		usage();
+		return argc < 2 ? -1 : 0;
+	}
+
+	for (c = cmds; c->name; c++) {
+		if (strcmp(argv[1], c->name) == 0)
+			return c->func(argc - 2, argv + 2);
+	}
+
+	fprintf(stderr, "Unknown command \"%s\".\n", argv[1]);
+	usage();
+	return -1;
+}
@@ -0,0 +1,35 @@
+/* Copyright 2017-2018 NXP
+ *
+ * SPDX-License-Identifier: GPL-2.0
+ */
+
+#ifndef __CEETMCTL_H
+#define __CEETMCTL_H
+
+#include <time.h>
+
+#include "ceetm_hier.h"
+
+int ceetmctl_parse_soc(const char *arg, enum dpaa_version *ver);
+int ceetmctl_load_hier(const char *dev, const char *file,
+		       enum dpaa_version ver, struct ceetm_hier *h);
+void ceetmctl_sleep_ms(unsigned int ms);
+double ceetmctl_secs(const struct timespec *a, const struct timespec *b);
+
+int do_tree(int argc, char **argv);
+int do_calc(int argc, char **argv);
+int do_tune(int argc, char **argv);
+int do_provision(int argc, char **argv);
+int do_check(int argc, char **argv);
+int do_save(int argc, char **argv);
+int do_restore(int argc, char **argv);
+int do_burst(int argc, char **argv);
+int do_autoscale(int argc, char **argv);
+int do_tenants(int argc, char **argv);
+int do_schedule(int argc, char **argv);
+int do_lag(int argc, char **argv);
+int do_place(int argc, char **argv);
+int do_export(int argc, char **argv);
+int do_calibrate(int argc, char **argv);
+
+#endif
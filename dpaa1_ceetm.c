@@ -12,25 +12,31 @@
 static void explain(void)
 {
 	fprintf(stderr, "Usage:\n"
-		"... qdisc add ... ceetm type root [rate R [ceil C] [overhead O]]\n"
-		"... class add ... ceetm type root (tbl T | rate R [ceil C])\n"
+		"... qdisc add ... ceetm type root [rate R [ceil C] [overhead O]] "
+		"[reserve B] [cap B]\n"
+		"... class add ... ceetm type root (tbl T | rate R [ceil C]) "
+		"[reserve B] [cap B]\n"
 		"... qdisc add ... ceetm type prio qcount Q\n"
 		"... qdisc add ... ceetm type wbfs qcount Q qweight W1 ... Wn "
-		"[cr CR] [er ER]\n"
+		"[cr CR] [er ER] [group G] [position P] [flowhash H]\n"
 		"\n"
 		"Update configurations:\n"
-		"... qdisc change ... ceetm type root [rate R [ceil C] [overhead O]]\n"
-		"... class change ... ceetm type root (tbl T | rate R [ceil C])\n"
-		"... class change ... ceetm type prio [cr CR] [er ER]\n"
-		"... qdisc change ... ceetm type wbfs [cr CR] [er ER]\n"
-		"... class change ... ceetm type wbfs qweight W\n"
+		"... qdisc change ... ceetm type root [rate R [ceil C] [overhead O]] "
+		"[reserve B] [cap B]\n"
+		"... class change ... ceetm type root (tbl T | rate R [ceil C]) "
+		"[reserve B] [cap B]\n"
+		"... class change ... ceetm type prio [cr CR] [er ER] "
+		"[minrate M] [maxrun N] [latsample S]\n"
+		"... qdisc change ... ceetm type wbfs [cr CR] [er ER] "
+		"[position P] [flowhash H]\n"
+		"... class change ... ceetm type wbfs qweight W [latsample S]\n"
 		"\n"
 		"Qdisc types:\n"
 		"root - configure a LNI linked to a FMan port\n"
 		"prio - configure a channel's Priority Scheduler with up to "
 		"eight classes\n"
 		"wbfs - configure a Weighted Bandwidth Fair Scheduler with "
-		"four or eight classes\n"
+		"four or eight classes, on a class group of the channel\n"
 		"\n"
 		"Class types:\n"
 		"root - configure a shaped or unshaped channel\n"
@@ -41,15 +47,41 @@ static void explain(void)
 		"(required for shaping scenarios)\n"
 		"C - the ER of the LNI's or channel's dual-rate shaper "
 		"(optional for shaping scenarios, defaults to 0)\n"
+		"R and C are byte rates, or both packet rates such as 2Mpps "
+		"to shape the frames whatever their size where the SoC "
+		"supports it\n"
 		"O - per-packet size overhead used in rate computations "
-		"(required for shaping scenarios, recommended value is 24 "
-		"i.e. 12 bytes IFG + 8 bytes Preamble + 4 bytes FCS)\n"
+		"(required for byte shaping scenarios, recommended value is 24 "
+		"i.e. 12 bytes IFG + 8 bytes Preamble + 4 bytes FCS; not used "
+		"with packet rates)\n"
 		"T - the token bucket limit of an unshaped channel used as "
 		"fair queuing weight (required for unshaped channels)\n"
 		"CR/ER - boolean marking if the class group or prio class "
 		"queue contributes to CR/ER shaping (1) or not (0) (optional, "
 		"at least one needs to be enabled for shaping scenarios, both "
 		"default to 1 for prio class queues)\n"
+		"M - minimum rate guaranteed to a prio class queue even when "
+		"higher priorities are flooded, served from the channel's CR "
+		"(cr must be 1)\n"
+		"N - most frames a prio class queue is served in a row while "
+		"lower priorities wait (0 for no limit)\n"
+		"S - one frame in S of the class queue has its queueing delay "
+		"sampled into the latency histogram (0 to stop sampling)\n"
+		"B - bytes of the FMan buffer pool: the reserve is set aside "
+		"for the LNI or channel so congestion on other ports cannot "
+		"take it, the cap is the most it may hold before frames are "
+		"rejected (optional, default 0 i.e. no reserve and no cap; "
+		"left untouched by a change that gives neither)\n"
+		"G - the class group of a wbfs qdisc, A or B: a channel hosts "
+		"one group of eight class queues (A) or two groups of four, "
+		"each with its own cr and er (optional, default A)\n"
+		"P - the group is served right after the independent class "
+		"queue P, from 0 to 7 (optional, defaults to the priority of "
+		"the prio class the wbfs qdisc is grafted on)\n"
+		"H - 1 to spread the flows over the class queues of the group "
+		"by hash of their 5-tuple, the class queues are then served at "
+		"equal weight whatever their qweight, 0 to stop (optional, "
+		"default 0; left untouched by a change that does not give it)\n"
 		"Q - the number of class queues connected to the channel "
 		"(from 1 to 8) or in a class group (either 4 or 8)\n"
 		"W - the weights of each class in the class group measured "
@@ -59,19 +91,60 @@ static void explain(void)
 		);
 }
 
+/* A byte rate, or a packet rate when given in pps */
+static int dpaa1_ceetm_get_rate(__u32 *rate, bool *pps, const char *str)
+{
+	__u64 val;
+
+	*pps = !ceetm_get_pps(&val, str);
+	if (!*pps)
+		return get_rate(rate, str);
+
+	if (val > (__u32)~0U)
+		return -1;
+
+	*rate = val;
+	return 0;
+}
+
+/* Both rates of a shaper count the same unit */
+static int dpaa1_ceetm_check_pps(bool rate_pps, bool ceil_set, bool ceil_pps)
+{
+	if (ceil_set && rate_pps != ceil_pps) {
+		fprintf(stderr, "rate and ceil must both be byte rates or "
+				"both packet rates.\n");
+		return -1;
+	}
+
+	return 0;
+}
+
 int dpaa1_ceetm_parse_qopt(struct qdisc_util *qu, int argc, char **argv,
 				  struct nlmsghdr *n)
 {
 	struct tc_ceetm_qopt opt;
+	struct tc_ceetm_buf_part bp, *bpp = NULL;
+	struct tc_ceetm_wbfs_group grp, *grpp = NULL;
+	__u32 pkt = 1, *pktp = NULL;
+	__u32 hash, *hashp = NULL;
+	struct tcmsg *t;
+	bool change = !(n->nlmsg_flags & NLM_F_CREATE);
+	bool group_set = false;
+	bool position_set = false;
+	bool reserve_set = false;
+	bool cap_set = false;
 	bool overhead_set = false;
 	bool rate_set = false;
+	bool rate_pps = false;
 	bool ceil_set = false;
+	bool ceil_pps = false;
 	bool cr_set = false;
 	bool er_set = false;
 	bool qweight_set = false;
-	struct rtattr *tail;
 	int i;
 	memset(&opt, 0, sizeof(opt));
+	memset(&bp, 0, sizeof(bp));
+	memset(&grp, 0, sizeof(grp));
 
 	while (argc > 0) {
 		if (strcmp(*argv, "type") == 0) {
@@ -155,7 +228,7 @@ int dpaa1_ceetm_parse_qopt(struct qdisc_util *qu, int argc, char **argv,
 			}
 
 			NEXT_ARG();
-			if (get_rate(&opt.rate, *argv)) {
+			if (dpaa1_ceetm_get_rate(&opt.rate, &rate_pps, *argv)) {
 				fprintf(stderr, "Illegal rate argument.\n");
 				return -1;
 			}
@@ -180,7 +253,7 @@ int dpaa1_ceetm_parse_qopt(struct qdisc_util *qu, int argc, char **argv,
 			}
 
 			NEXT_ARG();
-			if (get_rate(&opt.ceil, *argv)) {
+			if (dpaa1_ceetm_get_rate(&opt.ceil, &ceil_pps, *argv)) {
 				fprintf(stderr, "Illegal ceil argument.\n");
 				return -1;
 			}
@@ -212,6 +285,55 @@ int dpaa1_ceetm_parse_qopt(struct qdisc_util *qu, int argc, char **argv,
 
 			overhead_set = true;
 
+		} else if (strcmp(*argv, "reserve") == 0) {
+			if (!opt.type) {
+				fprintf(stderr, "Please specify the qdisc type "
+						"before the reserve.\n");
+				return -1;
+
+			} else if (opt.type != DPAA1_CEETM_ROOT) {
+				fprintf(stderr, "reserve belongs to root qdiscs "
+						"only.\n");
+				return -1;
+			}
+
+			if (reserve_set) {
+				fprintf(stderr, "reserve already specified.\n");
+				return -1;
+			}
+
+			NEXT_ARG();
+			if (get_size(&bp.reserve, *argv)) {
+				fprintf(stderr, "Illegal reserve argument.\n");
+				return -1;
+			}
+
+			reserve_set = true;
+
+		} else if (strcmp(*argv, "cap") == 0) {
+			if (!opt.type) {
+				fprintf(stderr, "Please specify the qdisc type "
+						"before the cap.\n");
+				return -1;
+
+			} else if (opt.type != DPAA1_CEETM_ROOT) {
+				fprintf(stderr, "cap belongs to root qdiscs "
+						"only.\n");
+				return -1;
+			}
+
+			if (cap_set) {
+				fprintf(stderr, "cap already specified.\n");
+				return -1;
+			}
+
+			NEXT_ARG();
+			if (get_size(&bp.cap, *argv)) {
+				fprintf(stderr, "Illegal cap argument.\n");
+				return -1;
+			}
+
+			cap_set = true;
 		} else if (strcmp(*argv, "cr") == 0) {
 			if (!opt.type) {
 				fprintf(stderr, "Please specify the qdisc type "
@@ -299,6 +421,97 @@ int dpaa1_ceetm_parse_qopt(struct qdisc_util *qu, int argc, char **argv,
 
 			qweight_set = true;
 
+		} else if (strcmp(*argv, "group") == 0) {
+			if (!opt.type) {
+				fprintf(stderr, "Please specify the qdisc type "
+						"before the group.\n");
+				return -1;
+
+			} else if (opt.type != DPAA1_CEETM_WBFS) {
+				fprintf(stderr, "group belongs to wbfs qdiscs "
+						"only.\n");
+				return -1;
+			}
+
+			if (change) {
+				fprintf(stderr, "The group of a wbfs qdisc is "
+						"set when adding it.\n");
+				return -1;
+			}
+
+			if (group_set) {
+				fprintf(stderr, "group already specified.\n");
+				return -1;
+			}
+
+			NEXT_ARG();
+			if (strcmp(*argv, "A") == 0) {
+				grp.group = DPAA1_CEETM_GROUP_A;
+			} else if (strcmp(*argv, "B") == 0) {
+				grp.group = DPAA1_CEETM_GROUP_B;
+			} else {
+				fprintf(stderr, "Illegal group argument: must "
+						"be A or B.\n");
+				return -1;
+			}
+
+			group_set = true;
+
+		} else if (strcmp(*argv, "position") == 0) {
+			if (!opt.type) {
+				fprintf(stderr, "Please specify the qdisc type "
+						"before the position.\n");
+				return -1;
+
+			} else if (opt.type != DPAA1_CEETM_WBFS) {
+				fprintf(stderr, "position belongs to wbfs "
+						"qdiscs only.\n");
+				return -1;
+			}
+
+			if (position_set) {
+				fprintf(stderr, "position already "
+						"specified.\n");
+				return -1;
+			}
+
+			NEXT_ARG();
+			if (get_u8(&grp.prio, *argv, 10) ||
+			    grp.prio >= CEETM_MAX_PRIO_QCOUNT) {
+				fprintf(stderr, "Illegal position argument: "
+						"must be between 0 and %d.\n",
+					CEETM_MAX_PRIO_QCOUNT - 1);
+				return -1;
+			}
+
+			position_set = true;
+
+		} else if (strcmp(*argv, "flowhash") == 0) {
+			if (!opt.type) {
+				fprintf(stderr, "Please specify the qdisc type "
+						"before flowhash.\n");
+				return -1;
+
+			} else if (opt.type != DPAA1_CEETM_WBFS) {
+				fprintf(stderr, "flowhash belongs to wbfs "
+						"qdiscs only.\n");
+				return -1;
+			}
+
+			if (hashp) {
+				fprintf(stderr, "flowhash already specified.\n");
+				return -1;
+			}
+
+			NEXT_ARG();
+			if (get_u32(&hash, *argv, 10) || hash > 1) {
+				fprintf(stderr, "Illegal flowhash argument. "
+						"Use 0/1.\n");
+				return -1;
+			}
+
+			hashp = &hash;
+
 		} else if (strcmp(*argv, "help") == 0) {
 			explain();
 			return -1;
@@ -322,33 +535,85 @@ int dpaa1_ceetm_parse_qopt(struct qdisc_util *qu, int argc, char **argv,
 		return -1;
 	}
 
+	if (rate_set &&
+	    dpaa1_ceetm_check_pps(rate_pps, ceil_set, ceil_pps))
+		return -1;
+
+	if (rate_pps && overhead_set) {
+		fprintf(stderr, "overhead does not apply to packet rates.\n");
+		return -1;
+	}
+
+	if (bp.cap && bp.reserve > bp.cap) {
+		fprintf(stderr, "The reserve can not exceed the cap.\n");
+		return -1;
+	}
+
 	if (opt.type == DPAA1_CEETM_PRIO && !opt.qcount) {
 		fprintf(stderr, "qcount is mandatory for a prio qdisc.\n");
 		return -1;
 	}
 
+	if (group_set && grp.group != DPAA1_CEETM_GROUP_A &&
+	    opt.qcount == CEETM_MAX_WBFS_QCOUNT) {
+		fprintf(stderr, "A group of eight class queues is group A.\n");
+		return -1;
+	}
+
+	/* By default a group sits at the priority of its prio class */
+	if (group_set && !position_set) {
+		t = NLMSG_DATA(n);
+		if (TC_H_MIN(t->tcm_parent) < 1 ||
+		    TC_H_MIN(t->tcm_parent) > CEETM_MAX_PRIO_QCOUNT) {
+			fprintf(stderr, "Please specify the position of the "
+					"group.\n");
+			return -1;
+		}
+		grp.prio = TC_H_MIN(t->tcm_parent) - 1;
+	}
+
 	if (opt.type == DPAA1_CEETM_ROOT && rate_set)
 		opt.shaped = 1;
 	else
 		opt.shaped = 0;
 
-	tail = NLMSG_TAIL(n);
-	addattr_l(n, 1024, TCA_OPTIONS, NULL, 0);
-	addattr_l(n, 1024, TCA_CEETM_QOPS, &opt, sizeof(opt));
-	tail->rta_len = (void *) NLMSG_TAIL(n) - (void *) tail;
+	if (reserve_set || cap_set)
+		bpp = &bp;
+	if (rate_pps)
+		pktp = &pkt;
+	if (group_set || position_set)
+		grpp = &grp;
 
-	return 0;
+	if (dpaa1_ceetm_check_qopt(&opt, bpp, pktp, grpp, hashp, change)) {
+		fprintf(stderr, "Invalid qdisc options.\n");
+		return -1;
+	}
+
+	return dpaa1_ceetm_put_qopt(n, 1024, &opt, bpp, pktp, grpp,
+				    hashp) ? -1 : 0;
 }
 
 int dpaa1_ceetm_parse_copt(struct qdisc_util *qu, int argc, char **argv,
 				  struct nlmsghdr *n)
 {
 	struct tc_ceetm_copt opt;
-	struct rtattr *tail;
+	struct tc_ceetm_min_service ms, *msp = NULL;
+	struct tc_ceetm_buf_part bp, *bpp = NULL;
+	__u32 lat, *latp = NULL;
+	__u32 pkt = 1, *pktp = NULL;
 	memset(&opt, 0, sizeof(opt));
+	memset(&ms, 0, sizeof(ms));
+	memset(&bp, 0, sizeof(bp));
+	bool reserve_set = false;
+	bool cap_set = false;
+	bool minrate_set = false;
+	bool maxrun_set = false;
+	bool lat_set = false;
 	bool tbl_set = false;
 	bool rate_set = false;
+	bool rate_pps = false;
 	bool ceil_set = false;
+	bool ceil_pps = false;
 	bool cr_set = false;
 	bool er_set = false;
 
@@ -392,7 +657,7 @@ int dpaa1_ceetm_parse_copt(struct qdisc_util *qu, int argc, char **argv,
 			}
 
 			NEXT_ARG();
-			if (get_rate(&opt.rate, *argv)) {
+			if (dpaa1_ceetm_get_rate(&opt.rate, &rate_pps, *argv)) {
 				fprintf(stderr, "Illegal rate argument.\n");
 				return -1;
 			}
@@ -417,7 +682,7 @@ int dpaa1_ceetm_parse_copt(struct qdisc_util *qu, int argc, char **argv,
 			}
 
 			NEXT_ARG();
-			if (get_rate(&opt.ceil, *argv)) {
+			if (dpaa1_ceetm_get_rate(&opt.ceil, &ceil_pps, *argv)) {
 				fprintf(stderr, "Illegal ceil argument.\n");
 				return -1;
 			}
@@ -449,6 +714,55 @@ int dpaa1_ceetm_parse_copt(struct qdisc_util *qu, int argc, char **argv,
 
 			tbl_set = true;
 
+		} else if (strcmp(*argv, "reserve") == 0) {
+			if (!opt.type) {
+				fprintf(stderr, "Please specify the class type "
+						"before the reserve.\n");
+				return -1;
+
+			} else if (opt.type != DPAA1_CEETM_ROOT) {
+				fprintf(stderr, "reserve belongs to root classes "
+						"only.\n");
+				return -1;
+			}
+
+			if (reserve_set) {
+				fprintf(stderr, "reserve already specified.\n");
+				return -1;
+			}
+
+			NEXT_ARG();
+			if (get_size(&bp.reserve, *argv)) {
+				fprintf(stderr, "Illegal reserve argument.\n");
+				return -1;
+			}
+
+			reserve_set = true;
+
+		} else if (strcmp(*argv, "cap") == 0) {
+			if (!opt.type) {
+				fprintf(stderr, "Please specify the class type "
+						"before the cap.\n");
+				return -1;
+
+			} else if (opt.type != DPAA1_CEETM_ROOT) {
+				fprintf(stderr, "cap belongs to root classes "
+						"only.\n");
+				return -1;
+			}
+
+			if (cap_set) {
+				fprintf(stderr, "cap already specified.\n");
+				return -1;
+			}
+
+			NEXT_ARG();
+			if (get_size(&bp.cap, *argv)) {
+				fprintf(stderr, "Illegal cap argument.\n");
+				return -1;
+			}
+
+			cap_set = true;
 		} else if (strcmp(*argv, "cr") == 0) {
 			if (!opt.type) {
 				fprintf(stderr, "Please specify the class type "
@@ -526,6 +840,82 @@ int dpaa1_ceetm_parse_copt(struct qdisc_util *qu, int argc, char **argv,
 				return -1;
 			}
 
+		} else if (strcmp(*argv, "minrate") == 0) {
+			if (!opt.type) {
+				fprintf(stderr, "Please specify the class type "
+						"before the minrate.\n");
+				return -1;
+
+			} else if (opt.type != DPAA1_CEETM_PRIO) {
+				fprintf(stderr, "minrate belongs to prio "
+						"classes only.\n");
+				return -1;
+			}
+
+			if (minrate_set) {
+				fprintf(stderr, "minrate already specified.\n");
+				return -1;
+			}
+
+			NEXT_ARG();
+			if (get_rate(&ms.rate, *argv)) {
+				fprintf(stderr, "Illegal minrate argument.\n");
+				return -1;
+			}
+
+			minrate_set = true;
+
+		} else if (strcmp(*argv, "maxrun") == 0) {
+			if (!opt.type) {
+				fprintf(stderr, "Please specify the class type "
+						"before the maxrun.\n");
+				return -1;
+
+			} else if (opt.type != DPAA1_CEETM_PRIO) {
+				fprintf(stderr, "maxrun belongs to prio "
+						"classes only.\n");
+				return -1;
+			}
+
+			if (maxrun_set) {
+				fprintf(stderr, "maxrun already specified.\n");
+				return -1;
+			}
+
+			NEXT_ARG();
+			if (get_u32(&ms.maxrun, *argv, 10)) {
+				fprintf(stderr, "Illegal maxrun argument.\n");
+				return -1;
+			}
+
+			maxrun_set = true;
+
+		} else if (strcmp(*argv, "latsample") == 0) {
+			if (!opt.type) {
+				fprintf(stderr, "Please specify the class type "
+						"before the latsample.\n");
+				return -1;
+
+			} else if (opt.type == DPAA1_CEETM_ROOT) {
+				fprintf(stderr, "latsample belongs to prio and "
+						"wbfs classes only.\n");
+				return -1;
+			}
+
+			if (lat_set) {
+				fprintf(stderr, "latsample already "
+						"specified.\n");
+				return -1;
+			}
+
+			NEXT_ARG();
+			if (get_u32(&lat, *argv, 10)) {
+				fprintf(stderr, "Illegal latsample argument.\n");
+				return -1;
+			}
+
+			lat_set = true;
+
 		} else {
 			fprintf(stderr, "Illegal argument.\n");
 			return -1;
@@ -556,6 +946,10 @@ int dpaa1_ceetm_parse_copt(struct qdisc_util *qu, int argc, char **argv,
 		return -1;
 	}
 
+	if (rate_set &&
+	    dpaa1_ceetm_check_pps(rate_pps, ceil_set, ceil_pps))
+		return -1;
+
 	if (opt.type == DPAA1_CEETM_PRIO && !(cr_set && er_set)) {
 		fprintf(stderr, "Both cr and er are mandatory when altering a "
 				"prio class.\n");
@@ -573,17 +967,54 @@ int dpaa1_ceetm_parse_copt(struct qdisc_util *qu, int argc, char **argv,
 		return -1;
 	}
 
+	if (bp.cap && bp.reserve > bp.cap) {
+		fprintf(stderr, "The reserve can not exceed the cap.\n");
+		return -1;
+	}
+
+	if ((minrate_set || maxrun_set) && !opt.cr) {
+		fprintf(stderr, "The minimum service is served from the CR, "
+				"cr must be 1.\n");
+		return -1;
+	}
+
 	if (rate_set)
 		opt.shaped = 1;
 	else
 		opt.shaped = 0;
 
-	tail = NLMSG_TAIL(n);
-	addattr_l(n, 1024, TCA_OPTIONS, NULL, 0);
-	addattr_l(n, 2024, TCA_CEETM_COPT, &opt, sizeof(opt));
-	tail->rta_len = (void *) NLMSG_TAIL(n) - (void *) tail;
+	if (minrate_set || maxrun_set)
+		msp = &ms;
+	if (reserve_set || cap_set)
+		bpp = &bp;
+	if (lat_set)
+		latp = &lat;
+	if (rate_pps)
+		pktp = &pkt;
+
+	if (dpaa1_ceetm_check_copt(&opt, msp, bpp, latp, pktp)) {
+		fprintf(stderr, "Invalid class options.\n");
+		return -1;
+	}
 
-	return 0;
+	return dpaa1_ceetm_put_copt(n, 2024, &opt, msp, bpp, latp, pktp) ?
+	       -1 : 0;
+}
+
+/* Packet mode of the shaper of a LNI or channel */
+static bool dpaa1_ceetm_pkt_mode(struct rtattr **tb)
+{
+	return tb[TCA_CEETM_PKT_MODE] &&
+	       RTA_PAYLOAD(tb[TCA_CEETM_PKT_MODE]) >= sizeof(__u32) &&
+	       rta_getattr_u32(tb[TCA_CEETM_PKT_MODE]);
+}
+
+static void dpaa1_ceetm_print_rate(char *buf, int len, __u32 rate, bool pps)
+{
+	if (pps)
+		ceetm_sprint_pps(buf, len, rate);
+	else
+		print_rate(buf, len, rate);
 }
 
 int dpaa1_ceetm_print_qopt(struct qdisc_util *qu, FILE *f,
@@ -591,7 +1022,10 @@ int dpaa1_ceetm_print_qopt(struct qdisc_util *qu, FILE *f,
 {
 	struct rtattr *tb[TCA_CEETM_MAX + 1];
 	struct tc_ceetm_qopt *qopt = NULL;
+	struct tc_ceetm_wbfs_group *grp;
+	struct tc_ceetm_buf_part *bp;
 	char buf[64];
+	bool pps;
 
 	if (opt == NULL)
 		return 0;
@@ -612,18 +1046,34 @@ int dpaa1_ceetm_print_qopt(struct qdisc_util *qu, FILE *f,
 		fprintf(f, "type root");
 
 		if (qopt->shaped) {
-			print_rate(buf, sizeof(buf), qopt->rate);
+			pps = dpaa1_ceetm_pkt_mode(tb);
+
+			dpaa1_ceetm_print_rate(buf, sizeof(buf), qopt->rate,
+					       pps);
 			fprintf(f, " shaped rate %s ", buf);
 
-			print_rate(buf, sizeof(buf), qopt->ceil);
+			dpaa1_ceetm_print_rate(buf, sizeof(buf), qopt->ceil,
+					       pps);
 			fprintf(f, "ceil %s ", buf);
 
-			fprintf(f, "overhead %u ", qopt->overhead);
+			if (!pps)
+				fprintf(f, "overhead %u ", qopt->overhead);
 
 		} else {
 			fprintf(f, " unshaped");
 		}
 
+		/* The shaped settings end with a space, unshaped does not */
+		if (tb[TCA_CEETM_BUF_PART] &&
+		    RTA_PAYLOAD(tb[TCA_CEETM_BUF_PART]) >= sizeof(*bp)) {
+			bp = RTA_DATA(tb[TCA_CEETM_BUF_PART]);
+			print_size(buf, sizeof(buf), bp->reserve);
+			fprintf(f, "%sreserve %s ", qopt->shaped ? "" : " ",
+				buf);
+			print_size(buf, sizeof(buf), bp->cap);
+			fprintf(f, "cap %s ", bp->cap ? buf : "none");
+		}
+
 	} else if (qopt->type == DPAA1_CEETM_PRIO) {
 		fprintf(f, "type prio %s qcount %u ",
 				qopt->shaped ? "shaped" : "unshaped",
@@ -639,6 +1089,19 @@ int dpaa1_ceetm_print_qopt(struct qdisc_util *qu, FILE *f,
 		}
 
 		fprintf(f, "qcount %u", qopt->qcount);
+
+		if (tb[TCA_CEETM_WBFS_GROUP] &&
+		    RTA_PAYLOAD(tb[TCA_CEETM_WBFS_GROUP]) >= sizeof(*grp)) {
+			grp = RTA_DATA(tb[TCA_CEETM_WBFS_GROUP]);
+			fprintf(f, " group %c position %u",
+				grp->group == DPAA1_CEETM_GROUP_A ? 'A' : 'B',
+				grp->prio);
+		}
+
+		if (tb[TCA_CEETM_FLOW_HASH] &&
+		    RTA_PAYLOAD(tb[TCA_CEETM_FLOW_HASH]) >= sizeof(__u32) &&
+		    rta_getattr_u32(tb[TCA_CEETM_FLOW_HASH]))
+			fprintf(f, " flowhash");
 	}
 
 	return 0;
@@ -649,7 +1112,10 @@ int dpaa1_ceetm_print_copt(struct qdisc_util *qu, FILE *f,
 {
 	struct rtattr *tb[TCA_CEETM_MAX + 1];
 	struct tc_ceetm_copt *copt = NULL;
+	struct tc_ceetm_min_service *ms;
+	struct tc_ceetm_buf_part *bp;
 	char buf[64];
+	bool pps;
 
 	if (opt == NULL)
 		return 0;
@@ -670,16 +1136,31 @@ int dpaa1_ceetm_print_copt(struct qdisc_util *qu, FILE *f,
 		fprintf(f, "type root ");
 
 		if (copt->shaped) {
-			print_rate(buf, sizeof(buf), copt->rate);
+			pps = dpaa1_ceetm_pkt_mode(tb);
+
+			dpaa1_ceetm_print_rate(buf, sizeof(buf), copt->rate,
+					       pps);
 			fprintf(f, "shaped rate %s ", buf);
 
-			print_rate(buf, sizeof(buf), copt->ceil);
+			dpaa1_ceetm_print_rate(buf, sizeof(buf), copt->ceil,
+					       pps);
 			fprintf(f, "ceil %s ", buf);
 
 		} else {
 			fprintf(f, "unshaped tbl %d", copt->tbl);
 		}
 
+		/* The shaped settings end with a space, unshaped does not */
+		if (tb[TCA_CEETM_BUF_PART] &&
+		    RTA_PAYLOAD(tb[TCA_CEETM_BUF_PART]) >= sizeof(*bp)) {
+			bp = RTA_DATA(tb[TCA_CEETM_BUF_PART]);
+			print_size(buf, sizeof(buf), bp->reserve);
+			fprintf(f, "%sreserve %s ", copt->shaped ? "" : " ",
+				buf);
+			print_size(buf, sizeof(buf), bp->cap);
+			fprintf(f, "cap %s ", bp->cap ? buf : "none");
+		}
+
 	} else if (copt->type == DPAA1_CEETM_PRIO) {
 		fprintf(f, "type prio ");
 
@@ -689,27 +1170,193 @@ int dpaa1_ceetm_print_copt(struct qdisc_util *qu, FILE *f,
 			fprintf(f, "unshaped");
 		}
 
+		if (tb[TCA_CEETM_MIN_SERVICE] &&
+		    RTA_PAYLOAD(tb[TCA_CEETM_MIN_SERVICE]) >= sizeof(*ms)) {
+			ms = RTA_DATA(tb[TCA_CEETM_MIN_SERVICE]);
+			print_rate(buf, sizeof(buf), ms->rate);
+			fprintf(f, " minrate %s maxrun %u", buf, ms->maxrun);
+		}
+
 	} else if (copt->type == DPAA1_CEETM_WBFS) {
 		fprintf(f, "type wbfs qweight %d", copt->weight);
 	}
 
+	if (tb[TCA_CEETM_LAT_SAMPLE] &&
+	    RTA_PAYLOAD(tb[TCA_CEETM_LAT_SAMPLE]) >= sizeof(__u32))
+		fprintf(f, " latsample %u",
+			rta_getattr_u32(tb[TCA_CEETM_LAT_SAMPLE]));
+
 	return 0;
 }
 
+/* One line per TX frame queue feeding a class queue */
+static void dpaa1_ceetm_print_txq(FILE *f, struct rtattr *xstats)
+{
+	struct tc_ceetm_txq_xstats txq[CEETM_MAX_TXQ_XSTATS];
+	int i, count;
+
+	count = dpaa1_ceetm_get_txq_xstats(xstats, txq, CEETM_MAX_TXQ_XSTATS);
+	for (i = 0; i < count && i < CEETM_MAX_TXQ_XSTATS; i++)
+		fprintf(f, "txq %d enq frames %llu deq frames %llu "
+			   "rej frames %llu\n", i, txq[i].enq_frames,
+			txq[i].deq_frames, txq[i].rej_frames);
+
+	if (count > CEETM_MAX_TXQ_XSTATS)
+		fprintf(f, "txq %d more not shown\n",
+			count - CEETM_MAX_TXQ_XSTATS);
+}
+
+/* Sojourn time of the sampled frames of a class queue, the buckets with
+ * details
+ */
+static void dpaa1_ceetm_print_lat(FILE *f, const struct tc_ceetm_xstats *st)
+{
+	int i;
+
+	fprintf(f, "latency samples %llu p50 %llu us p99 %llu us "
+		   "p999 %llu us max %llu us\n", st->lat_samples,
+		ceetm_lat_percentile(st->lat_hist, st->lat_max_ns, 0.5) / 1000,
+		ceetm_lat_percentile(st->lat_hist, st->lat_max_ns, 0.99) / 1000,
+		ceetm_lat_percentile(st->lat_hist, st->lat_max_ns, 0.999) / 1000,
+		st->lat_max_ns / 1000);
+
+	if (!show_details)
+		return;
+
+	for (i = 0; i < CEETM_LAT_BUCKETS - 1; i++)
+		if (st->lat_hist[i])
+			fprintf(f, "latency below %u us %llu\n", 1U << i,
+				st->lat_hist[i]);
+	if (st->lat_hist[i])
+		fprintf(f, "latency above %u us %llu\n", 1U << (i - 1),
+			st->lat_hist[i]);
+}
+
+/* Flows and frames hashed to each class queue of a flow-hashed wbfs qdisc,
+ * with the share of the frames of the group
+ */
+static void dpaa1_ceetm_print_hash(FILE *f, const struct tc_ceetm_xstats *st)
+{
+	__u64 total = 0;
+	int i;
+
+	for (i = 0; i < CEETM_MAX_WBFS_QCOUNT; i++)
+		total += st->hash_frames[i];
+	if (!total)
+		return;
+
+	for (i = 0; i < CEETM_MAX_WBFS_QCOUNT; i++)
+		if (st->hash_flows[i] || st->hash_frames[i])
+			fprintf(f, "flowhash class %d flows %u frames %llu "
+				   "(%.1f%%)\n", i + 1, st->hash_flows[i],
+				st->hash_frames[i],
+				100.0 * st->hash_frames[i] / total);
+}
+
 int dpaa1_ceetm_print_xstats(struct qdisc_util *qu, FILE *f,
 				    struct rtattr *xstats)
 {
-	struct tc_ceetm_xstats *st;
+	struct tc_ceetm_xstats st;
 
 	if (xstats == NULL)
 		return 0;
 
-	if (RTA_PAYLOAD(xstats) < sizeof(*st))
+	if (dpaa1_ceetm_get_xstats(xstats, &st))
 		return -1;
 
-	st = RTA_DATA(xstats);
 	fprintf(f, "ern drops %u congested %u frames %llu bytes %llu\n",
-			st->ern_drop_count, st->cgr_congested_count,
-			st->frame_count, st->byte_count);
+			st.ern_drop_count, st.cgr_congested_count,
+			st.frame_count, st.byte_count);
+
+	/* Only the LNI and channel shapers report a state */
+	if (CEETM_XSTATS_HAS(xstats, struct tc_ceetm_xstats,
+			     shaper_blocked_ns) &&
+	    (st.cr_tokens || st.er_tokens || st.shaper_blocked_ns))
+		fprintf(f, "shaper cr tokens %lld er tokens %lld "
+			   "blocked %llu us\n",
+			st.cr_tokens, st.er_tokens,
+			st.shaper_blocked_ns / 1000);
+
+	/* Only the LNIs and channels hold a share of the buffer pool */
+	if (CEETM_XSTATS_HAS(xstats, struct tc_ceetm_xstats, buf_cap_drops) &&
+	    (st.buf_bytes || st.buf_peak_bytes || st.buf_cap_drops))
+		fprintf(f, "buffer %llu bytes peak %llu bytes cap drops %llu\n",
+			st.buf_bytes, st.buf_peak_bytes, st.buf_cap_drops);
+
+	/* Only the sampled class queues have a histogram */
+	if (st.lat_samples)
+		dpaa1_ceetm_print_lat(f, &st);
+
+	/* Only the flow-hashed wbfs qdiscs spread their frames */
+	dpaa1_ceetm_print_hash(f, &st);
+
+	if (show_details)
+		dpaa1_ceetm_print_txq(f, xstats);
 	return 0;
 }
+
+/* Write the options of a qdisc / class in the syntax of the parsers, with
+ * exact rates, so that they can be fed back to them.
+ */
+int dpaa1_ceetm_sprint_qopt(char *buf, int len,
+			    const struct tc_ceetm_qopt *qopt, bool pps)
+{
+	int n, i;
+
+	switch (qopt->type) {
+	case DPAA1_CEETM_ROOT:
+		if (!qopt->shaped)
+			return snprintf(buf, len, "type root");
+
+		if (pps)
+			return snprintf(buf, len, "type root rate %upps "
+					"ceil %upps", qopt->rate, qopt->ceil);
+
+		return snprintf(buf, len, "type root rate %ubps ceil %ubps "
+				"overhead %u", qopt->rate, qopt->ceil,
+				qopt->overhead);
+
+	case DPAA1_CEETM_PRIO:
+		return snprintf(buf, len, "type prio qcount %u", qopt->qcount);
+
+	case DPAA1_CEETM_WBFS:
+		n = snprintf(buf, len, "type wbfs qcount %u qweight",
+			     qopt->qcount);
+		for (i = 0; i < qopt->qcount && i < CEETM_MAX_WBFS_QCOUNT &&
+		     n < len; i++)
+			n += snprintf(buf + n, len - n, " %u", qopt->qweight[i]);
+
+		if (n < len && (qopt->cr || qopt->er))
+			n += snprintf(buf + n, len - n, " cr %u er %u",
+				      qopt->cr, qopt->er);
+		return n;
+	}
+
+	return -1;
+}
+
+int dpaa1_ceetm_sprint_copt(char *buf, int len,
+			    const struct tc_ceetm_copt *copt, bool pps)
+{
+	switch (copt->type) {
+	case DPAA1_CEETM_ROOT:
+		if (!copt->shaped)
+			return snprintf(buf, len, "type root tbl %u", copt->tbl);
+
+		if (pps)
+			return snprintf(buf, len, "type root rate %upps "
+					"ceil %upps", copt->rate, copt->ceil);
+
+		return snprintf(buf, len, "type root rate %ubps ceil %ubps",
+				copt->rate, copt->ceil);
+
+	case DPAA1_CEETM_PRIO:
+		return snprintf(buf, len, "type prio cr %u er %u", copt->cr,
+				copt->er);
+
+	case DPAA1_CEETM_WBFS:
+		return snprintf(buf, len, "type wbfs qweight %u", copt->weight);
+	}
+
+	return -1;
+}
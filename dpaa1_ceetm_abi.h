@@ -0,0 +1,167 @@
+/* Copyright 2014-2016 Freescale Semiconductor Inc.
+ * Copyright 2017-2018 NXP
+ *
+ * SPDX-License-Identifier: GPL-2.0
+ */
+
+#ifndef __DPAA1_CEETM_ABI_H
+#define __DPAA1_CEETM_ABI_H
+
+#include <linux/types.h>
+
+/* Configuration and statistics exchanged with the DPAA1 CEETM qdisc, shared
+ * by the tc plugin and libceetm.
+ */
+
+/* Maximum number of CEETM CQs that can be linked to a channel (prio qdisc) */
+#define CEETM_MAX_PRIO_QCOUNT	8
+#define CEETM_MAX_WBFS_QCOUNT	8
+#define CEETM_MIN_WBFS_QCOUNT	4
+#define CEETM_MAX_WBFS_VALUE	248
+/* Buckets of the sojourn time histogram of a class queue */
+#define CEETM_LAT_BUCKETS	24
+
+enum {
+	TCA_CEETM_UNSPEC,
+	TCA_CEETM_COPT,
+	TCA_CEETM_QOPS,
+	TCA_CEETM_MIN_SERVICE,
+	TCA_CEETM_BUF_PART,
+	/* u32, one frame in N of a prio or wbfs class is timestamped at
+	 * enqueue and dequeue, 0 to stop sampling
+	 */
+	TCA_CEETM_LAT_SAMPLE,
+	/* u32, 1 if the shaper of a LNI (root qdisc) or channel (root class)
+	 * counts frames: rate and ceil are then in packets per second. Absent
+	 * for byte shaping, a change without it counts bytes again.
+	 */
+	TCA_CEETM_PKT_MODE,
+	/* struct tc_ceetm_wbfs_group, class group of a wbfs qdisc */
+	TCA_CEETM_WBFS_GROUP,
+	/* u32, 1 if a wbfs qdisc spreads the flows by 5-tuple hash over its
+	 * class queues, served at equal weight whatever their qweight. Absent
+	 * on a change, the current setting is kept.
+	 */
+	TCA_CEETM_FLOW_HASH,
+	__TCA_CEETM_MAX,
+};
+
+#define TCA_CEETM_MAX (__TCA_CEETM_MAX - 1)
+
+/* CEETM configuration types */
+enum {
+	DPAA1_CEETM_ROOT = 1,
+	DPAA1_CEETM_PRIO,
+	DPAA1_CEETM_WBFS
+};
+
+/* CEETM Qdisc configuration parameters */
+struct tc_ceetm_qopt {
+	__u32 type;
+	__u16 shaped;
+	__u16 qcount;
+	__u16 overhead;
+	__u32 rate;
+	__u32 ceil;
+	__u16 cr;
+	__u16 er;
+	__u8 qweight[CEETM_MAX_WBFS_QCOUNT];
+};
+
+/* CEETM Class configuration parameters */
+struct tc_ceetm_copt {
+	__u32 type;
+	__u16 shaped;
+	__u32 rate;
+	__u32 ceil;
+	__u16 tbl;
+	__u16 cr;
+	__u16 er;
+	__u8 weight;
+};
+
+/* Minimum service of a prio class, so a flood on a higher priority class
+ * queue does not starve it. There are no per-CQ shapers on DPAA1: the
+ * class queue is kept CR eligible and served from the channel's CR tokens
+ * up to the guaranteed rate, ahead of the ER-only higher priorities.
+ */
+struct tc_ceetm_min_service {
+	__u32 rate; /* guaranteed bytes per second, 0 for none */
+	__u32 maxrun; /* frames served in a row while lower CQs wait, 0 for no limit */
+};
+
+/* Share of the FMan buffer pool held by a LNI (root qdisc) or channel
+ * (root class), so a congested port cannot take the buffers of the others.
+ * Without the attribute the current partition is left as is, on creation
+ * the pool is shared with no reservation and no cap.
+ */
+struct tc_ceetm_buf_part {
+	__u32 reserve; /* bytes set aside for this LNI / channel only */
+	__u32 cap; /* most bytes queued at once, 0 for no cap */
+};
+
+/* Class groups of a channel: its eight grouped class queues form either
+ * one group of eight or the two groups A and B of four, each hosting a
+ * wbfs qdisc with its own cr / er eligibility.
+ */
+enum {
+	DPAA1_CEETM_GROUP_A,
+	DPAA1_CEETM_GROUP_B,
+};
+
+/* Class group of a wbfs qdisc and its place among the eight independent
+ * class queues of the channel. Without the attribute a wbfs qdisc takes
+ * group A, at the priority of the prio class it is grafted on. A change
+ * only applies prio: the group is kept.
+ */
+struct tc_ceetm_wbfs_group {
+	__u8 group; /* DPAA1_CEETM_GROUP_A or B, A for a group of eight */
+	__u8 prio; /* served right after independent CQ prio, 0 to 7 */
+};
+
+/* CEETM stats */
+struct tc_ceetm_xstats {
+	__u32 ern_drop_count;
+	__u32 cgr_congested_count;
+	__u64 frame_count;
+	__u64 byte_count;
+	/* Dual-rate shaper of a shaped LNI (root qdisc) or channel (root
+	 * class), appended: older kernels stop above. Bucket levels in bytes,
+	 * negative while in debt.
+	 */
+	__s64 cr_tokens;
+	__s64 er_tokens;
+	__u64 shaper_blocked_ns; /* time with frames held by the shaper */
+	/* Buffer pool occupancy of a LNI or channel, appended */
+	__u64 buf_bytes; /* queued now */
+	__u64 buf_peak_bytes; /* high watermark since the last read */
+	__u64 buf_cap_drops; /* frames rejected at the cap */
+	/* Per transmit queue breakdown of a class queue, appended: txq_count
+	 * struct tc_ceetm_txq_xstats end the payload, one per TX frame queue
+	 * (CPU) feeding the class, 0 if not reported. The fields appended
+	 * below sit between txq_pad and the entries, when the kernel has them.
+	 */
+	__u32 txq_count;
+	__u32 txq_pad;
+	/* Sojourn time of the sampled frames of a class queue, appended.
+	 * Bucket 0 counts the samples under 1 us, bucket i those from
+	 * 2^(i-1) up to 2^i us, the last one all the longer ones.
+	 */
+	__u64 lat_samples;
+	__u64 lat_max_ns;
+	__u64 lat_hist[CEETM_LAT_BUCKETS];
+	/* Spreading of a flow-hashed wbfs qdisc over its class queues,
+	 * appended: the flows seen active in the last second and the frames
+	 * hashed to each of them.
+	 */
+	__u32 hash_flows[CEETM_MAX_WBFS_QCOUNT];
+	__u64 hash_frames[CEETM_MAX_WBFS_QCOUNT];
+};
+
+struct tc_ceetm_txq_xstats {
+	__u64 enq_frames;
+	__u64 deq_frames;
+	__u64 rej_frames;
+};
+
+#endif
@@ -15,13 +15,25 @@
 static void explain(void)
 {
 	fprintf(stderr, "Usage:\n"
-		"... qdisc add ... ceetm type root\n"
+		"... qdisc add ... ceetm type root [reserve B] [cap B]\n"
 		"... class add ... ceetm type root [cir CIR] [eir EIR] [cbs CBS] [ebs EBS] [coupled C]\n"
+		"	[reserve B] [cap B]\n"
 		"... qdisc add ... ceetm type prio [prioA PRIO] [prioB PRIO] [separate SEPARATE]\n"
-		"... class add ... ceetm type prio [mode MODE] [weight W]\n"
+		"	[flowhashA H] [flowhashB H]\n"
+		"... class add ... ceetm type prio [mode MODE] [weight W] "
+		"[minrate M] [maxrun N] [latsample S]\n"
 		"\n"
 		"Update configurations:\n"
+		"... qdisc change ... ceetm type root [reserve B] [cap B]\n"
 		"... class change ... ceetm type root [cir CIR] [eir EIR] [cbs CBS] [ebs EBS] [coupled C]\n"
+		"	[reserve B] [cap B]\n"
+		"... class change ... ceetm type root unshaped [reserve B] [cap B]\n"
+		"... qdisc change ... ceetm type prio [prioA PRIO] [prioB PRIO] [separate SEPARATE]\n"
+		"	[flowhashA H] [flowhashB H]\n"
+		"... class change ... ceetm type prio [mode MODE] [weight W] "
+		"[minrate M] [maxrun N] [latsample S]\n"
+		"Only the options given on a change are applied, the others are\n"
+		"left untouched; unshaped turns the shaping of the channel off.\n"
 		"\n"
 		"Qdisc types:\n"
 		"root - associate a LNI to the DPNI\n"
@@ -36,20 +48,39 @@ static void explain(void)
 		"	dual-rate shaper (required for shaping scenarios)\n"
 		"EIR - the excess information rate of the LNI channel\n"
 		"	dual-rate shaper (optional for shaping scenarios, default 0)\n"
+		"CIR and EIR are byte rates, or both packet rates such as 2Mpps\n"
+		"	to shape the frames whatever their size where the SoC\n"
+		"	supports it; a change switches the unit only when it\n"
+		"	gives both, one rate alone must be in the current unit\n"
 		"CBS - the committed burst size of the LNI channel\n"
-		"	dual-rate shaper (required for shaping scenarios)\n"
+		"	dual-rate shaper (required for shaping scenarios), in\n"
+		"	frames with packet rates\n"
 		"EBS - the excess of the LNI channel\n"
 		"	dual-rate shaper (optional for shaping scenarios, default 0)\n"
 		"C - shaper coupled, if both CIR and EIR are finite, once the\n"
 		"	CR token bucket is full, additional CR tokens are instead\n"
 		"	added to the ER token bucket\n"
+		"B - bytes of the QBMan buffer pool: the reserve is set aside\n"
+		"	for the LNI or channel so congestion on other DPNIs cannot\n"
+		"	take it, the cap is the most it may hold before frames are\n"
+		"	rejected (default 0, i.e. no reserve and no cap)\n"
 		"PRIO - priority of the weighted group A / B of queues\n"
 		"SEPARATE - groups A and B are separate\n"
+		"H - 1 to spread the flows over the class queues of weighted\n"
+		"	group A / B by hash of their 5-tuple, the class queues\n"
+		"	are then served at equal weight whatever their weight\n"
+		"	(default 0)\n"
 		"MODE - scheduling mode of class queue, can be:\n"
 		"	STRICT_PRIORITY\n"
 		"	WEIGHTED_A\n"
 		"	WEIGHTED_B\n"
 		"W - the weight of the class queue in the weighted group\n"
+		"M - minimum rate guaranteed to the class queue even when\n"
+		"	higher priorities are flooded\n"
+		"N - most frames the class queue is served in a row while\n"
+		"	lower priorities wait (0 for no limit)\n"
+		"S - one frame in S of the class queue has its queueing delay\n"
+		"	sampled into the latency histogram (0 to stop sampling)\n"
 		);
 }
 
@@ -57,11 +88,20 @@ int dpaa2_ceetm_parse_qopt(struct qdisc_util *qu, int argc, char **argv,
 		struct nlmsghdr *n)
 {
 	struct dpaa2_ceetm_tc_qopt opt;
+	struct dpaa2_ceetm_tc_buf_part bp, *bpp = NULL;
+	bool reserve_set = false;
+	bool cap_set = false;
 	bool prioA_set = false;
 	bool prioB_set = false;
 	bool separate_set = false;
-	struct rtattr *tail;
+	bool hashA_set = false;
+	bool hashB_set = false;
+	bool change = !(n->nlmsg_flags & NLM_F_CREATE);
+	__u32 hash = 0, *hashp = NULL;
+	__u32 mask = 0;
+	__u8 val;
 	memset(&opt, 0, sizeof(opt));
+	memset(&bp, 0, sizeof(bp));
 
 	while (argc > 0) {
 		if (strcmp(*argv, "type") == 0) {
@@ -156,6 +196,93 @@ int dpaa2_ceetm_parse_qopt(struct qdisc_util *qu, int argc, char **argv,
 
 			separate_set = true;
 
+		} else if (strcmp(*argv, "flowhashA") == 0 ||
+			   strcmp(*argv, "flowhashB") == 0) {
+			bool is_A = strcmp(*argv, "flowhashA") == 0;
+
+			if (!opt.type) {
+				fprintf(stderr, "Please specify the qdisc type "
+						"before %s.\n", *argv);
+				return -1;
+
+			} else if (opt.type != DPAA2_CEETM_PRIO) {
+				fprintf(stderr, "%s belongs to prio qdiscs "
+						"only.\n", *argv);
+				return -1;
+			}
+
+			if (is_A ? hashA_set : hashB_set) {
+				fprintf(stderr, "%s already specified.\n",
+					*argv);
+				return -1;
+			}
+
+			NEXT_ARG();
+			if (get_u8(&val, *argv, 10) || val > 1) {
+				fprintf(stderr, "Illegal flowhash argument. "
+						"Use 0/1.\n");
+				return -1;
+			}
+
+			if (is_A) {
+				hashA_set = true;
+				if (val)
+					hash |= DPAA2_CEETM_FLOW_HASH_A;
+			} else {
+				hashB_set = true;
+				if (val)
+					hash |= DPAA2_CEETM_FLOW_HASH_B;
+			}
+
+		} else if (strcmp(*argv, "reserve") == 0) {
+			if (!opt.type) {
+				fprintf(stderr, "Please specify the qdisc type "
+						"before the reserve.\n");
+				return -1;
+
+			} else if (opt.type != DPAA2_CEETM_ROOT) {
+				fprintf(stderr, "reserve belongs to root qdiscs "
+						"only.\n");
+				return -1;
+			}
+
+			if (reserve_set) {
+				fprintf(stderr, "reserve already specified.\n");
+				return -1;
+			}
+
+			NEXT_ARG();
+			if (get_size(&bp.reserve, *argv)) {
+				fprintf(stderr, "Illegal reserve argument.\n");
+				return -1;
+			}
+
+			reserve_set = true;
+
+		} else if (strcmp(*argv, "cap") == 0) {
+			if (!opt.type) {
+				fprintf(stderr, "Please specify the qdisc type "
+						"before the cap.\n");
+				return -1;
+
+			} else if (opt.type != DPAA2_CEETM_ROOT) {
+				fprintf(stderr, "cap belongs to root qdiscs "
+						"only.\n");
+				return -1;
+			}
+
+			if (cap_set) {
+				fprintf(stderr, "cap already specified.\n");
+				return -1;
+			}
+
+			NEXT_ARG();
+			if (get_size(&bp.cap, *argv)) {
+				fprintf(stderr, "Illegal cap argument.\n");
+				return -1;
+			}
+
+			cap_set = true;
 		} else if (strcmp(*argv, "help") == 0) {
 			explain();
 			return -1;
@@ -174,27 +301,88 @@ int dpaa2_ceetm_parse_qopt(struct qdisc_util *qu, int argc, char **argv,
 		return -1;
 	}
 
-	tail = NLMSG_TAIL(n);
-	addattr_l(n, 1024, TCA_OPTIONS, NULL, 0);
-	addattr_l(n, 1024, DPAA2_CEETM_TCA_QOPS, &opt, sizeof(opt));
-	tail->rta_len = (void *) NLMSG_TAIL(n) - (void *) tail;
+	if (prioA_set)
+		mask |= DPAA2_CEETM_CHG_PRIO_A;
+	if (prioB_set)
+		mask |= DPAA2_CEETM_CHG_PRIO_B;
+	if (separate_set)
+		mask |= DPAA2_CEETM_CHG_SEPARATE;
+	if (hashA_set)
+		mask |= DPAA2_CEETM_CHG_FLOW_HASH_A;
+	if (hashB_set)
+		mask |= DPAA2_CEETM_CHG_FLOW_HASH_B;
+	if (reserve_set)
+		mask |= DPAA2_CEETM_CHG_BUF_RESERVE;
+	if (cap_set)
+		mask |= DPAA2_CEETM_CHG_BUF_CAP;
+
+	if (change && opt.type == DPAA2_CEETM_PRIO && !mask) {
+		fprintf(stderr, "Please specify at least one of prioA, prioB, "
+				"separate, flowhashA or flowhashB when "
+				"changing a prio qdisc.\n");
+		return -1;
+	}
 
-	return 0;
+	if (change && opt.type == DPAA2_CEETM_ROOT && !mask) {
+		fprintf(stderr, "Please specify the reserve and / or the cap "
+				"when changing a root qdisc.\n");
+		return -1;
+	}
+
+	if (reserve_set && cap_set && bp.cap && bp.reserve > bp.cap) {
+		fprintf(stderr, "The reserve can not exceed the cap.\n");
+		return -1;
+	}
+
+	if (reserve_set || cap_set)
+		bpp = &bp;
+	if (hashA_set || hashB_set)
+		hashp = &hash;
+
+	if (dpaa2_ceetm_check_qopt(&opt, bpp, hashp, change ? mask : 0)) {
+		fprintf(stderr, "Invalid qdisc options.\n");
+		return -1;
+	}
+
+	return dpaa2_ceetm_put_qopt(n, 1024, &opt, bpp, hashp, mask) ? -1 : 0;
+}
+
+/* A byte rate, or a packet rate when given in pps */
+static int dpaa2_ceetm_get_rate(__u64 *rate, bool *pps, const char *str)
+{
+	*pps = !ceetm_get_pps(rate, str);
+
+	return *pps ? 0 : get_rate64(rate, str);
 }
 
 int dpaa2_ceetm_parse_copt(struct qdisc_util *qu, int argc, char **argv,
 		struct nlmsghdr *n)
 {
 	struct dpaa2_ceetm_tc_copt opt;
-	struct rtattr *tail;
+	struct dpaa2_ceetm_tc_min_service ms, *msp = NULL;
+	struct dpaa2_ceetm_tc_buf_part bp, *bpp = NULL;
+	__u32 lat, *latp = NULL;
+	__u32 pkt, *pktp = NULL;
 	memset(&opt, 0, sizeof(opt));
+	memset(&ms, 0, sizeof(ms));
+	memset(&bp, 0, sizeof(bp));
+	bool reserve_set = false;
+	bool cap_set = false;
+	bool minrate_set = false;
+	bool maxrun_set = false;
+	bool lat_set = false;
 	bool cir_set = false;
+	bool cir_pps = false;
 	bool eir_set = false;
+	bool eir_pps = false;
 	bool cbs_set = false;
 	bool ebs_set = false;
 	bool coupled_set = false;
+	bool unshaped = false;
 	bool mode_set = false;
 	bool weight_set = false;
+	bool change = !(n->nlmsg_flags & NLM_F_CREATE);
+	__u32 mask = 0;
 
 	while (argc > 0) {
 		if (strcmp(*argv, "type") == 0) {
@@ -233,7 +421,8 @@ int dpaa2_ceetm_parse_copt(struct qdisc_util *qu, int argc, char **argv,
 			}
 
 			NEXT_ARG();
-			if (get_rate64(&opt.shaping_cfg.cir, *argv)) {
+			if (dpaa2_ceetm_get_rate(&opt.shaping_cfg.cir, &cir_pps,
+						 *argv)) {
 				fprintf(stderr, "Illegal CIR argument.\n");
 				return -1;
 			}
@@ -257,7 +446,8 @@ int dpaa2_ceetm_parse_copt(struct qdisc_util *qu, int argc, char **argv,
 			}
 
 			NEXT_ARG();
-			if (get_rate64(&opt.shaping_cfg.eir, *argv)) {
+			if (dpaa2_ceetm_get_rate(&opt.shaping_cfg.eir, &eir_pps,
+						 *argv)) {
 				fprintf(stderr, "Illegal EIR argument.\n");
 				return -1;
 			}
@@ -338,6 +528,82 @@ int dpaa2_ceetm_parse_copt(struct qdisc_util *qu, int argc, char **argv,
 
 			coupled_set = true;
 
+		} else if (strcmp(*argv, "unshaped") == 0) {
+			if (!opt.type) {
+				fprintf(stderr, "Please specify the class type "
+						"before unshaped.\n");
+				return -1;
+
+			} else if (opt.type != DPAA2_CEETM_ROOT) {
+				fprintf(stderr, "unshaped belongs to root classes "
+						"only.\n");
+				return -1;
+			}
+
+			if (!change) {
+				fprintf(stderr, "unshaped belongs to class "
+						"changes only, a root class is "
+						"added unshaped without a "
+						"CIR / EIR.\n");
+				return -1;
+			}
+
+			if (unshaped) {
+				fprintf(stderr, "unshaped already specified.\n");
+				return -1;
+			}
+
+			unshaped = true;
+
+		} else if (strcmp(*argv, "reserve") == 0) {
+			if (!opt.type) {
+				fprintf(stderr, "Please specify the class type "
+						"before the reserve.\n");
+				return -1;
+
+			} else if (opt.type != DPAA2_CEETM_ROOT) {
+				fprintf(stderr, "reserve belongs to root classes "
+						"only.\n");
+				return -1;
+			}
+
+			if (reserve_set) {
+				fprintf(stderr, "reserve already specified.\n");
+				return -1;
+			}
+
+			NEXT_ARG();
+			if (get_size(&bp.reserve, *argv)) {
+				fprintf(stderr, "Illegal reserve argument.\n");
+				return -1;
+			}
+
+			reserve_set = true;
+
+		} else if (strcmp(*argv, "cap") == 0) {
+			if (!opt.type) {
+				fprintf(stderr, "Please specify the class type "
+						"before the cap.\n");
+				return -1;
+
+			} else if (opt.type != DPAA2_CEETM_ROOT) {
+				fprintf(stderr, "cap belongs to root classes "
+						"only.\n");
+				return -1;
+			}
+
+			if (cap_set) {
+				fprintf(stderr, "cap already specified.\n");
+				return -1;
+			}
+
+			NEXT_ARG();
+			if (get_size(&bp.cap, *argv)) {
+				fprintf(stderr, "Illegal cap argument.\n");
+				return -1;
+			}
+
+			cap_set = true;
 		} else if (strcmp(*argv, "mode") == 0) {
 			if (!opt.type) {
 				fprintf(stderr, "Please specify the class type "
@@ -392,15 +658,94 @@ int dpaa2_ceetm_parse_copt(struct qdisc_util *qu, int argc, char **argv,
 
 			NEXT_ARG();
 			if (get_u16(&opt.weight, *argv, 10) ||
-				opt.weight == 0) {
+				opt.weight < DPAA2_CEETM_MIN_WEIGHT ||
+				opt.weight > DPAA2_CEETM_MAX_WEIGHT) {
 				fprintf(stderr, "Illegal weight "
 						"argument: must be "
-						"between 100 and 24800.\n");
+						"between %d and %d.\n",
+						DPAA2_CEETM_MIN_WEIGHT,
+						DPAA2_CEETM_MAX_WEIGHT);
 				return -1;
 			}
 
 			weight_set = true;
 
+		} else if (strcmp(*argv, "minrate") == 0) {
+			if (!opt.type) {
+				fprintf(stderr, "Please specify the class type "
+						"before the minrate.\n");
+				return -1;
+
+			} else if (opt.type != DPAA2_CEETM_PRIO) {
+				fprintf(stderr, "minrate belongs to prio "
+						"classes only.\n");
+				return -1;
+			}
+
+			if (minrate_set) {
+				fprintf(stderr, "minrate already specified.\n");
+				return -1;
+			}
+
+			NEXT_ARG();
+			if (get_rate64(&ms.rate, *argv)) {
+				fprintf(stderr, "Illegal minrate argument.\n");
+				return -1;
+			}
+
+			minrate_set = true;
+
+		} else if (strcmp(*argv, "maxrun") == 0) {
+			if (!opt.type) {
+				fprintf(stderr, "Please specify the class type "
+						"before the maxrun.\n");
+				return -1;
+
+			} else if (opt.type != DPAA2_CEETM_PRIO) {
+				fprintf(stderr, "maxrun belongs to prio "
+						"classes only.\n");
+				return -1;
+			}
+
+			if (maxrun_set) {
+				fprintf(stderr, "maxrun already specified.\n");
+				return -1;
+			}
+
+			NEXT_ARG();
+			if (get_u32(&ms.maxrun, *argv, 10)) {
+				fprintf(stderr, "Illegal maxrun argument.\n");
+				return -1;
+			}
+
+			maxrun_set = true;
+
+		} else if (strcmp(*argv, "latsample") == 0) {
+			if (!opt.type) {
+				fprintf(stderr, "Please specify the class type "
+						"before the latsample.\n");
+				return -1;
+
+			} else if (opt.type != DPAA2_CEETM_PRIO) {
+				fprintf(stderr, "latsample belongs to prio "
+						"classes only.\n");
+				return -1;
+			}
+
+			if (lat_set) {
+				fprintf(stderr, "latsample already "
+						"specified.\n");
+				return -1;
+			}
+
+			NEXT_ARG();
+			if (get_u32(&lat, *argv, 10)) {
+				fprintf(stderr, "Illegal latsample argument.\n");
+				return -1;
+			}
+
+			lat_set = true;
+
 		} else {
 			fprintf(stderr, "Illegal argument - %s.\n", *argv);
 			return -1;
@@ -420,23 +765,103 @@ int dpaa2_ceetm_parse_copt(struct qdisc_util *qu, int argc, char **argv,
 		return -1;
 	}
 
+	if (unshaped && (cir_set || eir_set || cbs_set || ebs_set ||
+			 coupled_set)) {
+		fprintf(stderr, "unshaped can not be given with the "
+				"shaper options.\n");
+		return -1;
+	}
+
+	if (cir_set && eir_set && cir_pps != eir_pps) {
+		fprintf(stderr, "CIR and EIR must both be byte rates or both "
+				"packet rates.\n");
+		return -1;
+	}
+
 	if (cir_set || eir_set)
 		opt.shaped = 1;
 	else
 		opt.shaped = 0;
 
-	tail = NLMSG_TAIL(n);
-	addattr_l(n, 1024, TCA_OPTIONS, NULL, 0);
-	addattr_l(n, 2024, DPAA2_CEETM_TCA_COPT, &opt, sizeof(opt));
-	tail->rta_len = (void *) NLMSG_TAIL(n) - (void *) tail;
+	if (cir_set)
+		mask |= DPAA2_CEETM_CHG_CIR;
+	if (eir_set)
+		mask |= DPAA2_CEETM_CHG_EIR;
+	if (cbs_set)
+		mask |= DPAA2_CEETM_CHG_CBS;
+	if (ebs_set)
+		mask |= DPAA2_CEETM_CHG_EBS;
+	if (coupled_set)
+		mask |= DPAA2_CEETM_CHG_COUPLED;
+	if (mode_set)
+		mask |= DPAA2_CEETM_CHG_MODE;
+	if (weight_set)
+		mask |= DPAA2_CEETM_CHG_WEIGHT;
+	if (minrate_set)
+		mask |= DPAA2_CEETM_CHG_MIN_RATE;
+	if (maxrun_set)
+		mask |= DPAA2_CEETM_CHG_MAX_RUN;
+	if (reserve_set)
+		mask |= DPAA2_CEETM_CHG_BUF_RESERVE;
+	if (cap_set)
+		mask |= DPAA2_CEETM_CHG_BUF_CAP;
+	if (lat_set)
+		mask |= DPAA2_CEETM_CHG_LAT_SAMPLE;
+	if (unshaped)
+		mask |= DPAA2_CEETM_CHG_SHAPED;
+	/* Only both rates switch the unit, so the untouched one is never
+	 * read in the other unit. One rate alone states its unit, for the
+	 * kernel to check against the current one.
+	 */
+	if (cir_set && eir_set)
+		mask |= DPAA2_CEETM_CHG_PKT_MODE;
+
+	if (change && opt.type == DPAA2_CEETM_PRIO && !mask) {
+		fprintf(stderr, "Please specify the mode, the weight, the "
+				"minimum service and / or the latency "
+				"sampling when changing a prio class.\n");
+		return -1;
+	}
 
-	return 0;
+	if (change && opt.type == DPAA2_CEETM_ROOT && !mask) {
+		fprintf(stderr, "Please specify the shaper, unshaped and / or "
+				"the buffer partition when changing a root "
+				"class.\n");
+		return -1;
+	}
+
+	if (reserve_set && cap_set && bp.cap && bp.reserve > bp.cap) {
+		fprintf(stderr, "The reserve can not exceed the cap.\n");
+		return -1;
+	}
+
+	if (minrate_set || maxrun_set)
+		msp = &ms;
+	if (reserve_set || cap_set)
+		bpp = &bp;
+	if (lat_set)
+		latp = &lat;
+	pkt = cir_pps || eir_pps;
+	if (pkt || (change && (cir_set || eir_set)))
+		pktp = &pkt;
+
+	if (dpaa2_ceetm_check_copt(&opt, msp, bpp, latp, pktp,
+				   change ? mask : 0)) {
+		fprintf(stderr, "Invalid class options.\n");
+		return -1;
+	}
+
+	return dpaa2_ceetm_put_copt(n, 2024, &opt, msp, bpp, latp, pktp,
+				    mask) ? -1 : 0;
 }
 
 int dpaa2_ceetm_print_qopt(struct qdisc_util *qu, FILE *f, struct rtattr *opt)
 {
 	struct rtattr *tb[DPAA2_CEETM_TCA_MAX];
 	struct dpaa2_ceetm_tc_qopt *qopt = NULL;
+	struct dpaa2_ceetm_tc_buf_part *bp;
+	char buf[64];
+	__u32 hash;
 
 	if (opt == NULL)
 		return 0;
@@ -455,20 +880,49 @@ int dpaa2_ceetm_print_qopt(struct qdisc_util *qu, FILE *f, struct rtattr *opt)
 
 	if (qopt->type == DPAA2_CEETM_ROOT) {
 		fprintf(f, "type root ");
+
+		if (tb[DPAA2_CEETM_TCA_BUF_PART] &&
+		    RTA_PAYLOAD(tb[DPAA2_CEETM_TCA_BUF_PART]) >= sizeof(*bp)) {
+			bp = RTA_DATA(tb[DPAA2_CEETM_TCA_BUF_PART]);
+			print_size(buf, sizeof(buf), bp->reserve);
+			fprintf(f, "reserve %s ", buf);
+			print_size(buf, sizeof(buf), bp->cap);
+			fprintf(f, "cap %s ", bp->cap ? buf : "none");
+		}
 	} else if (qopt->type == DPAA2_CEETM_PRIO) {
 		fprintf(f, "type prio prioA %d prioB %d separate %d",
 				qopt->prio_group_A, qopt->prio_group_B,
 				qopt->separate_groups);
+
+		if (tb[DPAA2_CEETM_TCA_FLOW_HASH] &&
+		    RTA_PAYLOAD(tb[DPAA2_CEETM_TCA_FLOW_HASH]) >= sizeof(__u32)) {
+			hash = rta_getattr_u32(tb[DPAA2_CEETM_TCA_FLOW_HASH]);
+			if (hash & DPAA2_CEETM_FLOW_HASH_A)
+				fprintf(f, " flowhashA 1");
+			if (hash & DPAA2_CEETM_FLOW_HASH_B)
+				fprintf(f, " flowhashB 1");
+		}
 	}
 
 	return 0;
 }
 
+static void dpaa2_ceetm_print_rate(char *buf, int len, __u64 rate, bool pps)
+{
+	if (pps)
+		ceetm_sprint_pps(buf, len, rate);
+	else
+		print_rate(buf, len, rate);
+}
+
 int dpaa2_ceetm_print_copt(struct qdisc_util *qu, FILE *f, struct rtattr *opt)
 {
 	struct rtattr *tb[DPAA2_CEETM_TCA_MAX];
 	struct dpaa2_ceetm_tc_copt *copt = NULL;
+	struct dpaa2_ceetm_tc_min_service *ms;
+	struct dpaa2_ceetm_tc_buf_part *bp;
 	char buf[64];
+	bool pps;
 
 	if (opt == NULL)
 		return 0;
@@ -489,10 +943,17 @@ int dpaa2_ceetm_print_copt(struct qdisc_util *qu, FILE *f, struct rtattr *opt)
 		fprintf(f, "type root ");
 
 		if (copt->shaped) {
-			print_rate(buf, sizeof(buf), copt->shaping_cfg.cir);
+			pps = tb[DPAA2_CEETM_TCA_PKT_MODE] &&
+			      RTA_PAYLOAD(tb[DPAA2_CEETM_TCA_PKT_MODE]) >=
+			      sizeof(__u32) &&
+			      rta_getattr_u32(tb[DPAA2_CEETM_TCA_PKT_MODE]);
+
+			dpaa2_ceetm_print_rate(buf, sizeof(buf),
+					       copt->shaping_cfg.cir, pps);
 			fprintf(f, "CIR %s ", buf);
 
-			print_rate(buf, sizeof(buf), copt->shaping_cfg.eir);
+			dpaa2_ceetm_print_rate(buf, sizeof(buf),
+					       copt->shaping_cfg.eir, pps);
 			fprintf(f, "EIR %s ", buf);
 
 			fprintf(f, "CBS %d EBS %d ", copt->shaping_cfg.cbs, copt->shaping_cfg.ebs);
@@ -502,6 +963,15 @@ int dpaa2_ceetm_print_copt(struct qdisc_util *qu, FILE *f, struct rtattr *opt)
 			fprintf(f, "unshaped ");
 		}
 
+		if (tb[DPAA2_CEETM_TCA_BUF_PART] &&
+		    RTA_PAYLOAD(tb[DPAA2_CEETM_TCA_BUF_PART]) >= sizeof(*bp)) {
+			bp = RTA_DATA(tb[DPAA2_CEETM_TCA_BUF_PART]);
+			print_size(buf, sizeof(buf), bp->reserve);
+			fprintf(f, "reserve %s ", buf);
+			print_size(buf, sizeof(buf), bp->cap);
+			fprintf(f, "cap %s ", bp->cap ? buf : "none");
+		}
+
 	} else if (copt->type == DPAA2_CEETM_PRIO) {
 		fprintf(f, "type prio ");
 
@@ -513,30 +983,205 @@ int dpaa2_ceetm_print_copt(struct qdisc_util *qu, FILE *f, struct rtattr *opt)
 			fprintf(f, "mode WEIGHTED_A ");
 			break;
 		case WEIGHTED_B:
-			fprintf(f, "mode WEIGTHED_B ");
+			fprintf(f, "mode WEIGHTED_B ");
 			break;
 		}
 
 		if (copt->mode != STRICT_PRIORITY)
 			fprintf(f, "weight %d ", copt->weight);
+
+		if (tb[DPAA2_CEETM_TCA_MIN_SERVICE] &&
+		    RTA_PAYLOAD(tb[DPAA2_CEETM_TCA_MIN_SERVICE]) >= sizeof(*ms)) {
+			ms = RTA_DATA(tb[DPAA2_CEETM_TCA_MIN_SERVICE]);
+			print_rate(buf, sizeof(buf), ms->rate);
+			fprintf(f, "minrate %s maxrun %u ", buf, ms->maxrun);
+		}
+
+		if (tb[DPAA2_CEETM_TCA_LAT_SAMPLE] &&
+		    RTA_PAYLOAD(tb[DPAA2_CEETM_TCA_LAT_SAMPLE]) >= sizeof(__u32))
+			fprintf(f, "latsample %u ",
+				rta_getattr_u32(tb[DPAA2_CEETM_TCA_LAT_SAMPLE]));
 	}
 
 	return 0;
 }
 
+/* One line per TX frame queue feeding a class queue */
+static void dpaa2_ceetm_print_txq(FILE *f, struct rtattr *xstats)
+{
+	struct dpaa2_ceetm_tc_txq_xstats txq[CEETM_MAX_TXQ_XSTATS];
+	int i, count;
+
+	count = dpaa2_ceetm_get_txq_xstats(xstats, txq, CEETM_MAX_TXQ_XSTATS);
+	for (i = 0; i < count && i < CEETM_MAX_TXQ_XSTATS; i++)
+		fprintf(f, "txq %d enq frames %llu deq frames %llu "
+			   "rej frames %llu\n", i, txq[i].ceetm_enqueue_frames,
+			txq[i].ceetm_dequeue_frames, txq[i].ceetm_reject_frames);
+
+	if (count > CEETM_MAX_TXQ_XSTATS)
+		fprintf(f, "txq %d more not shown\n",
+			count - CEETM_MAX_TXQ_XSTATS);
+}
+
+/* Sojourn time of the sampled frames of a class queue, the buckets with
+ * details
+ */
+static void dpaa2_ceetm_print_lat(FILE *f,
+				  const struct dpaa2_ceetm_tc_xstats *st)
+{
+	const __u64 *hist = st->ceetm_lat_hist;
+	__u64 max = st->ceetm_lat_max_ns;
+	int i;
+
+	fprintf(f, "latency samples %llu p50 %llu us p99 %llu us "
+		   "p999 %llu us max %llu us\n", st->ceetm_lat_samples,
+		ceetm_lat_percentile(hist, max, 0.5) / 1000,
+		ceetm_lat_percentile(hist, max, 0.99) / 1000,
+		ceetm_lat_percentile(hist, max, 0.999) / 1000, max / 1000);
+
+	if (!show_details)
+		return;
+
+	for (i = 0; i < CEETM_LAT_BUCKETS - 1; i++)
+		if (hist[i])
+			fprintf(f, "latency below %u us %llu\n", 1U << i,
+				hist[i]);
+	if (hist[i])
+		fprintf(f, "latency above %u us %llu\n", 1U << (i - 1),
+			hist[i]);
+}
+
+/* Flows and frames hashed to each class queue of the flow-hashed groups of
+ * a prio qdisc, with the share of the frames hashed by the qdisc
+ */
+static void dpaa2_ceetm_print_hash(FILE *f,
+				   const struct dpaa2_ceetm_tc_xstats *st)
+{
+	__u64 total = 0;
+	int i;
+
+	for (i = 0; i < CEETM_MAX_PRIO_QCOUNT; i++)
+		total += st->ceetm_hash_frames[i];
+	if (!total)
+		return;
+
+	for (i = 0; i < CEETM_MAX_PRIO_QCOUNT; i++)
+		if (st->ceetm_hash_flows[i] || st->ceetm_hash_frames[i])
+			fprintf(f, "flowhash class %d flows %u frames %llu "
+				   "(%.1f%%)\n", i + 1, st->ceetm_hash_flows[i],
+				st->ceetm_hash_frames[i],
+				100.0 * st->ceetm_hash_frames[i] / total);
+}
+
 int dpaa2_ceetm_print_xstats(struct qdisc_util *qu, FILE *f, struct rtattr *xstats)
 {
-	struct dpaa2_ceetm_tc_xstats *st;
+	struct dpaa2_ceetm_tc_xstats st;
 
 	if (xstats == NULL)
 		return 0;
 
-	if (RTA_PAYLOAD(xstats) < sizeof(*st))
+	if (dpaa2_ceetm_get_xstats(xstats, &st))
 		return -1;
 
-	st = RTA_DATA(xstats);
 	fprintf(f, "ceetm:\ndeq bytes %llu\ndeq frames %llu\nrej bytes %llu\nrej frames %llu\n",
-			st->ceetm_dequeue_bytes, st->ceetm_dequeue_frames,
-			st->ceetm_reject_bytes, st->ceetm_reject_frames);
+			st.ceetm_dequeue_bytes, st.ceetm_dequeue_frames,
+			st.ceetm_reject_bytes, st.ceetm_reject_frames);
+
+	if (CEETM_XSTATS_HAS(xstats, struct dpaa2_ceetm_tc_xstats,
+			     ceetm_reject_wred_frames))
+		fprintf(f, "rej shaper bytes %llu frames %llu\n"
+			   "rej cg bytes %llu frames %llu\n"
+			   "rej bp bytes %llu frames %llu\n"
+			   "rej wred bytes %llu frames %llu\n",
+			st.ceetm_reject_shaper_bytes,
+			st.ceetm_reject_shaper_frames,
+			st.ceetm_reject_cg_bytes, st.ceetm_reject_cg_frames,
+			st.ceetm_reject_bp_bytes, st.ceetm_reject_bp_frames,
+			st.ceetm_reject_wred_bytes, st.ceetm_reject_wred_frames);
+
+	/* Only the channel shapers report a state */
+	if (CEETM_XSTATS_HAS(xstats, struct dpaa2_ceetm_tc_xstats,
+			     ceetm_coupled_bytes) &&
+	    (st.ceetm_cr_tokens || st.ceetm_er_tokens ||
+	     st.ceetm_shaper_blocked_ns || st.ceetm_coupled_bytes))
+		fprintf(f, "shaper cr tokens %lld er tokens %lld\n"
+			   "shaper blocked %llu us coupled bytes %llu\n",
+			st.ceetm_cr_tokens, st.ceetm_er_tokens,
+			st.ceetm_shaper_blocked_ns / 1000,
+			st.ceetm_coupled_bytes);
+
+	/* Only the LNIs and channels hold a share of the buffer pool */
+	if (CEETM_XSTATS_HAS(xstats, struct dpaa2_ceetm_tc_xstats,
+			     ceetm_buf_cap_frames) &&
+	    (st.ceetm_buf_bytes || st.ceetm_buf_peak_bytes ||
+	     st.ceetm_buf_cap_frames))
+		fprintf(f, "buffer bytes %llu peak %llu cap rej frames %llu\n",
+			st.ceetm_buf_bytes, st.ceetm_buf_peak_bytes,
+			st.ceetm_buf_cap_frames);
+
+	/* Only the sampled class queues have a histogram */
+	if (st.ceetm_lat_samples)
+		dpaa2_ceetm_print_lat(f, &st);
+
+	/* Only the prio qdiscs with flow-hashed groups spread their frames */
+	dpaa2_ceetm_print_hash(f, &st);
+
+	if (show_details)
+		dpaa2_ceetm_print_txq(f, xstats);
 	return 0;
 }
+
+/* Write the options of a qdisc / class in the syntax of the parsers, with
+ * exact rates, so that they can be fed back to them.
+ */
+int dpaa2_ceetm_sprint_qopt(char *buf, int len,
+			    const struct dpaa2_ceetm_tc_qopt *qopt)
+{
+	switch (qopt->type) {
+	case DPAA2_CEETM_ROOT:
+		return snprintf(buf, len, "type root");
+
+	case DPAA2_CEETM_PRIO:
+		return snprintf(buf, len, "type prio prioA %u prioB %u "
+				"separate %u", qopt->prio_group_A,
+				qopt->prio_group_B, qopt->separate_groups);
+	}
+
+	return -1;
+}
+
+int dpaa2_ceetm_sprint_copt(char *buf, int len,
+			    const struct dpaa2_ceetm_tc_copt *copt, bool pps)
+{
+	const struct dpaa2_ceetm_shaping_cfg *cfg = &copt->shaping_cfg;
+	static const char * const modes[] = {
+		[STRICT_PRIORITY] = "STRICT_PRIORITY",
+		[WEIGHTED_A] = "WEIGHTED_A",
+		[WEIGHTED_B] = "WEIGHTED_B",
+	};
+
+	switch (copt->type) {
+	case DPAA2_CEETM_ROOT:
+		if (!copt->shaped)
+			return snprintf(buf, len, "type root");
+
+		return snprintf(buf, len, "type root cir %llu%s eir %llu%s "
+				"cbs %u ebs %u coupled %u", cfg->cir,
+				pps ? "pps" : "bps", cfg->eir,
+				pps ? "pps" : "bps", cfg->cbs, cfg->ebs,
+				cfg->coupled);
+
+	case DPAA2_CEETM_PRIO:
+		if (copt->mode > WEIGHTED_B)
+			return -1;
+
+		if (copt->mode == STRICT_PRIORITY)
+			return snprintf(buf, len, "type prio mode %s",
+					modes[copt->mode]);
+
+		return snprintf(buf, len, "type prio mode %s weight %u",
+				modes[copt->mode], copt->weight);
+	}
+
+	return -1;
+}
@@ -0,0 +1,194 @@
+/* Copyright 2014-2016 Freescale Semiconductor Inc.
+ * Copyright 2017-2018 NXP
+ *
+ * SPDX-License-Identifier: GPL-2.0
+ */
+
+#ifndef __DPAA2_CEETM_ABI_H
+#define __DPAA2_CEETM_ABI_H
+
+#include <linux/types.h>
+
+/* Configuration and statistics exchanged with the DPAA2 CEETM qdisc, shared
+ * by the tc plugin and libceetm.
+ */
+
+/* Maximum number of CEETM CQs that can be linked to a channel (prio qdisc) */
+#define CEETM_MAX_PRIO_QCOUNT	8
+#define CEETM_MAX_WBFS_QCOUNT	8
+#define CEETM_MIN_WBFS_QCOUNT	4
+#define CEETM_MAX_WBFS_VALUE	248
+/* Buckets of the sojourn time histogram of a class queue */
+#define CEETM_LAT_BUCKETS	24
+
+#define DPAA2_CEETM_MIN_WEIGHT	100
+#define DPAA2_CEETM_MAX_WEIGHT	24800
+
+enum {
+	DPAA2_CEETM_TCA_UNSPEC,
+	DPAA2_CEETM_TCA_COPT,
+	DPAA2_CEETM_TCA_QOPS,
+	DPAA2_CEETM_TCA_CHANGE_MASK,
+	DPAA2_CEETM_TCA_MIN_SERVICE,
+	DPAA2_CEETM_TCA_BUF_PART,
+	/* u32, one frame in N of a prio class is timestamped at enqueue and
+	 * dequeue, 0 to stop sampling
+	 */
+	DPAA2_CEETM_TCA_LAT_SAMPLE,
+	/* u32, 1 if the shaper of a root class counts frames: cir and eir are
+	 * then in packets per second, cbs and ebs in frames. On a change,
+	 * DPAA2_CEETM_CHG_PKT_MODE switches the unit and needs both rates;
+	 * without it the attribute gives the unit of the rate changed alone,
+	 * rejected if the shaper counts in the other one.
+	 */
+	DPAA2_CEETM_TCA_PKT_MODE,
+	/* u32, DPAA2_CEETM_FLOW_HASH_* flags of a prio qdisc: the flows of
+	 * a flagged weighted group are spread by 5-tuple hash over its class
+	 * queues, served at equal weight whatever their weight
+	 */
+	DPAA2_CEETM_TCA_FLOW_HASH,
+	DPAA2_CEETM_TCA_MAX,
+};
+
+/* Fields carried by DPAA2_CEETM_TCA_CHANGE_MASK on a change request; only
+ * the fields flagged here are applied to the running configuration.
+ */
+#define DPAA2_CEETM_CHG_PRIO_A		(1 << 0)
+#define DPAA2_CEETM_CHG_PRIO_B		(1 << 1)
+#define DPAA2_CEETM_CHG_SEPARATE	(1 << 2)
+#define DPAA2_CEETM_CHG_CIR		(1 << 3)
+#define DPAA2_CEETM_CHG_EIR		(1 << 4)
+#define DPAA2_CEETM_CHG_CBS		(1 << 5)
+#define DPAA2_CEETM_CHG_EBS		(1 << 6)
+#define DPAA2_CEETM_CHG_COUPLED		(1 << 7)
+#define DPAA2_CEETM_CHG_MODE		(1 << 8)
+#define DPAA2_CEETM_CHG_WEIGHT		(1 << 9)
+#define DPAA2_CEETM_CHG_MIN_RATE	(1 << 10)
+#define DPAA2_CEETM_CHG_MAX_RUN		(1 << 11)
+#define DPAA2_CEETM_CHG_BUF_RESERVE	(1 << 12)
+#define DPAA2_CEETM_CHG_BUF_CAP		(1 << 13)
+#define DPAA2_CEETM_CHG_LAT_SAMPLE	(1 << 14)
+#define DPAA2_CEETM_CHG_PKT_MODE	(1 << 15)
+#define DPAA2_CEETM_CHG_FLOW_HASH_A	(1 << 16)
+#define DPAA2_CEETM_CHG_FLOW_HASH_B	(1 << 17)
+/* Applies the shaped field of a root class, to turn the shaping of the
+ * channel off. Giving cir or eir shapes it again.
+ */
+#define DPAA2_CEETM_CHG_SHAPED		(1 << 18)
+
+#define DPAA2_CEETM_FLOW_HASH_A		(1 << 0)
+#define DPAA2_CEETM_FLOW_HASH_B		(1 << 1)
+
+/* CEETM configuration types */
+enum dpaa2_ceetm_type {
+	DPAA2_CEETM_ROOT = 1,
+	DPAA2_CEETM_PRIO,
+};
+
+enum {
+	STRICT_PRIORITY = 0,
+	WEIGHTED_A,
+	WEIGHTED_B,
+};
+
+struct dpaa2_ceetm_shaping_cfg {
+	__u64 cir; /* committed information rate */
+	__u64 eir; /* excess information rate */
+	__u16 cbs; /* committed burst size */
+	__u16 ebs; /* excess burst size */
+	__u8 coupled; /* shaper coupling */
+};
+
+/* CEETM Qdisc configuration parameters */
+struct dpaa2_ceetm_tc_qopt {
+	enum dpaa2_ceetm_type type;
+	__u16 shaped;
+	__u8 prio_group_A;
+	__u8 prio_group_B;
+	__u8 separate_groups;
+};
+
+/* CEETM Class configuration parameters */
+struct dpaa2_ceetm_tc_copt {
+	enum dpaa2_ceetm_type type;
+	struct dpaa2_ceetm_shaping_cfg shaping_cfg;
+	__u16 shaped;
+	__u8 mode;
+	__u16 weight;
+};
+
+/* Minimum service of a prio class, so a flood on a higher priority class
+ * queue does not starve it. Enforced by the per-CQ shapers where the SoC
+ * has them, by the channel scheduler otherwise.
+ */
+struct dpaa2_ceetm_tc_min_service {
+	__u64 rate; /* guaranteed bytes per second, 0 for none */
+	__u32 maxrun; /* frames served in a row while lower CQs wait, 0 for no limit */
+};
+
+/* Share of the QBMan buffer pool held by a LNI (root qdisc) or channel
+ * (root class), so a congested DPNI cannot take the buffers of the others.
+ * On creation, without the attribute the pool is shared with no
+ * reservation and no cap.
+ */
+struct dpaa2_ceetm_tc_buf_part {
+	__u32 reserve; /* bytes set aside for this LNI / channel only */
+	__u32 cap; /* most bytes queued at once, 0 for no cap */
+};
+
+/* CEETM stats */
+struct dpaa2_ceetm_tc_xstats {
+	__u64 ceetm_dequeue_bytes;
+	__u64 ceetm_dequeue_frames;
+	__u64 ceetm_reject_bytes;
+	__u64 ceetm_reject_frames;
+	/* Breakdown of the rejects, appended: older kernels stop above */
+	__u64 ceetm_reject_shaper_bytes; /* CQ backlog behind the shaper full */
+	__u64 ceetm_reject_shaper_frames;
+	__u64 ceetm_reject_cg_bytes; /* congestion group tail drop */
+	__u64 ceetm_reject_cg_frames;
+	__u64 ceetm_reject_bp_bytes; /* buffer pool depleted */
+	__u64 ceetm_reject_bp_frames;
+	__u64 ceetm_reject_wred_bytes; /* WRED early drop */
+	__u64 ceetm_reject_wred_frames;
+	/* Dual-rate shaper of a shaped root class, appended. Bucket levels in
+	 * bytes, negative while in debt.
+	 */
+	__s64 ceetm_cr_tokens;
+	__s64 ceetm_er_tokens;
+	__u64 ceetm_shaper_blocked_ns; /* time with frames held by the shaper */
+	__u64 ceetm_coupled_bytes; /* CR tokens moved to a full ER bucket */
+	/* Buffer pool occupancy of a LNI or channel, appended */
+	__u64 ceetm_buf_bytes; /* queued now */
+	__u64 ceetm_buf_peak_bytes; /* high watermark since the last read */
+	__u64 ceetm_buf_cap_frames; /* frames rejected at the cap */
+	/* Per transmit queue breakdown of a class queue, appended:
+	 * ceetm_txq_count struct dpaa2_ceetm_tc_txq_xstats end the payload,
+	 * one per TX frame queue (CPU) feeding the class, 0 if not reported.
+	 * The fields appended below sit between ceetm_txq_pad and the
+	 * entries, when the kernel has them.
+	 */
+	__u32 ceetm_txq_count;
+	__u32 ceetm_txq_pad;
+	/* Sojourn time of the sampled frames of a class queue, appended.
+	 * Bucket 0 counts the samples under 1 us, bucket i those from
+	 * 2^(i-1) up to 2^i us, the last one all the longer ones.
+	 */
+	__u64 ceetm_lat_samples;
+	__u64 ceetm_lat_max_ns;
+	__u64 ceetm_lat_hist[CEETM_LAT_BUCKETS];
+	/* Spreading of the flow-hashed groups of a prio qdisc, appended: per
+	 * class queue, the flows seen active in the last second and the frames
+	 * hashed to it, 0 outside the hashed groups.
+	 */
+	__u32 ceetm_hash_flows[CEETM_MAX_PRIO_QCOUNT];
+	__u64 ceetm_hash_frames[CEETM_MAX_PRIO_QCOUNT];
+};
+
+struct dpaa2_ceetm_tc_txq_xstats {
+	__u64 ceetm_enqueue_frames;
+	__u64 ceetm_dequeue_frames;
+	__u64 ceetm_reject_frames;
+};
+
+#endif
@@ -0,0 +1,903 @@
+/* Copyright 2017-2018 NXP
+ *
+ * SPDX-License-Identifier: GPL-2.0
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <linux/gen_stats.h>
+#include <linux/pkt_sched.h>
+
+#include "libceetm.h"
+
+#define CEETM_NLMSG_TAIL(n) \
+	((struct rtattr *)(((char *)(n)) + NLMSG_ALIGN((n)->nlmsg_len)))
+
+/* Size of the xstats reported by the first kernels, later fields are
+ * appended and may be missing.
+ */
+#define DPAA1_CEETM_XSTATS_MIN	\
+	CEETM_OFFSETOFEND(struct tc_ceetm_xstats, byte_count)
+#define DPAA2_CEETM_XSTATS_MIN	\
+	CEETM_OFFSETOFEND(struct dpaa2_ceetm_tc_xstats, ceetm_reject_frames)
+
+static int ceetm_addattr(struct nlmsghdr *n, int maxlen, int type,
+			 const void *data, int alen)
+{
+	int len = RTA_LENGTH(alen);
+	struct rtattr *rta;
+
+	if (NLMSG_ALIGN(n->nlmsg_len) + RTA_ALIGN(len) > (unsigned int)maxlen)
+		return -ENOSPC;
+
+	rta = CEETM_NLMSG_TAIL(n);
+	rta->rta_type = type;
+	rta->rta_len = len;
+	if (alen)
+		memcpy(RTA_DATA(rta), data, alen);
+	n->nlmsg_len = NLMSG_ALIGN(n->nlmsg_len) + RTA_ALIGN(len);
+
+	return 0;
+}
+
+static struct rtattr *ceetm_nest_start(struct nlmsghdr *n, int maxlen,
+				       int type)
+{
+	struct rtattr *nest = CEETM_NLMSG_TAIL(n);
+
+	return ceetm_addattr(n, maxlen, type, NULL, 0) ? NULL : nest;
+}
+
+static void ceetm_nest_end(struct nlmsghdr *n, struct rtattr *nest)
+{
+	nest->rta_len = (char *)CEETM_NLMSG_TAIL(n) - (char *)nest;
+}
+
+static void ceetm_parse_attrs(struct rtattr **tb, int max, struct rtattr *rta,
+			      int len)
+{
+	memset(tb, 0, sizeof(*tb) * (max + 1));
+
+	for (; RTA_OK(rta, len); rta = RTA_NEXT(rta, len))
+		if (rta->rta_type <= max && !tb[rta->rta_type])
+			tb[rta->rta_type] = rta;
+}
+
+void ceetm_req_init(struct ceetm_req *req, int type, bool change, int ifindex,
+		    __u32 parent, __u32 handle)
+{
+	memset(req, 0, sizeof(*req));
+	req->n.nlmsg_len = NLMSG_LENGTH(sizeof(struct tcmsg));
+	req->n.nlmsg_type = type;
+	req->n.nlmsg_flags = NLM_F_REQUEST;
+	if (!change)
+		req->n.nlmsg_flags |= NLM_F_CREATE | NLM_F_EXCL;
+	req->t.tcm_family = AF_UNSPEC;
+	req->t.tcm_ifindex = ifindex;
+	req->t.tcm_parent = parent;
+	req->t.tcm_handle = handle;
+
+	ceetm_addattr(&req->n, sizeof(*req), TCA_KIND, "ceetm",
+		      strlen("ceetm") + 1);
+}
+
+static bool ceetm_req_change(const struct ceetm_req *req)
+{
+	return !(req->n.nlmsg_flags & NLM_F_CREATE);
+}
+
+/* The buffer partition is for LNIs and channels: root qdiscs and classes */
+static int ceetm_check_buf_part(__u32 type, __u32 root, __u32 reserve,
+				__u32 cap)
+{
+	if (type != root)
+		return -EINVAL;
+	if (cap && reserve > cap)
+		return -EINVAL;
+
+	return 0;
+}
+
+/* Packet mode is for the shapers of LNIs and channels, the only ones */
+static int ceetm_check_pkt_mode(__u32 type, __u32 root, __u16 shaped,
+				const __u32 *pkt)
+{
+	if (!pkt)
+		return 0;
+	if (type != root || *pkt > 1)
+		return -EINVAL;
+	if (*pkt && !shaped)
+		return -EINVAL;
+
+	return 0;
+}
+
+int dpaa1_ceetm_check_qopt(const struct tc_ceetm_qopt *opt,
+			   const struct tc_ceetm_buf_part *bp,
+			   const __u32 *pkt,
+			   const struct tc_ceetm_wbfs_group *grp,
+			   const __u32 *hash, bool change)
+{
+	int i;
+
+	if (bp && ceetm_check_buf_part(opt->type, DPAA1_CEETM_ROOT,
+				       bp->reserve, bp->cap))
+		return -EINVAL;
+
+	if (ceetm_check_pkt_mode(opt->type, DPAA1_CEETM_ROOT, opt->shaped,
+				 pkt))
+		return -EINVAL;
+
+	if (grp && (opt->type != DPAA1_CEETM_WBFS ||
+		    grp->group > DPAA1_CEETM_GROUP_B ||
+		    grp->prio >= CEETM_MAX_PRIO_QCOUNT))
+		return -EINVAL;
+
+	if (hash && (opt->type != DPAA1_CEETM_WBFS || *hash > 1))
+		return -EINVAL;
+
+	switch (opt->type) {
+	case DPAA1_CEETM_ROOT:
+		if (opt->shaped && !opt->rate)
+			return -EINVAL;
+		/* The overhead is added to the frame lengths, not counted */
+		if (pkt && *pkt && opt->overhead)
+			return -EINVAL;
+		return 0;
+
+	case DPAA1_CEETM_PRIO:
+		if (!opt->qcount || opt->qcount > CEETM_MAX_PRIO_QCOUNT)
+			return -EINVAL;
+		return 0;
+
+	case DPAA1_CEETM_WBFS:
+		if (opt->cr > 1 || opt->er > 1)
+			return -EINVAL;
+
+		/* A change only updates the group's cr / er and position */
+		if (change)
+			return 0;
+
+		if (opt->qcount != CEETM_MIN_WBFS_QCOUNT &&
+		    opt->qcount != CEETM_MAX_WBFS_QCOUNT)
+			return -EINVAL;
+
+		/* A group of eight takes both halves, it is known as A */
+		if (grp && opt->qcount == CEETM_MAX_WBFS_QCOUNT &&
+		    grp->group != DPAA1_CEETM_GROUP_A)
+			return -EINVAL;
+
+		for (i = 0; i < opt->qcount; i++)
+			if (!opt->qweight[i] ||
+			    opt->qweight[i] > CEETM_MAX_WBFS_VALUE)
+				return -EINVAL;
+		return 0;
+	}
+
+	return -EINVAL;
+}
+
+int dpaa1_ceetm_check_copt(const struct tc_ceetm_copt *opt,
+			   const struct tc_ceetm_min_service *ms,
+			   const struct tc_ceetm_buf_part *bp,
+			   const __u32 *lat, const __u32 *pkt)
+{
+	/* The minimum service is drawn from CR tokens */
+	if (ms && (opt->type != DPAA1_CEETM_PRIO || !opt->cr))
+		return -EINVAL;
+
+	/* Only class queues are sampled, not channels */
+	if (lat && opt->type == DPAA1_CEETM_ROOT)
+		return -EINVAL;
+
+	if (bp && ceetm_check_buf_part(opt->type, DPAA1_CEETM_ROOT,
+				       bp->reserve, bp->cap))
+		return -EINVAL;
+
+	if (ceetm_check_pkt_mode(opt->type, DPAA1_CEETM_ROOT, opt->shaped,
+				 pkt))
+		return -EINVAL;
+
+	switch (opt->type) {
+	case DPAA1_CEETM_ROOT:
+		if (opt->shaped && !opt->rate)
+			return -EINVAL;
+		return 0;
+
+	case DPAA1_CEETM_PRIO:
+		if (opt->cr > 1 || opt->er > 1 || (!opt->cr && !opt->er))
+			return -EINVAL;
+		return 0;
+
+	case DPAA1_CEETM_WBFS:
+		if (!opt->weight || opt->weight > CEETM_MAX_WBFS_VALUE)
+			return -EINVAL;
+		return 0;
+	}
+
+	return -EINVAL;
+}
+
+/* A change of only the reserve or only the cap is checked against the
+ * running value of the other one by the kernel.
+ */
+static int dpaa2_ceetm_check_buf_part(enum dpaa2_ceetm_type type,
+				      const struct dpaa2_ceetm_tc_buf_part *bp,
+				      __u32 mask)
+{
+	__u32 buf = DPAA2_CEETM_CHG_BUF_RESERVE | DPAA2_CEETM_CHG_BUF_CAP;
+
+	if ((mask & buf) && !bp)
+		return -EINVAL;
+	if (!bp)
+		return 0;
+
+	return ceetm_check_buf_part(type, DPAA2_CEETM_ROOT, bp->reserve,
+				    mask && (mask & buf) != buf ? 0 : bp->cap);
+}
+
+/* A zero mask stands for a full configuration, as on creation */
+int dpaa2_ceetm_check_qopt(const struct dpaa2_ceetm_tc_qopt *opt,
+			   const struct dpaa2_ceetm_tc_buf_part *bp,
+			   const __u32 *hash, __u32 mask)
+{
+	__u32 hash_chg = DPAA2_CEETM_CHG_FLOW_HASH_A |
+			 DPAA2_CEETM_CHG_FLOW_HASH_B;
+
+	if (opt->type != DPAA2_CEETM_ROOT && opt->type != DPAA2_CEETM_PRIO)
+		return -EINVAL;
+
+	if (mask & ~(DPAA2_CEETM_CHG_PRIO_A | DPAA2_CEETM_CHG_PRIO_B |
+		     DPAA2_CEETM_CHG_SEPARATE | DPAA2_CEETM_CHG_BUF_RESERVE |
+		     DPAA2_CEETM_CHG_BUF_CAP | hash_chg))
+		return -EINVAL;
+
+	if ((mask & hash_chg) && !hash)
+		return -EINVAL;
+	if (hash && (opt->type != DPAA2_CEETM_PRIO ||
+		     *hash & ~(DPAA2_CEETM_FLOW_HASH_A |
+			       DPAA2_CEETM_FLOW_HASH_B)))
+		return -EINVAL;
+
+	if (dpaa2_ceetm_check_buf_part(opt->type, bp, mask))
+		return -EINVAL;
+
+	if ((!mask || (mask & DPAA2_CEETM_CHG_SEPARATE)) &&
+	    opt->separate_groups > 1)
+		return -EINVAL;
+
+	return 0;
+}
+
+int dpaa2_ceetm_check_copt(const struct dpaa2_ceetm_tc_copt *opt,
+			   const struct dpaa2_ceetm_tc_min_service *ms,
+			   const struct dpaa2_ceetm_tc_buf_part *bp,
+			   const __u32 *lat, const __u32 *pkt, __u32 mask)
+{
+	const struct dpaa2_ceetm_shaping_cfg *cfg = &opt->shaping_cfg;
+	__u32 both = DPAA2_CEETM_CHG_CIR | DPAA2_CEETM_CHG_EIR;
+	__u32 min = DPAA2_CEETM_CHG_MIN_RATE | DPAA2_CEETM_CHG_MAX_RUN;
+
+	if ((ms || (mask & min)) && opt->type != DPAA2_CEETM_PRIO)
+		return -EINVAL;
+	if ((mask & min) && !ms)
+		return -EINVAL;
+	if ((lat || (mask & DPAA2_CEETM_CHG_LAT_SAMPLE)) &&
+	    opt->type != DPAA2_CEETM_PRIO)
+		return -EINVAL;
+	if ((mask & DPAA2_CEETM_CHG_LAT_SAMPLE) && !lat)
+		return -EINVAL;
+	if ((mask & DPAA2_CEETM_CHG_PKT_MODE) &&
+	    (!pkt || (mask & both) != both))
+		return -EINVAL;
+	if (ceetm_check_pkt_mode(opt->type, DPAA2_CEETM_ROOT,
+				 mask ? 1 : opt->shaped, pkt))
+		return -EINVAL;
+	if (dpaa2_ceetm_check_buf_part(opt->type, bp, mask))
+		return -EINVAL;
+
+	switch (opt->type) {
+	case DPAA2_CEETM_ROOT:
+		if (mask & (DPAA2_CEETM_CHG_MODE | DPAA2_CEETM_CHG_WEIGHT))
+			return -EINVAL;
+
+		if ((!mask || (mask & DPAA2_CEETM_CHG_COUPLED)) &&
+		    cfg->coupled > 1)
+			return -EINVAL;
+
+		/* Coupling needs both rates, given along with it */
+		if (cfg->coupled && (mask & DPAA2_CEETM_CHG_COUPLED) &&
+		    (mask & both) != both)
+			return -EINVAL;
+
+		/* Turning the shaping off leaves no shaper field to apply */
+		if ((mask & DPAA2_CEETM_CHG_SHAPED) &&
+		    (opt->shaped || (mask & (both | DPAA2_CEETM_CHG_CBS |
+					     DPAA2_CEETM_CHG_EBS |
+					     DPAA2_CEETM_CHG_COUPLED))))
+			return -EINVAL;
+		return 0;
+
+	case DPAA2_CEETM_PRIO:
+		if (mask & ~(DPAA2_CEETM_CHG_MODE | DPAA2_CEETM_CHG_WEIGHT |
+			     DPAA2_CEETM_CHG_LAT_SAMPLE | min))
+			return -EINVAL;
+
+		if ((!mask || (mask & DPAA2_CEETM_CHG_MODE)) &&
+		    opt->mode > WEIGHTED_B)
+			return -EINVAL;
+
+		if (((!mask && opt->mode != STRICT_PRIORITY && opt->weight) ||
+		     (mask & DPAA2_CEETM_CHG_WEIGHT)) &&
+		    (opt->weight < DPAA2_CEETM_MIN_WEIGHT ||
+		     opt->weight > DPAA2_CEETM_MAX_WEIGHT))
+			return -EINVAL;
+		return 0;
+	}
+
+	return -EINVAL;
+}
+
+int dpaa1_ceetm_put_qopt(struct nlmsghdr *n, int maxlen,
+			 const struct tc_ceetm_qopt *opt,
+			 const struct tc_ceetm_buf_part *bp, const __u32 *pkt,
+			 const struct tc_ceetm_wbfs_group *grp,
+			 const __u32 *hash)
+{
+	struct rtattr *tail = ceetm_nest_start(n, maxlen, TCA_OPTIONS);
+
+	if (!tail ||
+	    ceetm_addattr(n, maxlen, TCA_CEETM_QOPS, opt, sizeof(*opt)))
+		return -ENOSPC;
+
+	if (bp && ceetm_addattr(n, maxlen, TCA_CEETM_BUF_PART, bp,
+				sizeof(*bp)))
+		return -ENOSPC;
+
+	if (pkt && ceetm_addattr(n, maxlen, TCA_CEETM_PKT_MODE, pkt,
+				 sizeof(*pkt)))
+		return -ENOSPC;
+
+	if (grp && ceetm_addattr(n, maxlen, TCA_CEETM_WBFS_GROUP, grp,
+				 sizeof(*grp)))
+		return -ENOSPC;
+
+	if (hash && ceetm_addattr(n, maxlen, TCA_CEETM_FLOW_HASH, hash,
+				  sizeof(*hash)))
+		return -ENOSPC;
+
+	ceetm_nest_end(n, tail);
+	return 0;
+}
+
+int dpaa1_ceetm_put_copt(struct nlmsghdr *n, int maxlen,
+			 const struct tc_ceetm_copt *opt,
+			 const struct tc_ceetm_min_service *ms,
+			 const struct tc_ceetm_buf_part *bp, const __u32 *lat,
+			 const __u32 *pkt)
+{
+	struct rtattr *tail = ceetm_nest_start(n, maxlen, TCA_OPTIONS);
+
+	if (!tail ||
+	    ceetm_addattr(n, maxlen, TCA_CEETM_COPT, opt, sizeof(*opt)))
+		return -ENOSPC;
+
+	if (ms && ceetm_addattr(n, maxlen, TCA_CEETM_MIN_SERVICE, ms,
+				sizeof(*ms)))
+		return -ENOSPC;
+
+	if (bp && ceetm_addattr(n, maxlen, TCA_CEETM_BUF_PART, bp,
+				sizeof(*bp)))
+		return -ENOSPC;
+
+	if (lat && ceetm_addattr(n, maxlen, TCA_CEETM_LAT_SAMPLE, lat,
+				 sizeof(*lat)))
+		return -ENOSPC;
+
+	if (pkt && ceetm_addattr(n, maxlen, TCA_CEETM_PKT_MODE, pkt,
+				 sizeof(*pkt)))
+		return -ENOSPC;
+
+	ceetm_nest_end(n, tail);
+	return 0;
+}
+
+int dpaa2_ceetm_put_qopt(struct nlmsghdr *n, int maxlen,
+			 const struct dpaa2_ceetm_tc_qopt *opt,
+			 const struct dpaa2_ceetm_tc_buf_part *bp,
+			 const __u32 *hash, __u32 mask)
+{
+	struct rtattr *tail = ceetm_nest_start(n, maxlen, TCA_OPTIONS);
+
+	if (!tail ||
+	    ceetm_addattr(n, maxlen, DPAA2_CEETM_TCA_QOPS, opt, sizeof(*opt)))
+		return -ENOSPC;
+
+	if (bp && ceetm_addattr(n, maxlen, DPAA2_CEETM_TCA_BUF_PART, bp,
+				sizeof(*bp)))
+		return -ENOSPC;
+
+	if (hash && ceetm_addattr(n, maxlen, DPAA2_CEETM_TCA_FLOW_HASH, hash,
+				  sizeof(*hash)))
+		return -ENOSPC;
+
+	if (!(n->nlmsg_flags & NLM_F_CREATE) &&
+	    ceetm_addattr(n, maxlen, DPAA2_CEETM_TCA_CHANGE_MASK, &mask,
+			  sizeof(mask)))
+		return -ENOSPC;
+
+	ceetm_nest_end(n, tail);
+	return 0;
+}
+
+int dpaa2_ceetm_put_copt(struct nlmsghdr *n, int maxlen,
+			 const struct dpaa2_ceetm_tc_copt *opt,
+			 const struct dpaa2_ceetm_tc_min_service *ms,
+			 const struct dpaa2_ceetm_tc_buf_part *bp,
+			 const __u32 *lat, const __u32 *pkt, __u32 mask)
+{
+	struct rtattr *tail = ceetm_nest_start(n, maxlen, TCA_OPTIONS);
+
+	if (!tail ||
+	    ceetm_addattr(n, maxlen, DPAA2_CEETM_TCA_COPT, opt, sizeof(*opt)))
+		return -ENOSPC;
+
+	if (ms && ceetm_addattr(n, maxlen, DPAA2_CEETM_TCA_MIN_SERVICE, ms,
+				sizeof(*ms)))
+		return -ENOSPC;
+
+	if (bp && ceetm_addattr(n, maxlen, DPAA2_CEETM_TCA_BUF_PART, bp,
+				sizeof(*bp)))
+		return -ENOSPC;
+
+	if (lat && ceetm_addattr(n, maxlen, DPAA2_CEETM_TCA_LAT_SAMPLE, lat,
+				 sizeof(*lat)))
+		return -ENOSPC;
+
+	if (pkt && ceetm_addattr(n, maxlen, DPAA2_CEETM_TCA_PKT_MODE, pkt,
+				 sizeof(*pkt)))
+		return -ENOSPC;
+
+	if (!(n->nlmsg_flags & NLM_F_CREATE) &&
+	    ceetm_addattr(n, maxlen, DPAA2_CEETM_TCA_CHANGE_MASK, &mask,
+			  sizeof(mask)))
+		return -ENOSPC;
+
+	ceetm_nest_end(n, tail);
+	return 0;
+}
+
+int dpaa1_ceetm_qdisc_req(struct ceetm_req *req,
+			  const struct tc_ceetm_qopt *opt,
+			  const struct tc_ceetm_buf_part *bp, const __u32 *pkt,
+			  const struct tc_ceetm_wbfs_group *grp,
+			  const __u32 *hash)
+{
+	if (dpaa1_ceetm_check_qopt(opt, bp, pkt, grp, hash,
+				   ceetm_req_change(req)))
+		return -EINVAL;
+
+	return dpaa1_ceetm_put_qopt(&req->n, sizeof(*req), opt, bp, pkt,
+				    grp, hash);
+}
+
+int dpaa1_ceetm_class_req(struct ceetm_req *req,
+			  const struct tc_ceetm_copt *opt,
+			  const struct tc_ceetm_min_service *ms,
+			  const struct tc_ceetm_buf_part *bp, const __u32 *lat,
+			  const __u32 *pkt)
+{
+	if (dpaa1_ceetm_check_copt(opt, ms, bp, lat, pkt))
+		return -EINVAL;
+
+	return dpaa1_ceetm_put_copt(&req->n, sizeof(*req), opt, ms, bp, lat,
+				    pkt);
+}
+
+int dpaa2_ceetm_qdisc_req(struct ceetm_req *req,
+			  const struct dpaa2_ceetm_tc_qopt *opt,
+			  const struct dpaa2_ceetm_tc_buf_part *bp,
+			  const __u32 *hash, __u32 mask)
+{
+	bool change = ceetm_req_change(req);
+
+	if ((change && !mask) ||
+	    dpaa2_ceetm_check_qopt(opt, bp, hash, change ? mask : 0))
+		return -EINVAL;
+
+	return dpaa2_ceetm_put_qopt(&req->n, sizeof(*req), opt, bp, hash,
+				    mask);
+}
+
+int dpaa2_ceetm_class_req(struct ceetm_req *req,
+			  const struct dpaa2_ceetm_tc_copt *opt,
+			  const struct dpaa2_ceetm_tc_min_service *ms,
+			  const struct dpaa2_ceetm_tc_buf_part *bp,
+			  const __u32 *lat, const __u32 *pkt, __u32 mask)
+{
+	bool change = ceetm_req_change(req);
+
+	if ((change && !mask) ||
+	    dpaa2_ceetm_check_copt(opt, ms, bp, lat, pkt, change ? mask : 0))
+		return -EINVAL;
+
+	return dpaa2_ceetm_put_copt(&req->n, sizeof(*req), opt, ms, bp, lat,
+				    pkt, mask);
+}
+
+/* Change the dual-rate shaper of a channel: the CR and ER of a DPAA1 root
+ * class, the CIR and EIR of a DPAA2 one. Bytes per second, a channel shaped
+ * in packets per second is switched back to bytes.
+ */
+int ceetm_channel_shaper_req(struct ceetm_req *req, enum dpaa_version ver,
+			     int ifindex, __u32 classid, __u64 cir, __u64 eir)
+{
+	struct dpaa2_ceetm_tc_copt c2;
+	struct tc_ceetm_copt c1;
+	__u32 bytes = 0;
+
+	ceetm_req_init(req, RTM_NEWTCLASS, true, ifindex, TC_H_MAJ(classid),
+		       classid);
+
+	if (ver == DPAA_1) {
+		if (cir > (__u32)~0U || eir > (__u32)~0U)
+			return -EINVAL;
+
+		memset(&c1, 0, sizeof(c1));
+		c1.type = DPAA1_CEETM_ROOT;
+		c1.shaped = 1;
+		c1.rate = cir;
+		c1.ceil = eir;
+		return dpaa1_ceetm_class_req(req, &c1, NULL, NULL, NULL, NULL);
+	}
+
+	memset(&c2, 0, sizeof(c2));
+	c2.type = DPAA2_CEETM_ROOT;
+	c2.shaped = 1;
+	c2.shaping_cfg.cir = cir;
+	c2.shaping_cfg.eir = eir;
+	return dpaa2_ceetm_class_req(req, &c2, NULL, NULL, NULL, &bytes,
+				     DPAA2_CEETM_CHG_CIR | DPAA2_CEETM_CHG_EIR |
+				     DPAA2_CEETM_CHG_PKT_MODE);
+}
+
+/* Change the weight of a class queue in a weighted group: a DPAA1 wbfs
+ * class or a DPAA2 prio class in WEIGHTED_A / WEIGHTED_B mode.
+ */
+int ceetm_cq_weight_req(struct ceetm_req *req, enum dpaa_version ver,
+			int ifindex, __u32 classid, unsigned int weight)
+{
+	struct dpaa2_ceetm_tc_copt c2;
+	struct tc_ceetm_copt c1;
+
+	ceetm_req_init(req, RTM_NEWTCLASS, true, ifindex, TC_H_MAJ(classid),
+		       classid);
+
+	/* The range of the tc parsers, the hardware rejects the others */
+	if (ver == DPAA_1) {
+		if (!weight || weight > CEETM_MAX_WBFS_VALUE)
+			return -EINVAL;
+
+		memset(&c1, 0, sizeof(c1));
+		c1.type = DPAA1_CEETM_WBFS;
+		c1.weight = weight;
+		return dpaa1_ceetm_class_req(req, &c1, NULL, NULL, NULL, NULL);
+	}
+
+	if (weight < DPAA2_CEETM_MIN_WEIGHT || weight > DPAA2_CEETM_MAX_WEIGHT)
+		return -EINVAL;
+
+	memset(&c2, 0, sizeof(c2));
+	c2.type = DPAA2_CEETM_PRIO;
+	c2.weight = weight;
+	return dpaa2_ceetm_class_req(req, &c2, NULL, NULL, NULL, NULL,
+				     DPAA2_CEETM_CHG_WEIGHT);
+}
+
+int ceetm_req_send(struct ceetm_nl *nl, struct ceetm_req *req)
+{
+	return ceetm_nl_talk(nl, &req->n);
+}
+
+void ceetm_batch_init(struct ceetm_batch *b, void *buf, int size)
+{
+	b->buf = buf;
+	b->size = size;
+	b->len = 0;
+	b->count = 0;
+}
+
+int ceetm_batch_add(struct ceetm_batch *b, const struct ceetm_req *req)
+{
+	int len = NLMSG_ALIGN(req->n.nlmsg_len);
+
+	if (b->len + len > b->size)
+		return -ENOSPC;
+
+	memcpy(b->buf + b->len, req, req->n.nlmsg_len);
+	b->len += len;
+	b->count++;
+
+	return 0;
+}
+
+/* Send and empty the batch. On error, failed is the index of the first
+ * request the kernel rejected, the requests before it were applied.
+ */
+int ceetm_batch_send(struct ceetm_nl *nl, struct ceetm_batch *b, int *failed)
+{
+	int err = ceetm_nl_batch(nl, b->buf, b->len, failed);
+
+	b->len = 0;
+	b->count = 0;
+
+	return err;
+}
+
+/* The per transmit queue entries end the payload, after the fields the
+ * kernel knows of: their count, at a fixed offset, tells where these stop.
+ */
+static int ceetm_txq_xstats_off(const struct rtattr *xstats, int cnt_off,
+				int esize, __u32 *count)
+{
+	int len = RTA_PAYLOAD(xstats);
+	__u32 cnt = 0;
+
+	if (len >= cnt_off + (int)sizeof(cnt))
+		memcpy(&cnt, (const char *)RTA_DATA(xstats) + cnt_off,
+		       sizeof(cnt));
+
+	/* The count is only trusted as far as the payload goes */
+	if (cnt > (__u32)((len - cnt_off) / esize))
+		cnt = 0;
+
+	*count = cnt;
+	return len - cnt * esize;
+}
+
+static int ceetm_get_xstats(const struct rtattr *xstats, void *st, int size,
+			    int min, int cnt_off, int esize)
+{
+	__u32 count;
+	int len;
+
+	if (!xstats || (int)RTA_PAYLOAD(xstats) < min)
+		return -EINVAL;
+
+	len = ceetm_txq_xstats_off(xstats, cnt_off, esize, &count);
+	if (len > size)
+		len = size;
+
+	memcpy(st, RTA_DATA(xstats), len);
+	memset((char *)st + len, 0, size - len);
+
+	return 0;
+}
+
+int dpaa1_ceetm_get_xstats(const struct rtattr *xstats,
+			   struct tc_ceetm_xstats *st)
+{
+	return ceetm_get_xstats(xstats, st, sizeof(*st),
+				DPAA1_CEETM_XSTATS_MIN,
+				offsetof(struct tc_ceetm_xstats, txq_count),
+				sizeof(struct tc_ceetm_txq_xstats));
+}
+
+int dpaa2_ceetm_get_xstats(const struct rtattr *xstats,
+			   struct dpaa2_ceetm_tc_xstats *st)
+{
+	return ceetm_get_xstats(xstats, st, sizeof(*st),
+				DPAA2_CEETM_XSTATS_MIN,
+				offsetof(struct dpaa2_ceetm_tc_xstats,
+					 ceetm_txq_count),
+				sizeof(struct dpaa2_ceetm_tc_txq_xstats));
+}
+
+static int ceetm_get_txq_xstats(const struct rtattr *xstats, int min,
+				int cnt_off, int esize, void *txq, int max)
+{
+	__u32 count;
+	int off;
+
+	if (!xstats || (int)RTA_PAYLOAD(xstats) < min)
+		return 0;
+
+	off = ceetm_txq_xstats_off(xstats, cnt_off, esize, &count);
+	memcpy(txq, (const char *)RTA_DATA(xstats) + off,
+	       ((int)count < max ? (int)count : max) * esize);
+
+	return count;
+}
+
+int dpaa1_ceetm_get_txq_xstats(const struct rtattr *xstats,
+			       struct tc_ceetm_txq_xstats *txq, int max)
+{
+	return ceetm_get_txq_xstats(xstats, DPAA1_CEETM_XSTATS_MIN,
+				    offsetof(struct tc_ceetm_xstats,
+					     txq_count),
+				    sizeof(*txq), txq, max);
+}
+
+int dpaa2_ceetm_get_txq_xstats(const struct rtattr *xstats,
+			       struct dpaa2_ceetm_tc_txq_xstats *txq, int max)
+{
+	return ceetm_get_txq_xstats(xstats, DPAA2_CEETM_XSTATS_MIN,
+				    offsetof(struct dpaa2_ceetm_tc_xstats,
+					     ceetm_txq_count),
+				    sizeof(*txq), txq, max);
+}
+
+/* Linear within the bucket, bucket i > 0 spanning 2^(i-1) to 2^i us */
+__u64 ceetm_lat_percentile(const __u64 *hist, __u64 max_ns, double q)
+{
+	__u64 total = 0, seen = 0;
+	double lo, hi, ns;
+	int i;
+
+	for (i = 0; i < CEETM_LAT_BUCKETS; i++)
+		total += hist[i];
+	if (!total)
+		return 0;
+
+	for (i = 0; i < CEETM_LAT_BUCKETS - 1; i++) {
+		if (seen + hist[i] >= q * total)
+			break;
+		seen += hist[i];
+	}
+
+	lo = i ? 1000.0 * (1ULL << (i - 1)) : 0;
+	hi = i < CEETM_LAT_BUCKETS - 1 ? 1000.0 * (1ULL << i) : max_ns;
+	if (hi < lo)
+		hi = lo;
+
+	ns = lo;
+	if (hist[i])
+		ns += (hi - lo) * (q * total - seen) / hist[i];
+	if (max_ns && ns > max_ns)
+		ns = max_ns;
+
+	return ns;
+}
+
+struct ceetm_xstats_walk {
+	enum dpaa_version ver;
+	int ifindex;
+	ceetm_xstats_cb_t cb;
+	void *arg;
+};
+
+static int ceetm_xstats_filter(struct nlmsghdr *n, void *arg)
+{
+	struct ceetm_xstats_walk *w = arg;
+	struct tcmsg *t = NLMSG_DATA(n);
+	struct rtattr *tb[TCA_MAX + 1];
+	struct rtattr *stb[TCA_STATS_MAX + 1];
+	struct rtattr *xstats = NULL;
+	struct ceetm_xstats st;
+	int len, err;
+
+	if (n->nlmsg_type != RTM_NEWQDISC && n->nlmsg_type != RTM_NEWTCLASS)
+		return 0;
+
+	len = n->nlmsg_len - NLMSG_LENGTH(sizeof(*t));
+	if (len < 0 || t->tcm_ifindex != w->ifindex)
+		return 0;
+
+	ceetm_parse_attrs(tb, TCA_MAX, TCA_RTA(t), len);
+
+	if (!tb[TCA_KIND] || strcmp(RTA_DATA(tb[TCA_KIND]), "ceetm") != 0)
+		return 0;
+
+	if (tb[TCA_STATS2]) {
+		ceetm_parse_attrs(stb, TCA_STATS_MAX, RTA_DATA(tb[TCA_STATS2]),
+				  RTA_PAYLOAD(tb[TCA_STATS2]));
+		xstats = stb[TCA_STATS_APP];
+	}
+
+	if (!xstats)
+		xstats = tb[TCA_XSTATS];
+
+	memset(&st, 0, sizeof(st));
+	st.ver = w->ver;
+	st.is_class = n->nlmsg_type == RTM_NEWTCLASS;
+	st.handle = t->tcm_handle;
+	st.parent = t->tcm_parent;
+
+	if (w->ver == DPAA_1)
+		err = dpaa1_ceetm_get_xstats(xstats, &st.d1);
+	else
+		err = dpaa2_ceetm_get_xstats(xstats, &st.d2);
+
+	/* Nodes without xstats, e.g. the root qdisc, are skipped */
+	if (err)
+		return 0;
+
+	return w->cb(&st, w->arg);
+}
+
+/* Report the xstats of every CEETM class of an interface, a single dump */
+int ceetm_class_xstats_dump(struct ceetm_nl *nl, enum dpaa_version ver,
+			    int ifindex, ceetm_xstats_cb_t cb, void *arg)
+{
+	struct ceetm_xstats_walk w = {
+		.ver = ver,
+		.ifindex = ifindex,
+		.cb = cb,
+		.arg = arg,
+	};
+
+	return ceetm_nl_dump(nl, RTM_GETTCLASS, ifindex, ceetm_xstats_filter,
+			     &w);
+}
+
+/* Report the xstats of every CEETM qdisc, then every class, of an
+ * interface.
+ */
+int ceetm_xstats_dump(struct ceetm_nl *nl, enum dpaa_version ver,
+		      int ifindex, ceetm_xstats_cb_t cb, void *arg)
+{
+	struct ceetm_xstats_walk w = {
+		.ver = ver,
+		.ifindex = ifindex,
+		.cb = cb,
+		.arg = arg,
+	};
+	int err;
+
+	err = ceetm_nl_dump(nl, RTM_GETQDISC, ifindex, ceetm_xstats_filter, &w);
+	if (err)
+		return err;
+
+	return ceetm_class_xstats_dump(nl, ver, ifindex, cb, arg);
+}
+
+/* A packet rate: a number with an optional k, M or G multiplier and the
+ * pps unit, such as 2Mpps or 1.5kpps
+ */
+int ceetm_get_pps(__u64 *pps, const char *str)
+{
+	static const struct {
+		const char *unit;
+		double scale;
+	} units[] = {
+		{ "pps", 1 },
+		{ "kpps", 1e3 },
+		{ "Kpps", 1e3 },
+		{ "Mpps", 1e6 },
+		{ "Gpps", 1e9 },
+	};
+	unsigned int i;
+	double val;
+	char *end;
+
+	val = strtod(str, &end);
+	if (end == str || val < 0)
+		return -EINVAL;
+
+	for (i = 0; i < sizeof(units) / sizeof(units[0]); i++) {
+		if (strcmp(end, units[i].unit) == 0) {
+			val *= units[i].scale;
+			if (val >= 18446744073709551615.0)
+				return -EINVAL;
+			*pps = val + 0.5;
+			return 0;
+		}
+	}
+
+	return -EINVAL;
+}
+
+/* The largest multiplier that keeps the rate exact, so it reads back */
+int ceetm_sprint_pps(char *buf, int len, __u64 pps)
+{
+	if (pps && pps % 1000000000 == 0)
+		return snprintf(buf, len, "%lluGpps", pps / 1000000000);
+	if (pps && pps % 1000000 == 0)
+		return snprintf(buf, len, "%lluMpps", pps / 1000000);
+	if (pps && pps % 1000 == 0)
+		return snprintf(buf, len, "%llukpps", pps / 1000);
+
+	return snprintf(buf, len, "%llupps", pps);
+}
@@ -0,0 +1,182 @@
+/* Copyright 2017-2018 NXP
+ *
+ * SPDX-License-Identifier: GPL-2.0
+ */
+
+#ifndef __LIBCEETM_H
+#define __LIBCEETM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <linux/types.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+
+#include "dpaa1_ceetm_abi.h"
+#include "dpaa2_ceetm_abi.h"
+#include "ceetm_soc.h"
+#include "ceetm_nl.h"
+
+/* In-process configuration of the CEETM qdiscs, for control-plane agents
+ * that would otherwise run tc for every change. The options are filled in
+ * the kernel structures directly, the requests go over a rtnetlink socket
+ * owned by the caller (see ceetm_nl_open()), one at a time or batched.
+ *
+ * The functions return 0 or a negative errno: -EINVAL for options the
+ * qdisc would reject, -ENOSPC if a request or batch buffer is full, or
+ * the error reported by the kernel.
+ */
+
+#define CEETM_OFFSETOFEND(type, member) \
+	(offsetof(type, member) + sizeof(((type *)0)->member))
+
+/* Fields appended to the xstats are only there with newer kernels */
+#define CEETM_XSTATS_HAS(xstats, type, member) \
+	(RTA_PAYLOAD(xstats) >= CEETM_OFFSETOFEND(type, member))
+
+/* Room for the options of any CEETM qdisc or class */
+#define CEETM_REQ_OPTS_SIZE	1024
+
+struct ceetm_req {
+	struct nlmsghdr n;
+	struct tcmsg t;
+	char buf[CEETM_REQ_OPTS_SIZE];
+};
+
+/* Back to back requests, sent with a single write */
+struct ceetm_batch {
+	char *buf;
+	int len;
+	int size;
+	int count;
+};
+
+/* CEETM xstats of a qdisc or class, decoded for the backend in use */
+struct ceetm_xstats {
+	enum dpaa_version ver;
+	bool is_class;
+	__u32 handle;
+	__u32 parent;
+	union {
+		struct tc_ceetm_xstats d1;
+		struct dpaa2_ceetm_tc_xstats d2;
+	};
+};
+
+/* Called for every CEETM qdisc and class, a negative return stops the dump */
+typedef int (*ceetm_xstats_cb_t)(const struct ceetm_xstats *st, void *arg);
+
+/* Request set up: RTM_NEWQDISC or RTM_NEWTCLASS, add or change */
+void ceetm_req_init(struct ceetm_req *req, int type, bool change, int ifindex,
+		    __u32 parent, __u32 handle);
+
+/* Option validation, also used by the tc plugin as a last check */
+int dpaa1_ceetm_check_qopt(const struct tc_ceetm_qopt *opt,
+			   const struct tc_ceetm_buf_part *bp,
+			   const __u32 *pkt,
+			   const struct tc_ceetm_wbfs_group *grp,
+			   const __u32 *hash, bool change);
+int dpaa1_ceetm_check_copt(const struct tc_ceetm_copt *opt,
+			   const struct tc_ceetm_min_service *ms,
+			   const struct tc_ceetm_buf_part *bp,
+			   const __u32 *lat, const __u32 *pkt);
+int dpaa2_ceetm_check_qopt(const struct dpaa2_ceetm_tc_qopt *opt,
+			   const struct dpaa2_ceetm_tc_buf_part *bp,
+			   const __u32 *hash, __u32 mask);
+int dpaa2_ceetm_check_copt(const struct dpaa2_ceetm_tc_copt *opt,
+			   const struct dpaa2_ceetm_tc_min_service *ms,
+			   const struct dpaa2_ceetm_tc_buf_part *bp,
+			   const __u32 *lat, const __u32 *pkt, __u32 mask);
+
+/* Append the TCA_OPTIONS of a qdisc / class to a message of maxlen bytes.
+ * The DPAA2 change mask is only sent on change requests. The minimum
+ * service of a prio class, the buffer partition of a root qdisc or
+ * class, the latency sampling of a class queue, the packet mode of a
+ * LNI or channel shaper, the class group of a DPAA1 wbfs qdisc and the
+ * flow hashing of a weighted group are optional (NULL).
+ */
+int dpaa1_ceetm_put_qopt(struct nlmsghdr *n, int maxlen,
+			 const struct tc_ceetm_qopt *opt,
+			 const struct tc_ceetm_buf_part *bp, const __u32 *pkt,
+			 const struct tc_ceetm_wbfs_group *grp,
+			 const __u32 *hash);
+int dpaa1_ceetm_put_copt(struct nlmsghdr *n, int maxlen,
+			 const struct tc_ceetm_copt *opt,
+			 const struct tc_ceetm_min_service *ms,
+			 const struct tc_ceetm_buf_part *bp, const __u32 *lat,
+			 const __u32 *pkt);
+int dpaa2_ceetm_put_qopt(struct nlmsghdr *n, int maxlen,
+			 const struct dpaa2_ceetm_tc_qopt *opt,
+			 const struct dpaa2_ceetm_tc_buf_part *bp,
+			 const __u32 *hash, __u32 mask);
+int dpaa2_ceetm_put_copt(struct nlmsghdr *n, int maxlen,
+			 const struct dpaa2_ceetm_tc_copt *opt,
+			 const struct dpaa2_ceetm_tc_min_service *ms,
+			 const struct dpaa2_ceetm_tc_buf_part *bp,
+			 const __u32 *lat, const __u32 *pkt, __u32 mask);
+
+/* Validate and append the options to an initialised request */
+int dpaa1_ceetm_qdisc_req(struct ceetm_req *req,
+			  const struct tc_ceetm_qopt *opt,
+			  const struct tc_ceetm_buf_part *bp, const __u32 *pkt,
+			  const struct tc_ceetm_wbfs_group *grp,
+			  const __u32 *hash);
+int dpaa1_ceetm_class_req(struct ceetm_req *req,
+			  const struct tc_ceetm_copt *opt,
+			  const struct tc_ceetm_min_service *ms,
+			  const struct tc_ceetm_buf_part *bp, const __u32 *lat,
+			  const __u32 *pkt);
+int dpaa2_ceetm_qdisc_req(struct ceetm_req *req,
+			  const struct dpaa2_ceetm_tc_qopt *opt,
+			  const struct dpaa2_ceetm_tc_buf_part *bp,
+			  const __u32 *hash, __u32 mask);
+int dpaa2_ceetm_class_req(struct ceetm_req *req,
+			  const struct dpaa2_ceetm_tc_copt *opt,
+			  const struct dpaa2_ceetm_tc_min_service *ms,
+			  const struct dpaa2_ceetm_tc_buf_part *bp,
+			  const __u32 *lat, const __u32 *pkt, __u32 mask);
+
+/* The frequent run-time changes, for either backend */
+int ceetm_channel_shaper_req(struct ceetm_req *req, enum dpaa_version ver,
+			     int ifindex, __u32 classid, __u64 cir, __u64 eir);
+int ceetm_cq_weight_req(struct ceetm_req *req, enum dpaa_version ver,
+			int ifindex, __u32 classid, unsigned int weight);
+
+int ceetm_req_send(struct ceetm_nl *nl, struct ceetm_req *req);
+
+void ceetm_batch_init(struct ceetm_batch *b, void *buf, int size);
+int ceetm_batch_add(struct ceetm_batch *b, const struct ceetm_req *req);
+int ceetm_batch_send(struct ceetm_nl *nl, struct ceetm_batch *b, int *failed);
+
+/* Copy the xstats payload into the structure, zeroing the fields an older
+ * kernel does not report. -EINVAL if the payload is too short.
+ */
+int dpaa1_ceetm_get_xstats(const struct rtattr *xstats,
+			   struct tc_ceetm_xstats *st);
+int dpaa2_ceetm_get_xstats(const struct rtattr *xstats,
+			   struct dpaa2_ceetm_tc_xstats *st);
+/* Transmit queues the tools show, one per CPU on current SoCs */
+#define CEETM_MAX_TXQ_XSTATS	64
+
+/* Copy up to max per transmit queue entries, found at the end of the
+ * xstats payload. Returns the number of entries reported, which can be above
+ * max, 0 if the kernel does not report them.
+ */
+int dpaa1_ceetm_get_txq_xstats(const struct rtattr *xstats,
+			       struct tc_ceetm_txq_xstats *txq, int max);
+int dpaa2_ceetm_get_txq_xstats(const struct rtattr *xstats,
+			       struct dpaa2_ceetm_tc_txq_xstats *txq, int max);
+/* Sojourn time in ns below which a share q (0 to 1) of the samples fall,
+ * interpolated within the log2 bucket and bounded by the largest sample.
+ */
+__u64 ceetm_lat_percentile(const __u64 *hist, __u64 max_ns, double q);
+
+/* Packet rates of the shapers in packet mode, written as 2Mpps */
+int ceetm_get_pps(__u64 *pps, const char *str);
+int ceetm_sprint_pps(char *buf, int len, __u64 pps);
+int ceetm_xstats_dump(struct ceetm_nl *nl, enum dpaa_version ver,
+		      int ifindex, ceetm_xstats_cb_t cb, void *arg);
+int ceetm_class_xstats_dump(struct ceetm_nl *nl, enum dpaa_version ver,
+			    int ifindex, ceetm_xstats_cb_t cb, void *arg);
+
+#endif
@@ -16,53 +16,59 @@
 
 #include "dpaa1_ceetm.h"
 #include "dpaa2_ceetm.h"
+#include "ceetm_soc.h"
 
-/* DPAA SoC identifier.
- * If this is not available, assume the board is DPAA2.
+/* A shaper counting frames needs a SoC that can. The parsers are shared
+ * with ceetmctl, whose plans name their SoC and are checked against it:
+ * only the requests of tc are checked against the running one here.
  */
-#define DPAA_SOC_ID_FILE	"/sys/devices/soc0/soc_id"
-
-#define SVR_LS1043A_FAMILY	0x87920000
-#define SVR_LS1046A_FAMILY	0x87070000
-#define SVR_MASK		0xffff0000
-
-enum dpaa_version {
-	DPAA_1,
-	DPAA_2,
-};
-
-static enum dpaa_version detect_dpaa_version(void)
+static int ceetm_check_pps(enum dpaa_version ver, struct nlmsghdr *n)
 {
-	FILE *svr_file = fopen(DPAA_SOC_ID_FILE, "r");
-	unsigned int svr_ver, dpaa_svr_family = 0;
-
-	if (svr_file) {
-		if (fscanf(svr_file, "svr:%x", &svr_ver) > 0)
-			dpaa_svr_family = svr_ver & SVR_MASK;
-		fclose(svr_file);
+	struct tcmsg *t = NLMSG_DATA(n);
+	struct rtattr *tb[TCA_MAX + 1];
+	struct rtattr *o1[TCA_CEETM_MAX + 1];
+	struct rtattr *o2[DPAA2_CEETM_TCA_MAX];
+	struct rtattr *pkt;
+
+	parse_rtattr(tb, TCA_MAX, TCA_RTA(t),
+		     n->nlmsg_len - NLMSG_LENGTH(sizeof(*t)));
+	if (!tb[TCA_OPTIONS])
+		return 0;
+
+	if (ver == DPAA_1) {
+		parse_rtattr_nested(o1, TCA_CEETM_MAX, tb[TCA_OPTIONS]);
+		pkt = o1[TCA_CEETM_PKT_MODE];
+	} else {
+		parse_rtattr_nested(o2, DPAA2_CEETM_TCA_MAX - 1,
+				    tb[TCA_OPTIONS]);
+		pkt = o2[DPAA2_CEETM_TCA_PKT_MODE];
 	}
 
-	switch (dpaa_svr_family) {
-	case SVR_LS1043A_FAMILY:
-	case SVR_LS1046A_FAMILY:
-		return DPAA_1;
-	default:
-		return DPAA_2;
-	}
+	if (!pkt || !rta_getattr_u32(pkt) || ceetm_soc_caps()->max_pps)
+		return 0;
+
+	fprintf(stderr, "The %s shapers can not count packets.\n",
+		ceetm_soc_caps()->name);
+	return -1;
 }
 
 static int ceetm_parse_qopt(struct qdisc_util *qu, int argc, char **argv,
 		struct nlmsghdr *n)
 {
 	enum dpaa_version ver = detect_dpaa_version();
+	int ret;
 
 	switch (ver) {
 	case DPAA_1:
-		return dpaa1_ceetm_parse_qopt(qu, argc, argv, n);
+		ret = dpaa1_ceetm_parse_qopt(qu, argc, argv, n);
+		break;
 	case DPAA_2:
 	default:
-		return dpaa2_ceetm_parse_qopt(qu, argc, argv, n);
+		ret = dpaa2_ceetm_parse_qopt(qu, argc, argv, n);
+		break;
 	}
+
+	return ret ? ret : ceetm_check_pps(ver, n);
 }
 
 static int ceetm_print_qopt(struct qdisc_util *qu, FILE *f, struct rtattr *opt)
@@ -82,14 +88,19 @@ static int ceetm_parse_copt(struct qdisc_util *qu, int argc, char **argv,
 		struct nlmsghdr *n)
 {
 	enum dpaa_version ver = detect_dpaa_version();
+	int ret;
 
 	switch (ver) {
 	case DPAA_1:
-		return dpaa1_ceetm_parse_copt(qu, argc, argv, n);
+		ret = dpaa1_ceetm_parse_copt(qu, argc, argv, n);
+		break;
 	case DPAA_2:
 	default:
-		return dpaa2_ceetm_parse_copt(qu, argc, argv, n);
+		ret = dpaa2_ceetm_parse_copt(qu, argc, argv, n);
+		break;
 	}
+
+	return ret ? ret : ceetm_check_pps(ver, n);
 }
 
 static int ceetm_print_copt(struct qdisc_util *qu, FILE *f, struct rtattr *opt)